@@ -0,0 +1,179 @@
+#ifndef AIRSPACEBOOKINGUTILS_ASYNCBOOKING_H
+#define AIRSPACEBOOKINGUTILS_ASYNCBOOKING_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "library.h"
+
+namespace ab {
+
+    /**
+     * @brief A pool of threads that runs booking calls in the order they are submitted.
+     *
+     * Destroying the executor runs the tasks still queued and then joins its threads. To abandon queued and running
+     * calls instead, cancel the CancellationToken in their BookingOptions.
+     */
+    class BookingExecutor {
+    public:
+        /**
+         * @param threads the number of threads to run tasks on, at least 1
+         */
+        explicit BookingExecutor(std::size_t threads = std::thread::hardware_concurrency());
+
+        ~BookingExecutor();
+
+        BookingExecutor(const BookingExecutor &) = delete;
+
+        BookingExecutor &operator=(const BookingExecutor &) = delete;
+
+        /**
+         * @brief The executor the async booking functions use by default, with a thread per hardware thread
+         */
+        static BookingExecutor &shared();
+
+        /**
+         * @brief Run a task on the executor
+         * @param task a callable taking no arguments
+         * @return a future of the result of the task, holding any exception it throws
+         */
+        template<typename Task>
+        std::future<std::invoke_result_t<Task>> submit(Task task) {
+            using Result = std::invoke_result_t<Task>;
+            // Tasks are held in std::function, which needs a copyable callable
+            auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+            auto future = packaged->get_future();
+            enqueue([packaged]() { (*packaged)(); });
+            return future;
+        }
+
+        /**
+         * @brief Run a task on the executor and then pass its result to a callback on the same thread
+         * @param task a callable taking no arguments
+         * @param callback a callable taking a ready future of the result of the task, holding any exception it throws.
+         * Exceptions thrown by the callback are logged and dropped
+         */
+        template<typename Task, typename Callback>
+        void submit(Task task, Callback callback) {
+            using Result = std::invoke_result_t<Task>;
+            enqueue([task = std::move(task), callback = std::move(callback)]() mutable {
+                std::packaged_task<Result()> packaged(std::move(task));
+                auto future = packaged.get_future();
+                packaged();
+                callback(std::move(future));
+            });
+        }
+
+        // The number of tasks queued and not yet started
+        std::size_t pending() const;
+
+        std::size_t threads() const;
+
+    private:
+        void enqueue(std::function<void()> task);
+
+        void work();
+
+        mutable std::mutex mutex;
+        std::condition_variable available;
+        std::deque<std::function<void()>> queue;
+        bool stopping = false;
+        std::vector<std::thread> workers;
+    };
+
+    /**
+     * @brief Get the H3 cells that are intersected by the trajectory with their time slices, without blocking.
+     *
+     * The booking runs on the executor with copies of its arguments. Set options.cancellation to abandon it and
+     * options.deadline to bound how long it may take, counting time spent queued. Calls running at the same time must
+     * not share options.stats or options.memoryResource, which are not thread safe, and the memory resource must
+     * outlive the call. See getH3CellBookings for the other parameters.
+     * @param executor the executor to book on
+     * @return a future of the cell bookings, holding a BookingCancelledError if the booking is cancelled or a
+     * BookingLimitError if it runs past its deadline
+     */
+    std::future<std::vector<CellBooking>>
+    getH3CellBookingsAsync(std::vector<d4::StateVector4D> trajectory4D, int temporalBackwardBuffer = 60 * 5,
+                           int temporalForwardBuffer = 60 * 10, FPScalar spatialLateralBuffer = 100,
+                           FPScalar spatialVerticalBuffer = 30, int h3Resolution = 8, BookingOptions options = {},
+                           BookingExecutor &executor = BookingExecutor::shared());
+
+    /**
+     * @brief Get the H3 cells that are intersected by the volume with their time slices, without blocking.
+     *
+     * See getH3CellBookingsAsync and getH3VolumeBookings.
+     */
+    std::future<std::vector<CellBooking>>
+    getH3VolumeBookingsAsync(d4::Volume4D volume4D, int h3Resolution = 8, BookingOptions options = {},
+                             BookingExecutor &executor = BookingExecutor::shared());
+
+    /**
+     * @brief Get the H3D cells that are intersected by the trajectory with their time slices, without blocking.
+     *
+     * See getH3CellBookingsAsync and getH3DCellBookings.
+     */
+    std::future<std::vector<CellBooking>>
+    getH3DCellBookingsAsync(std::vector<d4::StateVector4D> trajectory4D, int temporalBackwardBuffer = 60 * 5,
+                            int temporalForwardBuffer = 60 * 10, FPScalar spatialLateralBuffer = 100,
+                            FPScalar spatialVerticalBuffer = 30, int h3Resolution = 8, int verticalResolution = 40,
+                            BookingOptions options = {}, BookingExecutor &executor = BookingExecutor::shared());
+
+    /**
+     * @brief Get the H3D cells that are intersected by the volume with their time slices, without blocking.
+     *
+     * See getH3CellBookingsAsync and getH3DVolumeBookings.
+     */
+    std::future<std::vector<CellBooking>>
+    getH3DVolumeBookingsAsync(d4::Volume4D volume4D, int h3Resolution = 8, int verticalResolution = 40,
+                              BookingOptions options = {}, BookingExecutor &executor = BookingExecutor::shared());
+
+    /**
+     * @brief Get the S2 cells that are intersected by the trajectory with their time slices, without blocking.
+     *
+     * See getH3CellBookingsAsync and getS2CellBookings.
+     */
+    std::future<std::vector<CellBooking>>
+    getS2CellBookingsAsync(std::vector<d4::StateVector4D> trajectory4D, int temporalBackwardBuffer = 60 * 5,
+                           int temporalForwardBuffer = 60 * 10, FPScalar spatialLateralBuffer = 100,
+                           FPScalar spatialVerticalBuffer = 30, int s2Resolution = 13, BookingOptions options = {},
+                           BookingExecutor &executor = BookingExecutor::shared());
+
+    /**
+     * @brief Get the S2 cells that are intersected by the volume with their time slices, without blocking.
+     *
+     * See getH3CellBookingsAsync and getS2VolumeBookings.
+     */
+    std::future<std::vector<CellBooking>>
+    getS2VolumeBookingsAsync(d4::Volume4D volume4D, int s2Resolution = 13, BookingOptions options = {},
+                             BookingExecutor &executor = BookingExecutor::shared());
+
+    /**
+     * @brief Get the S2 3D cells that are intersected by the trajectory with their time slices, without blocking.
+     *
+     * See getH3CellBookingsAsync and getS23DCellBookings.
+     */
+    std::future<std::vector<CellBooking>>
+    getS23DCellBookingsAsync(std::vector<d4::StateVector4D> trajectory4D, int temporalBackwardBuffer = 60 * 5,
+                             int temporalForwardBuffer = 60 * 10, FPScalar spatialLateralBuffer = 100,
+                             FPScalar spatialVerticalBuffer = 30, int s2Resolution = 13, int verticalResolution = 40,
+                             BookingOptions options = {}, BookingExecutor &executor = BookingExecutor::shared());
+
+    /**
+     * @brief Get the S2 3D cells that are intersected by the volume with their time slices, without blocking.
+     *
+     * See getH3CellBookingsAsync and getS23DVolumeBookings.
+     */
+    std::future<std::vector<CellBooking>>
+    getS23DVolumeBookingsAsync(d4::Volume4D volume4D, int s2Resolution = 13, int verticalResolution = 40,
+                               BookingOptions options = {}, BookingExecutor &executor = BookingExecutor::shared());
+}
+
+#endif //AIRSPACEBOOKINGUTILS_ASYNCBOOKING_H
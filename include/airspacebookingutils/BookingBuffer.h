@@ -0,0 +1,195 @@
+#ifndef AIRSPACEBOOKINGUTILS_BOOKINGBUFFER_H
+#define AIRSPACEBOOKINGUTILS_BOOKINGBUFFER_H
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include "library.h"
+
+namespace ab {
+
+    /*
+     * A booking buffer is a fixed layout binary encoding of a set of cell bookings, for passing them between processes
+     * without parsing. In the native byte order it is
+     *
+     *   char[8]  magic "ABBOOKS\0"
+     *   uint32   version
+     *   uint32   reserved, 0
+     *   uint64   count
+     *   uint64   cellKeys[count]  packed cell IDs, see util::encodeCellKey
+     *   int64    starts[count]    booking start times in nanoseconds since the Unix epoch
+     *   int64    ends[count]      booking end times in nanoseconds since the Unix epoch
+     *
+     * Every column starts on an 8 byte boundary, so an aligned buffer can be read in place as arrays.
+     */
+
+    /**
+     * @brief The size in bytes of a booking buffer holding a number of bookings
+     */
+    std::size_t bookingBufferSize(std::size_t count);
+
+    /**
+     * @brief Encode cell bookings into a booking buffer
+     * @param bookings the cell bookings
+     * @param out bookingBufferSize(bookings.size()) bytes to write to, aligned to 8 bytes
+     * @throws std::invalid_argument if a cell ID can not be packed into a cell key
+     */
+    void encodeBookings(const std::vector<CellBooking> &bookings, void *out);
+
+    class BookingBuffer;
+
+    /**
+     * @brief Encode cell bookings into a booking buffer
+     * @throws std::invalid_argument if a cell ID can not be packed into a cell key
+     */
+    BookingBuffer encodeBookings(const std::vector<CellBooking> &bookings);
+
+    /**
+     * @brief Write cell bookings to a stream as a booking buffer, one column at a time
+     * @throws std::invalid_argument if a cell ID can not be packed into a cell key
+     * @throws std::runtime_error if the stream fails
+     */
+    void writeBookings(const std::vector<CellBooking> &bookings, std::ostream &out);
+
+    /**
+     * @brief A read only view of a booking buffer, reading its columns in place.
+     *
+     * The view does not own the buffer, which must outlive it.
+     */
+    class BookingBufferView {
+    public:
+        /**
+         * @brief View a booking buffer
+         * @param data the start of the buffer, aligned to 8 bytes
+         * @param size the size of the buffer in bytes
+         * @throws std::invalid_argument if the data is not an aligned, complete booking buffer
+         */
+        BookingBufferView(const void *data, std::size_t size);
+
+        // The number of bookings
+        std::size_t size() const {
+            return count;
+        }
+
+        // The packed cell IDs of the bookings
+        const std::uint64_t *cellKeys() const {
+            return keys;
+        }
+
+        // The start times of the bookings in nanoseconds since the Unix epoch
+        const std::int64_t *starts() const {
+            return startTimes;
+        }
+
+        // The end times of the bookings in nanoseconds since the Unix epoch
+        const std::int64_t *ends() const {
+            return endTimes;
+        }
+
+        /**
+         * @brief Decode a booking
+         */
+        CellBooking operator[](std::size_t i) const;
+
+        /**
+         * @brief Decode all bookings
+         */
+        std::vector<CellBooking> toCellBookings() const;
+
+    private:
+        std::size_t count;
+        const std::uint64_t *keys;
+        const std::int64_t *startTimes;
+        const std::int64_t *endTimes;
+    };
+
+    /**
+     * @brief An owned booking buffer, allocated aligned to 8 bytes so it can always be viewed in place
+     */
+    class BookingBuffer {
+    public:
+        /**
+         * @brief Allocate a zeroed buffer
+         * @param size the size of the buffer in bytes
+         */
+        explicit BookingBuffer(std::size_t size);
+
+        char *data() {
+            return bytes.get();
+        }
+
+        const char *data() const {
+            return bytes.get();
+        }
+
+        // The size of the buffer in bytes
+        std::size_t size() const {
+            return bufferSize;
+        }
+
+        /**
+         * @brief View the bookings in the buffer
+         * @throws std::invalid_argument if the buffer does not hold a complete booking buffer
+         */
+        BookingBufferView view() const {
+            return {data(), size()};
+        }
+
+    private:
+        struct AlignedDelete {
+            void operator()(char *p) const;
+        };
+
+        std::unique_ptr<char[], AlignedDelete> bytes;
+        std::size_t bufferSize;
+    };
+
+    /**
+     * @brief Builds a booking buffer one booking at a time, packing each booking into the columns as it is added.
+     *
+     * This lets a producer of bookings, such as a loop over the results of several booking calls, fill a buffer
+     * without first collecting a vector of cell bookings.
+     */
+    class BookingBufferWriter {
+    public:
+        /**
+         * @brief Reserve space for a number of bookings
+         */
+        void reserve(std::size_t count);
+
+        /**
+         * @brief Add a booking
+         * @throws std::invalid_argument if the cell ID can not be packed into a cell key
+         */
+        void add(const CellBooking &booking);
+
+        /**
+         * @brief Add cell bookings
+         * @throws std::invalid_argument if a cell ID can not be packed into a cell key
+         */
+        void add(const std::vector<CellBooking> &bookings);
+
+        // The number of bookings added
+        std::size_t size() const {
+            return keys.size();
+        }
+
+        /**
+         * @brief Encode the added bookings into a booking buffer
+         */
+        BookingBuffer finish() const;
+
+        /**
+         * @brief Remove all bookings
+         */
+        void clear();
+
+    private:
+        std::vector<std::uint64_t> keys;
+        std::vector<std::int64_t> starts;
+        std::vector<std::int64_t> ends;
+    };
+}
+
+#endif //AIRSPACEBOOKINGUTILS_BOOKINGBUFFER_H
@@ -0,0 +1,103 @@
+#ifndef AIRSPACEBOOKINGUTILS_BOOKINGCACHE_H
+#define AIRSPACEBOOKINGUTILS_BOOKINGCACHE_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "library.h"
+
+namespace ab {
+
+    /**
+     * @brief A least recently used cache of trajectory bookings that reuses them for repeats of the same route.
+     *
+     * Bookings are stored relative to the departure time of the trajectory, so a trajectory with identical positions,
+     * speeds and relative timings departing at a different time hits the cache and gets the same cells with time
+     * slices shifted by the change in departure time. Thread safe.
+     */
+    class BookingCache {
+    public:
+        /**
+         * @param maxBytes the approximate memory cap of the cached bookings in bytes
+         */
+        explicit BookingCache(std::size_t maxBytes = 64 * 1024 * 1024);
+
+        /**
+         * @brief Get the bookings cached for a key, shifted to a departure time
+         * @param key the cache key, see trajectoryKey
+         * @param departure the departure time to shift the bookings to
+         * @return the bookings of each level, or nullopt on a miss
+         */
+        std::optional<std::vector<std::vector<CellBooking>>> find(const std::string &key, d4::TimeInstant departure);
+
+        /**
+         * @brief Cache the bookings for a key, evicting the least recently used entries to stay within the memory cap.
+         * Bookings larger than the whole cap are not cached.
+         * @param key the cache key, see trajectoryKey
+         * @param departure the departure time of the booked trajectory
+         * @param bookings the bookings of each level
+         */
+        void insert(const std::string &key, d4::TimeInstant departure,
+                    const std::vector<std::vector<CellBooking>> &bookings);
+
+        /**
+         * @brief Remove all entries. Counters are kept
+         */
+        void clear();
+
+        /**
+         * @brief Change the memory cap, evicting entries if needed
+         */
+        void setMaxBytes(std::size_t maxBytes);
+
+        std::size_t maxBytes() const;
+
+        // The approximate memory used by cached entries in bytes
+        std::size_t bytes() const;
+
+        // The number of cached entries
+        std::size_t size() const;
+
+        std::uint64_t hits() const;
+
+        std::uint64_t misses() const;
+
+        std::uint64_t evictions() const;
+
+        /**
+         * @brief Make the cache key of a trajectory booking.
+         *
+         * The key holds positions, speeds and times relative to departure of every state vector, the buffers, the
+         * booked resolutions and the booking options that change the output.
+         * @param indexKey a description of the index systems and resolutions booked
+         */
+        static std::string trajectoryKey(const std::vector<d4::StateVector4D> &trajectory4D, int temporalBackwardBuffer,
+                                         int temporalForwardBuffer, FPScalar spatialLateralBuffer,
+                                         FPScalar spatialVerticalBuffer, const std::string &indexKey,
+                                         const BookingOptions &options);
+
+    private:
+        struct Entry {
+            std::string key;
+            std::vector<std::vector<CellBooking>> bookings;
+            std::size_t bytes;
+        };
+
+        void evict(std::size_t maxBytes);
+
+        mutable std::mutex mutex;
+        std::list<Entry> entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        std::size_t maxBytes_;
+        std::size_t bytes_ = 0;
+        std::uint64_t hits_ = 0;
+        std::uint64_t misses_ = 0;
+        std::uint64_t evictions_ = 0;
+    };
+}
+
+#endif //AIRSPACEBOOKINGUTILS_BOOKINGCACHE_H
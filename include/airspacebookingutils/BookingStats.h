@@ -0,0 +1,106 @@
+#ifndef AIRSPACEBOOKINGUTILS_BOOKINGSTATS_H
+#define AIRSPACEBOOKINGUTILS_BOOKINGSTATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace ab {
+
+    /**
+     * @brief Per-stage timings and counters of booking calls.
+     *
+     * Stats are accumulated, so a single instance can be shared across several calls and reset by assigning {}.
+     */
+    struct BookingStats {
+        // The number of booking calls recorded
+        std::uint64_t calls = 0;
+
+        // Wall time in seconds selecting and setting up the projection, including PROJ context creation
+        double setupSeconds = 0;
+        // Wall time in seconds projecting the input and rasterising trajectory ETAs
+        double etaSeconds = 0;
+        // Wall time in seconds covering the sampling grid, including reprojection and indexer calls
+        double coverageSeconds = 0;
+        // Wall time in seconds inside indexer calls. This is part of coverageSeconds
+        double indexerSeconds = 0;
+        // Wall time in seconds merging overlapping time slices per cell
+        double mergeSeconds = 0;
+        // Wall time in seconds compacting the output
+        double compactSeconds = 0;
+        // Wall time in seconds of the whole call
+        double totalSeconds = 0;
+
+        // The number of point in region tests on the sampling grid, counting block classifications
+        std::uint64_t samplesTested = 0;
+        // The number of sampling grid points inside the booked region
+        std::uint64_t samplesInside = 0;
+        // The number of calls to the cell indexer
+        std::uint64_t indexerCalls = 0;
+        // The number of coordinates forward or inverse projected
+        std::uint64_t reprojections = 0;
+        // The number of trajectory state vectors dropped by simplification
+        std::uint64_t simplifiedPoints = 0;
+        // The number of cell bookings before merging time slices
+        std::uint64_t rawBookings = 0;
+        // The number of cell bookings returned
+        std::uint64_t mergedBookings = 0;
+
+        BookingStats &operator+=(const BookingStats &other);
+
+        /**
+         * @brief Format the stats as Prometheus text exposition format counters
+         * @param prefix the metric name prefix
+         * @return the metrics text, one sample per line
+         */
+        std::string toPrometheus(const std::string &prefix = "ab_booking") const;
+    };
+
+    /**
+     * @brief Get a snapshot of the stats accumulated over every instrumented booking call in this process
+     */
+    BookingStats processBookingStats();
+
+    /**
+     * @brief Add stats to the process wide aggregate. Thread safe
+     */
+    void recordProcessBookingStats(const BookingStats &stats);
+
+    /**
+     * @brief Reset the process wide aggregate
+     */
+    void resetProcessBookingStats();
+
+    namespace util {
+        /**
+         * @brief Adds the wall time of its scope to a stats field. Does nothing when the field is null
+         */
+        class StageTimer {
+        public:
+            explicit StageTimer(double *seconds)
+                    : seconds(seconds),
+                      start(seconds ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()) {
+            }
+
+            StageTimer(BookingStats *stats, double BookingStats::*field)
+                    : StageTimer(stats ? &(stats->*field) : nullptr) {
+            }
+
+            ~StageTimer() {
+                if (seconds) {
+                    *seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                }
+            }
+
+            StageTimer(const StageTimer &) = delete;
+
+            StageTimer &operator=(const StageTimer &) = delete;
+
+        private:
+            double *seconds;
+            std::chrono::steady_clock::time_point start;
+        };
+    }
+}
+
+#endif //AIRSPACEBOOKINGUTILS_BOOKINGSTATS_H
@@ -0,0 +1,251 @@
+#ifndef AIRSPACEBOOKINGUTILS_BOOKINGSTORE_H
+#define AIRSPACEBOOKINGUTILS_BOOKINGSTORE_H
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "library.h"
+#include "util/RoaringBitmap.h"
+
+namespace ab {
+
+    /**
+     * @brief A registry of the cell bookings of operations, kept as a schedule of reservations per cell.
+     *
+     * Each cell can hold a number of operations at the same time, its capacity. This is a default for every cell with
+     * overrides for some cells, and a capacity of 0 closes a cell. Time slices that only touch at an endpoint do not
+     * overlap. Thread safe; queries can run concurrently.
+     *
+     * Alongside the schedules, each cell is numbered and a compressed bitmap of the cells occupied at some time in
+     * each fixed time bucket is kept, so bulk occupancy queries over many cells are set operations on a few bitmaps.
+     * The cells booked by each operation are indexed too, so the bookings of an operation can be found and removed
+     * without scanning the whole store.
+     */
+    class BookingStore {
+    public:
+        typedef std::uint64_t OperationId;
+        typedef d4::TimeInstant::duration Duration;
+
+        /**
+         * @param defaultCapacity the number of operations a cell without an override can hold at the same time
+         * @param occupancyBucketWidth the width of the time buckets of the occupancy bitmaps
+         */
+        explicit BookingStore(std::uint32_t defaultCapacity = 1,
+                              Duration occupancyBucketWidth = std::chrono::minutes(15));
+
+        /**
+         * @brief Add the bookings of an operation
+         */
+        void add(OperationId operation, const std::vector<CellBooking> &bookings);
+
+        /**
+         * @brief Remove the bookings of an operation, see remove(const std::vector<OperationId> &)
+         * @return the number of removed bookings
+         */
+        std::size_t remove(OperationId operation);
+
+        /**
+         * @brief Remove the bookings of several operations, such as a large cancellation.
+         *
+         * Each cell booked by any of the operations is visited once, and a cell is only cleared from the occupancy
+         * bitmap of a time bucket if none of its remaining reservations overlap that bucket.
+         * @return the number of removed bookings
+         */
+        std::size_t remove(const std::vector<OperationId> &operations);
+
+        /**
+         * @brief Get the cells an operation has bookings in
+         * @return the cell IDs, sorted
+         */
+        std::vector<std::string> cellsOf(OperationId operation) const;
+
+        /**
+         * @brief Get the operations with a reservation of a cell overlapping a time interval, such as to notify them
+         * when the cell closes
+         * @return the operations, sorted
+         */
+        std::vector<OperationId> operationsIn(const std::string &cellId, d4::TimeInstant start,
+                                              d4::TimeInstant end) const;
+
+        /**
+         * @brief Check that the bookings can be added without exceeding the capacity of their cells, so with the
+         * default capacity of 1 that no stored booking overlaps any of them. Bookings of the same cell overlapping each
+         * other count towards its load together, as they would once added
+         */
+        bool isFree(const std::vector<CellBooking> &bookings) const;
+
+        /**
+         * @brief Get the time slices of the reservations of a cell that overlap a time interval
+         * @return the time slices sorted by start
+         */
+        std::vector<d4::TimeSlice> reservedSlices(const std::string &cellId, d4::TimeInstant start,
+                                                  d4::TimeInstant end) const;
+
+        /**
+         * @brief Get the time slices over which a cell is at its capacity within a time interval, where it can not be
+         * booked
+         * @return the disjoint time slices sorted by start, clipped to the interval
+         */
+        std::vector<d4::TimeSlice> saturatedSlices(const std::string &cellId, d4::TimeInstant start,
+                                                   d4::TimeInstant end) const;
+
+        /**
+         * @brief Get the most reservations of a cell that overlap each other within a time interval
+         */
+        std::uint32_t maxOccupancy(const std::string &cellId, d4::TimeInstant start, d4::TimeInstant end) const;
+
+        /**
+         * @brief Find the cells with a reservation overlapping a time interval.
+         *
+         * The occupancy bitmaps of the time buckets inside the interval are joined and intersected with the cells,
+         * and only the cells found in the partly covered buckets at its ends are checked against their schedules.
+         * @param cellIds the cells to check
+         * @return the occupied cells, in the order they were given
+         */
+        std::vector<std::string> occupiedCells(const std::vector<std::string> &cellIds, d4::TimeInstant start,
+                                               d4::TimeInstant end) const;
+
+        /**
+         * @brief Find the cells without a reservation overlapping a time interval, see occupiedCells
+         * @return the unoccupied cells, in the order they were given
+         */
+        std::vector<std::string> unoccupiedCells(const std::vector<std::string> &cellIds, d4::TimeInstant start,
+                                                 d4::TimeInstant end) const;
+
+        /**
+         * @brief Find the earliest time offset at which a booking pattern is free.
+         *
+         * Every time slice over which a cell of the pattern is at its capacity forbids an open interval of offsets.
+         * These are merged and the first gap in the search window is returned, so a trajectory only needs booking once
+         * at a reference departure instead of once per candidate departure.
+         * @param bookings the bookings of an operation at a reference departure
+         * @param minOffset the earliest offset to the reference departure to search from
+         * @param maxOffset the latest offset to the reference departure to search to
+         * @return the earliest offset in the window at which all shifted bookings are free, or nullopt if there is none
+         */
+        std::optional<Duration> earliestFreeOffset(const std::vector<CellBooking> &bookings, Duration minOffset,
+                                                   Duration maxOffset) const;
+
+        /**
+         * @brief Set the capacity of the cells without an override
+         */
+        void setDefaultCapacity(std::uint32_t capacity);
+
+        std::uint32_t defaultCapacity() const;
+
+        /**
+         * @brief Override the capacity of a cell
+         */
+        void setCapacity(const std::string &cellId, std::uint32_t capacity);
+
+        /**
+         * @brief Get the capacity of a cell, its override if it has one or else the default
+         */
+        std::uint32_t capacity(const std::string &cellId) const;
+
+        /**
+         * @brief Load capacity overrides from a text file.
+         *
+         * Each line holds a cell ID and its capacity separated by whitespace or a comma. A cell ID of * sets the
+         * default capacity instead. Blank lines and lines starting with # are skipped.
+         * @throws std::runtime_error if the file can not be read or a line can not be parsed
+         */
+        void loadCapacities(const std::string &path);
+
+        /**
+         * @brief Remove all bookings. Capacities are kept
+         */
+        void clear();
+
+        // The number of stored bookings
+        std::size_t size() const;
+
+        // The number of cells with stored bookings
+        std::size_t cellCount() const;
+
+        // The number of operations with stored bookings
+        std::size_t operationCount() const;
+
+        Duration occupancyBucketWidth() const;
+
+        /**
+         * @brief Get the number of reservations of a cell a query over a time interval visits, which bounds its cost
+         */
+        std::size_t candidateCount(const std::string &cellId, d4::TimeInstant start, d4::TimeInstant end) const;
+
+    private:
+        // Reservations longer than this many occupancy buckets are kept apart from the others
+        static constexpr int LONG_RESERVATION_BUCKETS = 4;
+
+        struct Reservation {
+            d4::TimeInstant start;
+            d4::TimeInstant end;
+            OperationId operation;
+        };
+
+        struct CellSchedule {
+            // The number of the cell in the occupancy bitmaps
+            std::uint32_t ordinal = 0;
+            // Sorted by start, at most the long reservation length
+            std::vector<Reservation> reservations;
+            // The longest of reservations, bounding how far before a time an overlapping reservation can start
+            Duration longest{};
+            // Sorted by start, longer than the long reservation length. Kept apart so a few long holds do not widen
+            // the candidates of every query to the whole schedule
+            std::vector<Reservation> longReservations;
+
+            /**
+             * @brief Call visit on every reservation that may overlap [start, end), a superset of those that do
+             */
+            template<typename Visit>
+            void forEachCandidate(d4::TimeInstant start, d4::TimeInstant end, Visit &&visit) const;
+
+            /**
+             * @brief Call visit on the start and end of every maximal time slice within [start, end) over which at
+             * least a number of reservations overlap
+             */
+            template<typename Visit>
+            void forEachSaturated(d4::TimeInstant start, d4::TimeInstant end, std::uint32_t capacity,
+                                  Visit &&visit) const;
+
+            std::uint32_t maxOccupancy(d4::TimeInstant start, d4::TimeInstant end) const;
+        };
+
+        std::uint32_t capacityOf(const std::string &cellId) const;
+
+        std::int64_t bucketOf(d4::TimeInstant time) const;
+
+        /**
+         * @brief Remove the reservations of some operations from a cell, keeping the occupancy bitmaps in step
+         * @return the number of removed reservations
+         */
+        std::size_t removeReservations(const std::string &cellId, const std::unordered_set<OperationId> &operations);
+
+        /**
+         * @brief Flag which of the cells have a reservation overlapping a time interval
+         */
+        std::vector<bool> occupancyOf(const std::vector<std::string> &cellIds, d4::TimeInstant start,
+                                      d4::TimeInstant end) const;
+
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, CellSchedule> schedules;
+        std::uint32_t defaultCapacity_;
+        std::unordered_map<std::string, std::uint32_t> capacities;
+        Duration bucketWidth;
+        // The ordinals of the cells occupied at some time in each time bucket, by bucket index since the epoch
+        std::unordered_map<std::int64_t, util::RoaringBitmap> occupancyBuckets;
+        std::uint32_t nextOrdinal = 0;
+        // The ordinals of removed cells, reused before new ones
+        std::vector<std::uint32_t> freeOrdinals;
+        // The cells booked by each operation, possibly repeated
+        std::unordered_map<OperationId, std::vector<std::string>> operationCells;
+        std::size_t size_ = 0;
+    };
+}
+
+#endif //AIRSPACEBOOKINGUTILS_BOOKINGSTORE_H
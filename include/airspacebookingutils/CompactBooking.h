@@ -0,0 +1,96 @@
+#ifndef AIRSPACEBOOKINGUTILS_COMPACTBOOKING_H
+#define AIRSPACEBOOKINGUTILS_COMPACTBOOKING_H
+
+#include <cstdint>
+#include <vector>
+#include "library.h"
+
+namespace ab {
+
+    /**
+     * @brief A 16 byte cell booking, for holding large numbers of bookings in memory
+     */
+    struct CompactBooking {
+        // See util::encodeCellKey
+        std::uint64_t cellKey;
+        // Seconds since the epoch of the batch holding the booking
+        std::int32_t start;
+        std::int32_t end;
+
+        bool operator==(const CompactBooking &other) const {
+            return cellKey == other.cellKey && start == other.start && end == other.end;
+        }
+    };
+
+    static_assert(sizeof(CompactBooking) == 16, "Compact bookings must stay 16 bytes");
+
+    /**
+     * @brief Compact bookings sharing an epoch their times are offset from.
+     *
+     * Compacting rounds start times down and end times up to whole seconds, so a compact booking covers at least the
+     * time slice it was made from. Offsets can reach about 68 years either side of the epoch.
+     */
+    class CompactBookingBatch {
+    public:
+        /**
+         * @brief Make an empty batch
+         * @param epoch the time offsets are measured from, rounded down to a whole second
+         */
+        explicit CompactBookingBatch(d4::TimeInstant epoch = {});
+
+        /**
+         * @brief Compact cell bookings into a batch with the earliest booking start as its epoch
+         * @throws std::invalid_argument if a cell ID can not be packed or a booking is too far from the others
+         */
+        static CompactBookingBatch fromCellBookings(const std::vector<CellBooking> &bookings);
+
+        /**
+         * @brief Compact a cell booking relative to the epoch of the batch, without adding it
+         * @throws std::invalid_argument if the cell ID can not be packed or the booking is too far from the epoch
+         */
+        CompactBooking compact(const CellBooking &booking) const;
+
+        /**
+         * @brief Get the time slice of a compact booking of this batch
+         */
+        d4::TimeSlice timeSlice(const CompactBooking &booking) const;
+
+        /**
+         * @brief Expand a compact booking of this batch into a cell booking
+         */
+        CellBooking cellBooking(const CompactBooking &booking) const;
+
+        /**
+         * @brief Compact and add a cell booking
+         * @throws std::invalid_argument if the cell ID can not be packed or the booking is too far from the epoch
+         */
+        void add(const CellBooking &booking);
+
+        /**
+         * @brief Expand all bookings of the batch into cell bookings
+         */
+        std::vector<CellBooking> toCellBookings() const;
+
+        d4::TimeInstant epoch() const {
+            return epoch_;
+        }
+
+        const std::vector<CompactBooking> &bookings() const {
+            return bookings_;
+        }
+
+        std::size_t size() const {
+            return bookings_.size();
+        }
+
+        void reserve(std::size_t n) {
+            bookings_.reserve(n);
+        }
+
+    private:
+        d4::TimeInstant epoch_;
+        std::vector<CompactBooking> bookings_;
+    };
+}
+
+#endif //AIRSPACEBOOKINGUTILS_COMPACTBOOKING_H
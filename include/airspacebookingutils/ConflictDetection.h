@@ -0,0 +1,94 @@
+#ifndef AIRSPACEBOOKINGUTILS_CONFLICTDETECTION_H
+#define AIRSPACEBOOKINGUTILS_CONFLICTDETECTION_H
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "library.h"
+
+namespace ab {
+
+    /**
+     * @brief Two operations booking the same cell for overlapping time slices
+     */
+    struct Conflict {
+    public:
+        // The index of the first operation, always less than secondOperation
+        std::size_t firstOperation;
+        // The index of the second operation
+        std::size_t secondOperation;
+        // The cell both operations booked
+        std::string cellId;
+        // The time both operations booked the cell for
+        d4::TimeSlice overlap;
+
+        Conflict(std::size_t firstOperation, std::size_t secondOperation, std::string cellId,
+                 const d4::TimeSlice &overlap)
+                : firstOperation(firstOperation),
+                  secondOperation(secondOperation),
+                  cellId(std::move(cellId)),
+                  overlap(overlap) {
+        }
+    };
+
+    /**
+     * @brief Find every pair of operations that book the same cell for overlapping time slices.
+     *
+     * The bookings of all operations are flattened into (cell key, start, end, operation) records, sorted, and swept
+     * per cell. Time slices that only touch at an endpoint do not overlap. Bookings of an operation never conflict
+     * with other bookings of the same operation.
+     * @param operations the cell bookings of each operation
+     * @return the conflicts sorted by operations, then overlap start. Operations overlapping in several cells, or
+     * several times in one cell, have a conflict for each
+     */
+    std::vector<Conflict> detectConflicts(const std::vector<std::vector<CellBooking>> &operations);
+
+    /**
+     * @brief The closest point of approach of two trajectories
+     */
+    struct ClosestApproach {
+    public:
+        // The minimum 3D separation in meters
+        FPScalar distance;
+        // The lateral component of the separation at the closest approach in meters
+        FPScalar lateralDistance;
+        // The vertical component of the separation at the closest approach in meters
+        FPScalar verticalDistance;
+        // The time of the closest approach
+        d4::TimeInstant time;
+    };
+
+    /**
+     * @brief Find the 4D closest point of approach of two trajectories.
+     *
+     * Both trajectories are linearly interpolated between their state vectors in a local projection centred on them,
+     * and the separation is minimised analytically over every interval between the state vector times of either
+     * trajectory.
+     * @return the closest approach, or nullopt if the trajectories do not overlap in time
+     */
+    std::optional<ClosestApproach> closestPointOfApproach(const std::vector<d4::StateVector4D> &trajectoryA,
+                                                          const std::vector<d4::StateVector4D> &trajectoryB);
+
+    /**
+     * @brief Find the pairs of trajectories that may come within a separation of each other, to prune pairs before
+     * comparing their cell bookings.
+     *
+     * Pairs are swept by time interval and lateral bounding box first, and the closest point of approach is only
+     * found for pairs whose bounds overlap. A pair is kept if its closest approach is under the diagonal of the
+     * lateral and vertical separations. The temporal separation is covered by holding each trajectory at its end
+     * points and widening the separation by the distance either trajectory can travel within it, so the result is a
+     * superset of the pairs with overlapping bookings.
+     * @param trajectories the trajectories of each operation
+     * @param lateralSeparation the combined lateral buffers of a pair plus a margin for the cell size in meters
+     * @param verticalSeparation the combined vertical buffers of a pair plus a margin for the cell height in meters
+     * @param temporalSeparation the combined backward and forward temporal buffers of a pair in seconds
+     * @return the index pairs that may conflict, with the lower index first, sorted
+     */
+    std::vector<std::pair<std::size_t, std::size_t>>
+    conflictCandidatePairs(const std::vector<std::vector<d4::StateVector4D>> &trajectories,
+                           FPScalar lateralSeparation, FPScalar verticalSeparation,
+                           FPScalar temporalSeparation = 0);
+}
+
+#endif //AIRSPACEBOOKINGUTILS_CONFLICTDETECTION_H
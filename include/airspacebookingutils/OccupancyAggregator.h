@@ -0,0 +1,112 @@
+#ifndef AIRSPACEBOOKINGUTILS_OCCUPANCYAGGREGATOR_H
+#define AIRSPACEBOOKINGUTILS_OCCUPANCYAGGREGATOR_H
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "library.h"
+
+namespace ab {
+
+    /**
+     * @brief The occupancy of a cell by the operations booking it
+     */
+    struct CellOccupancy {
+    public:
+        std::string cellId;
+        // The start of the first time bucket of the histogram
+        d4::TimeInstant firstBucket;
+        // The number of operations occupying the cell at some time in each time bucket, from the first bucket
+        std::vector<std::uint32_t> histogram;
+        // The most operations occupying the cell at the same time
+        std::uint32_t peakConcurrency = 0;
+        // The first time slice over which peakConcurrency operations occupy the cell
+        d4::TimeSlice peak;
+        // The number of operations booking the cell
+        std::uint32_t operations = 0;
+    };
+
+    /**
+     * @brief Aggregates booking sets into per cell occupancy histograms over fixed time buckets and peak concurrency.
+     *
+     * Bookings can be added in any number of batches, such as while streaming them from a store. Occupancy counts
+     * operations, so the overlapping or touching time slices an operation books for a cell are joined first, and an
+     * operation booking several children of a cell occupies the parent once when rolled up. Time slices that only
+     * touch at an endpoint do not overlap. Cells are split into shards by a hash of their ID, and the shards are
+     * summarised in parallel. Thread safe.
+     */
+    class OccupancyAggregator {
+    public:
+        typedef std::uint64_t OperationId;
+        typedef d4::TimeInstant::duration Duration;
+
+        /**
+         * @param bucketWidth the width of the histogram time buckets
+         * @param origin a time the buckets are aligned to
+         */
+        explicit OccupancyAggregator(Duration bucketWidth, d4::TimeInstant origin = d4::TimeInstant());
+
+        /**
+         * @brief Add the bookings of an operation. Bookings of the same operation may be added in several batches, and
+         * bookings of empty time slices are ignored
+         */
+        void add(OperationId operation, const std::vector<CellBooking> &bookings);
+
+        /**
+         * @brief Summarise the occupancy of every booked cell
+         * @return the occupancy of each cell, sorted by cell ID
+         */
+        std::vector<CellOccupancy> occupancy() const;
+
+        /**
+         * @brief Summarise the occupancy of the parents of the booked cells at a coarser resolution
+         * @param indexSystem the index system of the booked cells, see parentCell
+         * @param resolution the H3 resolution or S2 level of the parents
+         * @return the occupancy of each parent cell, sorted by cell ID
+         */
+        std::vector<CellOccupancy> rollup(IndexSystem indexSystem, int resolution) const;
+
+        /**
+         * @brief Remove all bookings
+         */
+        void clear();
+
+        // The number of added bookings
+        std::size_t size() const;
+
+        // The number of booked cells
+        std::size_t cellCount() const;
+
+        Duration bucketWidth() const;
+
+        d4::TimeInstant origin() const;
+
+    private:
+        struct Occupation {
+            d4::TimeInstant start;
+            d4::TimeInstant end;
+            OperationId operation;
+        };
+
+        static constexpr std::size_t SHARDS = 64;
+        typedef std::unordered_map<std::string, std::vector<Occupation>> Shard;
+
+        static std::size_t shardOf(const std::string &cellId);
+
+        /**
+         * @brief Summarise the occupancy of the cells of a shard
+         */
+        std::vector<CellOccupancy> summarise(const Shard &shard) const;
+
+        Duration width;
+        d4::TimeInstant origin_;
+        mutable std::mutex mutex;
+        std::array<Shard, SHARDS> shards;
+        std::size_t size_ = 0;
+    };
+}
+
+#endif //AIRSPACEBOOKINGUTILS_OCCUPANCYAGGREGATOR_H
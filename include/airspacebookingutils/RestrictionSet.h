@@ -0,0 +1,124 @@
+#ifndef AIRSPACEBOOKINGUTILS_RESTRICTIONSET_H
+#define AIRSPACEBOOKINGUTILS_RESTRICTIONSET_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "library.h"
+
+namespace ab {
+
+    /**
+     * @brief Static restriction zones (airports, prisons, no fly zones) compiled once into sorted cell key sets per
+     * resolution, so checking bookings against them is a set intersection over integer keys.
+     *
+     * Sets can be saved to a file and opened again by memory mapping it, without parsing or copying the cells.
+     * Copies share the compiled or mapped cells and are thread safe to query.
+     */
+    class RestrictionSet {
+    public:
+        /**
+         * @brief A restricted cell in the file layout. Times are seconds since the epoch
+         */
+        struct Cell {
+            // See util::encodeCellKey
+            std::uint64_t cellKey;
+            std::int64_t start;
+            std::int64_t end;
+            // The index of the restriction in the compiled input
+            std::uint64_t restriction;
+        };
+
+        /**
+         * @brief Compile restriction volumes, each valid during its time slice
+         * @param restrictions the restriction volumes
+         * @param resolutions the index systems and resolutions to compile them at
+         * @param options optional booking settings. Compaction is not applied
+         * @throws std::invalid_argument if a cell ID can not be packed into a cell key
+         */
+        static RestrictionSet compile(const std::vector<d4::Volume4D> &restrictions,
+                                      const std::vector<ResolutionSpec> &resolutions,
+                                      const BookingOptions &options = {});
+
+        /**
+         * @brief Compile permanent restriction polygons between a floor and ceiling
+         * @param restrictions the restriction footprints
+         * @param floor the floor of the restrictions in meters
+         * @param ceiling the ceiling of the restrictions in meters
+         * @param resolutions the index systems and resolutions to compile them at
+         * @param options optional booking settings. Compaction is not applied
+         * @throws std::invalid_argument if a cell ID can not be packed into a cell key
+         */
+        static RestrictionSet compile(const std::vector<GeoPolygon> &restrictions, FPScalar floor, FPScalar ceiling,
+                                      const std::vector<ResolutionSpec> &resolutions,
+                                      const BookingOptions &options = {});
+
+        /**
+         * @brief Memory map a restriction set saved with save
+         * @throws std::runtime_error if the file can not be mapped or is not a restriction set
+         */
+        static RestrictionSet open(const std::string &path);
+
+        /**
+         * @brief Save the restriction set to a file that can be memory mapped with open. The file uses the native
+         * byte order
+         * @throws std::runtime_error if the file can not be written
+         */
+        void save(const std::string &path) const;
+
+        /**
+         * @brief Check if any of the bookings touches a restriction while it is valid
+         * @param bookings cell bookings at one of the compiled resolutions
+         * @param resolution the resolution of the bookings
+         * @throws std::invalid_argument if the resolution was not compiled
+         */
+        bool touches(const std::vector<CellBooking> &bookings, const ResolutionSpec &resolution) const;
+
+        /**
+         * @brief Get the restrictions the bookings touch while they are valid
+         * @param bookings cell bookings at one of the compiled resolutions
+         * @param resolution the resolution of the bookings
+         * @return the sorted indices of the touched restrictions in the compiled input
+         * @throws std::invalid_argument if the resolution was not compiled
+         */
+        std::vector<std::size_t> touchedRestrictions(const std::vector<CellBooking> &bookings,
+                                                     const ResolutionSpec &resolution) const;
+
+        /**
+         * @brief The compiled resolutions
+         */
+        std::vector<ResolutionSpec> resolutions() const;
+
+        /**
+         * @brief The number of restricted cells compiled at a resolution
+         * @throws std::invalid_argument if the resolution was not compiled
+         */
+        std::size_t cellCount(const ResolutionSpec &resolution) const;
+
+    private:
+        struct Level {
+            ResolutionSpec resolution;
+            // Sorted by cell key then start
+            const Cell *cells;
+            std::size_t size;
+        };
+
+        RestrictionSet() = default;
+
+        static RestrictionSet fromLevels(std::shared_ptr<const std::vector<std::vector<Cell>>> levelCells,
+                                         const std::vector<ResolutionSpec> &resolutions);
+
+        const Level &level(const ResolutionSpec &resolution) const;
+
+        template<typename Visit>
+        void forEachTouched(const std::vector<CellBooking> &bookings, const ResolutionSpec &resolution,
+                            Visit &&visit) const;
+
+        std::vector<Level> levels;
+        // Owns the compiled cells or the file mapping the levels point into
+        std::shared_ptr<const void> storage;
+    };
+}
+
+#endif //AIRSPACEBOOKINGUTILS_RESTRICTIONSET_H
@@ -0,0 +1,61 @@
+#ifndef AIRSPACEBOOKINGUTILS_ROUTESEARCH_H
+#define AIRSPACEBOOKINGUTILS_ROUTESEARCH_H
+
+#include <chrono>
+#include <optional>
+#include <vector>
+#include "library.h"
+#include "BookingStore.h"
+
+namespace ab {
+
+    /**
+     * @brief Settings of the free route search
+     */
+    struct RouteSearchOptions {
+        // H3 for a route at the origin altitude, or H3D to also climb and descend between vertical layers
+        IndexSystem indexSystem = IndexSystem::H3;
+        // The H3 resolution of the cells the route moves between
+        int h3Resolution = 11;
+        // The vertical resolution of H3D layers in meters
+        int verticalResolution = 40;
+        // The altitude band an H3D route may use in meters
+        FPScalar minAltitude = 0;
+        FPScalar maxAltitude = 120;
+        // The speed in meters per second, used for lateral and vertical moves
+        FPScalar speed = 15;
+        // The temporal buffers the route will be booked with in seconds. The route keeps its cells free within them
+        int temporalBackwardBuffer = 60 * 5;
+        int temporalForwardBuffer = 60 * 10;
+        // The number of rings of neighbouring cells that must also be free, to cover the lateral buffer of the route
+        int clearanceRings = 0;
+        // The longest the route may hover in a cell in seconds. Bookings of the route only cover hovers within its
+        // temporal buffers
+        FPScalar maxHover = 60;
+        // How far after departure reservations are considered. Cells are assumed free after it
+        d4::TimeInstant::duration horizon = std::chrono::hours(2);
+        // The number of search states expanded before giving up
+        std::size_t maxExpansions = 100000;
+    };
+
+    /**
+     * @brief Find the earliest arriving route between two positions through cells that are free in a booking store.
+     *
+     * This is a safe interval A* search over the H3 neighbour graph, and the vertical layers for H3D. Each cell is
+     * split into the intervals in which the route could occupy it without exceeding its capacity, given its temporal
+     * buffers and the time to cross the cell, and the route may hover to wait for a later interval.
+     * Travel times come from the distance between cell centres and the speed.
+     * @param store the bookings to avoid
+     * @param origin the (lon, lat, alt) position to depart from
+     * @param destination the (lon, lat, alt) position to arrive at
+     * @param departure the departure time
+     * @param options search settings
+     * @return the state vectors of the cell centres along the route, which can be booked with getH3CellBookings or
+     * getH3DCellBookings, or nullopt if there is no free route. A hover is a repeated state vector at a cell centre
+     */
+    std::optional<std::vector<d4::StateVector4D>>
+    findFreeRoute(const BookingStore &store, const Position &origin, const Position &destination,
+                  d4::TimeInstant departure, const RouteSearchOptions &options = {});
+}
+
+#endif //AIRSPACEBOOKINGUTILS_ROUTESEARCH_H
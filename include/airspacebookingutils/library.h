@@ -1,10 +1,18 @@
 #ifndef AIRSPACEBOOKINGUTILS_LIBRARY_H
 #define AIRSPACEBOOKINGUTILS_LIBRARY_H
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <Eigen/Dense>
 #include <ranges>
+#include <stdexcept>
 #include <utility>
+#include "BookingStats.h"
+#include "util/ScratchArena.h"
 
 namespace ab {
     namespace d4 {
@@ -82,6 +90,176 @@ namespace ab {
         }
     };
 
+    /**
+     * @brief The projection used for the metric work in the booking pipeline
+     */
+    enum class ProjectionMode {
+        // LocalTangentPlane if the input lies within BookingOptions::localProjectionMaxRadius of its centroid,
+        // otherwise EckertVI
+        Auto,
+        // Inline azimuthal equidistant projection centred on the centroid of the input
+        LocalTangentPlane,
+        // PROJ ESRI:54010 transform, for continental scale inputs
+        EckertVI
+    };
+
+    /**
+     * @brief The spatial indexing systems cell IDs can be generated in
+     */
+    enum class IndexSystem {
+        H3,
+        H3D,
+        S2,
+        S23D
+    };
+
+    class BookingCache;
+
+    /**
+     * @brief A flag shared by its copies, set to ask the booking calls given a copy to stop
+     */
+    class CancellationToken {
+    public:
+        CancellationToken() : state(std::make_shared<std::atomic<bool>>(false)) {
+        }
+
+        void cancel() const {
+            state->store(true, std::memory_order_relaxed);
+        }
+
+        bool cancelled() const {
+            return state->load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::shared_ptr<std::atomic<bool>> state;
+    };
+
+    /**
+     * @brief Optional settings for the cell booking functions
+     */
+    struct BookingOptions {
+        // The projection to use for the metric work
+        ProjectionMode projection = ProjectionMode::Auto;
+        // The largest distance in meters from the input centroid for which ProjectionMode::Auto projects locally
+        FPScalar localProjectionMaxRadius = 100e3;
+        // Replace complete sets of sibling cells sharing a time slice with their parent cell.
+        // Applied by the H3/S2 booking functions, see compactCellBookings
+        bool compact = false;
+        // When set, per-stage timings and counters of the call are added to these stats and to the process wide
+        // aggregate, see processBookingStats
+        std::shared_ptr<BookingStats> stats;
+        // When set, trajectory bookings are cached here and reused for repeats of the same route departing at a
+        // different time, see BookingCache
+        std::shared_ptr<BookingCache> cache;
+        // When set, the temporaries of a call are allocated from this resource, which must outlive the call.
+        // Otherwise they come from an arena kept per thread and reused across calls, see util::ScratchArena
+        std::pmr::memory_resource *memoryResource = nullptr;
+        // The largest arena buffer in bytes kept for the thread after a call without a memoryResource. Calls needing
+        // more go to the heap for the rest, and a larger buffer left by an earlier call is freed. 0 frees the buffer
+        // after every call
+        std::size_t scratchRetainedBytes = util::ScratchArena::DEFAULT_MAX_RETAINED_BYTES;
+        // Simplify trajectories before booking them, dropping state vectors within this fraction of the lateral,
+        // vertical and temporal buffers of the simplified track. The buffers are grown to cover the dropped state
+        // vectors, the vertical buffer in whole 40 m sampling steps, and the original sampling grid is kept, so the
+        // cells booked and their times cover those of the original track. 0 disables simplification
+        FPScalar simplifyTolerance = 0;
+        // With ProjectionMode::Auto, book trajectories too long to project locally as tiles along the track that each
+        // have a local projection, rather than in Eckert VI. Tiles are booked in parallel and their bookings merged,
+        // so the stage times of BookingStats are summed over the tiles
+        bool tileLongTrajectories = true;
+        // Join time slices of a cell separated by at most this many seconds, such as when a trajectory loops back
+        // through a cell shortly after leaving it. 0 only joins overlapping time slices, see coalesceCellBookings
+        int temporalMergeGap = 0;
+        // The longest time slice in seconds that joining separated time slices may produce. 0 is unlimited
+        int maxMergedSliceLength = 0;
+        // Reject calls estimated to sample more than this many sampling grid points, and abort calls that do, with a
+        // BookingLimitError. 0 is unlimited, see estimateBookingCost
+        std::uint64_t maxSamples = 0;
+        // Reject calls estimated to return more than this many cell bookings, and fail calls that do, with a
+        // BookingLimitError. 0 is unlimited
+        std::uint64_t maxOutputCells = 0;
+        // Abort calls still sampling this long after they started with a BookingLimitError. 0 is unlimited
+        std::chrono::milliseconds timeLimit{0};
+        // Abort calls still running at this time with a BookingLimitError. Unlike timeLimit this also counts time
+        // spent queued, such as by the async booking functions
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        // When set, calls check it between pipeline stages and while sampling, and stop with a BookingCancelledError
+        // once it is cancelled
+        std::optional<CancellationToken> cancellation;
+    };
+
+    /**
+     * @brief Thrown when a booking call exceeds a limit set in its BookingOptions
+     */
+    class BookingLimitError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * @brief Thrown when a booking call is cancelled through the CancellationToken of its BookingOptions
+     */
+    class BookingCancelledError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * @brief A cell resolution to book at with the multi-resolution booking functions
+     */
+    struct ResolutionSpec {
+        IndexSystem indexSystem;
+        // The H3 resolution or S2 level
+        int resolution;
+        // The vertical resolution of the grid cells in meters, used by H3D and S23D
+        int verticalResolution = 40;
+
+        ResolutionSpec(IndexSystem indexSystem, int resolution, int verticalResolution = 40)
+                : indexSystem(indexSystem),
+                  resolution(resolution),
+                  verticalResolution(verticalResolution) {
+        }
+    };
+
+    /**
+     * @brief The predicted cost of a booking call
+     */
+    struct BookingCostEstimate {
+        // Sampling grid points inside the booked region
+        std::uint64_t samples = 0;
+        // Cell indexer calls, one for each vertical step of each sample
+        std::uint64_t indexerCalls = 0;
+        // Cell bookings returned, over all resolutions
+        std::uint64_t cells = 0;
+        // Bytes of the raw bookings and output of the call
+        std::uint64_t bytes = 0;
+    };
+
+    /**
+     * @brief Estimate the cost of booking a trajectory from its length, buffers and resolutions, without rasterising.
+     *
+     * Trajectories are assumed to not cross themselves and each cell to be booked once, so loops are overestimated.
+     * @param trajectory4D a vector of 4D state vectors
+     * @param resolutions the index systems and resolutions to book at
+     * @param spatialLateralBuffer the lateral spatial buffer applied to the trajectory in meters
+     * @param spatialVerticalBuffer the vertical spatial buffer applied to the trajectory in meters
+     * @return the estimated cost
+     */
+    BookingCostEstimate
+    estimateBookingCost(const std::vector<d4::StateVector4D> &trajectory4D,
+                        const std::vector<ResolutionSpec> &resolutions, FPScalar spatialLateralBuffer = 100,
+                        FPScalar spatialVerticalBuffer = 30);
+
+    /**
+     * @brief Estimate the cost of booking a volume from its footprint, altitudes and resolutions, without rasterising
+     * @param volume4D the 4d volume
+     * @param resolutions the index systems and resolutions to book at
+     * @return the estimated cost
+     */
+    BookingCostEstimate
+    estimateBookingCost(const d4::Volume4D &volume4D, const std::vector<ResolutionSpec> &resolutions);
+
     /**
      * @brief Get the H3 cells that are intersected by the trajectory with their time slices
      * @param trajectory4D a vector of 4D state vectors
@@ -90,22 +268,25 @@ namespace ab {
      * @param spatialLateralBuffer the lateral spatial buffer applied to the trajectory in meters
      * @param spatialVerticalBuffer the vertical spatial buffer applied to the trajectory in meters
      * @param h3Resolution the H3 resolution to use
+     * @param options optional booking settings
      * @return
      */
     std::vector<CellBooking>
     getH3CellBookings(const std::vector<d4::StateVector4D> &trajectory4D, int temporalBackwardBuffer = 60 * 5,
                       int temporalForwardBuffer = 60 * 10, FPScalar spatialLateralBuffer = 100,
-                      FPScalar spatialVerticalBuffer = 30, int h3Resolution = 8);
+                      FPScalar spatialVerticalBuffer = 30, int h3Resolution = 8,
+                      const BookingOptions &options = {});
 
     /**
      * @brief Get the H3 cells that are intersected by the volume with their time slices
      * @param volume4D the 4d volume
 
      * @param h3Resolution the H3 resolution to use
+     * @param options optional booking settings
      * @return
      */
     std::vector<CellBooking>
-    getH3VolumeBookings(ab::d4::Volume4D volume4D, int h3Resolution = 8);
+    getH3VolumeBookings(ab::d4::Volume4D volume4D, int h3Resolution = 8, const BookingOptions &options = {});
 
     /**
      * @brief Get the H3D cells that are intersected by the trajectory with their time slices
@@ -116,12 +297,14 @@ namespace ab {
      * @param spatialVerticalBuffer the vertical spatial buffer applied to the trajectory in meters
      * @param h3Resolution the H3 resolution to use
      * @param verticalResolution the vertical resolution of the grid cells in meters
+     * @param options optional booking settings
      * @return
      */
     std::vector<CellBooking>
     getH3DCellBookings(const std::vector<d4::StateVector4D> &trajectory4D, int temporalBackwardBuffer = 60 * 5,
                        int temporalForwardBuffer = 60 * 10, FPScalar spatialLateralBuffer = 100,
-                       FPScalar spatialVerticalBuffer = 30, int h3Resolution = 8, int verticalResolution = 40);
+                       FPScalar spatialVerticalBuffer = 30, int h3Resolution = 8, int verticalResolution = 40,
+                       const BookingOptions &options = {});
 
 
     /**
@@ -129,10 +312,12 @@ namespace ab {
      * @param volume4D the 4d volume
      * @param h3Resolution the H3 resolution to use
      * @param verticalResolution the vertical resolution of the grid cells in meters
+     * @param options optional booking settings
      * @return
      */
     std::vector<CellBooking>
-    getH3DVolumeBookings(ab::d4::Volume4D volume4D, int h3Resolution = 8, int verticalResolution = 40);
+    getH3DVolumeBookings(ab::d4::Volume4D volume4D, int h3Resolution = 8, int verticalResolution = 40,
+                         const BookingOptions &options = {});
 
     /**
      * @brief Get the S2 cells that are intersected by the trajectory with their time slices
@@ -142,22 +327,25 @@ namespace ab {
      * @param spatialLateralBuffer the lateral spatial buffer applied to the trajectory in meters
      * @param spatialVerticalBuffer the vertical spatial buffer applied to the trajectory in meters
      * @param s2Resolution the S2 resolution to use
+     * @param options optional booking settings
      * @return
      */
     std::vector<CellBooking>
     getS2CellBookings(const std::vector<d4::StateVector4D> &trajectory4D, int temporalBackwardBuffer = 60 * 5,
                       int temporalForwardBuffer = 60 * 10, FPScalar spatialLateralBuffer = 100,
-                      FPScalar spatialVerticalBuffer = 30, int s2Resolution = 13);
+                      FPScalar spatialVerticalBuffer = 30, int s2Resolution = 13,
+                      const BookingOptions &options = {});
 
 
     /**
      * @brief Get the S2 cells that are intersected by the volume with their time slices
      * @param volume4D the 4d volume
      * @param s2Resolution the S2 resolution to use
+     * @param options optional booking settings
      * @return
      */
     std::vector<CellBooking>
-    getS2VolumeBookings(ab::d4::Volume4D volume4D, int s2Resolution = 13);
+    getS2VolumeBookings(ab::d4::Volume4D volume4D, int s2Resolution = 13, const BookingOptions &options = {});
 
     /**
      * @brief Get the S2 3D cells that are intersected by the trajectory with their time slices
@@ -168,22 +356,26 @@ namespace ab {
      * @param spatialVerticalBuffer the vertical spatial buffer applied to the trajectory in meters
      * @param s2Resolution the S2 resolution to use
      * @param verticalResolution the vertical resolution of the grid cells in meters
+     * @param options optional booking settings
      * @return
      */
     std::vector<CellBooking>
     getS23DCellBookings(const std::vector<d4::StateVector4D> &trajectory4D, int temporalBackwardBuffer = 60 * 5,
                         int temporalForwardBuffer = 60 * 10, FPScalar spatialLateralBuffer = 100,
-                        FPScalar spatialVerticalBuffer = 30, int s2Resolution = 13, int verticalResolution = 40);
+                        FPScalar spatialVerticalBuffer = 30, int s2Resolution = 13, int verticalResolution = 40,
+                        const BookingOptions &options = {});
 
     /**
      * @brief Get the S2 3D cells that are intersected by the volume with their time slices
      * @param volume4D the 4d volume
      * @param s2Resolution the S2 resolution to use
      * @param verticalResolution the vertical resolution of the grid cells in meters
+     * @param options optional booking settings
      * @return
      */
     std::vector<CellBooking>
-    getS23DVolumeBookings(ab::d4::Volume4D volume4D, int s2Resolution = 13, int verticalResolution = 40);
+    getS23DVolumeBookings(ab::d4::Volume4D volume4D, int s2Resolution = 13, int verticalResolution = 40,
+                          const BookingOptions &options = {});
 
 
     std::vector<CellBooking>
@@ -191,13 +383,138 @@ namespace ab {
                            const std::function<std::string(double, double, double)> &indexer,
                            int temporalBackwardBuffer = 60 * 5,
                            int temporalForwardBuffer = 60 * 10, FPScalar spatialLateralBuffer = 100,
-                           FPScalar spatialVerticalBuffer = 30);
+                           FPScalar spatialVerticalBuffer = 30, const BookingOptions &options = {});
 
 
     std::vector<CellBooking>
     getIndexedCellBookings(ab::d4::Volume4D volume4D,
-                           const std::function<std::string(double, double, double)> &indexer);
+                           const std::function<std::string(double, double, double)> &indexer,
+                           const BookingOptions &options = {});
+
+
+    /**
+     * @brief Get the cells intersected by the trajectory at several resolutions and index systems in a single pass.
+     *
+     * The projection, ETA rasterisation and sampling sweep are shared. Each sample is indexed once at the finest
+     * H3 resolution and S2 level requested, and coarser cells are derived as their parents. For H3 this can differ
+     * from booking the coarser resolution directly near cell edges, as H3 cells are not exactly nested.
+     * @param trajectory4D a vector of 4D state vectors
+     * @param resolutions the index systems and resolutions to book at
+     * @param temporalBackwardBuffer the temporal buffer applied before the expected cell ETA in seconds
+     * @param temporalForwardBuffer the temporal buffer applied after the expected cell ETA in seconds
+     * @param spatialLateralBuffer the lateral spatial buffer applied to the trajectory in meters
+     * @param spatialVerticalBuffer the vertical spatial buffer applied to the trajectory in meters
+     * @param options optional booking settings
+     * @return the cell bookings for each of the resolutions, in the same order
+     */
+    std::vector<std::vector<CellBooking>>
+    getMultiResolutionCellBookings(const std::vector<d4::StateVector4D> &trajectory4D,
+                                   const std::vector<ResolutionSpec> &resolutions, int temporalBackwardBuffer = 60 * 5,
+                                   int temporalForwardBuffer = 60 * 10, FPScalar spatialLateralBuffer = 100,
+                                   FPScalar spatialVerticalBuffer = 30, const BookingOptions &options = {});
+
+    /**
+     * @brief Get the cells intersected by the volume at several resolutions and index systems in a single pass.
+     *
+     * See getMultiResolutionCellBookings for how coarser cells are derived.
+     * @param volume4D the 4d volume
+     * @param resolutions the index systems and resolutions to book at
+     * @param options optional booking settings
+     * @return the cell bookings for each of the resolutions, in the same order
+     */
+    std::vector<std::vector<CellBooking>>
+    getMultiResolutionVolumeBookings(const d4::Volume4D &volume4D, const std::vector<ResolutionSpec> &resolutions,
+                                     const BookingOptions &options = {});
+
+    /**
+     * @brief Compact cell bookings by replacing every complete set of sibling cells booked for an identical time slice
+     * with their parent cell, recursively.
+     *
+     * H3 uses compactCells and S2 uses S2CellUnion normalisation. H3D bookings are compacted laterally within each
+     * vertical layer, as layer codes carry no hierarchy. H3D cells finer than resolution 12 and S23D cells are returned
+     * unchanged, as their layer code overwrites part of the lateral cell index.
+     * @param bookings the cell bookings to compact. These must all be of the same resolution
+     * @param indexSystem the index system the cell IDs are in
+     * @return the compacted cell bookings sorted by start time
+     */
+    std::vector<CellBooking>
+    compactCellBookings(const std::vector<CellBooking> &bookings, IndexSystem indexSystem);
+
+    /**
+     * @brief Join the time slices booked for each cell that overlap or are separated by at most a gap.
+     *
+     * Separated time slices are only joined while the joined time slice is no longer than maxSliceLength, so a cell
+     * revisited now and then is not booked for the whole of a long operation. Overlapping time slices are always
+     * joined.
+     * @param bookings the cell bookings
+     * @param gap the longest gap between time slices to join
+     * @param maxSliceLength the longest time slice joining separated time slices may produce, or zero for no limit
+     * @return the coalesced cell bookings sorted by start time
+     */
+    std::vector<CellBooking>
+    coalesceCellBookings(const std::vector<CellBooking> &bookings, d4::TimeInstant::duration gap,
+                         d4::TimeInstant::duration maxSliceLength = d4::TimeInstant::duration::zero());
 
+    /**
+     * @brief A booking of consecutive vertical layers of a lateral cell for a time slice
+     */
+    struct LayerSpanBooking {
+    public:
+        ab::d4::TimeSlice timeSlice;
+        // The H3D or S23D cell ID of the lowest layer
+        std::string cellId;
+        // The number of consecutive layers booked upwards from the lowest
+        int layers;
+
+        LayerSpanBooking(const ab::d4::TimeSlice &timeSlice, std::string cellId, int layers)
+                : timeSlice(timeSlice),
+                  cellId(std::move(cellId)),
+                  layers(layers) {
+        }
+    };
+
+    /**
+     * @brief Merge H3D or S23D bookings of adjacent vertical layers of the same lateral cell with an identical time
+     * slice into a single booking of the span of layers
+     * @param bookings the 3D cell bookings
+     * @return the layer span bookings sorted by start time
+     */
+    std::vector<LayerSpanBooking>
+    mergeVerticalLayers(const std::vector<CellBooking> &bookings);
+
+    /**
+     * @brief Expand layer span bookings back to a cell booking for each layer
+     */
+    std::vector<CellBooking>
+    expandVerticalLayers(const std::vector<LayerSpanBooking> &bookings);
+
+    /**
+     * @brief Get the parent of a cell at a coarser resolution.
+     *
+     * H3D cells keep their vertical layer. H3D cells finer than resolution 12 and S23D cells have no parent, as their
+     * layer code overwrites part of the lateral cell index.
+     * @param cellId the cell ID
+     * @param indexSystem the index system the cell ID is in
+     * @param resolution the H3 resolution or S2 level of the parent, no finer than the cell
+     * @return the parent cell ID, or the cell ID itself at its own resolution
+     */
+    std::string
+    parentCell(const std::string &cellId, IndexSystem indexSystem, int resolution);
+
+    /**
+     * @brief Simplify a trajectory with a Douglas-Peucker pass in space and booking time.
+     *
+     * A state vector is dropped if the simplified track passes within the lateral and vertical tolerances of it, and
+     * reaches it within the temporal tolerance of the original track. See util::simplifiedTrajectoryIndices
+     * @param trajectory4D a vector of 4D state vectors
+     * @param lateralTolerance the largest lateral distance to the original track in meters
+     * @param verticalTolerance the largest vertical distance to the original track in meters
+     * @param temporalTolerance the largest difference in seconds to when the original track reaches a position
+     * @return the kept state vectors, with speeds that reach the next kept state vector at its time
+     */
+    std::vector<d4::StateVector4D>
+    simplifyTrajectory(const std::vector<d4::StateVector4D> &trajectory4D, FPScalar lateralTolerance,
+                       FPScalar verticalTolerance, FPScalar temporalTolerance);
 
     std::string
     geoToH3(int h3Resolution, FPScalar latitude, FPScalar longitude);
@@ -20,9 +20,17 @@ namespace ab
 			static std::vector<ab::Index, Eigen::aligned_allocator<ab::Index>> line3d(
 				const ab::Index& start, const ab::Index& end)
 			{
-				// Collect results here
 				std::vector<ab::Index, Eigen::aligned_allocator<ab::Index>> out;
+				line3d<T>(start, end, out);
+				return out;
+			}
 
+			/**
+			 * @brief Append the points of a line to a container, so one container can be reused for many lines
+			 */
+			template <typename T = int_fast32_t, typename Container>
+			static void line3d(const ab::Index& start, const ab::Index& end, Container& out)
+			{
 				// Split out values for readability
 				T x0 = start[0];
 				T y0 = start[1];
@@ -132,7 +140,6 @@ namespace ab
 					}
 				}
 				out.emplace_back(px, py, pz);
-				return out;
 			}
 		};
 	}
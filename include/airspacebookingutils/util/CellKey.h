@@ -0,0 +1,64 @@
+/*
+ * CellKey.h
+ *
+ * Reversible packing of short hex cell IDs (H3 indexes, H3D IDs and S2/S23D tokens up to
+ * level 28) into 64 bit integers, so bookings can be sorted, hashed and stored without
+ * string comparisons or allocations.
+ */
+
+#ifndef AB_CELLKEY_H
+#define AB_CELLKEY_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace ab::util {
+
+    /**
+     * @brief The longest cell ID that can be packed into a cell key
+     */
+    constexpr std::size_t MAX_CELL_KEY_LENGTH = 15;
+
+    /**
+     * @brief Pack a lowercase hex cell ID of at most 15 characters into a cell key.
+     *
+     * The hex value occupies the upper 60 bits and the ID length the lower 4 bits, so IDs with leading zeros stay
+     * distinct and decodeCellKey recovers the exact ID.
+     * @return the cell key, or nullopt if the ID is too long or not lowercase hex
+     */
+    static inline std::optional<std::uint64_t> encodeCellKey(std::string_view cellId) {
+        if (cellId.size() > MAX_CELL_KEY_LENGTH) return std::nullopt;
+        std::uint64_t value = 0;
+        for (const char c: cellId) {
+            std::uint64_t digit;
+            if (c >= '0' && c <= '9') {
+                digit = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            } else {
+                return std::nullopt;
+            }
+            value = value << 4 | digit;
+        }
+        return value << 4 | cellId.size();
+    }
+
+    /**
+     * @brief Unpack a cell key made by encodeCellKey into its cell ID
+     */
+    static inline std::string decodeCellKey(std::uint64_t key) {
+        static constexpr char digits[] = "0123456789abcdef";
+        const std::size_t length = key & 0xF;
+        std::uint64_t value = key >> 4;
+        std::string cellId(length, '0');
+        for (std::size_t i = length; i-- > 0;) {
+            cellId[i] = digits[value & 0xF];
+            value >>= 4;
+        }
+        return cellId;
+    }
+}
+
+#endif // AB_CELLKEY_H
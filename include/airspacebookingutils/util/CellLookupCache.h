@@ -0,0 +1,206 @@
+/*
+ * CellLookupCache.h
+ *
+ * A small direct mapped cache of lateral cell lookups. Every sample column is indexed once
+ * per vertical layer at an identical (lat, lng), so caching on the exact coordinate skips
+ * the repeated latLngToCell / S2CellId conversions. Neighbouring columns along a scan row
+ * reuse the last cell looked up while they fall inside a cap inscribed in that cell, so the
+ * results stay identical to a full lookup.
+ */
+
+#ifndef AB_CELLLOOKUPCACHE_H
+#define AB_CELLLOOKUPCACHE_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace ab::util {
+
+    typedef std::array<double, 3> UnitVector;
+
+    /**
+     * @brief The unit vector of a (latitude, longitude) in degrees
+     */
+    inline UnitVector unitVector(double latitude, double longitude) {
+        const double lat = latitude * M_PI / 180, lng = longitude * M_PI / 180;
+        return {std::cos(lat) * std::cos(lng), std::cos(lat) * std::sin(lng), std::sin(lat)};
+    }
+
+    /**
+     * @brief A spherical cap around the centre of a cell that lies inside the cell
+     */
+    struct InscribedCap {
+        UnitVector centre{};
+        // The cosine of the angular radius of the cap
+        double cosRadius = 1;
+
+        /**
+         * @brief The cap of a cell bounded by great circle arcs
+         * @param centre the unit vector of a point inside the cell
+         * @param vertices the unit vectors of the vertices of the cell boundary, in order
+         * @param count the number of vertices
+         */
+        static InscribedCap of(const UnitVector &centre, const UnitVector *vertices, std::size_t count) {
+            // The sine of the angular distance to the great circle through the nearest edge
+            double minSin = 1;
+            for (std::size_t i = 0; i < count; ++i) {
+                const auto &a = vertices[i], &b = vertices[(i + 1) % count];
+                const UnitVector n{a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+                const double norm = std::sqrt(dot(n, n));
+                if (norm == 0) continue;
+                minSin = std::min(minSin, std::abs(dot(centre, n)) / norm);
+            }
+            // Shrunk so points within rounding of the boundary take the full lookup
+            return {centre, std::cos(std::asin(minSin) * (1 - MARGIN))};
+        }
+
+        bool contains(const UnitVector &point) const {
+            return dot(centre, point) > cosRadius;
+        }
+
+    private:
+        static constexpr double MARGIN = 0.02;
+
+        static double dot(const UnitVector &a, const UnitVector &b) {
+            return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+        }
+    };
+
+    /**
+     * @brief A direct mapped cache of cells keyed on an exact (resolution, latitude, longitude), which also reuses the
+     * last cell looked up for coordinates inside its inscribed cap.
+     *
+     * Not thread safe; use one instance per thread.
+     * @tparam Cell the cached cell type
+     * @tparam Size the number of slots, a power of two
+     */
+    template<typename Cell, std::size_t Size = 64>
+    class CellLookupCache {
+        static_assert(Size > 0 && (Size & (Size - 1)) == 0, "Size must be a power of two");
+
+    public:
+        /**
+         * @brief Get the cell of a coordinate, calling lookup on a miss
+         * @param lookup computes the cell of the coordinate at the resolution
+         */
+        template<typename Lookup>
+        const Cell &get(int resolution, double latitude, double longitude, Lookup &&lookup) {
+            return get(resolution, latitude, longitude, std::forward<Lookup>(lookup), nullptr);
+        }
+
+        /**
+         * @brief Get the cell of a coordinate, calling lookup on a miss, and reusing the last cell looked up while the
+         * coordinate is inside its inscribed cap
+         * @param lookup computes the cell of the coordinate at the resolution
+         * @param cap computes the InscribedCap of a cell. Only called for a cell looked up twice in a row, so cells
+         * visited once do not pay for it
+         */
+        template<typename Lookup, typename Cap>
+        const Cell &get(int resolution, double latitude, double longitude, Lookup &&lookup, Cap &&cap) {
+            const std::uint64_t latBits = bits(latitude), lngBits = bits(longitude);
+            // Mix the key so neighbouring coordinates spread over the slots
+            std::uint64_t h = (latBits ^ (lngBits * 0x9E3779B97F4A7C15ULL)) * 0xC2B2AE3D27D4EB4FULL;
+            h ^= static_cast<std::uint64_t>(resolution);
+            h ^= h >> 29;
+            h ^= h >> 13;
+            auto &entry = entries[h & (Size - 1)];
+            if (entry.valid && entry.resolution == resolution && entry.latBits == latBits
+                && entry.lngBits == lngBits) {
+                ++hits_;
+                return entry.cell;
+            }
+            constexpr bool usesCap = !std::is_same_v<std::decay_t<Cap>, std::nullptr_t>;
+            const bool sameResolution = last.valid && last.resolution == resolution;
+            if constexpr (usesCap) {
+                if (sameResolution && last.hasCap && last.cap.contains(unitVector(latitude, longitude))) {
+                    ++hits_;
+                    ++capHits_;
+                    return store(entry, last.cell, resolution, latBits, lngBits);
+                }
+            }
+            ++misses_;
+            const Cell &cell = store(entry, lookup(), resolution, latBits, lngBits);
+            if constexpr (usesCap) {
+                if (sameResolution && last.cell == cell) {
+                    if (!last.hasCap) {
+                        last.cap = cap(cell);
+                        last.hasCap = true;
+                    }
+                } else {
+                    last.cell = cell;
+                    last.resolution = resolution;
+                    last.hasCap = false;
+                    last.valid = true;
+                }
+            }
+            return cell;
+        }
+
+        std::uint64_t hits() const {
+            return hits_;
+        }
+
+        std::uint64_t misses() const {
+            return misses_;
+        }
+
+        // The hits reusing the last cell for a coordinate inside its inscribed cap
+        std::uint64_t capHits() const {
+            return capHits_;
+        }
+
+    private:
+        static std::uint64_t bits(double value) {
+            // Treat -0.0 and 0.0 as the same coordinate
+            if (value == 0) value = 0;
+            std::uint64_t out;
+            std::memcpy(&out, &value, sizeof(out));
+            return out;
+        }
+
+        struct Entry;
+
+        static const Cell &store(Entry &entry, const Cell &cell, int resolution, std::uint64_t latBits,
+                                 std::uint64_t lngBits) {
+            entry.cell = cell;
+            entry.resolution = resolution;
+            entry.latBits = latBits;
+            entry.lngBits = lngBits;
+            entry.valid = true;
+            return entry.cell;
+        }
+
+        struct Entry {
+            Cell cell{};
+            int resolution = 0;
+            std::uint64_t latBits = 0;
+            std::uint64_t lngBits = 0;
+            bool valid = false;
+        };
+
+        struct LastCell {
+            Cell cell{};
+            int resolution = 0;
+            InscribedCap cap;
+            bool hasCap = false;
+            bool valid = false;
+        };
+
+        std::array<Entry, Size> entries{};
+        LastCell last;
+        std::uint64_t hits_ = 0;
+        std::uint64_t misses_ = 0;
+        std::uint64_t capHits_ = 0;
+    };
+}
+
+#endif // AB_CELLLOOKUPCACHE_H
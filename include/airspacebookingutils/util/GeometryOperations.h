@@ -148,7 +148,9 @@ namespace ab {
         static T euclideanDistance(const Coordinate &coord, const Coordinate &otherCoord) {
             T sqSum = 0;
             for (int d = 0; d < Dimension; ++d) {
-                sqSum += (coord(d) - otherCoord(d)) * (coord(d) - otherCoord(d));
+                // Integer coordinates would overflow when squared beyond ~46 km
+                const T delta = static_cast<T>(coord(d)) - static_cast<T>(otherCoord(d));
+                sqSum += delta * delta;
             }
             return std::sqrt(sqSum);
         }
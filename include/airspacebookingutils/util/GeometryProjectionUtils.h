@@ -13,6 +13,7 @@
 #include <string>
 #include <cstdlib>
 #include "spdlog/spdlog.h"
+#include "../library.h"
 
 /**
  * None of these are templated to geos::geom::Geometry types as each geometry
@@ -296,6 +297,54 @@ namespace ab::util {
                 proj_trans(reproj, PJ_FWD, proj_coord(coordX, coordY, coordZ, coordT));
         return out;
     }
+
+    /**
+     * \brief A PROJ backed projection between EPSG:4326 and a projected CRS. Owns and destroys its PROJ objects.
+     *
+     * Geographic positions are always in (lon, lat, alt) order, regardless of the axis order of EPSG:4326.
+     */
+    class ProjProjection {
+    public:
+        explicit ProjProjection(const char *destCRS = "ESRI:54010") {
+            std::tie(reproj, reprojCtx) = makeProjObject("EPSG:4326", destCRS);
+            std::tie(revReproj, revReprojCtx) = makeProjObject(destCRS, "EPSG:4326");
+        }
+
+        ProjProjection(const ProjProjection &) = delete;
+
+        ProjProjection &operator=(const ProjProjection &) = delete;
+
+        ~ProjProjection() {
+            proj_destroy(reproj);
+            proj_context_destroy(reprojCtx);
+            proj_destroy(revReproj);
+            proj_context_destroy(revReprojCtx);
+        }
+
+        Position forward(double longitude, double latitude, double altitude) const {
+            const PJ_COORD c = proj_trans(reproj, PJ_FWD, proj_coord(latitude, longitude, altitude, 0));
+            return {c.xyz.x, c.xyz.y, c.xyz.z};
+        }
+
+        Position forward(const Position &position) const {
+            return forward(position.x(), position.y(), position.z());
+        }
+
+        Position inverse(double x, double y, double z) const {
+            const PJ_COORD c = proj_trans(revReproj, PJ_FWD, proj_coord(x, y, z, 0));
+            return {c.xyz.y, c.xyz.x, c.xyz.z};
+        }
+
+        Position inverse(const Position &position) const {
+            return inverse(position.x(), position.y(), position.z());
+        }
+
+    private:
+        PJ *reproj;
+        PJ_CONTEXT *reprojCtx;
+        PJ *revReproj;
+        PJ_CONTEXT *revReprojCtx;
+    };
 } // namespace ugr
 
 #endif // AIRSPACEBOOKING_SRC_UTILS_GEOMETRYPROJECTIONUTILS_H_
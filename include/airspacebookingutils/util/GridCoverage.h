@@ -0,0 +1,251 @@
+/*
+ * GridCoverage.h
+ *
+ * Coarse-to-fine coverage of a regular sampling grid by a region. Blocks of samples are
+ * classified against the region as a whole and only blocks straddling its boundary are
+ * subdivided, so the number of geometry tests scales with the region perimeter rather
+ * than its area.
+ */
+
+#ifndef AB_GRIDCOVERAGE_H
+#define AB_GRIDCOVERAGE_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "GeometryOperations.h"
+
+namespace ab::util {
+
+    /**
+     * @brief The relation of a block of the sampling grid to a region
+     */
+    enum class Coverage {
+        Outside,
+        Partial,
+        Inside
+    };
+
+    /**
+     * @brief Check whether a segment intersects a closed axis aligned box using Liang-Barsky clipping
+     */
+    template<typename T = ab::FPScalar>
+    static bool segmentIntersectsBox(T x0, T y0, T x1, T y1, T bxMin, T byMin, T bxMax, T byMax) {
+        const T dx = x1 - x0;
+        const T dy = y1 - y0;
+        const T p[4] = {-dx, dx, -dy, dy};
+        const T q[4] = {x0 - bxMin, bxMax - x0, y0 - byMin, byMax - y0};
+        T tMin = 0, tMax = 1;
+        for (int i = 0; i < 4; ++i) {
+            if (p[i] == 0) {
+                // Parallel to this boundary and outside of it
+                if (q[i] < 0) return false;
+                continue;
+            }
+            const T t = q[i] / p[i];
+            if (p[i] < 0) {
+                tMin = std::max(tMin, t);
+            } else {
+                tMax = std::min(tMax, t);
+            }
+            if (tMin > tMax) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief A polygon region in projected coordinates
+     */
+    template<typename P = ab::GeoPolygon>
+    class PolygonRegion {
+    public:
+        explicit PolygonRegion(const P &polygon) : polygon(polygon) {
+        }
+
+        template<typename T>
+        bool contains(const T &x, const T &y) const {
+            return isInsidePolygon(polygon, Eigen::Vector<T, 2>{x, y});
+        }
+
+        Coverage classify(ab::FPScalar xMin, ab::FPScalar yMin, ab::FPScalar xMax, ab::FPScalar yMax) const {
+            // Pad the box slightly so edges grazing it are treated as crossing
+            constexpr ab::FPScalar pad = 1e-3;
+            for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+                if (segmentIntersectsBox(polygon[j].x(), polygon[j].y(), polygon[i].x(), polygon[i].y(),
+                                         xMin - pad, yMin - pad, xMax + pad, yMax + pad)) {
+                    return Coverage::Partial;
+                }
+            }
+            // No edge crosses the box, so it lies either entirely inside or entirely outside the polygon
+            const Eigen::Vector<ab::FPScalar, 2> centre{(xMin + xMax) / 2, (yMin + yMax) / 2};
+            return isInsidePolygon(polygon, centre) ? Coverage::Inside : Coverage::Outside;
+        }
+
+    private:
+        const P &polygon;
+    };
+
+    /**
+     * @brief The region within a fixed distance of a polyline in projected coordinates, ie. the union of capsules
+     * around each of its segments.
+     *
+     * This is the exact lateral buffer of a trajectory, tested analytically rather than through a buffer polygon.
+     */
+    class CapsuleRegion {
+    public:
+        /**
+         * @param centreline the polyline vertices. Only the x and y coordinates are used
+         * @param radius the distance from the polyline
+         */
+        template<typename C>
+        CapsuleRegion(const C &centreline, ab::FPScalar radius) : radius(radius) {
+            vertices.reserve(centreline.size());
+            for (const auto &p: centreline) {
+                vertices.push_back({static_cast<ab::FPScalar>(p.x()), static_cast<ab::FPScalar>(p.y())});
+            }
+        }
+
+        /**
+         * @brief The squared distance from a point to the closest point on the polyline
+         */
+        ab::FPScalar distanceSquared(ab::FPScalar x, ab::FPScalar y) const {
+            if (vertices.size() == 1) {
+                return pointSegmentDistanceSquared(x, y, vertices[0], vertices[0]);
+            }
+            ab::FPScalar best = std::numeric_limits<ab::FPScalar>::infinity();
+            for (size_t i = 1; i < vertices.size(); ++i) {
+                best = std::min(best, pointSegmentDistanceSquared(x, y, vertices[i - 1], vertices[i]));
+            }
+            return best;
+        }
+
+        template<typename T>
+        bool contains(const T &x, const T &y) const {
+            return distanceSquared(x, y) <= radius * radius;
+        }
+
+        Coverage classify(ab::FPScalar xMin, ab::FPScalar yMin, ab::FPScalar xMax, ab::FPScalar yMax) const {
+            // The distance field is 1-Lipschitz, so every point of the box is within half its diagonal of the
+            // distance at its centre
+            const ab::FPScalar halfDiagonal = std::hypot(xMax - xMin, yMax - yMin) / 2;
+            const ab::FPScalar d = std::sqrt(distanceSquared((xMin + xMax) / 2, (yMin + yMax) / 2));
+            if (d + halfDiagonal <= radius) return Coverage::Inside;
+            if (d - halfDiagonal > radius) return Coverage::Outside;
+            return Coverage::Partial;
+        }
+
+        /**
+         * @brief The (xMin, yMin, xMax, yMax) bounds of the region
+         */
+        std::array<ab::FPScalar, 4> bounds() const {
+            std::array<ab::FPScalar, 4> b{std::numeric_limits<ab::FPScalar>::max(),
+                                          std::numeric_limits<ab::FPScalar>::max(),
+                                          std::numeric_limits<ab::FPScalar>::lowest(),
+                                          std::numeric_limits<ab::FPScalar>::lowest()};
+            for (const auto &v: vertices) {
+                b[0] = std::min(b[0], v[0] - radius);
+                b[1] = std::min(b[1], v[1] - radius);
+                b[2] = std::max(b[2], v[0] + radius);
+                b[3] = std::max(b[3], v[1] + radius);
+            }
+            return b;
+        }
+
+    private:
+        using Vertex = std::array<ab::FPScalar, 2>;
+
+        static ab::FPScalar pointSegmentDistanceSquared(ab::FPScalar x, ab::FPScalar y, const Vertex &a,
+                                                        const Vertex &b) {
+            const ab::FPScalar dx = b[0] - a[0], dy = b[1] - a[1];
+            const ab::FPScalar lengthSquared = dx * dx + dy * dy;
+            ab::FPScalar t = 0;
+            if (lengthSquared > 0) {
+                t = std::clamp(((x - a[0]) * dx + (y - a[1]) * dy) / lengthSquared,
+                               static_cast<ab::FPScalar>(0), static_cast<ab::FPScalar>(1));
+            }
+            const ab::FPScalar ex = a[0] + t * dx - x, ey = a[1] + t * dy - y;
+            return ex * ex + ey * ey;
+        }
+
+        std::vector<Vertex> vertices;
+        ab::FPScalar radius;
+    };
+
+    /**
+     * @brief Visit every point of a regular grid that is inside a region.
+     *
+     * The region must provide contains(x, y) for single samples and classify(xMin, yMin, xMax, yMax) for blocks.
+     * Visiting order is not the raster order of the grid.
+     * @param region the region to cover
+     * @param xMin the x coordinate of the first grid column
+     * @param yMin the y coordinate of the first grid row
+     * @param nx the number of grid columns
+     * @param ny the number of grid rows
+     * @param step the grid spacing
+     * @param visit called with the (x, y) coordinates of every grid point inside the region
+     * @param leafSize blocks with at most this many samples are tested sample by sample
+     * @return the number of geometry tests performed
+     */
+    template<typename Region, typename Visit>
+    static std::uint64_t coverGrid(const Region &region, int xMin, int yMin, int nx, int ny, int step, Visit &&visit,
+                                   int leafSize = 16) {
+        std::uint64_t nTests = 0;
+        // Blocks are (first column, first row, columns, rows) of the grid
+        std::vector<std::array<int, 4>> blocks;
+        if (nx > 0 && ny > 0) blocks.push_back({0, 0, nx, ny});
+        while (!blocks.empty()) {
+            const auto [i0, j0, ni, nj] = blocks.back();
+            blocks.pop_back();
+
+            // Whole grid blocks can hold more than 2^31 samples
+            if (static_cast<std::int64_t>(ni) * nj <= leafSize) {
+                for (int i = i0; i < i0 + ni; ++i) {
+                    for (int j = j0; j < j0 + nj; ++j) {
+                        const int x = xMin + i * step;
+                        const int y = yMin + j * step;
+                        ++nTests;
+                        if (region.contains(x, y)) visit(x, y);
+                    }
+                }
+                continue;
+            }
+
+            ++nTests;
+            const auto coverage = region.classify(
+                    static_cast<ab::FPScalar>(xMin + static_cast<std::int64_t>(i0) * step),
+                    static_cast<ab::FPScalar>(yMin + static_cast<std::int64_t>(j0) * step),
+                    static_cast<ab::FPScalar>(xMin + static_cast<std::int64_t>(i0 + ni - 1) * step),
+                    static_cast<ab::FPScalar>(yMin + static_cast<std::int64_t>(j0 + nj - 1) * step));
+            if (coverage == Coverage::Outside) continue;
+            if (coverage == Coverage::Inside) {
+                for (int i = i0; i < i0 + ni; ++i) {
+                    for (int j = j0; j < j0 + nj; ++j) {
+                        visit(xMin + i * step, yMin + j * step);
+                    }
+                }
+                continue;
+            }
+            // Partial, so split along the longer side
+            if (ni >= nj) {
+                blocks.push_back({i0, j0, ni / 2, nj});
+                blocks.push_back({i0 + ni / 2, j0, ni - ni / 2, nj});
+            } else {
+                blocks.push_back({i0, j0, ni, nj / 2});
+                blocks.push_back({i0, j0 + nj / 2, ni, nj - nj / 2});
+            }
+        }
+        return nTests;
+    }
+
+    /**
+     * @brief The number of samples of a grid starting at min with the given step that are less than max
+     */
+    static inline int gridSize(int min, int max, int step) {
+        return max > min ? static_cast<int>((static_cast<std::int64_t>(max) - min + step - 1) / step) : 0;
+    }
+}
+
+#endif // AB_GRIDCOVERAGE_H
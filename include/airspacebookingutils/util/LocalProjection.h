@@ -0,0 +1,143 @@
+/*
+ * LocalProjection.h
+ *
+ * A header-only azimuthal equidistant projection on a spherical earth, centred on
+ * a local origin. Over drone-scale extents (tens of km) the distortion is far below
+ * the applied buffers, and unlike opaque proj_trans calls it can be fully inlined.
+ */
+
+#ifndef AB_LOCALPROJECTION_H
+#define AB_LOCALPROJECTION_H
+
+#include <cmath>
+#include "../library.h"
+#include "VectorOperations.h"
+
+namespace ab::util {
+
+    /**
+     * @brief Mean earth radius in meters (IUGG)
+     */
+    constexpr FPScalar EARTH_RADIUS = 6371008.8;
+
+    /**
+     * @brief Great circle distance in meters between two (lon, lat, alt) positions
+     */
+    static inline FPScalar haversineDistance(const Position &p0, const Position &p1) {
+        const FPScalar dLat = DEG2RAD((p1.y() - p0.y()));
+        const FPScalar dLon = DEG2RAD((p1.x() - p0.x()));
+        const FPScalar a = std::sin(dLat / 2) * std::sin(dLat / 2)
+                           + std::cos(DEG2RAD(p0.y())) * std::cos(DEG2RAD(p1.y()))
+                             * std::sin(dLon / 2) * std::sin(dLon / 2);
+        return 2 * EARTH_RADIUS * std::atan2(std::sqrt(a), std::sqrt(1 - a));
+    }
+
+    /**
+     * @brief Spherical azimuthal equidistant projection about a (lon, lat) origin.
+     *
+     * Projected coordinates are meters east (x) and north (y) of the origin. Altitude is passed through unchanged.
+     */
+    class LocalProjection {
+    public:
+        LocalProjection(FPScalar originLongitude, FPScalar originLatitude)
+                : lon0(DEG2RAD(originLongitude)),
+                  sinLat0(std::sin(DEG2RAD(originLatitude))),
+                  cosLat0(std::cos(DEG2RAD(originLatitude))) {
+        }
+
+        /**
+         * @brief Create a projection centred on the spherical centroid of a set of (lon, lat, alt) positions
+         */
+        template<typename C>
+        static LocalProjection centredOn(const C &positions) {
+            FPScalar cx = 0, cy = 0, cz = 0;
+            for (const auto &p: positions) {
+                const FPScalar lat = DEG2RAD(p.y());
+                const FPScalar lon = DEG2RAD(p.x());
+                cx += std::cos(lat) * std::cos(lon);
+                cy += std::cos(lat) * std::sin(lon);
+                cz += std::sin(lat);
+            }
+            const FPScalar lon = std::atan2(cy, cx);
+            const FPScalar lat = std::atan2(cz, std::sqrt(cx * cx + cy * cy));
+            return {RAD2DEG(lon), RAD2DEG(lat)};
+        }
+
+        /**
+         * @brief The largest great circle distance in meters from the projection origin to any of the positions
+         */
+        template<typename C>
+        FPScalar radiusOf(const C &positions) const {
+            const Position origin = this->origin();
+            FPScalar radius = 0;
+            for (const auto &p: positions) {
+                radius = std::max(radius, haversineDistance(origin, p));
+            }
+            return radius;
+        }
+
+        /**
+         * @brief The projection origin as a (lon, lat, 0) position
+         */
+        Position origin() const {
+            return {RAD2DEG(lon0), RAD2DEG(std::atan2(sinLat0, cosLat0)), 0.0};
+        }
+
+        /**
+         * @brief Project a geographic coordinate
+         * @param longitude longitude in degrees
+         * @param latitude latitude in degrees
+         * @param altitude altitude in meters
+         * @return the (x, y, altitude) projected position in meters
+         */
+        inline Position forward(FPScalar longitude, FPScalar latitude, FPScalar altitude) const {
+            const FPScalar lat = DEG2RAD(latitude);
+            const FPScalar dLon = DEG2RAD(longitude) - lon0;
+            const FPScalar sinLat = std::sin(lat), cosLat = std::cos(lat);
+            const FPScalar sinDLon = std::sin(dLon), cosDLon = std::cos(dLon);
+
+            const FPScalar east = cosLat * sinDLon;
+            const FPScalar north = cosLat0 * sinLat - sinLat0 * cosLat * cosDLon;
+            const FPScalar sinC = std::sqrt(east * east + north * north);
+            const FPScalar cosC = sinLat0 * sinLat + cosLat0 * cosLat * cosDLon;
+            // Angular distance from the origin. The atan2 form stays well conditioned near the origin
+            const FPScalar c = std::atan2(sinC, cosC);
+            const FPScalar k = sinC > 0 ? EARTH_RADIUS * c / sinC : EARTH_RADIUS;
+            return {k * east, k * north, altitude};
+        }
+
+        inline Position forward(const Position &position) const {
+            return forward(position.x(), position.y(), position.z());
+        }
+
+        /**
+         * @brief Unproject a local coordinate
+         * @param x meters east of the origin
+         * @param y meters north of the origin
+         * @param z altitude in meters
+         * @return the (lon, lat, alt) geographic position in degrees
+         */
+        inline Position inverse(FPScalar x, FPScalar y, FPScalar z) const {
+            const FPScalar rho = std::sqrt(x * x + y * y);
+            if (rho == 0) {
+                return {RAD2DEG(lon0), RAD2DEG(std::atan2(sinLat0, cosLat0)), z};
+            }
+            const FPScalar c = rho / EARTH_RADIUS;
+            const FPScalar sinC = std::sin(c), cosC = std::cos(c);
+            const FPScalar lat = std::asin(cosC * sinLat0 + y * sinC * cosLat0 / rho);
+            const FPScalar lon = lon0 + std::atan2(x * sinC, rho * cosLat0 * cosC - y * sinLat0 * sinC);
+            return {RAD2DEG(std::remainder(lon, 2 * M_PI)), RAD2DEG(lat), z};
+        }
+
+        inline Position inverse(const Position &position) const {
+            return inverse(position.x(), position.y(), position.z());
+        }
+
+    private:
+        FPScalar lon0;
+        FPScalar sinLat0;
+        FPScalar cosLat0;
+    };
+}
+
+#endif // AB_LOCALPROJECTION_H
@@ -0,0 +1,32 @@
+/*
+ * Parallel.h
+ *
+ * Parallel algorithm helpers that use the parallel STL when the library is built with TBB
+ * and fall back to the sequential algorithms otherwise.
+ */
+
+#ifndef AB_PARALLEL_H
+#define AB_PARALLEL_H
+
+#include <algorithm>
+
+#ifdef AB_HAS_TBB
+#include <execution>
+#endif
+
+namespace ab::util {
+
+    /**
+     * @brief Sort a range, in parallel if available
+     */
+    template<typename It, typename Compare>
+    static void parallelSort(It first, It last, Compare compare) {
+#ifdef AB_HAS_TBB
+        std::sort(std::execution::par_unseq, first, last, compare);
+#else
+        std::sort(first, last, compare);
+#endif
+    }
+}
+
+#endif // AB_PARALLEL_H
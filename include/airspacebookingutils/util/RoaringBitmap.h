@@ -0,0 +1,331 @@
+/*
+ * RoaringBitmap.h
+ *
+ * A compressed bitmap of 32 bit integers in the style of Roaring bitmaps. Values are split
+ * by their high 16 bits into containers that hold the low 16 bits either as a sorted array
+ * while sparse or as a 65536 bit bitmap once dense, so sets of a few scattered values and
+ * sets of most values in a range both stay small, and AND, OR and AND NOT run a container
+ * at a time.
+ */
+
+#ifndef AB_ROARINGBITMAP_H
+#define AB_ROARINGBITMAP_H
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace ab::util {
+
+    /**
+     * @brief A compressed set of 32 bit integers. Not thread safe
+     */
+    class RoaringBitmap {
+    public:
+        // The most values an array container holds before it becomes a bitmap container
+        static constexpr std::size_t ARRAY_LIMIT = 4096;
+
+        /**
+         * @brief Add a value
+         * @return whether it was not already in the set
+         */
+        bool add(std::uint32_t value) {
+            return containerFor(high(value)).add(low(value));
+        }
+
+        /**
+         * @brief Remove a value
+         * @return whether it was in the set
+         */
+        bool remove(std::uint32_t value) {
+            const auto it = find(high(value));
+            if (it == containers.end() || !it->second.remove(low(value))) return false;
+            if (it->second.cardinality == 0) containers.erase(it);
+            return true;
+        }
+
+        bool contains(std::uint32_t value) const {
+            const auto it = std::lower_bound(containers.begin(), containers.end(), high(value), keyLess);
+            return it != containers.end() && it->first == high(value) && it->second.contains(low(value));
+        }
+
+        // The number of values in the set
+        std::uint64_t cardinality() const {
+            std::uint64_t total = 0;
+            for (const auto &[key, container]: containers) {
+                total += container.cardinality;
+            }
+            return total;
+        }
+
+        bool empty() const {
+            return containers.empty();
+        }
+
+        void clear() {
+            containers.clear();
+        }
+
+        // The approximate memory used by the containers in bytes
+        std::size_t bytes() const {
+            std::size_t total = containers.capacity() * sizeof(containers.front());
+            for (const auto &[key, container]: containers) {
+                total += container.array.capacity() * sizeof(std::uint16_t)
+                         + container.bits.capacity() * sizeof(std::uint64_t);
+            }
+            return total;
+        }
+
+        /**
+         * @brief Call visit on every value in ascending order
+         */
+        template<typename Visit>
+        void forEach(Visit &&visit) const {
+            for (const auto &[key, container]: containers) {
+                const std::uint32_t base = static_cast<std::uint32_t>(key) << 16;
+                if (container.isBitmap()) {
+                    for (std::size_t w = 0; w < container.bits.size(); ++w) {
+                        for (auto word = container.bits[w]; word != 0; word &= word - 1) {
+                            visit(base | static_cast<std::uint32_t>(w * 64 + lowestBit(word)));
+                        }
+                    }
+                } else {
+                    for (const auto value: container.array) {
+                        visit(base | value);
+                    }
+                }
+            }
+        }
+
+        // The values in ascending order
+        std::vector<std::uint32_t> values() const {
+            std::vector<std::uint32_t> result;
+            result.reserve(cardinality());
+            forEach([&result](std::uint32_t value) { result.push_back(value); });
+            return result;
+        }
+
+        RoaringBitmap &operator|=(const RoaringBitmap &other) {
+            return *this = combine(*this, other, Operation::Or);
+        }
+
+        RoaringBitmap &operator&=(const RoaringBitmap &other) {
+            return *this = combine(*this, other, Operation::And);
+        }
+
+        // Remove the values of another set
+        RoaringBitmap &operator-=(const RoaringBitmap &other) {
+            return *this = combine(*this, other, Operation::AndNot);
+        }
+
+        friend RoaringBitmap operator|(const RoaringBitmap &a, const RoaringBitmap &b) {
+            return combine(a, b, Operation::Or);
+        }
+
+        friend RoaringBitmap operator&(const RoaringBitmap &a, const RoaringBitmap &b) {
+            return combine(a, b, Operation::And);
+        }
+
+        friend RoaringBitmap operator-(const RoaringBitmap &a, const RoaringBitmap &b) {
+            return combine(a, b, Operation::AndNot);
+        }
+
+        friend bool operator==(const RoaringBitmap &a, const RoaringBitmap &b) {
+            return a.values() == b.values();
+        }
+
+    private:
+        static constexpr std::size_t WORDS = 65536 / 64;
+
+        enum class Operation {
+            Or, And, AndNot
+        };
+
+        struct Container {
+            // The sorted low bits of the values while there are at most ARRAY_LIMIT, else empty
+            std::vector<std::uint16_t> array;
+            // A bit for each low bits value once there are more than ARRAY_LIMIT values, else empty
+            std::vector<std::uint64_t> bits;
+            std::uint32_t cardinality = 0;
+
+            bool isBitmap() const {
+                return !bits.empty();
+            }
+
+            bool contains(std::uint16_t value) const {
+                if (isBitmap()) return bits[value / 64] >> (value % 64) & 1;
+                return std::binary_search(array.begin(), array.end(), value);
+            }
+
+            bool add(std::uint16_t value) {
+                if (isBitmap()) {
+                    auto &word = bits[value / 64];
+                    const auto bit = std::uint64_t(1) << (value % 64);
+                    if (word & bit) return false;
+                    word |= bit;
+                } else {
+                    const auto it = std::lower_bound(array.begin(), array.end(), value);
+                    if (it != array.end() && *it == value) return false;
+                    array.insert(it, value);
+                }
+                ++cardinality;
+                normalise();
+                return true;
+            }
+
+            bool remove(std::uint16_t value) {
+                if (isBitmap()) {
+                    auto &word = bits[value / 64];
+                    const auto bit = std::uint64_t(1) << (value % 64);
+                    if (!(word & bit)) return false;
+                    word &= ~bit;
+                } else {
+                    const auto it = std::lower_bound(array.begin(), array.end(), value);
+                    if (it == array.end() || *it != value) return false;
+                    array.erase(it);
+                }
+                --cardinality;
+                normalise();
+                return true;
+            }
+
+            /**
+             * @brief Switch to the representation that suits the cardinality
+             */
+            void normalise() {
+                if (isBitmap() && cardinality <= ARRAY_LIMIT) {
+                    std::vector<std::uint16_t> values;
+                    values.reserve(cardinality);
+                    for (std::size_t w = 0; w < WORDS; ++w) {
+                        for (auto word = bits[w]; word != 0; word &= word - 1) {
+                            values.push_back(static_cast<std::uint16_t>(w * 64 + lowestBit(word)));
+                        }
+                    }
+                    array = std::move(values);
+                    // Assigning a new vector releases the memory of the old one
+                    bits = std::vector<std::uint64_t>();
+                } else if (!isBitmap() && cardinality > ARRAY_LIMIT) {
+                    bits = toBits();
+                    array = std::vector<std::uint16_t>();
+                }
+            }
+
+            std::vector<std::uint64_t> toBits() const {
+                if (isBitmap()) return bits;
+                std::vector<std::uint64_t> words(WORDS, 0);
+                for (const auto value: array) {
+                    words[value / 64] |= std::uint64_t(1) << (value % 64);
+                }
+                return words;
+            }
+        };
+
+        static std::uint16_t high(std::uint32_t value) {
+            return static_cast<std::uint16_t>(value >> 16);
+        }
+
+        static std::uint16_t low(std::uint32_t value) {
+            return static_cast<std::uint16_t>(value & 0xFFFF);
+        }
+
+        static std::size_t lowestBit(std::uint64_t word) {
+            return std::bitset<64>((word & -word) - 1).count();
+        }
+
+        static bool keyLess(const std::pair<std::uint16_t, Container> &entry, std::uint16_t key) {
+            return entry.first < key;
+        }
+
+        std::vector<std::pair<std::uint16_t, Container>>::iterator find(std::uint16_t key) {
+            const auto it = std::lower_bound(containers.begin(), containers.end(), key, keyLess);
+            return it != containers.end() && it->first == key ? it : containers.end();
+        }
+
+        Container &containerFor(std::uint16_t key) {
+            auto it = std::lower_bound(containers.begin(), containers.end(), key, keyLess);
+            if (it == containers.end() || it->first != key) it = containers.insert(it, {key, Container()});
+            return it->second;
+        }
+
+        static Container combine(const Container &a, const Container &b, Operation operation) {
+            Container result;
+            if (!a.isBitmap() && !b.isBitmap()) {
+                auto out = std::back_inserter(result.array);
+                switch (operation) {
+                    case Operation::Or:
+                        std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), out);
+                        break;
+                    case Operation::And:
+                        std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), out);
+                        break;
+                    case Operation::AndNot:
+                        std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), out);
+                        break;
+                }
+                result.cardinality = static_cast<std::uint32_t>(result.array.size());
+            } else if (!a.isBitmap() && operation != Operation::Or) {
+                // Filtering the array is cheaper than building its bitmap
+                for (const auto value: a.array) {
+                    if (b.contains(value) == (operation == Operation::And)) result.array.push_back(value);
+                }
+                result.cardinality = static_cast<std::uint32_t>(result.array.size());
+            } else if (!b.isBitmap() && operation == Operation::And) {
+                for (const auto value: b.array) {
+                    if (a.contains(value)) result.array.push_back(value);
+                }
+                result.cardinality = static_cast<std::uint32_t>(result.array.size());
+            } else {
+                result.bits = a.toBits();
+                const auto other = b.toBits();
+                for (std::size_t w = 0; w < WORDS; ++w) {
+                    switch (operation) {
+                        case Operation::Or:
+                            result.bits[w] |= other[w];
+                            break;
+                        case Operation::And:
+                            result.bits[w] &= other[w];
+                            break;
+                        case Operation::AndNot:
+                            result.bits[w] &= ~other[w];
+                            break;
+                    }
+                    result.cardinality += static_cast<std::uint32_t>(std::bitset<64>(result.bits[w]).count());
+                }
+            }
+            result.normalise();
+            return result;
+        }
+
+        static RoaringBitmap combine(const RoaringBitmap &a, const RoaringBitmap &b, Operation operation) {
+            RoaringBitmap result;
+            auto i = a.containers.begin(), j = b.containers.begin();
+            const auto keep = [&result](std::uint16_t key, Container container) {
+                if (container.cardinality > 0) result.containers.emplace_back(key, std::move(container));
+            };
+            while (i != a.containers.end() || j != b.containers.end()) {
+                if (j == b.containers.end() || (i != a.containers.end() && i->first < j->first)) {
+                    // Only in a
+                    if (operation != Operation::And) keep(i->first, i->second);
+                    ++i;
+                } else if (i == a.containers.end() || j->first < i->first) {
+                    // Only in b
+                    if (operation == Operation::Or) keep(j->first, j->second);
+                    ++j;
+                } else {
+                    keep(i->first, combine(i->second, j->second, operation));
+                    ++i;
+                    ++j;
+                }
+            }
+            return result;
+        }
+
+        // Sorted by key, the high 16 bits of their values
+        std::vector<std::pair<std::uint16_t, Container>> containers;
+    };
+}
+
+#endif // AB_ROARINGBITMAP_H
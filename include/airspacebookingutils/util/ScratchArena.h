@@ -0,0 +1,132 @@
+/*
+ * ScratchArena.h
+ *
+ * A per-thread monotonic arena for the temporaries of a booking call. The arena keeps its
+ * initial buffer between calls on a thread and grows it to fit the largest call seen, up to
+ * a cap, so repeated calls stop going to the heap for their temporaries.
+ */
+
+#ifndef AB_SCRATCHARENA_H
+#define AB_SCRATCHARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+namespace ab::util {
+
+    /**
+     * @brief A monotonic arena that is released when it goes out of scope.
+     *
+     * The first arena alive on a thread reuses the buffer of the thread's previous arenas. Arenas nested within it
+     * start empty. Not thread safe; use one instance per thread.
+     */
+    class ScratchArena {
+    public:
+        // The default largest buffer kept for a thread between calls
+        static constexpr std::size_t DEFAULT_MAX_RETAINED_BYTES = 4 * 1024 * 1024;
+
+        /**
+         * @param maxRetainedBytes the largest buffer to keep for the thread once the arena is released. A larger
+         * buffer kept by an earlier arena is freed, and 0 frees the buffer
+         */
+        explicit ScratchArena(std::size_t maxRetainedBytes = DEFAULT_MAX_RETAINED_BYTES)
+                : maxRetainedBytes(maxRetainedBytes) {
+            auto &shared = threadBuffer();
+            if (!shared.inUse) {
+                buffer = &shared;
+                buffer->inUse = true;
+            } else {
+                buffer = &nestedBuffer;
+            }
+            if (buffer->size > 0) {
+                arena.emplace(buffer->data.get(), buffer->size, &upstream);
+            } else {
+                arena.emplace(&upstream);
+            }
+        }
+
+        ScratchArena(const ScratchArena &) = delete;
+
+        ScratchArena &operator=(const ScratchArena &) = delete;
+
+        ~ScratchArena() {
+            arena.reset();
+            if (buffer == &nestedBuffer) return;
+            // Grow the buffer to fit everything this call took from the heap, or trim it to the cap
+            const auto size = buffer->size + upstream.allocated;
+            if (upstream.allocated > 0 && size <= maxRetainedBytes) {
+                buffer->data = std::make_unique<std::byte[]>(size);
+                buffer->size = size;
+            } else if (buffer->size > maxRetainedBytes) {
+                buffer->data.reset();
+                buffer->size = 0;
+            }
+            buffer->inUse = false;
+        }
+
+        std::pmr::memory_resource *resource() {
+            return &*arena;
+        }
+
+        /**
+         * @brief The size of the buffer kept for this thread
+         */
+        static std::size_t retainedBytes() {
+            return threadBuffer().size;
+        }
+
+        /**
+         * @brief Free the buffer kept for this thread, unless an arena on the thread is using it
+         */
+        static void release() {
+            auto &shared = threadBuffer();
+            if (shared.inUse) return;
+            shared.data.reset();
+            shared.size = 0;
+        }
+
+    private:
+        struct Buffer {
+            std::unique_ptr<std::byte[]> data;
+            std::size_t size = 0;
+            bool inUse = false;
+        };
+
+        /**
+         * @brief Allocates from the heap, counting the bytes allocated
+         */
+        class CountingResource : public std::pmr::memory_resource {
+        public:
+            std::size_t allocated = 0;
+
+        private:
+            void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+                allocated += bytes;
+                return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+            }
+
+            void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override {
+                std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+                return this == &other;
+            }
+        };
+
+        static Buffer &threadBuffer() {
+            thread_local Buffer shared;
+            return shared;
+        }
+
+        std::size_t maxRetainedBytes;
+        Buffer nestedBuffer;
+        Buffer *buffer;
+        CountingResource upstream;
+        std::optional<std::pmr::monotonic_buffer_resource> arena;
+    };
+}
+
+#endif // AB_SCRATCHARENA_H
@@ -0,0 +1,168 @@
+/*
+ * TrajectorySimplification.h
+ *
+ * Douglas-Peucker simplification of trajectories in space and booking time. High rate
+ * telemetry tracks have far more state vectors than their shape needs, and every state
+ * vector is a segment the booking pipeline rasterises, so nearly collinear points are
+ * dropped while bounding how far the track moves laterally, vertically and in time.
+ */
+
+#ifndef AB_TRAJECTORYSIMPLIFICATION_H
+#define AB_TRAJECTORYSIMPLIFICATION_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "../library.h"
+
+namespace ab::util {
+
+    /**
+     * @brief The tolerances a simplified trajectory stays within of the original
+     */
+    struct SimplificationTolerance {
+        // The largest lateral distance in meters
+        FPScalar lateral = 0;
+        // The largest vertical distance in meters
+        FPScalar vertical = 0;
+        // The largest difference in seconds of the time a position is reached
+        FPScalar temporal = 0;
+    };
+
+    namespace detail {
+        inline double seconds(d4::TimeInstant::duration duration) {
+            return std::chrono::duration<double>(duration).count();
+        }
+
+        /**
+         * @brief The speed that flies from one state vector to a later one in the time between them
+         */
+        inline FPScalar segmentSpeed(const d4::StateVector4D &from, const d4::StateVector4D &to, FPScalar length) {
+            const auto duration = seconds(to.time - from.time);
+            return duration > 0 && length > 0 ? length / duration : from.speed;
+        }
+    }
+
+    /**
+     * @brief Find the state vectors to keep to simplify a trajectory within tolerances.
+     *
+     * Segments are flown like in the booking pipeline, from the time of their first state vector at its speed. A
+     * dropped state vector is replaced by a segment between the kept state vectors either side of it, flown at the
+     * speed that takes the time between them. A state vector is only dropped if its position is within the lateral
+     * and vertical tolerances of that segment, and the time the segment reaches it is within the temporal tolerance
+     * of the times the original trajectory arrives at and leaves it. Both deviations are linear along the original
+     * segments, so the whole track stays within the tolerances.
+     * @param trajectory the trajectory
+     * @param positions the projected positions of the state vectors, in meters
+     * @param tolerance the tolerances to stay within
+     * @return the sorted indices of the state vectors to keep, always including the first and last
+     */
+    template<typename Positions>
+    std::vector<std::size_t> simplifiedTrajectoryIndices(const std::vector<d4::StateVector4D> &trajectory,
+                                                         const Positions &positions,
+                                                         const SimplificationTolerance &tolerance) {
+        const auto n = trajectory.size();
+        std::vector<std::size_t> kept;
+        if (n <= 2) {
+            for (std::size_t i = 0; i < n; ++i) {
+                kept.push_back(i);
+            }
+            return kept;
+        }
+
+        // The times the original trajectory arrives at and leaves each state vector, in seconds since departure
+        const auto departure = trajectory.front().time;
+        std::vector<std::pair<double, double>> visits(n);
+        visits[0] = {0, 0};
+        for (std::size_t i = 1; i < n; ++i) {
+            const auto &previous = trajectory[i - 1];
+            const double length = (positions[i] - positions[i - 1]).norm();
+            const double arrival = detail::seconds(previous.time - departure)
+                                   + (previous.speed > 0 ? length / previous.speed : 0);
+            const double leave = detail::seconds(trajectory[i].time - departure);
+            visits[i] = {std::min(arrival, leave), std::max(arrival, leave)};
+        }
+
+        std::vector<bool> keep(n, false);
+        keep.front() = keep.back() = true;
+        std::vector<std::pair<std::size_t, std::size_t>> spans{{0, n - 1}};
+        while (!spans.empty()) {
+            const auto [a, b] = spans.back();
+            spans.pop_back();
+            if (b - a < 2) continue;
+
+            const Position start = positions[a], end = positions[b];
+            const Position direction = end - start;
+            const double length = direction.norm();
+            const double speed = detail::segmentSpeed(trajectory[a], trajectory[b], length);
+            const double startTime = detail::seconds(trajectory[a].time - departure);
+
+            // The state vector exceeding its tolerances the most, relative to the tolerances
+            std::size_t worst = 0;
+            double worstExcess = 1;
+            for (auto k = a + 1; k < b; ++k) {
+                const Position offset = positions[k] - start;
+                const double s = length > 0 ? std::clamp(offset.dot(direction) / (length * length), 0.0, 1.0) : 0;
+                const Position deviation = offset - s * direction;
+                const double lateral = deviation.template head<2>().norm();
+                const double vertical = std::abs(deviation.z());
+                const double time = startTime + (speed > 0 ? s * length / speed : 0);
+                const double temporal = std::max({0.0, visits[k].first - time, time - visits[k].second});
+
+                const auto excess = [](double value, double limit) {
+                    return limit > 0 ? value / limit : (value > 0 ? std::numeric_limits<double>::infinity() : 0);
+                };
+                const double worstOfAxes = std::max({excess(lateral, tolerance.lateral),
+                                                     excess(vertical, tolerance.vertical),
+                                                     excess(temporal, tolerance.temporal)});
+                if (worstOfAxes > worstExcess) {
+                    worst = k;
+                    worstExcess = worstOfAxes;
+                }
+            }
+            if (worst != 0) {
+                keep[worst] = true;
+                spans.emplace_back(a, worst);
+                spans.emplace_back(worst, b);
+            }
+        }
+
+        for (std::size_t i = 0; i < n; ++i) {
+            if (keep[i]) kept.push_back(i);
+        }
+        return kept;
+    }
+
+    /**
+     * @brief Build the simplified trajectory of the kept state vectors of a trajectory.
+     *
+     * Each kept state vector takes the speed that reaches the next kept state vector at its time, unless they are at
+     * the same time or position.
+     * @param trajectory the trajectory
+     * @param positions the projected positions of the state vectors, in meters
+     * @param kept the sorted indices of the state vectors to keep
+     */
+    template<typename Positions>
+    std::vector<d4::StateVector4D> simplifiedTrajectory(const std::vector<d4::StateVector4D> &trajectory,
+                                                        const Positions &positions,
+                                                        const std::vector<std::size_t> &kept) {
+        std::vector<d4::StateVector4D> simplified;
+        simplified.reserve(kept.size());
+        for (std::size_t i = 0; i < kept.size(); ++i) {
+            const auto &sv = trajectory[kept[i]];
+            if (i + 1 < kept.size() && kept[i + 1] != kept[i] + 1) {
+                const auto length = (positions[kept[i + 1]] - positions[kept[i]]).norm();
+                simplified.emplace_back(sv.position, sv.time,
+                                        detail::segmentSpeed(sv, trajectory[kept[i + 1]], length));
+            } else {
+                simplified.push_back(sv);
+            }
+        }
+        return simplified;
+    }
+}
+
+#endif // AB_TRAJECTORYSIMPLIFICATION_H
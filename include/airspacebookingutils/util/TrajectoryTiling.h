@@ -0,0 +1,107 @@
+/*
+ * TrajectoryTiling.h
+ *
+ * Splits long trajectories into tiles that each fit a local projection. A transcontinental
+ * route projected as a whole needs a global projection, which distorts away from its
+ * centre, and its bounds cover far more area than a diagonal route does. Tiles are booked
+ * separately about their own origins and their bookings merged.
+ */
+
+#ifndef AB_TRAJECTORYTILING_H
+#define AB_TRAJECTORYTILING_H
+
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "../library.h"
+#include "LocalProjection.h"
+
+namespace ab::util {
+
+    /**
+     * @brief A run of consecutive state vectors of a trajectory and the origin to project them about
+     */
+    struct TrajectoryTile {
+        std::vector<d4::StateVector4D> trajectory;
+        // The (lon, lat, alt) position of a state vector of the tile
+        Position origin;
+    };
+
+    /**
+     * @brief Interpolate along the great circle between two (lon, lat, alt) positions
+     * @param fraction the fraction of the way from the first position to the second
+     */
+    inline Position greatCircleInterpolate(const Position &from, const Position &to, FPScalar fraction) {
+        // Great circles through the origin of an azimuthal equidistant projection are straight lines
+        const LocalProjection projection(from.x(), from.y());
+        const auto projected = projection.forward(to);
+        return projection.inverse(fraction * projected.x(), fraction * projected.y(),
+                                  from.z() + fraction * (to.z() - from.z()));
+    }
+
+    /**
+     * @brief Split a trajectory into tiles whose state vectors are all within a distance of their origin.
+     *
+     * Segments longer than half the distance are split along their great circle first, with the added state vectors
+     * reached at the speed of the segment. Consecutive tiles share the state vector at their seam, so every segment is
+     * in exactly one tile.
+     * @param trajectory the trajectory
+     * @param reach the largest great circle distance in meters from the origin of a tile to its state vectors
+     * @return the tiles in trajectory order
+     */
+    inline std::vector<TrajectoryTile> trajectoryTiles(const std::vector<d4::StateVector4D> &trajectory,
+                                                       FPScalar reach) {
+        if (!(reach > 0)) {
+            throw std::invalid_argument("Tile reach must be positive");
+        }
+        if (trajectory.empty()) return {};
+
+        // Densify so no segment is longer than half the reach, tracking the distance along the track
+        std::vector<d4::StateVector4D> dense{trajectory.front()};
+        std::vector<FPScalar> alongTrack{0};
+        for (std::size_t i = 1; i < trajectory.size(); ++i) {
+            const auto &previous = trajectory[i - 1];
+            const auto &current = trajectory[i];
+            const auto length = haversineDistance(previous.position, current.position);
+            const auto pieces = std::max(1, static_cast<int>(std::ceil(length / (reach / 2))));
+            for (int k = 1; k < pieces; ++k) {
+                const FPScalar fraction = static_cast<FPScalar>(k) / pieces;
+                const auto flown = previous.speed > 0
+                                   ? std::chrono::duration_cast<d4::TimeInstant::duration>(
+                                std::chrono::duration<double>(fraction * length / previous.speed))
+                                   : d4::TimeInstant::duration::zero();
+                dense.emplace_back(greatCircleInterpolate(previous.position, current.position, fraction),
+                                   previous.time + flown, previous.speed);
+                alongTrack.push_back(alongTrack.back() + length / pieces);
+            }
+            dense.push_back(current);
+            alongTrack.push_back(alongTrack.back() + length / pieces);
+        }
+
+        std::vector<TrajectoryTile> tiles;
+        std::size_t first = 0;
+        while (true) {
+            // Extend the tile while it spans at most the reach along the track
+            auto last = std::min(first + 1, dense.size() - 1);
+            while (last + 1 < dense.size() && alongTrack[last + 1] - alongTrack[first] <= reach) {
+                ++last;
+            }
+            // Taking the origin at the middle of the tile along the track, no state vector is further than half the
+            // span plus one segment from it
+            auto middle = first;
+            const auto halfSpan = (alongTrack[last] - alongTrack[first]) / 2;
+            while (middle < last && alongTrack[middle] - alongTrack[first] < halfSpan) {
+                ++middle;
+            }
+            tiles.push_back({std::vector<d4::StateVector4D>(dense.begin() + static_cast<long>(first),
+                                                            dense.begin() + static_cast<long>(last) + 1),
+                             dense[middle].position});
+            if (last + 1 >= dense.size()) break;
+            first = last;
+        }
+        return tiles;
+    }
+}
+
+#endif // AB_TRAJECTORYTILING_H
@@ -2,7 +2,16 @@
 #include <pybind11/stl.h>
 #include <pybind11/chrono.h>
 #include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
 #include <airspacebookingutils/library.h>
+#include <airspacebookingutils/BookingBuffer.h>
+#include <airspacebookingutils/BookingCache.h>
+#include <airspacebookingutils/BookingStore.h>
+#include <airspacebookingutils/CompactBooking.h>
+#include <airspacebookingutils/ConflictDetection.h>
+#include <airspacebookingutils/OccupancyAggregator.h>
+#include <airspacebookingutils/RestrictionSet.h>
+#include <airspacebookingutils/RouteSearch.h>
 
 #define STRINGIFY(x) #x
 #define MACRO_STRINGIFY(x) STRINGIFY(x)
@@ -10,6 +19,20 @@
 namespace py = pybind11;
 using namespace pybind11::literals;
 
+namespace {
+    /**
+     * @brief A booking buffer view that holds the buffer export of the Python object it views, so the buffer can not
+     * be released, such as by closing a memory map or resizing a bytearray, while the view or its arrays are alive
+     */
+    struct ExportedBookingBufferView {
+        py::buffer_info info;
+        ab::BookingBufferView view;
+
+        explicit ExportedBookingBufferView(py::buffer_info buffer)
+                : info(std::move(buffer)), view(info.ptr, info.size * info.itemsize) {}
+    };
+}
+
 PYBIND11_MODULE(_pyairspacebooking, m) {
     m.doc() = "Python bindings for airspacebookingutils";
 #ifdef VERSION_INFO
@@ -56,13 +79,297 @@ PYBIND11_MODULE(_pyairspacebooking, m) {
                  }
             );
 
+    py::enum_<ab::ProjectionMode>(m, "ProjectionMode")
+            .value("AUTO", ab::ProjectionMode::Auto)
+            .value("LOCAL_TANGENT_PLANE", ab::ProjectionMode::LocalTangentPlane)
+            .value("ECKERT_VI", ab::ProjectionMode::EckertVI);
+
+    py::enum_<ab::IndexSystem>(m, "IndexSystem")
+            .value("H3", ab::IndexSystem::H3)
+            .value("H3D", ab::IndexSystem::H3D)
+            .value("S2", ab::IndexSystem::S2)
+            .value("S23D", ab::IndexSystem::S23D);
+
+    py::class_<ab::ResolutionSpec>(m, "ResolutionSpec")
+            .def(py::init<ab::IndexSystem, int, int>(), "index_system"_a, "resolution"_a,
+                 "vertical_resolution"_a = 40)
+            .def_readwrite("index_system", &ab::ResolutionSpec::indexSystem, "Index system")
+            .def_readwrite("resolution", &ab::ResolutionSpec::resolution, "H3 resolution or S2 level")
+            .def_readwrite("vertical_resolution", &ab::ResolutionSpec::verticalResolution,
+                           "Vertical resolution of the grid cells in meters, used by H3D and S23D");
+
+    py::register_exception<ab::BookingLimitError>(m, "BookingLimitError", PyExc_RuntimeError);
+    py::register_exception<ab::BookingCancelledError>(m, "BookingCancelledError", PyExc_RuntimeError);
+
+    py::class_<ab::CancellationToken>(m, "CancellationToken")
+            .def(py::init<>())
+            .def("cancel", &ab::CancellationToken::cancel, "Ask the booking calls given this token to stop")
+            .def_property_readonly("cancelled", &ab::CancellationToken::cancelled, "Whether cancel has been called");
+
+    py::class_<ab::BookingCostEstimate>(m, "BookingCostEstimate")
+            .def_readonly("samples", &ab::BookingCostEstimate::samples,
+                          "Sampling grid points inside the booked region")
+            .def_readonly("indexer_calls", &ab::BookingCostEstimate::indexerCalls,
+                          "Cell indexer calls, one for each vertical step of each sample")
+            .def_readonly("cells", &ab::BookingCostEstimate::cells, "Cell bookings returned, over all resolutions")
+            .def_readonly("bytes", &ab::BookingCostEstimate::bytes,
+                          "Bytes of the raw bookings and output of the call");
+
+    m.def("estimate_booking_cost",
+          py::overload_cast<const std::vector<ab::d4::StateVector4D> &, const std::vector<ab::ResolutionSpec> &,
+                  ab::FPScalar, ab::FPScalar>(&ab::estimateBookingCost),
+          "Estimate the cost of booking a trajectory without rasterising it",
+          "trajectory_4d"_a, "resolutions"_a, "spatial_lateral_buffer"_a = 100.0, "spatial_vertical_buffer"_a = 30.0);
+    m.def("estimate_booking_cost",
+          py::overload_cast<const ab::d4::Volume4D &, const std::vector<ab::ResolutionSpec> &>(
+                  &ab::estimateBookingCost),
+          "Estimate the cost of booking a volume without rasterising it", "volume_4d"_a, "resolutions"_a);
+
+    py::class_<ab::BookingStats, std::shared_ptr<ab::BookingStats>>(m, "BookingStats")
+            .def(py::init<>())
+            .def_readwrite("calls", &ab::BookingStats::calls, "Number of booking calls recorded")
+            .def_readwrite("setup_seconds", &ab::BookingStats::setupSeconds,
+                           "Wall time selecting and setting up the projection")
+            .def_readwrite("eta_seconds", &ab::BookingStats::etaSeconds,
+                           "Wall time projecting the input and rasterising trajectory ETAs")
+            .def_readwrite("coverage_seconds", &ab::BookingStats::coverageSeconds,
+                           "Wall time covering the sampling grid, including reprojection and indexer calls")
+            .def_readwrite("indexer_seconds", &ab::BookingStats::indexerSeconds, "Wall time inside indexer calls")
+            .def_readwrite("merge_seconds", &ab::BookingStats::mergeSeconds,
+                           "Wall time merging overlapping time slices per cell")
+            .def_readwrite("compact_seconds", &ab::BookingStats::compactSeconds, "Wall time compacting the output")
+            .def_readwrite("total_seconds", &ab::BookingStats::totalSeconds, "Wall time of the whole call")
+            .def_readwrite("samples_tested", &ab::BookingStats::samplesTested,
+                           "Number of point in region tests on the sampling grid")
+            .def_readwrite("samples_inside", &ab::BookingStats::samplesInside,
+                           "Number of sampling grid points inside the booked region")
+            .def_readwrite("indexer_calls", &ab::BookingStats::indexerCalls, "Number of cell indexer calls")
+            .def_readwrite("reprojections", &ab::BookingStats::reprojections, "Number of coordinates projected")
+            .def_readwrite("raw_bookings", &ab::BookingStats::rawBookings,
+                           "Number of cell bookings before merging")
+            .def_readwrite("merged_bookings", &ab::BookingStats::mergedBookings, "Number of cell bookings returned")
+            .def_readwrite("simplified_points", &ab::BookingStats::simplifiedPoints,
+                           "Number of state vectors dropped by trajectory simplification")
+            .def("to_prometheus", &ab::BookingStats::toPrometheus, "prefix"_a = "ab_booking",
+                 "Format the stats as Prometheus text exposition format counters")
+            .def("__iadd__", [](ab::BookingStats &stats, const ab::BookingStats &other) -> ab::BookingStats & {
+                return stats += other;
+            }, py::return_value_policy::reference_internal);
+
+    m.def("process_booking_stats", &ab::processBookingStats,
+          "Get a snapshot of the stats accumulated over every instrumented booking call in this process");
+    m.def("reset_process_booking_stats", &ab::resetProcessBookingStats,
+          "Reset the process wide booking stats");
+
+    py::class_<ab::BookingCache, std::shared_ptr<ab::BookingCache>>(m, "BookingCache")
+            .def(py::init<std::size_t>(), "max_bytes"_a = 64 * 1024 * 1024)
+            .def_property("max_bytes", &ab::BookingCache::maxBytes, &ab::BookingCache::setMaxBytes,
+                          "Approximate memory cap of the cached bookings in bytes")
+            .def_property_readonly("bytes", &ab::BookingCache::bytes,
+                                   "Approximate memory used by cached entries in bytes")
+            .def_property_readonly("hits", &ab::BookingCache::hits, "Number of cache hits")
+            .def_property_readonly("misses", &ab::BookingCache::misses, "Number of cache misses")
+            .def_property_readonly("evictions", &ab::BookingCache::evictions, "Number of evicted entries")
+            .def("clear", &ab::BookingCache::clear, "Remove all entries")
+            .def("__len__", &ab::BookingCache::size);
+
+    py::class_<ab::BookingStore, std::shared_ptr<ab::BookingStore>>(m, "BookingStore")
+            .def(py::init<std::uint32_t, ab::BookingStore::Duration>(), "default_capacity"_a = 1,
+                 "occupancy_bucket_width"_a = ab::BookingStore::Duration(std::chrono::minutes(15)))
+            .def("add", &ab::BookingStore::add, "Add the bookings of an operation", "operation"_a, "bookings"_a)
+            .def("remove", py::overload_cast<ab::BookingStore::OperationId>(&ab::BookingStore::remove),
+                 "Remove the bookings of an operation, returning the number removed", "operation"_a)
+            .def("remove", py::overload_cast<const std::vector<ab::BookingStore::OperationId> &>(
+                         &ab::BookingStore::remove),
+                 "Remove the bookings of several operations in one batch, returning the number removed",
+                 "operations"_a)
+            .def("cells_of", &ab::BookingStore::cellsOf, "Get the sorted cells an operation has bookings in",
+                 "operation"_a)
+            .def("operations_in", &ab::BookingStore::operationsIn,
+                 "Get the sorted operations with a reservation of a cell overlapping a time interval",
+                 "cell_id"_a, "start"_a, "end"_a)
+            .def("is_free", &ab::BookingStore::isFree,
+                 "Check that each of the bookings can be added without exceeding the capacity of its cell",
+                 "bookings"_a)
+            .def("saturated_slices", &ab::BookingStore::saturatedSlices,
+                 "Get the time slices over which a cell is at its capacity within a time interval",
+                 "cell_id"_a, "start"_a, "end"_a)
+            .def("max_occupancy", &ab::BookingStore::maxOccupancy,
+                 "Get the most reservations of a cell that overlap each other within a time interval",
+                 "cell_id"_a, "start"_a, "end"_a)
+            .def_property("default_capacity", &ab::BookingStore::defaultCapacity,
+                          &ab::BookingStore::setDefaultCapacity,
+                          "Number of operations a cell without an override can hold at the same time")
+            .def("set_capacity", &ab::BookingStore::setCapacity, "Override the capacity of a cell",
+                 "cell_id"_a, "capacity"_a)
+            .def("capacity", &ab::BookingStore::capacity, "Get the capacity of a cell", "cell_id"_a)
+            .def("load_capacities", &ab::BookingStore::loadCapacities,
+                 "Load capacity overrides from lines of a cell ID and capacity, with * for the default", "path"_a)
+            .def("occupied_cells", &ab::BookingStore::occupiedCells,
+                 "Find the cells with a reservation overlapping a time interval, in the order given",
+                 "cell_ids"_a, "start"_a, "end"_a)
+            .def("unoccupied_cells", &ab::BookingStore::unoccupiedCells,
+                 "Find the cells without a reservation overlapping a time interval, in the order given",
+                 "cell_ids"_a, "start"_a, "end"_a)
+            .def("earliest_free_offset", &ab::BookingStore::earliestFreeOffset,
+                 "bookings"_a, "min_offset"_a, "max_offset"_a,
+                 R"pbdoc(
+    Find the earliest time offset at which a booking pattern is free, without booking it again per candidate departure.
+
+    Args:
+        bookings (list): the cell bookings of an operation at a reference departure
+        min_offset (timedelta): the earliest offset to the reference departure to search from
+        max_offset (timedelta): the latest offset to the reference departure to search to
+
+    Returns:
+        timedelta: the earliest offset at which all shifted bookings are free, or None if there is none
+    )pbdoc")
+            .def("clear", &ab::BookingStore::clear, "Remove all bookings")
+            .def_property_readonly("cell_count", &ab::BookingStore::cellCount,
+                                   "Number of cells with stored bookings")
+            .def_property_readonly("operation_count", &ab::BookingStore::operationCount,
+                                   "Number of operations with stored bookings")
+            .def("candidate_count", &ab::BookingStore::candidateCount,
+                 "Get the number of reservations of a cell a query over a time interval visits",
+                 "cell_id"_a, "start"_a, "end"_a)
+            .def_property_readonly("occupancy_bucket_width", &ab::BookingStore::occupancyBucketWidth,
+                                   "Width of the time buckets of the occupancy bitmaps")
+            .def("__len__", &ab::BookingStore::size);
+
+    py::class_<ab::BookingOptions>(m, "BookingOptions")
+            .def(py::init<>())
+            .def_readwrite("projection", &ab::BookingOptions::projection, "Projection used for the metric work")
+            .def_readwrite("local_projection_max_radius", &ab::BookingOptions::localProjectionMaxRadius,
+                           "Largest distance in meters from the input centroid for which AUTO projects locally")
+            .def_readwrite("compact", &ab::BookingOptions::compact,
+                           "Replace complete sibling cell sets sharing a time slice with their parent")
+            .def_readwrite("stats", &ab::BookingOptions::stats,
+                           "When set, per-stage timings and counters of each call are added to these stats")
+            .def_readwrite("cache", &ab::BookingOptions::cache,
+                           "When set, trajectory bookings are cached and reused for time shifted repeats of a route")
+            .def_readwrite("scratch_retained_bytes", &ab::BookingOptions::scratchRetainedBytes,
+                           "Largest scratch buffer in bytes kept per thread between calls, 0 frees it after each call")
+            .def_readwrite("simplify_tolerance", &ab::BookingOptions::simplifyTolerance,
+                           "Simplify trajectories within this fraction of the buffers before booking them, 0 disables")
+            .def_readwrite("tile_long_trajectories", &ab::BookingOptions::tileLongTrajectories,
+                           "With AUTO projection, book trajectories too long to project locally as tiles in parallel")
+            .def_readwrite("temporal_merge_gap", &ab::BookingOptions::temporalMergeGap,
+                           "Join time slices of a cell separated by at most this many seconds")
+            .def_readwrite("max_merged_slice_length", &ab::BookingOptions::maxMergedSliceLength,
+                           "The longest time slice in seconds that joining separated time slices may produce, "
+                           "0 is unlimited")
+            .def_readwrite("max_samples", &ab::BookingOptions::maxSamples,
+                           "Reject or abort calls sampling more grid points than this with BookingLimitError, "
+                           "0 is unlimited")
+            .def_readwrite("max_output_cells", &ab::BookingOptions::maxOutputCells,
+                           "Reject or fail calls returning more cell bookings than this with BookingLimitError, "
+                           "0 is unlimited")
+            .def_readwrite("time_limit", &ab::BookingOptions::timeLimit,
+                           "Abort calls still sampling this long after they started with BookingLimitError")
+            .def_readwrite("cancellation", &ab::BookingOptions::cancellation,
+                           "When set, calls stop with BookingCancelledError once this token is cancelled");
+
+    m.def("compact_cell_bookings", &ab::compactCellBookings, "Compact cell bookings",
+          "bookings"_a, "index_system"_a,
+          R"pbdoc(
+    Replace every complete set of sibling cells booked for an identical time slice with their parent cell
+
+    Args:
+        bookings (list): a list of cell bookings of the same resolution
+        index_system (IndexSystem): the index system the cell IDs are in
+
+    Returns:
+        list: a list of compacted cell bookings
+    )pbdoc");
+
+    m.def("simplify_trajectory", &ab::simplifyTrajectory, "Simplify a trajectory within tolerances",
+          "trajectory_4d"_a, "lateral_tolerance"_a, "vertical_tolerance"_a, "temporal_tolerance"_a,
+          R"pbdoc(
+    Drop the state vectors of a trajectory that a simplified track passes close to in space and time
+
+    Args:
+        trajectory_4d (list): a list of 4D state vectors
+        lateral_tolerance (float): the largest lateral distance to the original track in meters
+        vertical_tolerance (float): the largest vertical distance to the original track in meters
+        temporal_tolerance (float): the largest difference in seconds to when the original track reaches a position
+
+    Returns:
+        list: the kept state vectors, with speeds that reach the next kept state vector at its time
+    )pbdoc");
+
+    m.def("coalesce_cell_bookings", &ab::coalesceCellBookings, "Coalesce cell bookings",
+          "bookings"_a, "gap"_a, "max_slice_length"_a = ab::d4::TimeInstant::duration::zero(),
+          R"pbdoc(
+    Join the time slices booked for each cell that overlap or are separated by at most a gap
+
+    Args:
+        bookings (list): a list of cell bookings
+        gap (timedelta): the longest gap between time slices to join
+        max_slice_length (timedelta): the longest time slice joining separated time slices may produce, or zero for
+            no limit
+
+    Returns:
+        list: a list of coalesced cell bookings sorted by start time
+    )pbdoc");
+
+    py::class_<ab::LayerSpanBooking>(m, "LayerSpanBooking")
+            .def(py::init<const ab::d4::TimeSlice &, std::string, int>(), "time_slice"_a, "cell_id"_a, "layers"_a)
+            .def_readwrite("time_slice", &ab::LayerSpanBooking::timeSlice, "Time slice")
+            .def_readwrite("cell_id", &ab::LayerSpanBooking::cellId, "3D cell ID of the lowest layer")
+            .def_readwrite("layers", &ab::LayerSpanBooking::layers, "Number of consecutive layers booked upwards");
+
+    m.def("merge_vertical_layers", &ab::mergeVerticalLayers,
+          "Merge 3D bookings of adjacent vertical layers of a lateral cell with an identical time slice", "bookings"_a);
+    m.def("expand_vertical_layers", &ab::expandVerticalLayers,
+          "Expand layer span bookings back to a cell booking for each layer", "bookings"_a);
+    m.def("parent_cell", &ab::parentCell, "Get the parent of a cell at a coarser resolution",
+          "cell_id"_a, "index_system"_a, "resolution"_a);
+
+    py::class_<ab::CellOccupancy>(m, "CellOccupancy")
+            .def_readonly("cell_id", &ab::CellOccupancy::cellId, "Cell ID")
+            .def_readonly("first_bucket", &ab::CellOccupancy::firstBucket,
+                          "Start of the first time bucket of the histogram")
+            .def_readonly("histogram", &ab::CellOccupancy::histogram,
+                          "Number of operations occupying the cell at some time in each time bucket")
+            .def_readonly("peak_concurrency", &ab::CellOccupancy::peakConcurrency,
+                          "Most operations occupying the cell at the same time")
+            .def_readonly("peak", &ab::CellOccupancy::peak,
+                          "First time slice over which peak_concurrency operations occupy the cell")
+            .def_readonly("operations", &ab::CellOccupancy::operations, "Number of operations booking the cell");
+
+    py::class_<ab::OccupancyAggregator, std::shared_ptr<ab::OccupancyAggregator>>(m, "OccupancyAggregator")
+            .def(py::init<ab::OccupancyAggregator::Duration, ab::d4::TimeInstant>(),
+                 "bucket_width"_a, "origin"_a = ab::d4::TimeInstant())
+            .def("add", &ab::OccupancyAggregator::add,
+                 "Add the bookings of an operation, which may be split over several calls", "operation"_a, "bookings"_a)
+            .def("add_all", [](ab::OccupancyAggregator &aggregator, const py::iterable &operations) {
+                     for (const auto &item: operations) {
+                         const auto [operation, bookings] =
+                                 item.cast<std::pair<ab::OccupancyAggregator::OperationId,
+                                                     std::vector<ab::CellBooking>>>();
+                         aggregator.add(operation, bookings);
+                     }
+                 }, "Add the bookings of an iterable of (operation, bookings) pairs, such as a generator",
+                 "operations"_a)
+            .def("occupancy", &ab::OccupancyAggregator::occupancy,
+                 "Summarise the occupancy of every booked cell, sorted by cell ID")
+            .def("rollup", &ab::OccupancyAggregator::rollup,
+                 "Summarise the occupancy of the parents of the booked cells at a coarser resolution, sorted by cell ID",
+                 "index_system"_a, "resolution"_a)
+            .def("clear", &ab::OccupancyAggregator::clear, "Remove all bookings")
+            .def_property_readonly("bucket_width", &ab::OccupancyAggregator::bucketWidth, "Width of the time buckets")
+            .def_property_readonly("cell_count", &ab::OccupancyAggregator::cellCount, "Number of booked cells")
+            .def("__len__", &ab::OccupancyAggregator::size);
+
     /*
      * Trajectory Based Functions
      */
 
     m.def("get_H3_cell_bookings", &ab::getH3CellBookings, "Get H3 cell bookings",
+          py::call_guard<py::gil_scoped_release>(),
           "trajectory_4d"_a, "temporal_backward_buffer"_a = 60 * 5, "temporal_forward_buffer"_a = 60 * 10,
           "spatial_lateral_buffer"_a = 100.0, "spatial_vertical_buffer"_a = 30.0, "h3_resolution"_a = 8,
+          "options"_a = ab::BookingOptions(),
           R"pbdoc(
     Get the H3 cells that are intersected by the trajectory with their time slices
 
@@ -73,15 +380,17 @@ PYBIND11_MODULE(_pyairspacebooking, m) {
         spatial_lateral_buffer (float): the lateral spatial buffer applied to the trajectory in meters
         spatial_vertical_buffer (float): the vertical spatial buffer applied to the trajectory in meters
         h3_resolution (int): the H3 resolution to use
+        options (BookingOptions): optional booking settings
 
     Returns:
         list: a list of cell bookings
     )pbdoc");
 
     m.def("get_H3D_cell_bookings", &ab::getH3DCellBookings, "Get H3D cell bookings",
+          py::call_guard<py::gil_scoped_release>(),
           "trajectory_4d"_a, "temporal_backward_buffer"_a = 60 * 5, "temporal_forward_buffer"_a = 60 * 10,
           "spatial_lateral_buffer"_a = 100.0, "spatial_vertical_buffer"_a = 30.0, "h3_resolution"_a = 8,
-          "vertical_resolution"_a = 40,
+          "vertical_resolution"_a = 40, "options"_a = ab::BookingOptions(),
           R"pbdoc(
     Get the H3D cells that are intersected by the trajectory with their time slices
 
@@ -93,14 +402,17 @@ PYBIND11_MODULE(_pyairspacebooking, m) {
         spatial_vertical_buffer (float): the vertical spatial buffer applied to the trajectory in meters
         h3_resolution (int): the H3 resolution to use
         vertical_resolution (int): the vertical resolution of the grid cells in meters
+        options (BookingOptions): optional booking settings
 
     Returns:
         list: a list of cell bookings
     )pbdoc");
 
     m.def("get_S2_cell_bookings", &ab::getS2CellBookings, "Get S2 cell bookings",
+          py::call_guard<py::gil_scoped_release>(),
           "trajectory_4d"_a, "temporal_backward_buffer"_a = 60 * 5, "temporal_forward_buffer"_a = 60 * 10,
           "spatial_lateral_buffer"_a = 100.0, "spatial_vertical_buffer"_a = 30.0, "s2_resolution"_a = 8,
+          "options"_a = ab::BookingOptions(),
           R"pbdoc(
     Get the S2 cells that are intersected by the trajectory with their time slices
 
@@ -111,15 +423,17 @@ PYBIND11_MODULE(_pyairspacebooking, m) {
         spatial_lateral_buffer (float): the lateral spatial buffer applied to the trajectory in meters
         spatial_vertical_buffer (float): the vertical spatial buffer applied to the trajectory in meters
         s2_resolution (int): the S2 resolution to use
+        options (BookingOptions): optional booking settings
 
     Returns:
         list: a list of cell bookings
     )pbdoc");
 
     m.def("get_S23D_cell_bookings", &ab::getS23DCellBookings, "Get S23D cell bookings",
+          py::call_guard<py::gil_scoped_release>(),
           "trajectory_4d"_a, "temporal_backward_buffer"_a = 60 * 5, "temporal_forward_buffer"_a = 60 * 10,
           "spatial_lateral_buffer"_a = 100.0, "spatial_vertical_buffer"_a = 30.0, "s2_resolution"_a = 8,
-          "vertical_resolution"_a = 40,
+          "vertical_resolution"_a = 40, "options"_a = ab::BookingOptions(),
           R"pbdoc(
     Get the S23D cells that are intersected by the trajectory with their time slices
 
@@ -131,11 +445,36 @@ PYBIND11_MODULE(_pyairspacebooking, m) {
         spatial_vertical_buffer (float): the vertical spatial buffer applied to the trajectory in meters
         s2_resolution (int): the S2 resolution to use
         vertical_resolution (int): the vertical resolution of the grid cells in meters
+        options (BookingOptions): optional booking settings
 
     Returns:
         list: a list of cell bookings
     )pbdoc");
 
+    m.def("get_multi_resolution_cell_bookings", &ab::getMultiResolutionCellBookings,
+          "Get cell bookings at several resolutions in a single pass",
+          py::call_guard<py::gil_scoped_release>(),
+          "trajectory_4d"_a, "resolutions"_a, "temporal_backward_buffer"_a = 60 * 5,
+          "temporal_forward_buffer"_a = 60 * 10, "spatial_lateral_buffer"_a = 100.0,
+          "spatial_vertical_buffer"_a = 30.0, "options"_a = ab::BookingOptions(),
+          R"pbdoc(
+    Get the cells that are intersected by the trajectory at several resolutions and index systems in a single pass.
+    Coarser cells are derived as parents of the finest cells, so coarse H3 cells can differ from booking that
+    resolution directly near cell edges.
+
+    Args:
+        trajectory_4d (list): a list of 4D state vectors
+        resolutions (list): a list of ResolutionSpec to book at
+        temporal_backward_buffer (int): the temporal buffer applied before the expected cell ETA in seconds
+        temporal_forward_buffer (int): the temporal buffer applied after the expected cell ETA in seconds
+        spatial_lateral_buffer (float): the lateral spatial buffer applied to the trajectory in meters
+        spatial_vertical_buffer (float): the vertical spatial buffer applied to the trajectory in meters
+        options (BookingOptions): optional booking settings
+
+    Returns:
+        list: a list of cell bookings for each of the resolutions, in the same order
+    )pbdoc");
+
     /*
      * Volume Based Functions
      */
@@ -157,20 +496,24 @@ PYBIND11_MODULE(_pyairspacebooking, m) {
             );
 
     m.def("get_H3_volume_bookings", &ab::getH3VolumeBookings, "Get H3 volume bookings",
-          "volume_4d"_a, "h3_resolution"_a = 8,
+          py::call_guard<py::gil_scoped_release>(),
+          "volume_4d"_a, "h3_resolution"_a = 8, "options"_a = ab::BookingOptions(),
           R"pbdoc(
     Get the H3 cells that are intersected by a 4D volume
 
     Args:
         volume_4d (Volume4D): a 4D volume
         h3_resolution (int): the H3 resolution to use
+        options (BookingOptions): optional booking settings
 
     Returns:
         list: a list of cell bookings
     )pbdoc");
 
     m.def("get_H3D_volume_bookings", &ab::getH3DVolumeBookings, "Get H3D volume bookings",
+          py::call_guard<py::gil_scoped_release>(),
           "volume_4d"_a, "h3_resolution"_a = 8, "vertical_resolution"_a = 40,
+          "options"_a = ab::BookingOptions(),
           R"pbdoc(
     Get the H3 cells that are intersected by a 4D volume
 
@@ -178,26 +521,31 @@ PYBIND11_MODULE(_pyairspacebooking, m) {
         volume_4d (Volume4D): a 4D volume
         h3_resolution (int): the H3 resolution to use
         vertical_resolution (int): the vertical resolution of the grid cells in meters
+        options (BookingOptions): optional booking settings
 
     Returns:
         list: a list of cell bookings
     )pbdoc");
 
     m.def("get_S2_volume_bookings", &ab::getS2VolumeBookings, "Get S2 volume bookings",
-          "volume_4d"_a, "s2_resolution"_a = 8,
+          py::call_guard<py::gil_scoped_release>(),
+          "volume_4d"_a, "s2_resolution"_a = 8, "options"_a = ab::BookingOptions(),
           R"pbdoc(
     Get the S2 cells that are intersected by a 4D volume
 
     Args:
         volume_4d (Volume4D): a 4D volume
         s2_resolution (int): the S2 resolution to use
+        options (BookingOptions): optional booking settings
 
     Returns:
         list: a list of cell bookings
     )pbdoc");
 
     m.def("get_S23D_volume_bookings", &ab::getS23DVolumeBookings, "Get S23D volume bookings",
+          py::call_guard<py::gil_scoped_release>(),
           "volume_4d"_a, "s2_resolution"_a = 8, "vertical_resolution"_a = 40,
+          "options"_a = ab::BookingOptions(),
           R"pbdoc(
     Get the S23D cells that are intersected by a 4D volume
 
@@ -205,8 +553,226 @@ PYBIND11_MODULE(_pyairspacebooking, m) {
         volume_4d (Volume4D): a 4D volume
         s2_resolution (int): the S2 resolution to use
         vertical_resolution (int): the vertical resolution of the grid cells in meters
+        options (BookingOptions): optional booking settings
 
     Returns:
         list: a list of cell bookings
     )pbdoc");
+
+    m.def("get_multi_resolution_volume_bookings", &ab::getMultiResolutionVolumeBookings,
+          "Get volume bookings at several resolutions in a single pass",
+          py::call_guard<py::gil_scoped_release>(),
+          "volume_4d"_a, "resolutions"_a, "options"_a = ab::BookingOptions(),
+          R"pbdoc(
+    Get the cells that are intersected by a 4D volume at several resolutions and index systems in a single pass.
+    Coarser cells are derived as parents of the finest cells, so coarse H3 cells can differ from booking that
+    resolution directly near cell edges.
+
+    Args:
+        volume_4d (Volume4D): a 4D volume
+        resolutions (list): a list of ResolutionSpec to book at
+        options (BookingOptions): optional booking settings
+
+    Returns:
+        list: a list of cell bookings for each of the resolutions, in the same order
+    )pbdoc");
+
+    py::class_<ab::Conflict>(m, "Conflict")
+            .def(py::init<std::size_t, std::size_t, std::string, const ab::d4::TimeSlice &>(),
+                 "first_operation"_a, "second_operation"_a, "cell_id"_a, "overlap"_a)
+            .def_readwrite("first_operation", &ab::Conflict::firstOperation)
+            .def_readwrite("second_operation", &ab::Conflict::secondOperation)
+            .def_readwrite("cell_id", &ab::Conflict::cellId)
+            .def_readwrite("overlap", &ab::Conflict::overlap)
+            .def("__repr__", [](const ab::Conflict &c) {
+                return "<Conflict " + std::to_string(c.firstOperation) + " x " + std::to_string(c.secondOperation) +
+                       " in " + c.cellId + ">";
+            });
+
+    m.def("detect_conflicts", &ab::detectConflicts, "Detect conflicts between the bookings of several operations",
+          "operations"_a,
+          R"pbdoc(
+    Find every pair of operations that book the same cell for overlapping time slices. Time slices that only touch
+    at an endpoint do not overlap, and bookings of one operation never conflict with each other.
+
+    Args:
+        operations (list): a list of the cell bookings of each operation
+
+    Returns:
+        list: the conflicts, sorted by operation indices then overlap start
+    )pbdoc");
+
+    py::class_<ab::ClosestApproach>(m, "ClosestApproach")
+            .def_readwrite("distance", &ab::ClosestApproach::distance, "Minimum 3D separation in meters")
+            .def_readwrite("lateral_distance", &ab::ClosestApproach::lateralDistance,
+                           "Lateral separation at the closest approach in meters")
+            .def_readwrite("vertical_distance", &ab::ClosestApproach::verticalDistance,
+                           "Vertical separation at the closest approach in meters")
+            .def_readwrite("time", &ab::ClosestApproach::time, "Time of the closest approach");
+
+    m.def("closest_point_of_approach", &ab::closestPointOfApproach,
+          "Get the closest point of approach of two trajectories", "trajectory_a"_a, "trajectory_b"_a,
+          R"pbdoc(
+    Get the 4D closest point of approach of two linearly interpolated trajectories.
+
+    Args:
+        trajectory_a (list): a list of StateVector4D
+        trajectory_b (list): a list of StateVector4D
+
+    Returns:
+        ClosestApproach: the closest approach, or None if the trajectories do not overlap in time
+    )pbdoc");
+
+    m.def("conflict_candidate_pairs", &ab::conflictCandidatePairs,
+          "Get the pairs of trajectories that may conflict", "trajectories"_a, "lateral_separation"_a,
+          "vertical_separation"_a, "temporal_separation"_a = 0,
+          R"pbdoc(
+    Prune trajectory pairs that can not conflict with a time and bounding box sweep followed by the closest point of
+    approach, so only the remaining pairs need their cell bookings compared.
+
+    Args:
+        trajectories (list): a list of trajectories, each a list of StateVector4D
+        lateral_separation (float): the combined lateral buffers of a pair plus a cell size margin in meters
+        vertical_separation (float): the combined vertical buffers of a pair plus a cell height margin in meters
+        temporal_separation (float): the combined temporal buffers of a pair in seconds
+
+    Returns:
+        list: the index pairs that may conflict
+    )pbdoc");
+
+    py::class_<ab::RouteSearchOptions>(m, "RouteSearchOptions")
+            .def(py::init<>())
+            .def_readwrite("index_system", &ab::RouteSearchOptions::indexSystem,
+                           "H3 for a route at the origin altitude, or H3D to also change vertical layers")
+            .def_readwrite("h3_resolution", &ab::RouteSearchOptions::h3Resolution)
+            .def_readwrite("vertical_resolution", &ab::RouteSearchOptions::verticalResolution)
+            .def_readwrite("min_altitude", &ab::RouteSearchOptions::minAltitude)
+            .def_readwrite("max_altitude", &ab::RouteSearchOptions::maxAltitude)
+            .def_readwrite("speed", &ab::RouteSearchOptions::speed, "Speed in meters per second")
+            .def_readwrite("temporal_backward_buffer", &ab::RouteSearchOptions::temporalBackwardBuffer)
+            .def_readwrite("temporal_forward_buffer", &ab::RouteSearchOptions::temporalForwardBuffer)
+            .def_readwrite("clearance_rings", &ab::RouteSearchOptions::clearanceRings,
+                           "Number of rings of neighbouring cells that must also be free")
+            .def_readwrite("max_hover", &ab::RouteSearchOptions::maxHover,
+                           "Longest the route may hover in a cell in seconds")
+            .def_readwrite("horizon", &ab::RouteSearchOptions::horizon,
+                           "How far after departure reservations are considered")
+            .def_readwrite("max_expansions", &ab::RouteSearchOptions::maxExpansions);
+
+    m.def("find_free_route", &ab::findFreeRoute, "Find a route through free cells",
+          "store"_a, "origin"_a, "destination"_a, "departure"_a, "options"_a = ab::RouteSearchOptions(),
+          R"pbdoc(
+    Find the earliest arriving route between two positions through cells that are free in a booking store, with a
+    safe interval A* search over the H3 neighbour graph.
+
+    Args:
+        store (BookingStore): the bookings to avoid
+        origin (np.ndarray): the (lon, lat, alt) position to depart from
+        destination (np.ndarray): the (lon, lat, alt) position to arrive at
+        departure (datetime): the departure time
+        options (RouteSearchOptions): search settings
+
+    Returns:
+        list: the StateVector4D of the cell centres along the route, or None if there is no free route
+    )pbdoc");
+
+    py::class_<ab::RestrictionSet>(m, "RestrictionSet")
+            .def_static("compile", py::overload_cast<const std::vector<ab::d4::Volume4D> &,
+                                const std::vector<ab::ResolutionSpec> &, const ab::BookingOptions &>(
+                                &ab::RestrictionSet::compile),
+                        "Compile restriction volumes, each valid during its time slice",
+                        "restrictions"_a, "resolutions"_a, "options"_a = ab::BookingOptions())
+            .def_static("compile_permanent", py::overload_cast<const std::vector<ab::GeoPolygon> &, ab::FPScalar,
+                                ab::FPScalar, const std::vector<ab::ResolutionSpec> &, const ab::BookingOptions &>(
+                                &ab::RestrictionSet::compile),
+                        "Compile permanent restriction polygons between a floor and ceiling",
+                        "restrictions"_a, "floor"_a, "ceiling"_a, "resolutions"_a,
+                        "options"_a = ab::BookingOptions())
+            .def_static("open", &ab::RestrictionSet::open, "Memory map a saved restriction set", "path"_a)
+            .def("save", &ab::RestrictionSet::save, "Save the restriction set to a memory mappable file", "path"_a)
+            .def("touches", &ab::RestrictionSet::touches,
+                 "Check if any of the bookings touches a restriction while it is valid",
+                 "bookings"_a, "resolution"_a)
+            .def("touched_restrictions", &ab::RestrictionSet::touchedRestrictions,
+                 "Get the indices of the restrictions the bookings touch while they are valid",
+                 "bookings"_a, "resolution"_a)
+            .def_property_readonly("resolutions", &ab::RestrictionSet::resolutions, "The compiled resolutions")
+            .def("cell_count", &ab::RestrictionSet::cellCount,
+                 "Number of restricted cells compiled at a resolution", "resolution"_a);
+
+    m.def("encode_bookings", [](const std::vector<ab::CellBooking> &bookings) {
+              // Encoded straight into the bytes object
+              py::bytes buffer(nullptr, ab::bookingBufferSize(bookings.size()));
+              ab::encodeBookings(bookings, PyBytes_AsString(buffer.ptr()));
+              return buffer;
+          }, "bookings"_a,
+          R"pbdoc(
+    Encode cell bookings into a fixed layout booking buffer, a header followed by columns of uint64 cell keys and
+    int64 start and end times in nanoseconds since the Unix epoch
+
+    Args:
+        bookings (list): the cell bookings
+
+    Returns:
+        bytes: the booking buffer
+    )pbdoc");
+
+    // Views a column of a booking buffer as a read only array that keeps the view, and so the buffer, alive
+    const auto column = [](py::object view, auto *data, std::size_t size) {
+        using T = std::remove_const_t<std::remove_pointer_t<decltype(data)>>;
+        py::array_t<T> array({size}, {sizeof(T)}, data, view);
+        array.attr("setflags")("write"_a = false);
+        return array;
+    };
+    py::class_<ExportedBookingBufferView>(m, "BookingBufferView")
+            .def(py::init([](const py::buffer &buffer) {
+                     return std::make_unique<ExportedBookingBufferView>(buffer.request());
+                 }), "buffer"_a,
+                 "View a booking buffer in place, such as bytes from encode_bookings or a memory mapped file. The "
+                 "buffer is exported until the view and its arrays are released")
+            .def_property_readonly("cell_keys", [column](py::object self) {
+                const auto &view = self.cast<const ExportedBookingBufferView &>().view;
+                return column(self, view.cellKeys(), view.size());
+            }, "The packed cell IDs as a uint64 array")
+            .def_property_readonly("starts", [column](py::object self) {
+                const auto &view = self.cast<const ExportedBookingBufferView &>().view;
+                return column(self, view.starts(), view.size());
+            }, "The start times in nanoseconds since the Unix epoch as an int64 array")
+            .def_property_readonly("ends", [column](py::object self) {
+                const auto &view = self.cast<const ExportedBookingBufferView &>().view;
+                return column(self, view.ends(), view.size());
+            }, "The end times in nanoseconds since the Unix epoch as an int64 array")
+            .def("__getitem__", [](const ExportedBookingBufferView &self, std::size_t i) {
+                if (i >= self.view.size()) throw py::index_error();
+                return self.view[i];
+            })
+            .def("to_cell_bookings", [](const ExportedBookingBufferView &self) {
+                return self.view.toCellBookings();
+            }, "Decode all bookings")
+            .def("__len__", [](const ExportedBookingBufferView &self) { return self.view.size(); });
+
+    py::class_<ab::CompactBooking>(m, "CompactBooking")
+            .def_readonly("cell_key", &ab::CompactBooking::cellKey, "Packed cell ID")
+            .def_readonly("start", &ab::CompactBooking::start, "Start time in seconds since the batch epoch")
+            .def_readonly("end", &ab::CompactBooking::end, "End time in seconds since the batch epoch")
+            .def("__eq__", &ab::CompactBooking::operator==)
+            .def("__repr__",
+                 [](const ab::CompactBooking &b) {
+                     return "<CompactBooking " + std::to_string(b.cellKey) + " [" + std::to_string(b.start) + ", "
+                            + std::to_string(b.end) + ")>";
+                 });
+
+    py::class_<ab::CompactBookingBatch>(m, "CompactBookingBatch")
+            .def(py::init<ab::d4::TimeInstant>(), "epoch"_a)
+            .def_static("from_cell_bookings", &ab::CompactBookingBatch::fromCellBookings,
+                        "Compact cell bookings with the earliest booking start as the epoch", "bookings"_a)
+            .def("add", &ab::CompactBookingBatch::add, "Compact and add a cell booking", "booking"_a)
+            .def("time_slice", &ab::CompactBookingBatch::timeSlice,
+                 "Get the time slice of a compact booking of this batch", "booking"_a)
+            .def("cell_booking", &ab::CompactBookingBatch::cellBooking,
+                 "Expand a compact booking of this batch into a cell booking", "booking"_a)
+            .def("to_cell_bookings", &ab::CompactBookingBatch::toCellBookings, "Expand all bookings")
+            .def_property_readonly("epoch", &ab::CompactBookingBatch::epoch, "The time offsets are measured from")
+            .def_property_readonly("bookings", &ab::CompactBookingBatch::bookings, "The compact bookings")
+            .def("__len__", &ab::CompactBookingBatch::size);
 }
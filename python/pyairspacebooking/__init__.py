@@ -28,6 +28,43 @@ from ._pyairspacebooking import (
     get_S2_volume_bookings,
     get_H3D_volume_bookings,
     get_S23D_volume_bookings,
+    BookingOptions,
+    ProjectionMode,
+    IndexSystem,
+    compact_cell_bookings,
+    BookingStats,
+    process_booking_stats,
+    reset_process_booking_stats,
+    ResolutionSpec,
+    get_multi_resolution_cell_bookings,
+    get_multi_resolution_volume_bookings,
+    BookingCache,
+    BookingStore,
+    Conflict,
+    detect_conflicts,
+    ClosestApproach,
+    closest_point_of_approach,
+    conflict_candidate_pairs,
+    RouteSearchOptions,
+    find_free_route,
+    RestrictionSet,
+    encode_bookings,
+    BookingBufferView,
+    CompactBooking,
+    CompactBookingBatch,
+    simplify_trajectory,
+    coalesce_cell_bookings,
+    LayerSpanBooking,
+    merge_vertical_layers,
+    expand_vertical_layers,
+    BookingLimitError,
+    BookingCostEstimate,
+    estimate_booking_cost,
+    CancellationToken,
+    BookingCancelledError,
+    parent_cell,
+    CellOccupancy,
+    OccupancyAggregator,
 )
 
 __all__ = [
@@ -45,6 +82,43 @@ __all__ = [
     "get_S2_volume_bookings",
     "get_H3D_volume_bookings",
     "get_S23D_volume_bookings",
+    "BookingOptions",
+    "ProjectionMode",
+    "IndexSystem",
+    "compact_cell_bookings",
+    "BookingStats",
+    "process_booking_stats",
+    "reset_process_booking_stats",
+    "ResolutionSpec",
+    "get_multi_resolution_cell_bookings",
+    "get_multi_resolution_volume_bookings",
+    "BookingCache",
+    "BookingStore",
+    "Conflict",
+    "detect_conflicts",
+    "ClosestApproach",
+    "closest_point_of_approach",
+    "conflict_candidate_pairs",
+    "RouteSearchOptions",
+    "find_free_route",
+    "RestrictionSet",
+    "encode_bookings",
+    "BookingBufferView",
+    "CompactBooking",
+    "CompactBookingBatch",
+    "simplify_trajectory",
+    "coalesce_cell_bookings",
+    "LayerSpanBooking",
+    "merge_vertical_layers",
+    "expand_vertical_layers",
+    "BookingLimitError",
+    "BookingCostEstimate",
+    "estimate_booking_cost",
+    "CancellationToken",
+    "BookingCancelledError",
+    "parent_cell",
+    "CellOccupancy",
+    "OccupancyAggregator",
 ]
 
 __dir__ = __all__
@@ -0,0 +1,142 @@
+#include "../include/airspacebookingutils/AsyncBooking.h"
+#include <algorithm>
+#include <exception>
+#include <spdlog/spdlog.h>
+
+ab::BookingExecutor::BookingExecutor(std::size_t threads) {
+    // hardware_concurrency is 0 when it is not known
+    threads = std::max<std::size_t>(threads, 1);
+    workers.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([this]() { work(); });
+    }
+}
+
+ab::BookingExecutor::~BookingExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+ab::BookingExecutor &ab::BookingExecutor::shared() {
+    static BookingExecutor executor;
+    return executor;
+}
+
+std::size_t ab::BookingExecutor::pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+std::size_t ab::BookingExecutor::threads() const {
+    return workers.size();
+}
+
+void ab::BookingExecutor::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(task));
+    }
+    available.notify_one();
+}
+
+void ab::BookingExecutor::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this]() { return stopping || !queue.empty(); });
+            // Queued tasks are run before stopping
+            if (queue.empty()) return;
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        // Task exceptions are held by their futures, so only callbacks can throw here
+        try {
+            task();
+        } catch (const std::exception &e) {
+            spdlog::error("Booking callback threw: {}", e.what());
+        } catch (...) {
+            spdlog::error("Booking callback threw an unknown exception");
+        }
+    }
+}
+
+std::future<std::vector<ab::CellBooking>>
+ab::getH3CellBookingsAsync(std::vector<d4::StateVector4D> trajectory4D, int temporalBackwardBuffer,
+                           int temporalForwardBuffer, FPScalar spatialLateralBuffer, FPScalar spatialVerticalBuffer,
+                           int h3Resolution, BookingOptions options, BookingExecutor &executor) {
+    return executor.submit([=, trajectory4D = std::move(trajectory4D), options = std::move(options)]() {
+        return getH3CellBookings(trajectory4D, temporalBackwardBuffer, temporalForwardBuffer, spatialLateralBuffer,
+                                 spatialVerticalBuffer, h3Resolution, options);
+    });
+}
+
+std::future<std::vector<ab::CellBooking>>
+ab::getH3VolumeBookingsAsync(d4::Volume4D volume4D, int h3Resolution, BookingOptions options,
+                             BookingExecutor &executor) {
+    return executor.submit([=, volume4D = std::move(volume4D), options = std::move(options)]() {
+        return getH3VolumeBookings(volume4D, h3Resolution, options);
+    });
+}
+
+std::future<std::vector<ab::CellBooking>>
+ab::getH3DCellBookingsAsync(std::vector<d4::StateVector4D> trajectory4D, int temporalBackwardBuffer,
+                            int temporalForwardBuffer, FPScalar spatialLateralBuffer, FPScalar spatialVerticalBuffer,
+                            int h3Resolution, int verticalResolution, BookingOptions options,
+                            BookingExecutor &executor) {
+    return executor.submit([=, trajectory4D = std::move(trajectory4D), options = std::move(options)]() {
+        return getH3DCellBookings(trajectory4D, temporalBackwardBuffer, temporalForwardBuffer, spatialLateralBuffer,
+                                  spatialVerticalBuffer, h3Resolution, verticalResolution, options);
+    });
+}
+
+std::future<std::vector<ab::CellBooking>>
+ab::getH3DVolumeBookingsAsync(d4::Volume4D volume4D, int h3Resolution, int verticalResolution,
+                              BookingOptions options, BookingExecutor &executor) {
+    return executor.submit([=, volume4D = std::move(volume4D), options = std::move(options)]() {
+        return getH3DVolumeBookings(volume4D, h3Resolution, verticalResolution, options);
+    });
+}
+
+std::future<std::vector<ab::CellBooking>>
+ab::getS2CellBookingsAsync(std::vector<d4::StateVector4D> trajectory4D, int temporalBackwardBuffer,
+                           int temporalForwardBuffer, FPScalar spatialLateralBuffer, FPScalar spatialVerticalBuffer,
+                           int s2Resolution, BookingOptions options, BookingExecutor &executor) {
+    return executor.submit([=, trajectory4D = std::move(trajectory4D), options = std::move(options)]() {
+        return getS2CellBookings(trajectory4D, temporalBackwardBuffer, temporalForwardBuffer, spatialLateralBuffer,
+                                 spatialVerticalBuffer, s2Resolution, options);
+    });
+}
+
+std::future<std::vector<ab::CellBooking>>
+ab::getS2VolumeBookingsAsync(d4::Volume4D volume4D, int s2Resolution, BookingOptions options,
+                             BookingExecutor &executor) {
+    return executor.submit([=, volume4D = std::move(volume4D), options = std::move(options)]() {
+        return getS2VolumeBookings(volume4D, s2Resolution, options);
+    });
+}
+
+std::future<std::vector<ab::CellBooking>>
+ab::getS23DCellBookingsAsync(std::vector<d4::StateVector4D> trajectory4D, int temporalBackwardBuffer,
+                             int temporalForwardBuffer, FPScalar spatialLateralBuffer, FPScalar spatialVerticalBuffer,
+                             int s2Resolution, int verticalResolution, BookingOptions options,
+                             BookingExecutor &executor) {
+    return executor.submit([=, trajectory4D = std::move(trajectory4D), options = std::move(options)]() {
+        return getS23DCellBookings(trajectory4D, temporalBackwardBuffer, temporalForwardBuffer, spatialLateralBuffer,
+                                   spatialVerticalBuffer, s2Resolution, verticalResolution, options);
+    });
+}
+
+std::future<std::vector<ab::CellBooking>>
+ab::getS23DVolumeBookingsAsync(d4::Volume4D volume4D, int s2Resolution, int verticalResolution,
+                               BookingOptions options, BookingExecutor &executor) {
+    return executor.submit([=, volume4D = std::move(volume4D), options = std::move(options)]() {
+        return getS23DVolumeBookings(volume4D, s2Resolution, verticalResolution, options);
+    });
+}
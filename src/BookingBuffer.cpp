@@ -0,0 +1,182 @@
+#include "../include/airspacebookingutils/BookingBuffer.h"
+#include "../include/airspacebookingutils/util/CellKey.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace {
+    constexpr char MAGIC[8] = {'A', 'B', 'B', 'O', 'O', 'K', 'S', '\0'};
+    constexpr std::uint32_t VERSION = 1;
+    constexpr std::align_val_t ALIGNMENT{alignof(std::uint64_t)};
+
+    struct BufferHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t reserved;
+        std::uint64_t count;
+    };
+
+    std::uint64_t cellKey(const ab::CellBooking &booking) {
+        const auto key = ab::util::encodeCellKey(booking.cellId);
+        if (!key) throw std::invalid_argument("Cell " + booking.cellId + " can not be packed into a cell key");
+        return *key;
+    }
+
+    std::int64_t nanoseconds(ab::d4::TimeInstant time) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    }
+
+    ab::d4::TimeInstant timeInstant(std::int64_t nanoseconds) {
+        return ab::d4::TimeInstant(
+                std::chrono::duration_cast<ab::d4::TimeInstant::duration>(std::chrono::nanoseconds(nanoseconds)));
+    }
+
+    BufferHeader header(std::size_t count) {
+        BufferHeader header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.count = count;
+        return header;
+    }
+
+    /**
+     * @brief Write a column of a booking buffer to a stream in chunks
+     */
+    template<typename T, typename Value>
+    void writeColumn(const std::vector<ab::CellBooking> &bookings, std::ostream &out, Value &&value) {
+        std::array<T, 512> chunk{};
+        for (std::size_t i = 0; i < bookings.size(); i += chunk.size()) {
+            const auto n = std::min(chunk.size(), bookings.size() - i);
+            for (std::size_t j = 0; j < n; ++j) {
+                chunk[j] = value(bookings[i + j]);
+            }
+            out.write(reinterpret_cast<const char *>(chunk.data()), static_cast<std::streamsize>(n * sizeof(T)));
+        }
+    }
+}
+
+std::size_t ab::bookingBufferSize(std::size_t count) {
+    return sizeof(BufferHeader) + count * (sizeof(std::uint64_t) + 2 * sizeof(std::int64_t));
+}
+
+void ab::encodeBookings(const std::vector<CellBooking> &bookings, void *out) {
+    if (reinterpret_cast<std::uintptr_t>(out) % alignof(std::uint64_t) != 0) {
+        throw std::invalid_argument("Booking buffers must be aligned to 8 bytes");
+    }
+    const auto n = bookings.size();
+    auto *bytes = static_cast<char *>(out);
+    const auto bufferHeader = header(n);
+    std::memcpy(bytes, &bufferHeader, sizeof(bufferHeader));
+    auto *keys = reinterpret_cast<std::uint64_t *>(bytes + sizeof(BufferHeader));
+    auto *starts = reinterpret_cast<std::int64_t *>(keys + n);
+    auto *ends = starts + n;
+    for (std::size_t i = 0; i < n; ++i) {
+        keys[i] = cellKey(bookings[i]);
+        starts[i] = nanoseconds(bookings[i].timeSlice.start);
+        ends[i] = nanoseconds(bookings[i].timeSlice.end);
+    }
+}
+
+ab::BookingBuffer ab::encodeBookings(const std::vector<CellBooking> &bookings) {
+    BookingBuffer buffer(bookingBufferSize(bookings.size()));
+    encodeBookings(bookings, buffer.data());
+    return buffer;
+}
+
+void ab::writeBookings(const std::vector<CellBooking> &bookings, std::ostream &out) {
+    const auto bufferHeader = header(bookings.size());
+    out.write(reinterpret_cast<const char *>(&bufferHeader), sizeof(bufferHeader));
+    writeColumn<std::uint64_t>(bookings, out, cellKey);
+    writeColumn<std::int64_t>(bookings, out, [](const CellBooking &b) { return nanoseconds(b.timeSlice.start); });
+    writeColumn<std::int64_t>(bookings, out, [](const CellBooking &b) { return nanoseconds(b.timeSlice.end); });
+    if (!out) throw std::runtime_error("Could not write booking buffer");
+}
+
+ab::BookingBufferView::BookingBufferView(const void *data, std::size_t size) {
+    if (reinterpret_cast<std::uintptr_t>(data) % alignof(std::uint64_t) != 0) {
+        throw std::invalid_argument("Booking buffers must be aligned to 8 bytes to be read in place");
+    }
+    BufferHeader bufferHeader{};
+    if (size < sizeof(BufferHeader)) throw std::invalid_argument("Not a booking buffer");
+    std::memcpy(&bufferHeader, data, sizeof(bufferHeader));
+    if (std::memcmp(bufferHeader.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::invalid_argument("Not a booking buffer");
+    }
+    if (bufferHeader.version != VERSION) {
+        throw std::invalid_argument("Unsupported booking buffer version " + std::to_string(bufferHeader.version));
+    }
+    if (bufferHeader.count > (size - sizeof(BufferHeader)) / (3 * sizeof(std::uint64_t))) {
+        throw std::invalid_argument("Booking buffer is truncated");
+    }
+    count = static_cast<std::size_t>(bufferHeader.count);
+    keys = reinterpret_cast<const std::uint64_t *>(static_cast<const char *>(data) + sizeof(BufferHeader));
+    startTimes = reinterpret_cast<const std::int64_t *>(keys + count);
+    endTimes = startTimes + count;
+}
+
+ab::CellBooking ab::BookingBufferView::operator[](std::size_t i) const {
+    return {d4::TimeSlice(timeInstant(startTimes[i]), timeInstant(endTimes[i])), util::decodeCellKey(keys[i])};
+}
+
+std::vector<ab::CellBooking> ab::BookingBufferView::toCellBookings() const {
+    std::vector<CellBooking> bookings;
+    bookings.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        bookings.push_back((*this)[i]);
+    }
+    return bookings;
+}
+
+ab::BookingBuffer::BookingBuffer(std::size_t size)
+        : bytes(static_cast<char *>(::operator new(size, ALIGNMENT))), bufferSize(size) {
+    std::memset(bytes.get(), 0, size);
+}
+
+void ab::BookingBuffer::AlignedDelete::operator()(char *p) const {
+    ::operator delete(p, ALIGNMENT);
+}
+
+void ab::BookingBufferWriter::reserve(std::size_t count) {
+    keys.reserve(count);
+    starts.reserve(count);
+    ends.reserve(count);
+}
+
+void ab::BookingBufferWriter::add(const CellBooking &booking) {
+    // Packed first, so a booking that can not be packed leaves the columns the same length
+    const auto key = cellKey(booking);
+    keys.push_back(key);
+    starts.push_back(nanoseconds(booking.timeSlice.start));
+    ends.push_back(nanoseconds(booking.timeSlice.end));
+}
+
+void ab::BookingBufferWriter::add(const std::vector<CellBooking> &bookings) {
+    reserve(size() + bookings.size());
+    for (const auto &booking: bookings) {
+        add(booking);
+    }
+}
+
+ab::BookingBuffer ab::BookingBufferWriter::finish() const {
+    const auto n = size();
+    BookingBuffer buffer(bookingBufferSize(n));
+    const auto bufferHeader = header(n);
+    auto *bytes = buffer.data();
+    std::memcpy(bytes, &bufferHeader, sizeof(bufferHeader));
+    bytes += sizeof(bufferHeader);
+    std::memcpy(bytes, keys.data(), n * sizeof(std::uint64_t));
+    bytes += n * sizeof(std::uint64_t);
+    std::memcpy(bytes, starts.data(), n * sizeof(std::int64_t));
+    bytes += n * sizeof(std::int64_t);
+    std::memcpy(bytes, ends.data(), n * sizeof(std::int64_t));
+    return buffer;
+}
+
+void ab::BookingBufferWriter::clear() {
+    keys.clear();
+    starts.clear();
+    ends.clear();
+}
@@ -0,0 +1,144 @@
+#include "../include/airspacebookingutils/BookingCache.h"
+
+namespace {
+    template<typename T>
+    void appendBytes(std::string &key, const T &value) {
+        key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    std::vector<std::vector<ab::CellBooking>>
+    shifted(const std::vector<std::vector<ab::CellBooking>> &levels, ab::d4::TimeInstant::duration offset) {
+        auto shiftedLevels = levels;
+        for (auto &bookings: shiftedLevels) {
+            for (auto &booking: bookings) {
+                booking.timeSlice.start += offset;
+                booking.timeSlice.end += offset;
+            }
+        }
+        return shiftedLevels;
+    }
+}
+
+ab::BookingCache::BookingCache(std::size_t maxBytes) : maxBytes_(maxBytes) {
+}
+
+std::optional<std::vector<std::vector<ab::CellBooking>>>
+ab::BookingCache::find(const std::string &key, d4::TimeInstant departure) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto it = index.find(key);
+    if (it == index.end()) {
+        ++misses_;
+        return std::nullopt;
+    }
+    ++hits_;
+    // Move to the front as the most recently used
+    entries.splice(entries.begin(), entries, it->second);
+    return shifted(it->second->bookings, departure.time_since_epoch());
+}
+
+void ab::BookingCache::insert(const std::string &key, d4::TimeInstant departure,
+                              const std::vector<std::vector<CellBooking>> &bookings) {
+    std::size_t entryBytes = sizeof(Entry) + 2 * key.capacity();
+    for (const auto &levelBookings: bookings) {
+        entryBytes += sizeof(levelBookings);
+        for (const auto &booking: levelBookings) {
+            entryBytes += sizeof(CellBooking) + booking.cellId.capacity();
+        }
+    }
+    // Stored relative to the departure time
+    auto relativeBookings = shifted(bookings, -departure.time_since_epoch());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entryBytes > maxBytes_) return;
+    const auto it = index.find(key);
+    if (it != index.end()) {
+        bytes_ -= it->second->bytes;
+        entries.erase(it->second);
+        index.erase(it);
+    }
+    evict(maxBytes_ - entryBytes);
+    entries.push_front({key, std::move(relativeBookings), entryBytes});
+    index.emplace(key, entries.begin());
+    bytes_ += entryBytes;
+}
+
+void ab::BookingCache::evict(std::size_t maxBytes) {
+    while (bytes_ > maxBytes && !entries.empty()) {
+        bytes_ -= entries.back().bytes;
+        index.erase(entries.back().key);
+        entries.pop_back();
+        ++evictions_;
+    }
+}
+
+void ab::BookingCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    index.clear();
+    bytes_ = 0;
+}
+
+void ab::BookingCache::setMaxBytes(std::size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    maxBytes_ = maxBytes;
+    evict(maxBytes_);
+}
+
+std::size_t ab::BookingCache::maxBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return maxBytes_;
+}
+
+std::size_t ab::BookingCache::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes_;
+}
+
+std::size_t ab::BookingCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+std::uint64_t ab::BookingCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits_;
+}
+
+std::uint64_t ab::BookingCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses_;
+}
+
+std::uint64_t ab::BookingCache::evictions() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return evictions_;
+}
+
+std::string ab::BookingCache::trajectoryKey(const std::vector<d4::StateVector4D> &trajectory4D,
+                                            int temporalBackwardBuffer, int temporalForwardBuffer,
+                                            FPScalar spatialLateralBuffer, FPScalar spatialVerticalBuffer,
+                                            const std::string &indexKey, const BookingOptions &options) {
+    std::string key = indexKey;
+    key.push_back('\0');
+    key.reserve(key.size() + trajectory4D.size() * (4 * sizeof(FPScalar) + sizeof(std::int64_t)) + 64);
+    const auto departure = trajectory4D.empty() ? d4::TimeInstant() : trajectory4D.front().time;
+    for (const auto &sv: trajectory4D) {
+        appendBytes(key, sv.position.x());
+        appendBytes(key, sv.position.y());
+        appendBytes(key, sv.position.z());
+        appendBytes(key, sv.speed);
+        appendBytes(key, static_cast<std::int64_t>((sv.time - departure).count()));
+    }
+    appendBytes(key, temporalBackwardBuffer);
+    appendBytes(key, temporalForwardBuffer);
+    appendBytes(key, spatialLateralBuffer);
+    appendBytes(key, spatialVerticalBuffer);
+    appendBytes(key, options.projection);
+    appendBytes(key, options.localProjectionMaxRadius);
+    appendBytes(key, options.compact);
+    appendBytes(key, options.simplifyTolerance);
+    appendBytes(key, options.tileLongTrajectories);
+    appendBytes(key, options.temporalMergeGap);
+    appendBytes(key, options.maxMergedSliceLength);
+    return key;
+}
@@ -0,0 +1,80 @@
+#include "../include/airspacebookingutils/BookingStats.h"
+
+#include <mutex>
+#include <sstream>
+
+namespace {
+    std::mutex processStatsMutex;
+    ab::BookingStats processStats;
+}
+
+ab::BookingStats &ab::BookingStats::operator+=(const BookingStats &other) {
+    calls += other.calls;
+    setupSeconds += other.setupSeconds;
+    etaSeconds += other.etaSeconds;
+    coverageSeconds += other.coverageSeconds;
+    indexerSeconds += other.indexerSeconds;
+    mergeSeconds += other.mergeSeconds;
+    compactSeconds += other.compactSeconds;
+    totalSeconds += other.totalSeconds;
+    samplesTested += other.samplesTested;
+    samplesInside += other.samplesInside;
+    indexerCalls += other.indexerCalls;
+    reprojections += other.reprojections;
+    simplifiedPoints += other.simplifiedPoints;
+    rawBookings += other.rawBookings;
+    mergedBookings += other.mergedBookings;
+    return *this;
+}
+
+std::string ab::BookingStats::toPrometheus(const std::string &prefix) const {
+    std::ostringstream out;
+    out.precision(9);
+    const auto counter = [&](const std::string &name, const std::string &help, auto value) {
+        out << "# HELP " << prefix << "_" << name << "_total " << help << "\n"
+            << "# TYPE " << prefix << "_" << name << "_total counter\n"
+            << prefix << "_" << name << "_total " << value << "\n";
+    };
+
+    counter("calls", "Number of booking calls", calls);
+
+    const std::string stageMetric = prefix + "_stage_seconds_total";
+    out << "# HELP " << stageMetric << " Wall time spent in each booking stage in seconds\n"
+        << "# TYPE " << stageMetric << " counter\n";
+    const std::pair<const char *, double> stages[] = {
+            {"setup",    setupSeconds},
+            {"eta",      etaSeconds},
+            {"coverage", coverageSeconds},
+            {"indexer",  indexerSeconds},
+            {"merge",    mergeSeconds},
+            {"compact",  compactSeconds},
+            {"total",    totalSeconds},
+    };
+    for (const auto &stage: stages) {
+        out << stageMetric << "{stage=\"" << stage.first << "\"} " << stage.second << "\n";
+    }
+
+    counter("samples_tested", "Number of sampling grid point in region tests", samplesTested);
+    counter("samples_inside", "Number of sampling grid points inside the booked region", samplesInside);
+    counter("indexer_calls", "Number of cell indexer calls", indexerCalls);
+    counter("reprojections", "Number of coordinates projected", reprojections);
+    counter("simplified_points", "Number of trajectory state vectors dropped by simplification", simplifiedPoints);
+    counter("raw_bookings", "Number of cell bookings before merging", rawBookings);
+    counter("merged_bookings", "Number of cell bookings returned", mergedBookings);
+    return out.str();
+}
+
+ab::BookingStats ab::processBookingStats() {
+    std::lock_guard<std::mutex> lock(processStatsMutex);
+    return processStats;
+}
+
+void ab::recordProcessBookingStats(const BookingStats &stats) {
+    std::lock_guard<std::mutex> lock(processStatsMutex);
+    processStats += stats;
+}
+
+void ab::resetProcessBookingStats() {
+    std::lock_guard<std::mutex> lock(processStatsMutex);
+    processStats = {};
+}
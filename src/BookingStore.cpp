@@ -0,0 +1,530 @@
+#include "../include/airspacebookingutils/BookingStore.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    // (time, +1 for a start or -1 for an end), so ends sort before starts at the same time
+    typedef std::vector<std::pair<ab::d4::TimeInstant, int>> Events;
+
+    /**
+     * @brief Get the sorted starts and ends of the reservations of a schedule overlapping [start, end), clipped to it.
+     * The events are reused by the next call on the same thread
+     */
+    template<typename Schedule>
+    const Events &overlapEvents(const Schedule &schedule, ab::d4::TimeInstant start, ab::d4::TimeInstant end) {
+        thread_local Events events;
+        events.clear();
+        schedule.forEachCandidate(start, end, [&](const auto &r) {
+            if (r.start < r.end && r.start < end && r.end > start) {
+                events.emplace_back(std::max(r.start, start), 1);
+                events.emplace_back(std::min(r.end, end), -1);
+            }
+        });
+        std::sort(events.begin(), events.end());
+        return events;
+    }
+}
+
+template<typename Visit>
+void ab::BookingStore::CellSchedule::forEachCandidate(d4::TimeInstant start, d4::TimeInstant end,
+                                                      Visit &&visit) const {
+    // Reservations starting before start - longest end before start
+    const auto first = std::lower_bound(reservations.begin(), reservations.end(), start - longest,
+                                        [](const Reservation &r, d4::TimeInstant t) { return r.start < t; });
+    for (auto it = first; it != reservations.end() && it->start < end; ++it) {
+        visit(*it);
+    }
+    for (auto it = longReservations.begin(); it != longReservations.end() && it->start < end; ++it) {
+        visit(*it);
+    }
+}
+
+template<typename Visit>
+void ab::BookingStore::CellSchedule::forEachSaturated(d4::TimeInstant start, d4::TimeInstant end,
+                                                      std::uint32_t capacity, Visit &&visit) const {
+    if (!(start < end)) return;
+    if (capacity == 0) {
+        visit(start, end);
+        return;
+    }
+    std::uint32_t count = 0;
+    // The last saturated time slice, held back in case the next one starts where it ends
+    std::optional<std::pair<d4::TimeInstant, d4::TimeInstant>> pending;
+    d4::TimeInstant from;
+    for (const auto &[time, change]: overlapEvents(*this, start, end)) {
+        if (change < 0 && count == capacity) pending.emplace(from, time);
+        count += change;
+        if (change > 0 && count == capacity) {
+            if (pending && pending->second == time) {
+                from = pending->first;
+            } else {
+                if (pending) visit(pending->first, pending->second);
+                from = time;
+            }
+            pending.reset();
+        }
+    }
+    if (pending) visit(pending->first, pending->second);
+}
+
+std::uint32_t ab::BookingStore::CellSchedule::maxOccupancy(d4::TimeInstant start, d4::TimeInstant end) const {
+    std::uint32_t count = 0, peak = 0;
+    for (const auto &[time, change]: overlapEvents(*this, start, end)) {
+        count += change;
+        peak = std::max(peak, count);
+    }
+    return peak;
+}
+
+ab::BookingStore::BookingStore(std::uint32_t defaultCapacity, Duration occupancyBucketWidth)
+        : defaultCapacity_(defaultCapacity), bucketWidth(occupancyBucketWidth) {
+    if (occupancyBucketWidth <= Duration::zero()) {
+        throw std::invalid_argument("Occupancy bucket width must be positive");
+    }
+}
+
+std::int64_t ab::BookingStore::bucketOf(d4::TimeInstant time) const {
+    const auto sinceEpoch = time.time_since_epoch();
+    auto bucket = sinceEpoch / bucketWidth;
+    // Round down before the epoch
+    if (sinceEpoch % bucketWidth < Duration::zero()) --bucket;
+    return bucket;
+}
+
+std::uint32_t ab::BookingStore::capacityOf(const std::string &cellId) const {
+    if (capacities.empty()) return defaultCapacity_;
+    const auto it = capacities.find(cellId);
+    return it == capacities.end() ? defaultCapacity_ : it->second;
+}
+
+void ab::BookingStore::add(OperationId operation, const std::vector<CellBooking> &bookings) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    for (const auto &booking: bookings) {
+        const auto [entry, inserted] = schedules.try_emplace(booking.cellId);
+        auto &schedule = entry->second;
+        if (inserted && freeOrdinals.empty()) {
+            schedule.ordinal = nextOrdinal++;
+        } else if (inserted) {
+            schedule.ordinal = freeOrdinals.back();
+            freeOrdinals.pop_back();
+        }
+        // Bookings are mostly grouped by cell, so skipping repeats of the last cell keeps the index small
+        auto &cells = operationCells[operation];
+        if (cells.empty() || cells.back() != booking.cellId) cells.push_back(booking.cellId);
+        if (booking.timeSlice.start < booking.timeSlice.end) {
+            const auto last = bucketOf(booking.timeSlice.end - Duration(1));
+            for (auto bucket = bucketOf(booking.timeSlice.start); bucket <= last; ++bucket) {
+                occupancyBuckets[bucket].add(schedule.ordinal);
+            }
+        }
+        const Reservation reservation{booking.timeSlice.start, booking.timeSlice.end, operation};
+        const bool isLong = reservation.end - reservation.start > LONG_RESERVATION_BUCKETS * bucketWidth;
+        auto &reservations = isLong ? schedule.longReservations : schedule.reservations;
+        const auto it = std::upper_bound(reservations.begin(), reservations.end(), reservation,
+                                         [](const Reservation &a, const Reservation &b) { return a.start < b.start; });
+        reservations.insert(it, reservation);
+        if (!isLong) schedule.longest = std::max(schedule.longest, reservation.end - reservation.start);
+    }
+    size_ += bookings.size();
+}
+
+std::size_t ab::BookingStore::removeReservations(const std::string &cellId,
+                                                 const std::unordered_set<OperationId> &operations) {
+    const auto it = schedules.find(cellId);
+    if (it == schedules.end()) return 0;
+    auto &schedule = it->second;
+    // The buckets the removed reservations were counted in
+    std::vector<std::int64_t> touched;
+    Duration longest = Duration::zero();
+    std::size_t removed = 0;
+    for (auto *reservations: {&schedule.reservations, &schedule.longReservations}) {
+        auto kept = reservations->begin();
+        for (const auto &r: *reservations) {
+            if (operations.count(r.operation)) {
+                if (!(r.start < r.end)) continue;
+                const auto last = bucketOf(r.end - Duration(1));
+                for (auto bucket = bucketOf(r.start); bucket <= last; ++bucket) {
+                    touched.push_back(bucket);
+                }
+            } else {
+                if (reservations == &schedule.reservations) longest = std::max(longest, r.end - r.start);
+                *kept++ = r;
+            }
+        }
+        removed += static_cast<std::size_t>(reservations->end() - kept);
+        reservations->erase(kept, reservations->end());
+    }
+    schedule.longest = longest;
+
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (const auto bucket: touched) {
+        const auto bucketStart = d4::TimeInstant(bucket * bucketWidth), bucketEnd = bucketStart + bucketWidth;
+        bool occupied = false;
+        schedule.forEachCandidate(bucketStart, bucketEnd, [&](const Reservation &r) {
+            occupied |= r.start < r.end && r.start < bucketEnd && r.end > bucketStart;
+        });
+        if (occupied) continue;
+        const auto bitmap = occupancyBuckets.find(bucket);
+        bitmap->second.remove(schedule.ordinal);
+        if (bitmap->second.empty()) occupancyBuckets.erase(bitmap);
+    }
+
+    if (schedule.reservations.empty() && schedule.longReservations.empty()) {
+        freeOrdinals.push_back(schedule.ordinal);
+        schedules.erase(it);
+    }
+    return removed;
+}
+
+std::size_t ab::BookingStore::remove(OperationId operation) {
+    return remove(std::vector<OperationId>{operation});
+}
+
+std::size_t ab::BookingStore::remove(const std::vector<OperationId> &operations) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    std::unordered_set<OperationId> removing;
+    std::vector<std::string> cells;
+    for (const auto operation: operations) {
+        const auto it = operationCells.find(operation);
+        if (it == operationCells.end()) continue;
+        removing.insert(operation);
+        cells.insert(cells.end(), std::make_move_iterator(it->second.begin()),
+                     std::make_move_iterator(it->second.end()));
+        operationCells.erase(it);
+    }
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+    std::size_t removed = 0;
+    for (const auto &cellId: cells) {
+        removed += removeReservations(cellId, removing);
+    }
+    size_ -= removed;
+    return removed;
+}
+
+std::vector<std::string> ab::BookingStore::cellsOf(OperationId operation) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    const auto it = operationCells.find(operation);
+    if (it == operationCells.end()) return {};
+    auto cells = it->second;
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+    return cells;
+}
+
+std::vector<ab::BookingStore::OperationId>
+ab::BookingStore::operationsIn(const std::string &cellId, d4::TimeInstant start, d4::TimeInstant end) const {
+    std::vector<OperationId> operations;
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    const auto it = schedules.find(cellId);
+    if (it == schedules.end()) return operations;
+    it->second.forEachCandidate(start, end, [&](const Reservation &r) {
+        if (r.start < end && r.end > start) operations.push_back(r.operation);
+    });
+    std::sort(operations.begin(), operations.end());
+    operations.erase(std::unique(operations.begin(), operations.end()), operations.end());
+    return operations;
+}
+
+bool ab::BookingStore::isFree(const std::vector<CellBooking> &bookings) const {
+    // Bookings of the same cell that overlap each other load it together, as they would once added, so each cell's
+    // bookings are checked in runs of chained overlaps
+    std::vector<const CellBooking *> sorted;
+    sorted.reserve(bookings.size());
+    for (const auto &booking: bookings) {
+        sorted.push_back(&booking);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const CellBooking *a, const CellBooking *b) {
+        return a->cellId != b->cellId ? a->cellId < b->cellId : a->timeSlice.start < b->timeSlice.start;
+    });
+
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    for (std::size_t first = 0, last; first < sorted.size(); first = last) {
+        const auto &cellId = sorted[first]->cellId;
+        auto runEnd = sorted[first]->timeSlice.end;
+        for (last = first + 1; last < sorted.size() && sorted[last]->cellId == cellId
+                               && sorted[last]->timeSlice.start < runEnd; ++last) {
+            runEnd = std::max(runEnd, sorted[last]->timeSlice.end);
+        }
+        const auto capacity = capacityOf(cellId);
+        if (capacity == 0) return false;
+        const auto runStart = sorted[first]->timeSlice.start;
+        const auto it = schedules.find(cellId);
+        if (last - first > 1) {
+            Events events;
+            if (it != schedules.end()) events = overlapEvents(it->second, runStart, runEnd);
+            for (auto i = first; i < last; ++i) {
+                if (!(sorted[i]->timeSlice.start < sorted[i]->timeSlice.end)) continue;
+                events.emplace_back(sorted[i]->timeSlice.start, 1);
+                events.emplace_back(sorted[i]->timeSlice.end, -1);
+            }
+            std::sort(events.begin(), events.end());
+            std::uint32_t count = 0;
+            for (const auto &[time, change]: events) {
+                count += change;
+                if (count > capacity) return false;
+            }
+            continue;
+        }
+        if (it == schedules.end()) continue;
+        std::uint32_t overlapping = 0;
+        it->second.forEachCandidate(runStart, runEnd, [&](const Reservation &r) {
+            overlapping += r.start < runEnd && r.end > runStart;
+        });
+        // Fewer overlapping reservations than the capacity can not exceed it, so most cells skip the sweep
+        if (overlapping >= capacity
+            && (capacity == 1 || it->second.maxOccupancy(runStart, runEnd) >= capacity)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<ab::d4::TimeSlice>
+ab::BookingStore::reservedSlices(const std::string &cellId, d4::TimeInstant start, d4::TimeInstant end) const {
+    std::vector<d4::TimeSlice> slices;
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    const auto it = schedules.find(cellId);
+    if (it == schedules.end()) return slices;
+    it->second.forEachCandidate(start, end, [&](const Reservation &r) {
+        if (r.start < end && r.end > start) slices.emplace_back(r.start, r.end);
+    });
+    // Long reservations are visited after the others
+    std::stable_sort(slices.begin(), slices.end(),
+                     [](const d4::TimeSlice &a, const d4::TimeSlice &b) { return a.start < b.start; });
+    return slices;
+}
+
+std::vector<ab::d4::TimeSlice>
+ab::BookingStore::saturatedSlices(const std::string &cellId, d4::TimeInstant start, d4::TimeInstant end) const {
+    std::vector<d4::TimeSlice> slices;
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    const auto capacity = capacityOf(cellId);
+    const auto it = schedules.find(cellId);
+    if (it == schedules.end()) {
+        if (capacity == 0 && start < end) slices.emplace_back(start, end);
+        return slices;
+    }
+    it->second.forEachSaturated(start, end, capacity, [&](d4::TimeInstant from, d4::TimeInstant to) {
+        slices.emplace_back(from, to);
+    });
+    return slices;
+}
+
+std::uint32_t
+ab::BookingStore::maxOccupancy(const std::string &cellId, d4::TimeInstant start, d4::TimeInstant end) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    const auto it = schedules.find(cellId);
+    return it == schedules.end() ? 0 : it->second.maxOccupancy(start, end);
+}
+
+std::vector<bool>
+ab::BookingStore::occupancyOf(const std::vector<std::string> &cellIds, d4::TimeInstant start,
+                              d4::TimeInstant end) const {
+    std::vector<bool> occupied(cellIds.size(), false);
+    if (!(start < end)) return occupied;
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::vector<const CellSchedule *> cellSchedules(cellIds.size(), nullptr);
+    util::RoaringBitmap queried;
+    for (std::size_t i = 0; i < cellIds.size(); ++i) {
+        const auto it = schedules.find(cellIds[i]);
+        if (it == schedules.end()) continue;
+        cellSchedules[i] = &it->second;
+        queried.add(it->second.ordinal);
+    }
+
+    // Cells occupied in a bucket inside the interval are occupied in the interval, while those only occupied in the
+    // buckets at its ends may be occupied just outside it
+    util::RoaringBitmap inside, edges;
+    const auto first = bucketOf(start), last = bucketOf(end - Duration(1));
+    const auto addBucket = [&](std::int64_t bucket) {
+        const auto it = occupancyBuckets.find(bucket);
+        if (it == occupancyBuckets.end()) return;
+        const auto bucketStart = d4::TimeInstant(bucket * bucketWidth);
+        auto &target = bucketStart >= start && bucketStart + bucketWidth <= end ? inside : edges;
+        target |= it->second;
+    };
+    // Only the buckets holding occupancy are visited when there are fewer of them than the interval spans
+    if (static_cast<std::uint64_t>(last - first) < occupancyBuckets.size()) {
+        for (auto bucket = first; bucket <= last; ++bucket) {
+            addBucket(bucket);
+        }
+    } else {
+        for (const auto &[bucket, bitmap]: occupancyBuckets) {
+            if (bucket >= first && bucket <= last) addBucket(bucket);
+        }
+    }
+    inside &= queried;
+    edges &= queried;
+    edges -= inside;
+
+    for (std::size_t i = 0; i < cellIds.size(); ++i) {
+        if (!cellSchedules[i]) continue;
+        const auto ordinal = cellSchedules[i]->ordinal;
+        if (inside.contains(ordinal)) {
+            occupied[i] = true;
+        } else if (edges.contains(ordinal)) {
+            bool overlaps = false;
+            cellSchedules[i]->forEachCandidate(start, end, [&](const Reservation &r) {
+                overlaps |= r.start < end && r.end > start;
+            });
+            occupied[i] = overlaps;
+        }
+    }
+    return occupied;
+}
+
+std::vector<std::string>
+ab::BookingStore::occupiedCells(const std::vector<std::string> &cellIds, d4::TimeInstant start,
+                                d4::TimeInstant end) const {
+    const auto occupied = occupancyOf(cellIds, start, end);
+    std::vector<std::string> cells;
+    for (std::size_t i = 0; i < cellIds.size(); ++i) {
+        if (occupied[i]) cells.push_back(cellIds[i]);
+    }
+    return cells;
+}
+
+std::vector<std::string>
+ab::BookingStore::unoccupiedCells(const std::vector<std::string> &cellIds, d4::TimeInstant start,
+                                  d4::TimeInstant end) const {
+    const auto occupied = occupancyOf(cellIds, start, end);
+    std::vector<std::string> cells;
+    for (std::size_t i = 0; i < cellIds.size(); ++i) {
+        if (!occupied[i]) cells.push_back(cellIds[i]);
+    }
+    return cells;
+}
+
+std::optional<ab::BookingStore::Duration>
+ab::BookingStore::earliestFreeOffset(const std::vector<CellBooking> &bookings, Duration minOffset,
+                                     Duration maxOffset) const {
+    if (maxOffset < minOffset) return std::nullopt;
+    // The open intervals of offsets at which a shifted booking overlaps a time slice its cell is at capacity over
+    std::vector<std::pair<Duration, Duration>> forbidden;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        for (const auto &booking: bookings) {
+            const auto capacity = capacityOf(booking.cellId);
+            if (capacity == 0) return std::nullopt;
+            const auto it = schedules.find(booking.cellId);
+            if (it == schedules.end()) continue;
+            const auto &slice = booking.timeSlice;
+            it->second.forEachSaturated(slice.start + minOffset, slice.end + maxOffset, capacity,
+                                        [&](d4::TimeInstant from, d4::TimeInstant to) {
+                                            const auto lower = from - slice.end, upper = to - slice.start;
+                                            if (upper > minOffset && lower < maxOffset) {
+                                                forbidden.emplace_back(lower, upper);
+                                            }
+                                        });
+        }
+    }
+    std::sort(forbidden.begin(), forbidden.end());
+
+    auto offset = minOffset;
+    for (const auto &[lower, upper]: forbidden) {
+        // Sorted by lower, so no later interval contains the offset either
+        if (lower >= offset) break;
+        offset = std::max(offset, upper);
+    }
+    if (offset > maxOffset) return std::nullopt;
+    return offset;
+}
+
+void ab::BookingStore::setDefaultCapacity(std::uint32_t capacity) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    defaultCapacity_ = capacity;
+}
+
+std::uint32_t ab::BookingStore::defaultCapacity() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return defaultCapacity_;
+}
+
+void ab::BookingStore::setCapacity(const std::string &cellId, std::uint32_t capacity) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    capacities[cellId] = capacity;
+}
+
+std::uint32_t ab::BookingStore::capacity(const std::string &cellId) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return capacityOf(cellId);
+}
+
+void ab::BookingStore::loadCapacities(const std::string &path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Could not open " + path);
+    // Parse the whole file first so a malformed file changes nothing
+    std::vector<std::pair<std::string, std::uint32_t>> loaded;
+    std::string line;
+    for (std::size_t lineNumber = 1; std::getline(in, line); ++lineNumber) {
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream fields(line);
+        std::string cellId, rest;
+        long long capacity;
+        if (!(fields >> cellId) || cellId[0] == '#') continue;
+        if (!(fields >> capacity) || capacity < 0 || capacity > std::numeric_limits<std::uint32_t>::max()
+            || fields >> rest) {
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + " is not a cell ID and capacity");
+        }
+        loaded.emplace_back(cellId, static_cast<std::uint32_t>(capacity));
+    }
+    if (in.bad()) throw std::runtime_error("Could not read " + path);
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    for (const auto &[cellId, capacity]: loaded) {
+        if (cellId == "*") {
+            defaultCapacity_ = capacity;
+        } else {
+            capacities[cellId] = capacity;
+        }
+    }
+}
+
+void ab::BookingStore::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    schedules.clear();
+    occupancyBuckets.clear();
+    nextOrdinal = 0;
+    freeOrdinals.clear();
+    operationCells.clear();
+    size_ = 0;
+}
+
+std::size_t ab::BookingStore::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return size_;
+}
+
+std::size_t ab::BookingStore::cellCount() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return schedules.size();
+}
+
+std::size_t ab::BookingStore::operationCount() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return operationCells.size();
+}
+
+ab::BookingStore::Duration ab::BookingStore::occupancyBucketWidth() const {
+    return bucketWidth;
+}
+
+std::size_t
+ab::BookingStore::candidateCount(const std::string &cellId, d4::TimeInstant start, d4::TimeInstant end) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    const auto it = schedules.find(cellId);
+    if (it == schedules.end()) return 0;
+    std::size_t candidates = 0;
+    it->second.forEachCandidate(start, end, [&candidates](const Reservation &) { ++candidates; });
+    return candidates;
+}
@@ -0,0 +1,60 @@
+#include "../include/airspacebookingutils/CompactBooking.h"
+#include "../include/airspacebookingutils/util/CellKey.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+    std::int32_t secondsOffset(std::chrono::seconds offset) {
+        if (offset.count() < std::numeric_limits<std::int32_t>::min()
+            || offset.count() > std::numeric_limits<std::int32_t>::max()) {
+            throw std::invalid_argument("Booking is too far from the batch epoch to be compacted");
+        }
+        return static_cast<std::int32_t>(offset.count());
+    }
+}
+
+ab::CompactBookingBatch::CompactBookingBatch(d4::TimeInstant epoch)
+        : epoch_(std::chrono::floor<std::chrono::seconds>(epoch)) {
+}
+
+ab::CompactBookingBatch ab::CompactBookingBatch::fromCellBookings(const std::vector<CellBooking> &bookings) {
+    const auto earliest = std::min_element(bookings.begin(), bookings.end(), [](const auto &a, const auto &b) {
+        return a.timeSlice.start < b.timeSlice.start;
+    });
+    CompactBookingBatch batch(earliest == bookings.end() ? d4::TimeInstant() : earliest->timeSlice.start);
+    batch.reserve(bookings.size());
+    for (const auto &booking: bookings) {
+        batch.add(booking);
+    }
+    return batch;
+}
+
+ab::CompactBooking ab::CompactBookingBatch::compact(const CellBooking &booking) const {
+    const auto key = util::encodeCellKey(booking.cellId);
+    if (!key) throw std::invalid_argument("Cell " + booking.cellId + " can not be packed into a cell key");
+    return {*key, secondsOffset(std::chrono::floor<std::chrono::seconds>(booking.timeSlice.start - epoch_)),
+            secondsOffset(std::chrono::ceil<std::chrono::seconds>(booking.timeSlice.end - epoch_))};
+}
+
+ab::d4::TimeSlice ab::CompactBookingBatch::timeSlice(const CompactBooking &booking) const {
+    return {epoch_ + std::chrono::seconds(booking.start), epoch_ + std::chrono::seconds(booking.end)};
+}
+
+ab::CellBooking ab::CompactBookingBatch::cellBooking(const CompactBooking &booking) const {
+    return {timeSlice(booking), util::decodeCellKey(booking.cellKey)};
+}
+
+void ab::CompactBookingBatch::add(const CellBooking &booking) {
+    bookings_.push_back(compact(booking));
+}
+
+std::vector<ab::CellBooking> ab::CompactBookingBatch::toCellBookings() const {
+    std::vector<CellBooking> cellBookings;
+    cellBookings.reserve(bookings_.size());
+    for (const auto &booking: bookings_) {
+        cellBookings.push_back(cellBooking(booking));
+    }
+    return cellBookings;
+}
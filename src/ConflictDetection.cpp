@@ -0,0 +1,369 @@
+#include "../include/airspacebookingutils/ConflictDetection.h"
+#include "../include/airspacebookingutils/util/CellKey.h"
+#include "../include/airspacebookingutils/util/LocalProjection.h"
+#include "../include/airspacebookingutils/util/Parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <spdlog/spdlog.h>
+
+namespace {
+    struct BookingRecord {
+        std::uint64_t cellKey;
+        ab::d4::TimeInstant start;
+        ab::d4::TimeInstant end;
+        std::uint32_t operation;
+        std::uint32_t booking;
+    };
+
+    /**
+     * @brief Flatten bookings into records keyed by cell. Cell IDs are packed into cell keys where possible, otherwise
+     * they are all interned
+     */
+    std::vector<BookingRecord> flattenBookings(const std::vector<std::vector<ab::CellBooking>> &operations) {
+        std::size_t nBookings = 0;
+        for (const auto &bookings: operations) {
+            nBookings += bookings.size();
+        }
+        std::vector<BookingRecord> records;
+        records.reserve(nBookings);
+
+        bool packed = true;
+        for (std::uint32_t op = 0; op < operations.size() && packed; ++op) {
+            for (std::uint32_t b = 0; b < operations[op].size(); ++b) {
+                const auto &booking = operations[op][b];
+                const auto key = ab::util::encodeCellKey(booking.cellId);
+                if (!key) {
+                    packed = false;
+                    break;
+                }
+                records.push_back({*key, booking.timeSlice.start, booking.timeSlice.end, op, b});
+            }
+        }
+        if (packed) return records;
+
+        spdlog::info("Cell IDs can not all be packed, interning them instead");
+        records.clear();
+        std::unordered_map<std::string_view, std::uint64_t> internedIds;
+        for (std::uint32_t op = 0; op < operations.size(); ++op) {
+            for (std::uint32_t b = 0; b < operations[op].size(); ++b) {
+                const auto &booking = operations[op][b];
+                const auto key = internedIds.emplace(booking.cellId, internedIds.size()).first->second;
+                records.push_back({key, booking.timeSlice.start, booking.timeSlice.end, op, b});
+            }
+        }
+        return records;
+    }
+
+    /**
+     * @brief A point of a track that is linearly interpolated in time between its knots
+     */
+    struct TrackKnot {
+        // The index of the state vector at this knot
+        std::size_t state;
+        // Seconds since the reference time
+        double time;
+        ab::Position position;
+    };
+
+    /**
+     * @brief A trajectory timed like its bookings, with each segment flown from the time of its first state vector at
+     * its speed, and held at its end points for a number of seconds
+     */
+    struct Track {
+        const std::vector<ab::d4::StateVector4D> *trajectory;
+        std::vector<TrackKnot> knots;
+        // The fastest speed between knots in meters per second
+        ab::FPScalar maxSpeed = 0;
+    };
+
+    double secondsSince(ab::d4::TimeInstant reference, ab::d4::TimeInstant time) {
+        return std::chrono::duration<double>(time - reference).count();
+    }
+
+    Track makeTrack(const std::vector<ab::d4::StateVector4D> &trajectory, ab::d4::TimeInstant reference,
+                    double holdSeconds) {
+        Track track{&trajectory, {}, 0};
+        if (trajectory.empty()) return track;
+        std::vector<ab::Position> positions;
+        positions.reserve(trajectory.size());
+        for (const auto &sv: trajectory) {
+            positions.emplace_back(sv.position);
+        }
+        const auto projection = ab::util::LocalProjection::centredOn(positions);
+
+        auto &knots = track.knots;
+        knots.reserve(2 * trajectory.size() + 1);
+        ab::Position previous = projection.forward(positions.front());
+        const double departure = secondsSince(reference, trajectory.front().time);
+        if (holdSeconds > 0) knots.push_back({0, departure - holdSeconds, previous});
+        knots.push_back({0, departure, previous});
+        for (std::size_t i = 0; i + 1 < trajectory.size(); ++i) {
+            const ab::Position next = projection.forward(positions[i + 1]);
+            const double start = std::max(knots.back().time, secondsSince(reference, trajectory[i].time));
+            // Hold until the segment starts
+            if (start > knots.back().time) knots.push_back({i, start, previous});
+            const auto length = (next - previous).norm();
+            const double duration = trajectory[i].speed > 0 ? length / trajectory[i].speed : 0;
+            knots.push_back({i + 1, start + duration, next});
+            if (duration > 0) track.maxSpeed = std::max(track.maxSpeed, length / duration);
+            previous = next;
+        }
+        if (holdSeconds > 0) knots.push_back({knots.back().state, knots.back().time + holdSeconds, previous});
+        return track;
+    }
+
+    /**
+     * @brief Project the knots of a track into a shared projection
+     */
+    std::vector<TrackKnot> reprojected(const Track &track, const ab::util::LocalProjection &projection) {
+        auto knots = track.knots;
+        for (auto &knot: knots) {
+            knot.position = projection.forward((*track.trajectory)[knot.state].position);
+        }
+        return knots;
+    }
+
+    ab::Position positionAt(const std::vector<TrackKnot> &knots, double time) {
+        const auto next = std::upper_bound(knots.begin(), knots.end(), time, [](double t, const TrackKnot &k) {
+            return t < k.time;
+        });
+        if (next == knots.begin()) return knots.front().position;
+        if (next == knots.end()) return knots.back().position;
+        const auto &k0 = *(next - 1), &k1 = *next;
+        return k0.position + (time - k0.time) / (k1.time - k0.time) * (k1.position - k0.position);
+    }
+
+    /**
+     * @brief Minimise the separation of two tracks over their common time. Both tracks are linear between the knot
+     * times of either, so the minimum of each interval is found in closed form
+     * @return the separation vector and time of the closest approach
+     */
+    std::optional<std::pair<ab::Position, double>> closestSeparation(const Track &a, const Track &b) {
+        if (a.knots.empty() || b.knots.empty()) return std::nullopt;
+        const double start = std::max(a.knots.front().time, b.knots.front().time);
+        const double end = std::min(a.knots.back().time, b.knots.back().time);
+        if (start > end) return std::nullopt;
+
+        std::vector<ab::Position> positions;
+        positions.reserve(a.trajectory->size() + b.trajectory->size());
+        for (const auto *trajectory: {a.trajectory, b.trajectory}) {
+            for (const auto &sv: *trajectory) {
+                positions.emplace_back(sv.position);
+            }
+        }
+        const auto projection = ab::util::LocalProjection::centredOn(positions);
+        const auto knotsA = reprojected(a, projection), knotsB = reprojected(b, projection);
+
+        std::vector<double> times{start};
+        for (const auto *knots: {&knotsA, &knotsB}) {
+            for (const auto &knot: *knots) {
+                if (knot.time > start && knot.time < end) times.push_back(knot.time);
+            }
+        }
+        times.push_back(end);
+        std::sort(times.begin(), times.end());
+
+        ab::Position closest = positionAt(knotsA, start) - positionAt(knotsB, start);
+        double closestTime = start;
+        for (std::size_t i = 0; i + 1 < times.size(); ++i) {
+            if (times[i + 1] <= times[i]) continue;
+            const ab::Position r0 = positionAt(knotsA, times[i]) - positionAt(knotsB, times[i]);
+            const ab::Position v = positionAt(knotsA, times[i + 1]) - positionAt(knotsB, times[i + 1]) - r0;
+            const auto vv = v.squaredNorm();
+            const ab::FPScalar f = vv > 0 ? std::clamp(-r0.dot(v) / vv, ab::FPScalar(0), ab::FPScalar(1)) : 0;
+            const ab::Position r = r0 + f * v;
+            if (r.squaredNorm() < closest.squaredNorm()) {
+                closest = r;
+                closestTime = times[i] + f * (times[i + 1] - times[i]);
+            }
+        }
+        return std::make_pair(closest, closestTime);
+    }
+
+    /**
+     * @brief The time interval and (lon, lat, alt) bounds of a track, widened by a distance
+     */
+    struct TrackBounds {
+        double start;
+        double end;
+        std::array<ab::FPScalar, 3> min;
+        std::array<ab::FPScalar, 3> max;
+
+        bool overlaps(const TrackBounds &other) const {
+            for (int d = 0; d < 3; ++d) {
+                if (min[d] > other.max[d] || other.min[d] > max[d]) return false;
+            }
+            return start <= other.end && other.start <= end;
+        }
+    };
+
+    TrackBounds trackBounds(const Track &track, ab::FPScalar distance, double holdSeconds) {
+        constexpr auto inf = std::numeric_limits<ab::FPScalar>::infinity();
+        TrackBounds bounds{-std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(),
+                           {inf, inf, inf}, {-inf, -inf, -inf}};
+        if (track.knots.empty()) return bounds;
+        // The hold is split between both tracks of a pair
+        bounds.start = track.knots.front().time + holdSeconds / 2;
+        bounds.end = track.knots.back().time - holdSeconds / 2;
+        const auto &trajectory = *track.trajectory;
+        for (std::size_t i = 0; i < trajectory.size(); ++i) {
+            for (int d = 0; d < 3; ++d) {
+                bounds.min[d] = std::min(bounds.min[d], trajectory[i].position(d));
+                bounds.max[d] = std::max(bounds.max[d], trajectory[i].position(d));
+            }
+            if (i > 0 && std::abs(trajectory[i].position.x() - trajectory[i - 1].position.x()) > 180) {
+                // Crosses the antimeridian
+                bounds.min[0] = -inf;
+                bounds.max[0] = inf;
+            }
+        }
+        const ab::FPScalar latDistance = RAD2DEG(distance / ab::util::EARTH_RADIUS);
+        bounds.min[1] -= latDistance;
+        bounds.max[1] += latDistance;
+        const ab::FPScalar cosLat = std::cos(DEG2RAD(std::min<ab::FPScalar>(
+                std::max(std::abs(bounds.min[1]), std::abs(bounds.max[1])), 90)));
+        if (cosLat > 1e-6) {
+            bounds.min[0] -= latDistance / cosLat;
+            bounds.max[0] += latDistance / cosLat;
+        } else {
+            bounds.min[0] = -inf;
+            bounds.max[0] = inf;
+        }
+        bounds.min[2] -= distance;
+        bounds.max[2] += distance;
+        return bounds;
+    }
+}
+
+std::vector<ab::Conflict> ab::detectConflicts(const std::vector<std::vector<CellBooking>> &operations) {
+    auto records = flattenBookings(operations);
+    util::parallelSort(records.begin(), records.end(), [](const BookingRecord &a, const BookingRecord &b) {
+        return std::tie(a.cellKey, a.start) < std::tie(b.cellKey, b.start);
+    });
+
+    // Each cell is swept independently
+    std::vector<std::size_t> cellStarts;
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        if (i == 0 || records[i].cellKey != records[i - 1].cellKey) cellStarts.push_back(i);
+    }
+    cellStarts.push_back(records.size());
+    const auto nCells = static_cast<long>(cellStarts.size()) - 1;
+
+    std::vector<Conflict> conflicts;
+#pragma omp parallel
+    {
+        std::vector<Conflict> threadConflicts;
+        // Records of the current cell whose time slices may still overlap later records
+        std::vector<const BookingRecord *> active;
+#pragma omp for schedule(dynamic, 256) nowait
+        for (long c = 0; c < nCells; ++c) {
+            active.clear();
+            for (std::size_t i = cellStarts[c]; i < cellStarts[c + 1]; ++i) {
+                const auto &record = records[i];
+                if (record.end <= record.start) continue;
+                // Records are sorted by start, so any active record ending by now can not overlap this or later ones
+                active.erase(std::remove_if(active.begin(), active.end(), [&record](const BookingRecord *a) {
+                    return a->end <= record.start;
+                }), active.end());
+                for (const auto *other: active) {
+                    if (other->operation == record.operation) continue;
+                    const auto first = std::min(other->operation, record.operation);
+                    const auto second = std::max(other->operation, record.operation);
+                    threadConflicts.emplace_back(first, second,
+                                                 operations[record.operation][record.booking].cellId,
+                                                 d4::TimeSlice(record.start, std::min(other->end, record.end)));
+                }
+                active.push_back(&record);
+            }
+        }
+#pragma omp critical
+        conflicts.insert(conflicts.end(), std::make_move_iterator(threadConflicts.begin()),
+                         std::make_move_iterator(threadConflicts.end()));
+    }
+
+    util::parallelSort(conflicts.begin(), conflicts.end(), [](const Conflict &a, const Conflict &b) {
+        return std::tie(a.firstOperation, a.secondOperation, a.overlap.start, a.cellId)
+               < std::tie(b.firstOperation, b.secondOperation, b.overlap.start, b.cellId);
+    });
+    return conflicts;
+}
+
+std::optional<ab::ClosestApproach>
+ab::closestPointOfApproach(const std::vector<d4::StateVector4D> &trajectoryA,
+                           const std::vector<d4::StateVector4D> &trajectoryB) {
+    if (trajectoryA.empty() || trajectoryB.empty()) return std::nullopt;
+    const auto reference = trajectoryA.front().time;
+    const auto separation = closestSeparation(makeTrack(trajectoryA, reference, 0),
+                                              makeTrack(trajectoryB, reference, 0));
+    if (!separation) return std::nullopt;
+    const auto &[r, time] = *separation;
+    return ClosestApproach{r.norm(), r.head<2>().norm(), std::abs(r.z()),
+                           reference + std::chrono::duration_cast<d4::TimeInstant::duration>(
+                                   std::chrono::duration<double>(time))};
+}
+
+std::vector<std::pair<std::size_t, std::size_t>>
+ab::conflictCandidatePairs(const std::vector<std::vector<d4::StateVector4D>> &trajectories,
+                           FPScalar lateralSeparation, FPScalar verticalSeparation, FPScalar temporalSeparation) {
+    const FPScalar separation = std::hypot(lateralSeparation, verticalSeparation);
+    d4::TimeInstant reference{};
+    for (const auto &trajectory: trajectories) {
+        if (!trajectory.empty()) {
+            reference = trajectory.front().time;
+            break;
+        }
+    }
+
+    const auto n = trajectories.size();
+    std::vector<Track> tracks(n);
+    std::vector<TrackBounds> bounds(n);
+#pragma omp parallel for schedule(dynamic, 16)
+    for (long i = 0; i < static_cast<long>(n); ++i) {
+        tracks[i] = makeTrack(trajectories[i], reference, temporalSeparation);
+        // Holding a track at its end points for the temporal separation moves it at most this far from where it
+        // could be at the same time
+        bounds[i] = trackBounds(tracks[i], separation / 2 + tracks[i].maxSpeed * temporalSeparation,
+                                temporalSeparation);
+    }
+
+    // Sweep the tracks by time, comparing bounds of the tracks still in the air
+    std::vector<std::size_t> order;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!trajectories[i].empty()) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&bounds](std::size_t a, std::size_t b) {
+        return bounds[a].start < bounds[b].start;
+    });
+    std::vector<std::pair<std::size_t, std::size_t>> boundedPairs;
+    std::vector<std::size_t> active;
+    for (const auto i: order) {
+        active.erase(std::remove_if(active.begin(), active.end(), [&](std::size_t a) {
+            return bounds[a].end < bounds[i].start;
+        }), active.end());
+        for (const auto j: active) {
+            if (bounds[i].overlaps(bounds[j])) boundedPairs.emplace_back(std::min(i, j), std::max(i, j));
+        }
+        active.push_back(i);
+    }
+    spdlog::info("{} of {} trajectory pairs have overlapping bounds", boundedPairs.size(), n * (n - 1) / 2);
+
+    std::vector<char> keep(boundedPairs.size(), 0);
+#pragma omp parallel for schedule(dynamic, 16)
+    for (long p = 0; p < static_cast<long>(boundedPairs.size()); ++p) {
+        const auto &a = tracks[boundedPairs[p].first], &b = tracks[boundedPairs[p].second];
+        const auto closest = closestSeparation(a, b);
+        keep[p] = closest && closest->first.norm() < separation + std::max(a.maxSpeed, b.maxSpeed) * temporalSeparation;
+    }
+
+    std::vector<std::pair<std::size_t, std::size_t>> pairs;
+    for (std::size_t p = 0; p < boundedPairs.size(); ++p) {
+        if (keep[p]) pairs.push_back(boundedPairs[p]);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+}
@@ -0,0 +1,223 @@
+#include "../include/airspacebookingutils/OccupancyAggregator.h"
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    /**
+     * @brief The index of the bucket containing an offset from the origin, rounding down for negative offsets
+     */
+    std::int64_t bucketOf(ab::OccupancyAggregator::Duration offset, ab::OccupancyAggregator::Duration width) {
+        auto bucket = offset / width;
+        if (offset % width < ab::OccupancyAggregator::Duration::zero()) --bucket;
+        return bucket;
+    }
+
+    bool byCellId(const ab::CellOccupancy &a, const ab::CellOccupancy &b) {
+        return a.cellId < b.cellId;
+    }
+}
+
+ab::OccupancyAggregator::OccupancyAggregator(Duration bucketWidth, d4::TimeInstant origin)
+        : width(bucketWidth), origin_(origin) {
+    if (bucketWidth <= Duration::zero()) {
+        throw std::invalid_argument("Bucket width must be positive");
+    }
+}
+
+std::size_t ab::OccupancyAggregator::shardOf(const std::string &cellId) {
+    return std::hash<std::string>{}(cellId) % SHARDS;
+}
+
+void ab::OccupancyAggregator::add(OperationId operation, const std::vector<CellBooking> &bookings) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &booking: bookings) {
+        if (!(booking.timeSlice.start < booking.timeSlice.end)) continue;
+        shards[shardOf(booking.cellId)][booking.cellId].push_back({booking.timeSlice.start, booking.timeSlice.end,
+                                                                   operation});
+        ++size_;
+    }
+}
+
+std::vector<ab::CellOccupancy> ab::OccupancyAggregator::summarise(const Shard &shard) const {
+    std::vector<CellOccupancy> cells;
+    cells.reserve(shard.size());
+    std::vector<Occupation> joined;
+    // (time, +1 for a start or -1 for an end), so ends sort before starts at the same time
+    std::vector<std::pair<d4::TimeInstant, int>> events;
+    for (const auto &[cellId, occupations]: shard) {
+        CellOccupancy cell;
+        cell.cellId = cellId;
+
+        // Join the overlapping and touching time slices of each operation
+        joined = occupations;
+        std::sort(joined.begin(), joined.end(), [](const Occupation &a, const Occupation &b) {
+            return a.operation != b.operation ? a.operation < b.operation : a.start < b.start;
+        });
+        std::size_t nJoined = 0;
+        for (const auto &occupation: joined) {
+            if (nJoined > 0 && joined[nJoined - 1].operation == occupation.operation
+                && occupation.start <= joined[nJoined - 1].end) {
+                joined[nJoined - 1].end = std::max(joined[nJoined - 1].end, occupation.end);
+            } else {
+                // Runs are grouped by operation, so an operation that leaves and comes back is counted once
+                if (nJoined == 0 || joined[nJoined - 1].operation != occupation.operation) ++cell.operations;
+                joined[nJoined++] = occupation;
+            }
+        }
+        joined.resize(nJoined);
+
+        // Count the operations in each bucket from the differences at the first and after the last bucket of each
+        std::int64_t first = std::numeric_limits<std::int64_t>::max();
+        std::int64_t last = std::numeric_limits<std::int64_t>::min();
+        for (const auto &occupation: joined) {
+            first = std::min(first, bucketOf(occupation.start - origin_, width));
+            // The end is exclusive
+            last = std::max(last, bucketOf(occupation.end - origin_ - Duration(1), width));
+        }
+        std::vector<std::int64_t> differences(last - first + 2, 0);
+        // Each operation counts once in a bucket however many of its runs touch it, so its runs, sorted by start,
+        // each begin after the last bucket of the one before
+        std::int64_t lastCounted = 0;
+        for (std::size_t r = 0; r < joined.size(); ++r) {
+            const auto &occupation = joined[r];
+            auto from = bucketOf(occupation.start - origin_, width);
+            if (r > 0 && joined[r - 1].operation == occupation.operation) from = std::max(from, lastCounted + 1);
+            const auto to = bucketOf(occupation.end - origin_ - Duration(1), width);
+            if (from > to) continue;
+            ++differences[from - first];
+            --differences[to - first + 1];
+            lastCounted = to;
+        }
+        cell.firstBucket = origin_ + first * width;
+        cell.histogram.resize(differences.size() - 1);
+        std::int64_t count = 0;
+        for (std::size_t b = 0; b < cell.histogram.size(); ++b) {
+            count += differences[b];
+            cell.histogram[b] = static_cast<std::uint32_t>(count);
+        }
+
+        // Sweep the starts and ends for the first time slice at the peak
+        events.clear();
+        for (const auto &occupation: joined) {
+            events.emplace_back(occupation.start, 1);
+            events.emplace_back(occupation.end, -1);
+        }
+        std::sort(events.begin(), events.end());
+        std::uint32_t current = 0;
+        bool atPeak = false;
+        for (const auto &[time, change]: events) {
+            if (change < 0 && atPeak) {
+                cell.peak.end = time;
+                atPeak = false;
+            }
+            current += change;
+            if (current > cell.peakConcurrency) {
+                cell.peakConcurrency = current;
+                cell.peak.start = time;
+                atPeak = true;
+            }
+        }
+        cells.push_back(std::move(cell));
+    }
+    return cells;
+}
+
+std::vector<ab::CellOccupancy> ab::OccupancyAggregator::occupancy() const {
+    std::array<std::vector<CellOccupancy>, SHARDS> summaries;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+#pragma omp parallel for schedule(dynamic, 1)
+        for (long s = 0; s < static_cast<long>(SHARDS); ++s) {
+            summaries[s] = summarise(shards[s]);
+        }
+    }
+    std::vector<CellOccupancy> cells;
+    for (auto &summary: summaries) {
+        cells.insert(cells.end(), std::make_move_iterator(summary.begin()), std::make_move_iterator(summary.end()));
+    }
+    std::sort(cells.begin(), cells.end(), byCellId);
+    return cells;
+}
+
+std::vector<ab::CellOccupancy> ab::OccupancyAggregator::rollup(IndexSystem indexSystem, int resolution) const {
+    // The occupations of the parents of the cells of each shard, split by the shard of the parent
+    std::vector<std::array<Shard, SHARDS>> parents(SHARDS);
+    std::vector<std::exception_ptr> errors(SHARDS);
+    std::array<std::vector<CellOccupancy>, SHARDS> summaries;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+#pragma omp parallel for schedule(dynamic, 1)
+        for (long s = 0; s < static_cast<long>(SHARDS); ++s) {
+            try {
+                for (const auto &[cellId, occupations]: shards[s]) {
+                    const auto parent = parentCell(cellId, indexSystem, resolution);
+                    auto &parentOccupations = parents[s][shardOf(parent)][parent];
+                    parentOccupations.insert(parentOccupations.end(), occupations.begin(), occupations.end());
+                }
+            } catch (...) {
+                errors[s] = std::current_exception();
+            }
+        }
+    }
+    for (const auto &error: errors) {
+        if (error) std::rethrow_exception(error);
+    }
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (long t = 0; t < static_cast<long>(SHARDS); ++t) {
+        Shard shard;
+        for (auto &split: parents) {
+            for (auto &[cellId, occupations]: split[t]) {
+                auto &parentOccupations = shard[cellId];
+                if (parentOccupations.empty()) {
+                    parentOccupations = std::move(occupations);
+                } else {
+                    parentOccupations.insert(parentOccupations.end(), occupations.begin(), occupations.end());
+                }
+            }
+        }
+        summaries[t] = summarise(shard);
+    }
+
+    std::vector<CellOccupancy> cells;
+    for (auto &summary: summaries) {
+        cells.insert(cells.end(), std::make_move_iterator(summary.begin()), std::make_move_iterator(summary.end()));
+    }
+    std::sort(cells.begin(), cells.end(), byCellId);
+    return cells;
+}
+
+void ab::OccupancyAggregator::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &shard: shards) {
+        shard.clear();
+    }
+    size_ = 0;
+}
+
+std::size_t ab::OccupancyAggregator::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return size_;
+}
+
+std::size_t ab::OccupancyAggregator::cellCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::size_t cells = 0;
+    for (const auto &shard: shards) {
+        cells += shard.size();
+    }
+    return cells;
+}
+
+ab::OccupancyAggregator::Duration ab::OccupancyAggregator::bucketWidth() const {
+    return width;
+}
+
+ab::d4::TimeInstant ab::OccupancyAggregator::origin() const {
+    return origin_;
+}
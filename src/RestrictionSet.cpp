@@ -0,0 +1,332 @@
+#include "../include/airspacebookingutils/RestrictionSet.h"
+#include "../include/airspacebookingutils/util/CellKey.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <spdlog/spdlog.h>
+
+namespace {
+    constexpr char MAGIC[8] = {'A', 'B', 'R', 'S', 'E', 'T', '\0', '\0'};
+    constexpr std::uint32_t VERSION = 1;
+
+    struct FileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t levelCount;
+    };
+
+    struct LevelHeader {
+        std::int32_t indexSystem;
+        std::int32_t resolution;
+        std::int32_t verticalResolution;
+        std::uint32_t reserved;
+        // Byte offset of the cells from the start of the file
+        std::uint64_t offset;
+        std::uint64_t count;
+    };
+
+    using Cell = ab::RestrictionSet::Cell;
+
+    std::int64_t floorSeconds(ab::d4::TimeInstant time) {
+        return std::chrono::floor<std::chrono::seconds>(time).time_since_epoch().count();
+    }
+
+    std::int64_t ceilSeconds(ab::d4::TimeInstant time) {
+        return std::chrono::ceil<std::chrono::seconds>(time).time_since_epoch().count();
+    }
+
+    /**
+     * @brief Book restriction volumes at each resolution and sort their cells by key
+     * @param permanent make the restrictions valid at all times instead of during their time slices
+     */
+    std::shared_ptr<std::vector<std::vector<Cell>>>
+    compiledCells(const std::vector<ab::d4::Volume4D> &restrictions, const std::vector<ab::ResolutionSpec> &resolutions,
+                  const ab::BookingOptions &options, bool permanent) {
+        auto bookingOptions = options;
+        bookingOptions.compact = false;
+        auto levelCells = std::make_shared<std::vector<std::vector<Cell>>>(resolutions.size());
+        for (std::size_t r = 0; r < restrictions.size(); ++r) {
+            const auto &restriction = restrictions[r];
+            const auto bookings = ab::getMultiResolutionVolumeBookings(restriction, resolutions, bookingOptions);
+            const auto start = permanent ? std::numeric_limits<std::int64_t>::min()
+                                         : floorSeconds(restriction.timeSlice.start);
+            const auto end = permanent ? std::numeric_limits<std::int64_t>::max()
+                                       : ceilSeconds(restriction.timeSlice.end);
+            for (std::size_t l = 0; l < resolutions.size(); ++l) {
+                for (const auto &booking: bookings[l]) {
+                    const auto key = ab::util::encodeCellKey(booking.cellId);
+                    if (!key) {
+                        throw std::invalid_argument("Cell " + booking.cellId + " can not be packed into a cell key");
+                    }
+                    (*levelCells)[l].push_back({*key, start, end, r});
+                }
+            }
+        }
+        for (std::size_t l = 0; l < resolutions.size(); ++l) {
+            auto &cells = (*levelCells)[l];
+            std::sort(cells.begin(), cells.end(), [](const Cell &a, const Cell &b) {
+                return std::tie(a.cellKey, a.start) < std::tie(b.cellKey, b.start);
+            });
+            spdlog::info("Compiled {} restricted cells at resolution {}", cells.size(), resolutions[l].resolution);
+        }
+        return levelCells;
+    }
+
+    bool sameResolution(const ab::ResolutionSpec &a, const ab::ResolutionSpec &b) {
+        const bool is3D = a.indexSystem == ab::IndexSystem::H3D || a.indexSystem == ab::IndexSystem::S23D;
+        return a.indexSystem == b.indexSystem && a.resolution == b.resolution
+               && (!is3D || a.verticalResolution == b.verticalResolution);
+    }
+
+    /**
+     * @brief A read only memory mapping of a whole file
+     */
+    class FileMapping {
+    public:
+#ifdef _WIN32
+        explicit FileMapping(const std::string &path) {
+            const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                            FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Could not open " + path + ": " + lastError());
+            LARGE_INTEGER fileSize{};
+            if (!GetFileSizeEx(file, &fileSize)) {
+                const auto error = lastError();
+                CloseHandle(file);
+                throw std::runtime_error("Could not stat " + path + ": " + error);
+            }
+            size = static_cast<std::size_t>(fileSize.QuadPart);
+            // Empty files can not be mapped
+            if (size > 0) {
+                const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping) {
+                    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                    // The view holds the mapping open
+                    CloseHandle(mapping);
+                }
+                if (!data) {
+                    const auto error = lastError();
+                    CloseHandle(file);
+                    throw std::runtime_error("Could not map " + path + ": " + error);
+                }
+            }
+            CloseHandle(file);
+        }
+
+        ~FileMapping() {
+            if (data) UnmapViewOfFile(data);
+        }
+#else
+        explicit FileMapping(const std::string &path) {
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+            struct stat status{};
+            if (fstat(fd, &status) != 0) {
+                ::close(fd);
+                throw std::runtime_error("Could not stat " + path + ": " + std::strerror(errno));
+            }
+            size = static_cast<std::size_t>(status.st_size);
+            if (size > 0) data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (data == MAP_FAILED) throw std::runtime_error("Could not map " + path + ": " + std::strerror(errno));
+        }
+
+        ~FileMapping() {
+            if (data && data != MAP_FAILED) munmap(data, size);
+        }
+#endif
+
+        FileMapping(const FileMapping &) = delete;
+
+        FileMapping &operator=(const FileMapping &) = delete;
+
+        const char *bytes() const {
+            return static_cast<const char *>(data);
+        }
+
+        std::size_t size = 0;
+
+    private:
+#ifdef _WIN32
+        static std::string lastError() {
+            return "error " + std::to_string(GetLastError());
+        }
+#endif
+
+        void *data = nullptr;
+    };
+}
+
+ab::RestrictionSet
+ab::RestrictionSet::compile(const std::vector<d4::Volume4D> &restrictions,
+                            const std::vector<ResolutionSpec> &resolutions, const BookingOptions &options) {
+    return fromLevels(compiledCells(restrictions, resolutions, options, false), resolutions);
+}
+
+ab::RestrictionSet
+ab::RestrictionSet::compile(const std::vector<GeoPolygon> &restrictions, FPScalar floor, FPScalar ceiling,
+                            const std::vector<ResolutionSpec> &resolutions, const BookingOptions &options) {
+    // Booked over a placeholder time slice, then made permanent
+    const d4::TimeSlice placeholder(d4::TimeInstant(), d4::TimeInstant() + std::chrono::seconds(1));
+    std::vector<d4::Volume4D> volumes;
+    volumes.reserve(restrictions.size());
+    for (const auto &footprint: restrictions) {
+        volumes.emplace_back(footprint, floor, ceiling, placeholder);
+    }
+    return fromLevels(compiledCells(volumes, resolutions, options, true), resolutions);
+}
+
+ab::RestrictionSet ab::RestrictionSet::open(const std::string &path) {
+    auto mapping = std::make_shared<FileMapping>(path);
+    const auto *bytes = mapping->bytes();
+    FileHeader header{};
+    if (mapping->size < sizeof(FileHeader)) throw std::runtime_error(path + " is not a restriction set");
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(path + " is not a restriction set");
+    }
+    if (header.version != VERSION) {
+        throw std::runtime_error(path + " has unsupported restriction set version " + std::to_string(header.version));
+    }
+    if (mapping->size < sizeof(FileHeader) + header.levelCount * sizeof(LevelHeader)) {
+        throw std::runtime_error(path + " is truncated");
+    }
+
+    RestrictionSet set;
+    for (std::uint32_t l = 0; l < header.levelCount; ++l) {
+        LevelHeader levelHeader{};
+        std::memcpy(&levelHeader, bytes + sizeof(FileHeader) + l * sizeof(LevelHeader), sizeof(levelHeader));
+        if (levelHeader.offset % alignof(Cell) != 0 || levelHeader.offset > mapping->size
+            || levelHeader.count > (mapping->size - levelHeader.offset) / sizeof(Cell)) {
+            throw std::runtime_error(path + " is truncated");
+        }
+        set.levels.push_back({ResolutionSpec(static_cast<IndexSystem>(levelHeader.indexSystem),
+                                             levelHeader.resolution, levelHeader.verticalResolution),
+                              reinterpret_cast<const Cell *>(bytes + levelHeader.offset),
+                              static_cast<std::size_t>(levelHeader.count)});
+    }
+    set.storage = mapping;
+    return set;
+}
+
+void ab::RestrictionSet::save(const std::string &path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Could not open " + path + " for writing");
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.levelCount = static_cast<std::uint32_t>(levels.size());
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    // Headers are multiples of 8 bytes, so the cells stay aligned
+    std::uint64_t offset = sizeof(FileHeader) + levels.size() * sizeof(LevelHeader);
+    for (const auto &level: levels) {
+        const LevelHeader levelHeader{static_cast<std::int32_t>(level.resolution.indexSystem),
+                                      level.resolution.resolution, level.resolution.verticalResolution, 0, offset,
+                                      level.size};
+        out.write(reinterpret_cast<const char *>(&levelHeader), sizeof(levelHeader));
+        offset += level.size * sizeof(Cell);
+    }
+    for (const auto &level: levels) {
+        out.write(reinterpret_cast<const char *>(level.cells), static_cast<std::streamsize>(level.size * sizeof(Cell)));
+    }
+    if (!out) throw std::runtime_error("Could not write " + path);
+}
+
+ab::RestrictionSet
+ab::RestrictionSet::fromLevels(std::shared_ptr<const std::vector<std::vector<Cell>>> levelCells,
+                               const std::vector<ResolutionSpec> &resolutions) {
+    RestrictionSet set;
+    for (std::size_t l = 0; l < resolutions.size(); ++l) {
+        set.levels.push_back({resolutions[l], (*levelCells)[l].data(), (*levelCells)[l].size()});
+    }
+    set.storage = std::move(levelCells);
+    return set;
+}
+
+const ab::RestrictionSet::Level &ab::RestrictionSet::level(const ResolutionSpec &resolution) const {
+    for (const auto &level: levels) {
+        if (sameResolution(level.resolution, resolution)) return level;
+    }
+    throw std::invalid_argument("Resolution " + std::to_string(resolution.resolution) + " was not compiled");
+}
+
+template<typename Visit>
+void ab::RestrictionSet::forEachTouched(const std::vector<CellBooking> &bookings, const ResolutionSpec &resolution,
+                                        Visit &&visit) const {
+    const auto &restricted = level(resolution);
+    struct Query {
+        std::uint64_t cellKey;
+        std::int64_t start;
+        std::int64_t end;
+    };
+    std::vector<Query> queries;
+    queries.reserve(bookings.size());
+    for (const auto &booking: bookings) {
+        // Cells that can not be packed are never restricted
+        if (const auto key = util::encodeCellKey(booking.cellId)) {
+            queries.push_back({*key, floorSeconds(booking.timeSlice.start), ceilSeconds(booking.timeSlice.end)});
+        }
+    }
+    std::sort(queries.begin(), queries.end(), [](const Query &a, const Query &b) { return a.cellKey < b.cellKey; });
+
+    // Both sides are sorted by key, so each search continues from the last
+    const Cell *cell = restricted.cells, *const end = restricted.cells + restricted.size;
+    for (const auto &query: queries) {
+        cell = std::lower_bound(cell, end, query.cellKey, [](const Cell &c, std::uint64_t key) {
+            return c.cellKey < key;
+        });
+        if (cell == end) return;
+        for (auto it = cell; it != end && it->cellKey == query.cellKey && it->start < query.end; ++it) {
+            if (it->end > query.start && !visit(*it)) return;
+        }
+    }
+}
+
+bool ab::RestrictionSet::touches(const std::vector<CellBooking> &bookings, const ResolutionSpec &resolution) const {
+    bool touched = false;
+    forEachTouched(bookings, resolution, [&touched](const Cell &) {
+        touched = true;
+        return false;
+    });
+    return touched;
+}
+
+std::vector<std::size_t>
+ab::RestrictionSet::touchedRestrictions(const std::vector<CellBooking> &bookings,
+                                        const ResolutionSpec &resolution) const {
+    std::vector<std::size_t> touched;
+    forEachTouched(bookings, resolution, [&touched](const Cell &cell) {
+        touched.push_back(cell.restriction);
+        return true;
+    });
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    return touched;
+}
+
+std::vector<ab::ResolutionSpec> ab::RestrictionSet::resolutions() const {
+    std::vector<ResolutionSpec> out;
+    for (const auto &level: levels) {
+        out.push_back(level.resolution);
+    }
+    return out;
+}
+
+std::size_t ab::RestrictionSet::cellCount(const ResolutionSpec &resolution) const {
+    return level(resolution).size;
+}
@@ -0,0 +1,296 @@
+#include "../include/airspacebookingutils/RouteSearch.h"
+#include "../include/airspacebookingutils/util/LocalProjection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include <spdlog/spdlog.h>
+#include <h3/h3api.h>
+
+namespace {
+    constexpr double INF = std::numeric_limits<double>::infinity();
+
+    /**
+     * @brief A closed interval of seconds after departure in which the route can be at a cell centre
+     */
+    struct SafeInterval {
+        double start;
+        double end;
+    };
+
+    struct LayerCell {
+        H3Index cell;
+        int layer;
+
+        bool operator==(const LayerCell &other) const {
+            return cell == other.cell && layer == other.layer;
+        }
+    };
+
+    struct LayerCellHash {
+        std::size_t operator()(const LayerCell &c) const {
+            return std::hash<H3Index>()(c.cell) ^ (static_cast<std::size_t>(c.layer) * 0x9E3779B97F4A7C15ULL);
+        }
+    };
+
+    /**
+     * @brief The H3 neighbour graph and the safe intervals of its cells, built lazily as the search reaches them
+     */
+    class SearchGraph {
+    public:
+        SearchGraph(const ab::BookingStore &store, const ab::RouteSearchOptions &options, ab::d4::TimeInstant departure,
+                    const ab::util::LocalProjection &projection, ab::FPScalar fixedAltitude)
+                : store(store), options(options), departure(departure), projection(projection),
+                  fixedAltitude(fixedAltitude) {
+            double edgeLength = 0;
+            getHexagonEdgeLengthAvgM(options.h3Resolution, &edgeLength);
+            // The time to cross a cell, around the time the route is at its centre
+            double crossing = std::sqrt(3.0) * edgeLength;
+            if (options.indexSystem == ab::IndexSystem::H3D) {
+                crossing = std::max<double>(crossing, options.verticalResolution);
+            }
+            halfCrossing = crossing / options.speed / 2;
+        }
+
+        bool isH3D() const {
+            return options.indexSystem == ab::IndexSystem::H3D;
+        }
+
+        ab::FPScalar altitude(int layer) const {
+            return isH3D() ? (layer + 0.5) * options.verticalResolution : fixedAltitude;
+        }
+
+        /**
+         * @brief The (lon, lat, alt) position of a cell centre
+         */
+        ab::Position geoCentre(const LayerCell &c) const {
+            LatLng latLng;
+            cellToLatLng(c.cell, &latLng);
+            return {RAD2DEG(latLng.lng), RAD2DEG(latLng.lat), altitude(c.layer)};
+        }
+
+        /**
+         * @brief The projected position of a cell centre
+         */
+        const ab::Position &centre(const LayerCell &c) {
+            const auto it = centres.find(c);
+            if (it != centres.end()) return it->second;
+            return centres.emplace(c, projection.forward(geoCentre(c))).first->second;
+        }
+
+        double travelTime(const LayerCell &from, const LayerCell &to) {
+            return (centre(to) - centre(from)).norm() / options.speed;
+        }
+
+        const std::vector<H3Index> &neighbours(H3Index cell) {
+            const auto it = neighbourCells.find(cell);
+            if (it != neighbourCells.end()) return it->second;
+            auto disk = gridDiskOf(cell, 1);
+            disk.erase(std::remove(disk.begin(), disk.end(), cell), disk.end());
+            return neighbourCells.emplace(cell, std::move(disk)).first->second;
+        }
+
+        /**
+         * @brief The safe intervals of a cell, sorted by start
+         */
+        const std::vector<SafeInterval> &safeIntervals(const LayerCell &c) {
+            const auto it = intervals.find(c);
+            if (it != intervals.end()) return it->second;
+
+            // Occupying the cell around a centre time t books [t - halfCrossing - backward, t + halfCrossing + forward]
+            // which overlaps a reservation for t in (start - halfCrossing - forward, end + halfCrossing + backward)
+            const auto before = std::chrono::duration<double>(halfCrossing + options.temporalForwardBuffer);
+            const auto after = std::chrono::duration<double>(halfCrossing + options.temporalBackwardBuffer);
+            const auto from = departure - std::chrono::duration_cast<ab::d4::TimeInstant::duration>(after);
+            const auto to = departure + options.horizon + std::chrono::duration_cast<ab::d4::TimeInstant::duration>(before);
+            std::vector<std::pair<double, double>> forbidden;
+            for (const auto cell: gridDiskOf(c.cell, options.clearanceRings)) {
+                const auto id = cellId({cell, c.layer});
+                for (const auto &slice: store.saturatedSlices(id, from, to)) {
+                    forbidden.emplace_back(secondsAfterDeparture(slice.start) - before.count(),
+                                           secondsAfterDeparture(slice.end) + after.count());
+                }
+            }
+            std::sort(forbidden.begin(), forbidden.end());
+
+            std::vector<SafeInterval> safe;
+            double start = -INF;
+            for (const auto &[lower, upper]: forbidden) {
+                if (lower > start) safe.push_back({start, lower});
+                start = std::max(start, upper);
+            }
+            safe.push_back({start, INF});
+            return intervals.emplace(c, std::move(safe)).first->second;
+        }
+
+        std::string cellId(const LayerCell &c) const {
+            const auto centre = geoCentre(c);
+            return isH3D()
+                   ? ab::geoToH3D(options.h3Resolution, options.verticalResolution, centre.y(), centre.x(), centre.z())
+                   : ab::geoToH3(options.h3Resolution, centre.y(), centre.x());
+        }
+
+    private:
+        std::vector<H3Index> gridDiskOf(H3Index cell, int k) const {
+            std::int64_t size = 0;
+            maxGridDiskSize(k, &size);
+            std::vector<H3Index> disk(size, 0);
+            gridDisk(cell, k, disk.data());
+            // Pentagons leave empty slots
+            disk.erase(std::remove(disk.begin(), disk.end(), H3Index(0)), disk.end());
+            return disk;
+        }
+
+        double secondsAfterDeparture(ab::d4::TimeInstant time) const {
+            return std::chrono::duration<double>(time - departure).count();
+        }
+
+        const ab::BookingStore &store;
+        const ab::RouteSearchOptions &options;
+        const ab::d4::TimeInstant departure;
+        const ab::util::LocalProjection &projection;
+        const ab::FPScalar fixedAltitude;
+        double halfCrossing;
+        std::unordered_map<LayerCell, ab::Position, LayerCellHash> centres;
+        std::unordered_map<H3Index, std::vector<H3Index>> neighbourCells;
+        std::unordered_map<LayerCell, std::vector<SafeInterval>, LayerCellHash> intervals;
+    };
+
+    /**
+     * @brief A search state, a cell in one of its safe intervals reached at an arrival time
+     */
+    struct SearchNode {
+        LayerCell cell;
+        std::size_t interval;
+        double arrival;
+        std::size_t parent;
+    };
+}
+
+std::optional<std::vector<ab::d4::StateVector4D>>
+ab::findFreeRoute(const BookingStore &store, const Position &origin, const Position &destination,
+                  d4::TimeInstant departure, const RouteSearchOptions &options) {
+    if (options.indexSystem != IndexSystem::H3 && options.indexSystem != IndexSystem::H3D) {
+        throw std::invalid_argument("Routes can only be searched over H3 or H3D cells");
+    }
+    if (options.speed <= 0) {
+        throw std::invalid_argument("The route speed must be positive");
+    }
+    const auto projection = util::LocalProjection::centredOn(std::vector<Position>{origin, destination});
+    SearchGraph graph(store, options, departure, projection, origin.z());
+
+    // The layers within the altitude band
+    int minLayer = 0, maxLayer = 0;
+    if (graph.isH3D()) {
+        minLayer = static_cast<int>(std::floor(options.minAltitude / options.verticalResolution));
+        maxLayer = std::max(minLayer, static_cast<int>(std::ceil(options.maxAltitude / options.verticalResolution)) - 1);
+    }
+    const auto layerOf = [&](FPScalar altitude) {
+        return std::clamp(static_cast<int>(std::floor(altitude / options.verticalResolution)), minLayer, maxLayer);
+    };
+    const auto cellOf = [&](const Position &p) {
+        const LatLng latLng{DEG2RAD(p.y()), DEG2RAD(p.x())};
+        H3Index cell = 0;
+        latLngToCell(&latLng, options.h3Resolution, &cell);
+        return LayerCell{cell, layerOf(p.z())};
+    };
+    const LayerCell start = cellOf(origin), goal = cellOf(destination);
+
+    const auto &startIntervals = graph.safeIntervals(start);
+    const auto startInterval = std::find_if(startIntervals.begin(), startIntervals.end(), [](const SafeInterval &i) {
+        return i.start <= 0 && 0 <= i.end;
+    });
+    if (startInterval == startIntervals.end()) {
+        spdlog::info("The origin cell is not free at departure");
+        return std::nullopt;
+    }
+
+    const auto heuristic = [&](const LayerCell &c) {
+        return graph.travelTime(c, goal);
+    };
+
+    std::vector<SearchNode> nodes;
+    std::unordered_map<LayerCell, std::vector<double>, LayerCellHash> bestArrivals;
+    using QueueEntry = std::pair<double, std::size_t>;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<>> open;
+
+    const auto push = [&](const LayerCell &c, std::size_t interval, double arrival, std::size_t parent) {
+        auto &best = bestArrivals[c];
+        if (best.size() <= interval) best.resize(interval + 1, INF);
+        if (arrival >= best[interval]) return;
+        best[interval] = arrival;
+        nodes.push_back({c, interval, arrival, parent});
+        open.emplace(arrival + heuristic(c), nodes.size() - 1);
+    };
+    push(start, startInterval - startIntervals.begin(), 0, 0);
+
+    std::size_t expansions = 0;
+    std::vector<LayerCell> successors;
+    while (!open.empty()) {
+        const auto index = open.top().second;
+        open.pop();
+        const SearchNode node = nodes[index];
+        // Skip states that have been reached earlier since being queued
+        if (node.arrival > bestArrivals[node.cell][node.interval]) continue;
+
+        if (node.cell == goal) {
+            std::vector<std::size_t> path;
+            for (auto i = index; i != 0; i = nodes[i].parent) {
+                path.push_back(i);
+            }
+            path.push_back(0);
+            std::reverse(path.begin(), path.end());
+
+            std::vector<d4::StateVector4D> route;
+            const auto at = [&](double seconds) {
+                return departure + std::chrono::duration_cast<d4::TimeInstant::duration>(
+                        std::chrono::duration<double>(seconds));
+            };
+            for (std::size_t i = 0; i < path.size(); ++i) {
+                const auto &current = nodes[path[i]];
+                const auto position = graph.geoCentre(current.cell);
+                route.emplace_back(position, at(current.arrival), options.speed);
+                if (i + 1 < path.size()) {
+                    const auto &next = nodes[path[i + 1]];
+                    const double leave = next.arrival - graph.travelTime(current.cell, next.cell);
+                    // Hover until leaving
+                    if (leave > current.arrival) route.emplace_back(position, at(leave), options.speed);
+                }
+            }
+            spdlog::info("Found a route of {} cells after {} expansions", path.size(), expansions);
+            return route;
+        }
+
+        if (++expansions > options.maxExpansions) {
+            spdlog::warn("Route search gave up after {} expansions", options.maxExpansions);
+            return std::nullopt;
+        }
+
+        // The route can leave this cell until the end of its safe interval, hovering for at most maxHover
+        const double latestLeave = std::min(graph.safeIntervals(node.cell)[node.interval].end,
+                                            node.arrival + options.maxHover);
+        successors.clear();
+        for (const auto neighbour: graph.neighbours(node.cell.cell)) {
+            successors.push_back({neighbour, node.cell.layer});
+        }
+        if (graph.isH3D()) {
+            if (node.cell.layer > minLayer) successors.push_back({node.cell.cell, node.cell.layer - 1});
+            if (node.cell.layer < maxLayer) successors.push_back({node.cell.cell, node.cell.layer + 1});
+        }
+        for (const auto &successor: successors) {
+            const double travel = graph.travelTime(node.cell, successor);
+            const auto &safe = graph.safeIntervals(successor);
+            for (std::size_t i = 0; i < safe.size(); ++i) {
+                if (safe[i].start > latestLeave + travel) break;
+                const double arrival = std::max(node.arrival + travel, safe[i].start);
+                if (arrival > safe[i].end) continue;
+                push(successor, i, arrival, index);
+            }
+        }
+    }
+    spdlog::info("No free route found");
+    return std::nullopt;
+}
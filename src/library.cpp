@@ -1,15 +1,38 @@
 #include "../include/airspacebookingutils/library.h"
+#include "../include/airspacebookingutils/BookingCache.h"
 #include "../include/airspacebookingutils/util/GeometryProjectionUtils.h"
 #include "../include/airspacebookingutils/util/GeometryOperations.h"
 #include "../include/airspacebookingutils/util/4DUtils.h"
 #include "../include/airspacebookingutils/util/Bresenham3D.h"
+#include "../include/airspacebookingutils/util/LocalProjection.h"
+#include "../include/airspacebookingutils/util/GridCoverage.h"
+#include "../include/airspacebookingutils/util/CellLookupCache.h"
+#include "../include/airspacebookingutils/util/ScratchArena.h"
+#include "../include/airspacebookingutils/util/TrajectorySimplification.h"
+#include "../include/airspacebookingutils/util/TrajectoryTiling.h"
 
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <exception>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
 #include <spdlog/spdlog.h>
 #include <h3/h3api.h>
 #include <s2/s2point.h>
 #include <s2/s2latlng.h>
 #include <s2/s2cell_id.h>
+#include <s2/s2cell.h>
+#include <s2/s2cell_union.h>
 
 
 #define RADIANS(x) (x/180 * M_PI)
@@ -17,453 +40,1368 @@
 
 constexpr int GRID_SCALE_FACTOR = 40.0f;
 
+namespace {
+    using Indexer = std::function<std::string(double, double, double)>;
+    // Writes the cell ID of a (lat, lng, alt) sample at each of several resolutions
+    using LevelIndexer = std::function<void(double, double, double, std::vector<std::string> &)>;
+    // Cell bookings at each of several resolutions
+    using LevelBookings = std::vector<std::vector<ab::CellBooking>>;
+
+    // The booking of a single sample before merging, allocated from the arena of the call
+    struct RawBooking {
+        ab::d4::TimeSlice timeSlice;
+        std::pmr::string cellId;
+    };
+    using RawBookings = std::pmr::vector<RawBooking>;
+
+    /**
+     * @brief The sampling limits, deadline and cancellation of a booking call from BookingOptions, shared by the
+     * tiles of the call
+     */
+    class CallBudget {
+    public:
+        explicit CallBudget(const ab::BookingOptions &options)
+                : maxSamples(options.maxSamples), deadline(options.deadline), cancellation(options.cancellation) {
+            if (options.timeLimit.count() > 0) {
+                const auto limit = std::chrono::steady_clock::now() + options.timeLimit;
+                deadline = deadline ? std::min(*deadline, limit) : limit;
+            }
+        }
+
+        /**
+         * @brief Count a sample, throwing a BookingLimitError if the call is over its limits
+         */
+        void sample() {
+            const auto n = ++samples;
+            if (maxSamples > 0 && n > maxSamples) {
+                throw ab::BookingLimitError("Booking exceeded the limit of " + std::to_string(maxSamples)
+                                            + " samples");
+            }
+            // Reading the clock costs more than a sample, so it is only checked every so often
+            if (n % 1024 == 0) check();
+        }
+
+        /**
+         * @brief Throw a BookingCancelledError if the call is cancelled, or a BookingLimitError if it is past its
+         * deadline
+         */
+        void check() const {
+            if (cancellation && cancellation->cancelled()) {
+                throw ab::BookingCancelledError("Booking was cancelled");
+            }
+            if (deadline && std::chrono::steady_clock::now() > *deadline) {
+                throw ab::BookingLimitError("Booking exceeded its time limit");
+            }
+        }
+
+    private:
+        std::uint64_t maxSamples;
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        std::optional<ab::CancellationToken> cancellation;
+        std::atomic<std::uint64_t> samples{0};
+    };
+
+    std::vector<ab::CellBooking>
+    indexedCellBookings(const std::vector<ab::d4::StateVector4D> &trajectory4D, const Indexer &indexer,
+                        int temporalBackwardBuffer, int temporalForwardBuffer, ab::FPScalar spatialLateralBuffer,
+                        ab::FPScalar spatialVerticalBuffer, const ab::BookingOptions &options, ab::BookingStats *stats);
+
+    std::vector<ab::CellBooking>
+    indexedCellBookings(const ab::d4::Volume4D &volume4D, const Indexer &indexer, const ab::BookingOptions &options,
+                        ab::BookingStats *stats);
+
+    void admit(const ab::BookingOptions &options, const std::vector<ab::d4::StateVector4D> &trajectory4D,
+               const std::vector<ab::ResolutionSpec> &resolutions, ab::FPScalar spatialLateralBuffer,
+               ab::FPScalar spatialVerticalBuffer);
+
+    void admit(const ab::BookingOptions &options, const ab::d4::Volume4D &volume4D,
+               const std::vector<ab::ResolutionSpec> &resolutions);
+
+    // Where a booking call is looked up in BookingOptions::cache
+    struct CacheLookup {
+        std::string key;
+        ab::d4::TimeInstant departure;
+    };
+
+    std::optional<CacheLookup>
+    trajectoryCacheLookup(const ab::BookingOptions &options, const std::vector<ab::d4::StateVector4D> &trajectory4D,
+                          int temporalBackwardBuffer, int temporalForwardBuffer, ab::FPScalar spatialLateralBuffer,
+                          ab::FPScalar spatialVerticalBuffer, const std::string &indexKey);
+
+    std::vector<ab::CellBooking>
+    recordedBookings(const ab::BookingOptions &options, std::optional<ab::IndexSystem> compactAs,
+                     const std::function<std::vector<ab::CellBooking>(ab::BookingStats *)> &book,
+                     const std::optional<CacheLookup> &cacheLookup = std::nullopt);
+}
 
 std::vector<ab::CellBooking>
 ab::getH3CellBookings(const std::vector<d4::StateVector4D> &traj, int temporalBackwardBuffer, int temporalForwardBuffer,
-                      FPScalar spatialLateralBuffer, FPScalar spatialVerticalBuffer, int h3Resolution) {
+                      FPScalar spatialLateralBuffer, FPScalar spatialVerticalBuffer, int h3Resolution,
+                      const BookingOptions &options) {
     std::function<std::string(FPScalar, FPScalar, FPScalar)> indexer = [h3Resolution](FPScalar lat, FPScalar lng,
                                                                                       FPScalar alt) {
         return geoToH3(h3Resolution, lat, lng);
     };
-    return getIndexedCellBookings(traj, indexer, temporalBackwardBuffer, temporalForwardBuffer, spatialLateralBuffer,
-                                  spatialVerticalBuffer);
+    admit(options, traj, {{IndexSystem::H3, h3Resolution}}, spatialLateralBuffer, spatialVerticalBuffer);
+    return recordedBookings(options, IndexSystem::H3, [&](BookingStats *stats) {
+        return indexedCellBookings(traj, indexer, temporalBackwardBuffer, temporalForwardBuffer,
+                                   spatialLateralBuffer, spatialVerticalBuffer, options, stats);
+    }, trajectoryCacheLookup(options, traj, temporalBackwardBuffer, temporalForwardBuffer, spatialLateralBuffer,
+                             spatialVerticalBuffer, "H3:" + std::to_string(h3Resolution)));
 }
 
 std::vector<ab::CellBooking>
 ab::getH3DCellBookings(const std::vector<d4::StateVector4D> &trajectory4D, int temporalBackwardBuffer,
                        int temporalForwardBuffer, FPScalar spatialLateralBuffer, FPScalar spatialVerticalBuffer,
-                       int h3Resolution, int verticalResolution) {
+                       int h3Resolution, int verticalResolution, const BookingOptions &options) {
     std::function<std::string(FPScalar, FPScalar, FPScalar)> indexer = [h3Resolution, verticalResolution](FPScalar lat,
                                                                                                           FPScalar lng,
                                                                                                           FPScalar alt) {
         return geoToH3D(h3Resolution, verticalResolution, lat, lng, alt);
     };
-    return getIndexedCellBookings(trajectory4D, indexer, temporalBackwardBuffer, temporalForwardBuffer,
-                                  spatialLateralBuffer, spatialVerticalBuffer);
+    admit(options, trajectory4D, {{IndexSystem::H3D, h3Resolution, verticalResolution}}, spatialLateralBuffer,
+          spatialVerticalBuffer);
+    return recordedBookings(options, IndexSystem::H3D, [&](BookingStats *stats) {
+        return indexedCellBookings(trajectory4D, indexer, temporalBackwardBuffer, temporalForwardBuffer,
+                                   spatialLateralBuffer, spatialVerticalBuffer, options, stats);
+    }, trajectoryCacheLookup(options, trajectory4D, temporalBackwardBuffer, temporalForwardBuffer, spatialLateralBuffer,
+                             spatialVerticalBuffer, "H3D:" + std::to_string(h3Resolution) + ":" + std::to_string(verticalResolution)));
 }
 
 std::vector<ab::CellBooking>
 ab::getS2CellBookings(const std::vector<d4::StateVector4D> &trajectory4D, int temporalBackwardBuffer,
                       int temporalForwardBuffer, FPScalar spatialLateralBuffer, FPScalar spatialVerticalBuffer,
-                      int s2Resolution) {
+                      int s2Resolution, const BookingOptions &options) {
     std::function<std::string(FPScalar, FPScalar, FPScalar)> indexer = [s2Resolution](FPScalar lat, FPScalar lng,
                                                                                       FPScalar alt) {
         return geoToS2(s2Resolution, lat, lng);
     };
-    return getIndexedCellBookings(trajectory4D, indexer, temporalBackwardBuffer, temporalForwardBuffer,
-                                  spatialLateralBuffer, spatialVerticalBuffer);
+    admit(options, trajectory4D, {{IndexSystem::S2, s2Resolution}}, spatialLateralBuffer, spatialVerticalBuffer);
+    return recordedBookings(options, IndexSystem::S2, [&](BookingStats *stats) {
+        return indexedCellBookings(trajectory4D, indexer, temporalBackwardBuffer, temporalForwardBuffer,
+                                   spatialLateralBuffer, spatialVerticalBuffer, options, stats);
+    }, trajectoryCacheLookup(options, trajectory4D, temporalBackwardBuffer, temporalForwardBuffer, spatialLateralBuffer,
+                             spatialVerticalBuffer, "S2:" + std::to_string(s2Resolution)));
 }
 
 std::vector<ab::CellBooking>
 ab::getS23DCellBookings(const std::vector<d4::StateVector4D> &trajectory4D, int temporalBackwardBuffer,
                         int temporalForwardBuffer, FPScalar spatialLateralBuffer, FPScalar spatialVerticalBuffer,
-                        int s2Resolution, int verticalResolution) {
+                        int s2Resolution, int verticalResolution, const BookingOptions &options) {
     std::function<std::string(FPScalar, FPScalar, FPScalar)> indexer = [s2Resolution, verticalResolution](FPScalar lat,
                                                                                                           FPScalar lng,
                                                                                                           FPScalar alt) {
         return geoToS23D(s2Resolution, verticalResolution, lat, lng, alt);
     };
-    return getIndexedCellBookings(trajectory4D, indexer, temporalBackwardBuffer, temporalForwardBuffer,
-                                  spatialLateralBuffer, spatialVerticalBuffer);
+    admit(options, trajectory4D, {{IndexSystem::S23D, s2Resolution, verticalResolution}}, spatialLateralBuffer,
+          spatialVerticalBuffer);
+    return recordedBookings(options, IndexSystem::S23D, [&](BookingStats *stats) {
+        return indexedCellBookings(trajectory4D, indexer, temporalBackwardBuffer, temporalForwardBuffer,
+                                   spatialLateralBuffer, spatialVerticalBuffer, options, stats);
+    }, trajectoryCacheLookup(options, trajectory4D, temporalBackwardBuffer, temporalForwardBuffer, spatialLateralBuffer,
+                             spatialVerticalBuffer, "S23D:" + std::to_string(s2Resolution) + ":" + std::to_string(verticalResolution)));
 }
 
 
 std::vector<ab::CellBooking>
-ab::getH3VolumeBookings(ab::d4::Volume4D volume4D, int h3Resolution) {
+ab::getH3VolumeBookings(ab::d4::Volume4D volume4D, int h3Resolution, const BookingOptions &options) {
     std::function<std::string(FPScalar, FPScalar, FPScalar)> indexer = [h3Resolution](FPScalar lat, FPScalar lng,
                                                                                       FPScalar alt) {
         return geoToH3(h3Resolution, lat, lng);
     };
-    return getIndexedCellBookings(volume4D, indexer);
+    admit(options, volume4D, {{IndexSystem::H3, h3Resolution}});
+    return recordedBookings(options, IndexSystem::H3, [&](BookingStats *stats) {
+        return indexedCellBookings(volume4D, indexer, options, stats);
+    });
 }
 
 std::vector<ab::CellBooking>
 ab::getH3DVolumeBookings(ab::d4::Volume4D volume4D,
-                         int h3Resolution, int verticalResolution) {
+                         int h3Resolution, int verticalResolution, const BookingOptions &options) {
     std::function<std::string(FPScalar, FPScalar, FPScalar)> indexer = [h3Resolution, verticalResolution](FPScalar lat,
                                                                                                           FPScalar lng,
                                                                                                           FPScalar alt) {
         return geoToH3D(h3Resolution, verticalResolution, lat, lng, alt);
     };
-    return getIndexedCellBookings(volume4D, indexer);
+    admit(options, volume4D, {{IndexSystem::H3D, h3Resolution, verticalResolution}});
+    return recordedBookings(options, IndexSystem::H3D, [&](BookingStats *stats) {
+        return indexedCellBookings(volume4D, indexer, options, stats);
+    });
 }
 
 std::vector<ab::CellBooking>
 ab::getS2VolumeBookings(ab::d4::Volume4D volume4D,
-                        int s2Resolution) {
+                        int s2Resolution, const BookingOptions &options) {
     std::function<std::string(FPScalar, FPScalar, FPScalar)> indexer = [s2Resolution](FPScalar lat, FPScalar lng,
                                                                                       FPScalar alt) {
         return geoToS2(s2Resolution, lat, lng);
     };
-    return getIndexedCellBookings(volume4D, indexer);
+    admit(options, volume4D, {{IndexSystem::S2, s2Resolution}});
+    return recordedBookings(options, IndexSystem::S2, [&](BookingStats *stats) {
+        return indexedCellBookings(volume4D, indexer, options, stats);
+    });
 }
 
 std::vector<ab::CellBooking> ab::getS23DVolumeBookings(ab::d4::Volume4D volume4D, int s2Resolution,
-                                                       int verticalResolution) {
+                                                       int verticalResolution, const BookingOptions &options) {
     std::function<std::string(FPScalar, FPScalar, FPScalar)> indexer = [s2Resolution, verticalResolution](FPScalar lat,
                                                                                                           FPScalar lng,
                                                                                                           FPScalar alt) {
         return geoToS23D(s2Resolution, verticalResolution, lat, lng, alt);
     };
-    return getIndexedCellBookings(volume4D, indexer);
+    admit(options, volume4D, {{IndexSystem::S23D, s2Resolution, verticalResolution}});
+    return recordedBookings(options, IndexSystem::S23D, [&](BookingStats *stats) {
+        return indexedCellBookings(volume4D, indexer, options, stats);
+    });
 }
 
 
-std::vector<ab::CellBooking> ab::getIndexedCellBookings(std::vector<d4::StateVector4D> trajectory4D,
-                                                        const std::function<std::string(double, double,
-                                                                                        double)> &indexer,
-                                                        int temporalBackwardBuffer, int temporalForwardBuffer,
-                                                        FPScalar spatialLateralBuffer, FPScalar spatialVerticalBuffer) {
-    // The Eckert VI projection is good enough for the whole world
-    // The only distances being measured are between points on the same trajectory
-    // rather than the start to end of the trajectory
-    // UTM could be used for a more accurate projection, but the accuracy improvement is smaller
-    // than the applied buffer and is much less than the eventual loss of accuracy after discretisation
-    // to an indexing system
-    const auto pj = util::makeProjObject("EPSG:4326", "ESRI:54010");
-    PJ *reproj = std::get<0>(pj);
-    const auto revpj = util::makeProjObject("ESRI:54010", "EPSG:4326");
-    PJ *revReproj = std::get<0>(revpj);
-    spdlog::info("Made PROJ contexts");
-    GEOSContextHandle_t geosCtx = initGEOS_r(notice, log_and_exit);
-    spdlog::info("Made GEOS Context");
-
-    // Iterate through all points in the trajectory and rasterise between them
-    const auto lsSize = trajectory4D.size();
-
-    spdlog::info("Converting to GEOS objects...");
-    auto *trajCoordSeq = GEOSCoordSeq_create_r(geosCtx, lsSize, 3);
-    for (int i = 0; i < lsSize; ++i) {
-        const auto &sv = trajectory4D[i];
-        GEOSCoordSeq_setXYZ_r(geosCtx, trajCoordSeq, i, sv.position.x(), sv.position.y(), sv.position.z());
-    }
-    auto *trajLs = GEOSGeom_createLineString_r(geosCtx, trajCoordSeq);
-    spdlog::info("\tCreated World LineString");
-
-    auto *reprojTrajCoordSeq = util::reprojectCoordinates_r(reproj, trajCoordSeq, geosCtx);
-    std::vector<ab::Index> reprojTrajIntCoords(lsSize);
-    {
-        double x, y, z;
+namespace {
+    /**
+     * @brief Run fn with the projection selected by the booking options for a set of (lon, lat, alt) positions
+     * @param margin a distance in meters the input will be extended by, such as a lateral buffer
+     */
+    template<typename Fn>
+    auto withProjection(const ab::BookingOptions &options, const ab::GeoPolygon &positions, ab::FPScalar margin,
+                        ab::BookingStats *stats, Fn &&fn) {
+        std::optional<ab::util::StageTimer> setupTimer(std::in_place, stats, &ab::BookingStats::setupSeconds);
+        const auto localProjection = ab::util::LocalProjection::centredOn(positions);
+        if (options.projection == ab::ProjectionMode::LocalTangentPlane
+            || (options.projection == ab::ProjectionMode::Auto
+                && localProjection.radiusOf(positions) + margin <= options.localProjectionMaxRadius)) {
+            spdlog::info("Using local tangent plane projection");
+            setupTimer.reset();
+            return fn(localProjection);
+        }
+        // The Eckert VI projection is good enough for the whole world
+        // The only distances being measured are between points on the same trajectory
+        // rather than the start to end of the trajectory
+        // UTM could be used for a more accurate projection, but the accuracy improvement is smaller
+        // than the applied buffer and is much less than the eventual loss of accuracy after discretisation
+        // to an indexing system
+        const ab::util::ProjProjection eckertVI("ESRI:54010");
+        spdlog::info("Made PROJ contexts");
+        setupTimer.reset();
+        return fn(eckertVI);
+    }
+
+    /**
+     * @brief Merge the overlapping time slices booked for each cell
+     * @param rawBookings the bookings of every sample, which may repeat cells
+     * @param resource the resource to allocate temporaries from
+     * @return a booking for every disjoint time slice of every cell, in no particular order
+     */
+    std::vector<ab::CellBooking> mergeCellBookings(const RawBookings &rawBookings, std::pmr::memory_resource *resource) {
+        using namespace ab;
+        // Map each cell ID to a vector of time slices from rawBookings. The IDs are viewed in rawBookings
+        std::pmr::unordered_map<std::string_view, std::pmr::vector<d4::TimeSlice>> cellTimeSlices(resource);
+        for (const auto &booking: rawBookings) {
+            cellTimeSlices[booking.cellId].emplace_back(booking.timeSlice);
+        }
+        // For each cell ID in the map, combine all overlapping time slices by checking their intersections
+        std::vector<CellBooking> finalBookings;
+        finalBookings.reserve(cellTimeSlices.size());
+        for (auto &[cellId, timeSlices]: cellTimeSlices) {
+            if (timeSlices.size() == 1) {
+                finalBookings.emplace_back(timeSlices[0], std::string(cellId));
+                continue;
+            }
+            // Sort time slices by start time
+            std::sort(timeSlices.begin(), timeSlices.end(),
+                      [](const auto &a, const auto &b) {
+                          return a.start < b.start;
+                      });
+            // Merge time slices in place
+            std::size_t last = 0;
+            for (std::size_t i = 1; i < timeSlices.size(); ++i) {
+                auto &prev = timeSlices[last];
+                const auto &curr = timeSlices[i];
+                if (prev.end >= curr.start) {
+                    prev.end = std::max(prev.end, curr.end);
+                } else {
+                    timeSlices[++last] = curr;
+                }
+            }
+            // Add merged time slices to final bookings
+            for (std::size_t i = 0; i <= last; ++i) {
+                finalBookings.emplace_back(timeSlices[i], std::string(cellId));
+            }
+        }
+
+        return finalBookings;
+    }
+
+    template<typename Projection>
+    LevelBookings
+    trajectoryCellBookings(const Projection &projection, const std::vector<ab::d4::StateVector4D> &trajectory4D,
+                           const LevelIndexer &indexer, size_t nLevels, int temporalBackwardBuffer, int temporalForwardBuffer,
+                           ab::FPScalar spatialLateralBuffer, ab::FPScalar spatialVerticalBuffer,
+                           ab::BookingStats *stats, CallBudget &budget, std::pmr::memory_resource *resource,
+                           const std::optional<std::array<int, 2>> &gridOrigin = std::nullopt) {
+        using namespace ab;
+        std::optional<util::StageTimer> etaTimer(std::in_place, stats, &BookingStats::etaSeconds);
+        // Iterate through all points in the trajectory and rasterise between them
+        const auto lsSize = trajectory4D.size();
+        if (stats) stats->reprojections += lsSize;
+
+        std::vector<ab::Position> reprojTrajCoords(lsSize);
+        std::vector<ab::Index> reprojTrajIntCoords(lsSize);
         for (int i = 0; i < lsSize; ++i) {
-            GEOSCoordSeq_getXYZ_r(geosCtx, reprojTrajCoordSeq, i, &x, &y, &z);
+            const auto &sv = trajectory4D[i];
+            const auto projected = projection.forward(sv.position);
             spdlog::info(
-                    "Reprojected coordinate " + std::to_string(trajectory4D[i].position.x()) + ", " +
-                    std::to_string(trajectory4D[i].position.y()) + ", " + std::to_string(trajectory4D[i].position.z()) +
+                    "Reprojected coordinate " + std::to_string(sv.position.x()) + ", " +
+                    std::to_string(sv.position.y()) + ", " + std::to_string(sv.position.z()) +
                     " to " +
-                    std::to_string(x) + ", " + std::to_string(y) + ", " + std::to_string(z));
-            reprojTrajIntCoords[i] = ab::Index(static_cast<int>(x), static_cast<int>(y), static_cast<int>(z));
-        }
-    }
-    auto *reprojLs = GEOSGeom_createLineString_r(geosCtx, reprojTrajCoordSeq);
-    if (reprojLs == nullptr) {
-        spdlog::error("Reprojected LineString is null");
-    }
-    spdlog::info("\tCreated Projected LineString");
-    auto *reprojBufferPoly = GEOSBuffer_r(geosCtx, reprojLs, spatialLateralBuffer, 30);
-    if (reprojBufferPoly == nullptr) {
-        spdlog::error("Reprojected buffer is null");
-    }
-    auto reprojBufferGeoPoly = util::asGeoPolygon_r(reprojBufferPoly, geosCtx);
-    spdlog::info("\tBuffered Projected LineString");
-    auto *bufferPoly = util::swapCoordOrder_r(util::reprojectPolygon_r(revReproj, reprojBufferPoly, geosCtx), geosCtx);
-    auto bufferGeoPoly = util::asGeoPolygon_r(bufferPoly, geosCtx);
-    spdlog::info("\tConverted to World GeoPolygon");
-
-    GEOSGeom_destroy_r(geosCtx, bufferPoly);
-    spdlog::info("\tFreed World Buffer Polygon");
-    GEOSGeom_destroy_r(geosCtx, reprojBufferPoly);
-    spdlog::info("\tFreed Projected Buffer Polygon");
-    GEOSGeom_destroy_r(geosCtx, reprojLs);
-    spdlog::info("\tFreed Projected LineString");
-    GEOSGeom_destroy_r(geosCtx, trajLs);
-    spdlog::info("\tFreed World LineString");
-
-    spdlog::info("Assigning nearest trajectory points to buffer cells...");
-    for (auto &coord: bufferGeoPoly) {
-        std::vector<std::pair<int, FPScalar>> distances;
-        distances.reserve(trajectory4D.size());
-        for (int j = 0; j < trajectory4D.size(); ++j) {
-            distances.emplace_back(j, util::euclideanDistance<2>(coord, trajectory4D[j].position));
-        }
-        const auto minNode = std::min_element(distances.cbegin(), distances.cend(),
-                                              [](const auto &a, const auto &b) {
-                                                  return a.second < b.second;
-                                              });
-        coord[2] = trajectory4D[minNode->first].position[2];
-    }
-
-    auto indexCmp = [](const Index &i1, const Index &i2) {
-        for (int d = 0; d < i1.size(); ++d) {
-            if (i1(d) != i2(d))
-                return i1(d) < i2(d);
-        }
-        return false;
+                    std::to_string(projected.x()) + ", " + std::to_string(projected.y()) + ", " +
+                    std::to_string(projected.z()));
+            reprojTrajCoords[i] = projected;
+            reprojTrajIntCoords[i] = ab::Index(static_cast<int>(projected.x()), static_cast<int>(projected.y()),
+                                               static_cast<int>(projected.z()));
+        }
+        // The lateral buffer is every point within the buffer distance of the projected trajectory
+        const util::CapsuleRegion bufferRegion(reprojTrajCoords, spatialLateralBuffer);
+
+        auto indexCmp = [](const Index &i1, const Index &i2) {
+            for (int d = 0; d < i1.size(); ++d) {
+                if (i1(d) != i2(d))
+                    return i1(d) < i2(d);
+            }
+            return false;
+        };
+        std::pmr::vector<Index> trajPoints(resource);
+        std::pmr::map<Index, d4::TimeSlice, decltype(indexCmp)> trajPointMap(indexCmp, resource);
+        std::pmr::vector<Index> points(resource);
+
+        spdlog::info("Projecting cell ETAs forward...");
+        for (int i = 0; i < lsSize - 1; ++i) {
+            // Narrow down the possible voxels intersected by passing through bresenham algo
+            // This requires projection to local grid coords as bresenham is integer based
+            const auto &prevProjP = reprojTrajIntCoords[i] / GRID_SCALE_FACTOR;
+            const auto &projP = reprojTrajIntCoords[i + 1] / GRID_SCALE_FACTOR;
+            points.clear();
+            util::Bresenham3D::line3d(prevProjP, projP, points);
+
+            ab::d4::TimeInstant posETA;
+            ab::d4::TimeSlice desiredTimeSlice({}, {}); // Initialise with random values
+
+            for (const auto &c: points) {
+                // Get the Euclidean distance from the previous point to this point
+                // In floating point, as integer grid distances would overflow when squared beyond ~46 km
+                const auto dist = std::sqrt(
+                        ((prevProjP - c).template cast<FPScalar>() * GRID_SCALE_FACTOR).square().sum());
+                // Project the ETA to this cell based on a linear interpolation of the speed
+                posETA = trajectory4D[i].time + std::chrono::seconds(static_cast<int>(dist / trajectory4D[i].speed));
+
+                // Buffer around the ETA
+                desiredTimeSlice = d4::TimeSlice(posETA - std::chrono::seconds(temporalBackwardBuffer),
+                                                 posETA + std::chrono::seconds(temporalForwardBuffer));
+                trajPoints.emplace_back(c * GRID_SCALE_FACTOR);
+                trajPointMap.emplace(c * GRID_SCALE_FACTOR, desiredTimeSlice);
+            }
+        }
+
+        etaTimer.reset();
+        budget.check();
+
+        // We store the deconflicted bookings first before committing them to the grid
+        // This is in case the trajectory fails to deconflict at a later stage and we
+        // have already booked previous cells in the grid
+        std::pmr::vector<RawBookings> clearedTimeSlices(nLevels, resource);
+        std::vector<std::string> levelIds(nLevels);
+
+        std::optional<util::StageTimer> coverageTimer(std::in_place, stats, &BookingStats::coverageSeconds);
+        spdlog::info("\tGetting bounds of buffer...");
+        const auto bounds = bufferRegion.bounds();
+        // Cast down to ints as they will be iterated over
+        // The scale is so small that no precision is lost
+        int xMin = static_cast<int>(bounds[0]), xMax = static_cast<int>(bounds[2] + 1);
+        int yMin = static_cast<int>(bounds[1]), yMax = static_cast<int>(bounds[3] + 1);
+        if (gridOrigin) {
+            // Extend the grid to sample on the lattice through the origin
+            const auto alignDown = [](int value, int origin) {
+                return origin + static_cast<int>(std::floor(static_cast<double>(value - origin) / GRID_SCALE_FACTOR))
+                                * GRID_SCALE_FACTOR;
+            };
+            xMin = alignDown(xMin, (*gridOrigin)[0]);
+            yMin = alignDown(yMin, (*gridOrigin)[1]);
+        }
+
+        spdlog::info("Covering buffer bounds to book cells...");
+        const auto nTests = util::coverGrid(
+                bufferRegion, xMin, yMin, util::gridSize(xMin, xMax, GRID_SCALE_FACTOR),
+                util::gridSize(yMin, yMax, GRID_SCALE_FACTOR), GRID_SCALE_FACTOR, [&](int x, int y) {
+                    if (stats) ++stats->samplesInside;
+                    budget.sample();
+                    // The first of the nearest trajectory points
+                    std::size_t nearest = 0;
+                    FPScalar nearestDistance = std::numeric_limits<FPScalar>::infinity();
+                    for (std::size_t i = 0; i < trajPoints.size(); ++i) {
+                        const auto distance = util::euclideanDistance<2>({x, y, 0}, trajPoints[i]);
+                        if (distance < nearestDistance) {
+                            nearest = i;
+                            nearestDistance = distance;
+                        }
+                    }
+                    const auto trajPoint = trajPoints[nearest];
+                    const auto desiredTimeSlice = trajPointMap.at(trajPoint);
+                    const auto midZ = static_cast<FPScalar>(trajPoint.z());
+                    const int minZ = static_cast<int>(std::max(midZ - spatialVerticalBuffer,
+                                                               static_cast<FPScalar>(0)));
+                    const int maxZ = static_cast<int>(midZ + spatialVerticalBuffer);
+
+                    // Both projections pass altitude through, so the column is only unprojected once
+                    const auto geoCoord = projection.inverse(x, y, minZ);
+                    if (stats) ++stats->reprojections;
+                    for (int z = minZ; z < maxZ; z += GRID_SCALE_FACTOR) {
+                        const util::StageTimer indexerTimer(stats, &BookingStats::indexerSeconds);
+                        indexer(geoCoord.y(), geoCoord.x(), z, levelIds);
+                        for (size_t l = 0; l < nLevels; ++l) {
+                            clearedTimeSlices[l].push_back({desiredTimeSlice, std::pmr::string(levelIds[l], resource)});
+                        }
+                        if (stats) ++stats->indexerCalls;
+                    }
+                });
+        coverageTimer.reset();
+        if (stats) {
+            stats->samplesTested += nTests;
+            for (const auto &levelTimeSlices: clearedTimeSlices) {
+                stats->rawBookings += levelTimeSlices.size();
+            }
+        }
+        budget.check();
+
+        const util::StageTimer mergeTimer(stats, &BookingStats::mergeSeconds);
+        LevelBookings finalBookings;
+        for (const auto &levelTimeSlices: clearedTimeSlices) {
+            auto merged = mergeCellBookings(levelTimeSlices, resource);
+            // Sort final bookings by start time
+            std::sort(merged.begin(), merged.end(),
+                      [](const auto &a, const auto &b) {
+                          return a.timeSlice.start < b.timeSlice.start;
+                      });
+            finalBookings.emplace_back(std::move(merged));
+        }
+
+        return finalBookings;
+    }
+
+    template<typename Projection>
+    LevelBookings
+    volumeCellBookings(const Projection &projection, const ab::d4::Volume4D &volume4D, const LevelIndexer &indexer,
+                       size_t nLevels, ab::BookingStats *stats, CallBudget &budget,
+                       std::pmr::memory_resource *resource) {
+        using namespace ab;
+        std::optional<util::StageTimer> etaTimer(std::in_place, stats, &BookingStats::etaSeconds);
+        if (stats) stats->reprojections += volume4D.footprint.size();
+        std::vector<ab::Position> reprojFootprintPoints;
+        std::transform(volume4D.footprint.begin(), volume4D.footprint.end(),
+                       std::back_inserter(reprojFootprintPoints),
+                       [&projection](const auto &p) {
+                           return projection.forward(p);
+                       });
+        const auto reprojGeoPoly = ab::GeoPolygon(reprojFootprintPoints);
+        etaTimer.reset();
+        budget.check();
+
+
+        // We store the deconflicted bookings first before committing them to the grid
+        // This is in case the trajectory fails to deconflict at a later stage and we
+        // have already booked previous cells in the grid
+        std::pmr::vector<RawBookings> clearedTimeSlices(nLevels, resource);
+        std::vector<std::string> levelIds(nLevels);
+
+        std::optional<util::StageTimer> coverageTimer(std::in_place, stats, &BookingStats::coverageSeconds);
+        spdlog::info("\tGetting bounds of buffer...");
+        const auto bounds = util::getPolyBounds<3>(reprojGeoPoly);
+        // Cast down to ints as they will be iterated over
+        // The scale is so small that no precision is lost
+        int xMin = static_cast<int>(bounds[0]), xMax = static_cast<int>(bounds[3] + 1);
+        int yMin = static_cast<int>(bounds[1]), yMax = static_cast<int>(bounds[4] + 1);
+
+        spdlog::info("Covering bounds to book cells...");
+        const util::PolygonRegion footprintRegion(reprojGeoPoly);
+        const auto nTests = util::coverGrid(
+                footprintRegion, xMin, yMin, util::gridSize(xMin, xMax, GRID_SCALE_FACTOR),
+                util::gridSize(yMin, yMax, GRID_SCALE_FACTOR), GRID_SCALE_FACTOR, [&](int x, int y) {
+                    if (stats) ++stats->samplesInside;
+                    budget.sample();
+                    // Both projections pass altitude through, so the column is only unprojected once
+                    const auto geoCoord = projection.inverse(x, y, volume4D.floor);
+                    if (stats) ++stats->reprojections;
+                    for (int z = volume4D.floor; z < volume4D.ceiling; z += GRID_SCALE_FACTOR) {
+                        const util::StageTimer indexerTimer(stats, &BookingStats::indexerSeconds);
+                        indexer(geoCoord.y(), geoCoord.x(), z, levelIds);
+                        for (size_t l = 0; l < nLevels; ++l) {
+                            clearedTimeSlices[l].push_back({volume4D.timeSlice,
+                                                            std::pmr::string(levelIds[l], resource)});
+                        }
+                        if (stats) ++stats->indexerCalls;
+                    }
+                });
+        coverageTimer.reset();
+        if (stats) {
+            stats->samplesTested += nTests;
+            for (const auto &levelTimeSlices: clearedTimeSlices) {
+                stats->rawBookings += levelTimeSlices.size();
+            }
+        }
+        budget.check();
+
+        const util::StageTimer mergeTimer(stats, &BookingStats::mergeSeconds);
+        LevelBookings finalBookings;
+        for (const auto &levelTimeSlices: clearedTimeSlices) {
+            finalBookings.emplace_back(mergeCellBookings(levelTimeSlices, resource));
+        }
+
+        return finalBookings;
+    }
+
+    /**
+     * @brief The resource the temporaries of a call are allocated from, BookingOptions::memoryResource if set or else
+     * the arena of the thread
+     */
+    struct ScratchResource {
+        explicit ScratchResource(const ab::BookingOptions &options)
+                : resource(options.memoryResource ? options.memoryResource
+                                                  : arena.emplace(options.scratchRetainedBytes).resource()) {
+        }
+
+        std::optional<ab::util::ScratchArena> arena;
+        std::pmr::memory_resource *resource;
     };
-    std::vector<Index, Eigen::aligned_allocator<Index>> trajPoints;
-    std::map<Index, d4::TimeSlice, decltype(indexCmp)> trajPointMap(indexCmp);
-
-    spdlog::info("Projecting cell ETAs forward...");
-    for (int i = 0; i < lsSize - 1; ++i) {
-        // Narrow down the possible voxels intersected by passing through bresenham algo
-        // This requires projection to local grid coords as bresenham is integer based
-        const auto &prevProjP = reprojTrajIntCoords[i] / GRID_SCALE_FACTOR;
-        const auto &projP = reprojTrajIntCoords[i + 1] / GRID_SCALE_FACTOR;
-        auto points = util::Bresenham3D::line3d(prevProjP, projP);
-
-        ab::d4::TimeInstant posETA;
-        ab::d4::TimeSlice desiredTimeSlice({}, {}); // Initialise with random values
-
-        for (const auto &c: points) {
-            // Get the Euclidean distance from the previous point to this point
-            const auto dist = std::sqrt(((prevProjP - c) * GRID_SCALE_FACTOR).array().square().sum());
-            // Project the ETA to this cell based on a linear interpolation of the speed
-            posETA = trajectory4D[i].time + std::chrono::seconds(static_cast<int>(dist / trajectory4D[i].speed));
-
-            // Buffer around the ETA
-            desiredTimeSlice = d4::TimeSlice(posETA - std::chrono::seconds(temporalBackwardBuffer),
-                                             posETA + std::chrono::seconds(temporalForwardBuffer));
-            trajPoints.emplace_back(c * GRID_SCALE_FACTOR);
-            trajPointMap.emplace(c * GRID_SCALE_FACTOR, desiredTimeSlice);
-        }
-    }
-
-    // We store the deconflicted bookings first before committing them to the grid
-    // This is in case the trajectory fails to deconflict at a later stage and we
-    // have already booked previous cells in the grid
-    std::vector<CellBooking> clearedTimeSlices;
-
-    spdlog::info("\tGetting bounds of buffer...");
-    const auto bounds = util::getPolyBounds<3>(reprojBufferGeoPoly);
-    // Cast down to ints as they will be iterated over
-    // The scale is so small that no precision is lost
-    int xMin = static_cast<int>(bounds[0]), xMax = static_cast<int>(bounds[3] + 1);
-    int yMin = static_cast<int>(bounds[1]), yMax = static_cast<int>(bounds[4] + 1);
-
-    spdlog::info("Iterating buffer bounds to book cells...");
-//#pragma omp parallel for collapse(2) schedule(dynamic)
-    for (int x = xMin; x < xMax; x += GRID_SCALE_FACTOR) {
-        for (int y = yMin; y < yMax; y += GRID_SCALE_FACTOR) {
-            const Eigen::Vector2i xyC{x, y};
-            if (!util::isInsidePolygon(reprojBufferGeoPoly, xyC)) continue;
-
-            std::vector<std::pair<int, FPScalar>> distances;
-            distances.reserve(trajPoints.size());
-            for (int i = 0; i < trajPoints.size(); ++i) {
-                distances.emplace_back(i, util::euclideanDistance<2>({x, y, 0}, trajPoints[i]));
+
+    /**
+     * @brief Book a trajectory in a projection, simplifying it first if requested by the options
+     */
+    template<typename Projection>
+    LevelBookings
+    projectedCellBookings(const Projection &projection, const std::vector<ab::d4::StateVector4D> &trajectory4D,
+                          const LevelIndexer &indexer, size_t nLevels, int temporalBackwardBuffer,
+                          int temporalForwardBuffer, ab::FPScalar spatialLateralBuffer,
+                          ab::FPScalar spatialVerticalBuffer, const ab::BookingOptions &options,
+                          ab::BookingStats *stats, CallBudget &budget, std::pmr::memory_resource *resource) {
+        if (options.simplifyTolerance <= 0 || trajectory4D.size() <= 2) {
+            return trajectoryCellBookings(projection, trajectory4D, indexer, nLevels, temporalBackwardBuffer,
+                                          temporalForwardBuffer, spatialLateralBuffer, spatialVerticalBuffer,
+                                          stats, budget, resource);
+        }
+        // Drop state vectors within a fraction of the buffers, and grow the buffers by it to cover them
+        std::optional<ab::util::StageTimer> etaTimer(std::in_place, stats, &ab::BookingStats::etaSeconds);
+        const ab::util::SimplificationTolerance tolerance{
+                options.simplifyTolerance * spatialLateralBuffer, options.simplifyTolerance * spatialVerticalBuffer,
+                options.simplifyTolerance * std::min(temporalBackwardBuffer, temporalForwardBuffer)};
+        std::vector<ab::Position> projected;
+        projected.reserve(trajectory4D.size());
+        for (const auto &sv: trajectory4D) {
+            projected.emplace_back(projection.forward(sv.position));
+        }
+        const auto kept = ab::util::simplifiedTrajectoryIndices(trajectory4D, projected, tolerance);
+        const auto simplified = ab::util::simplifiedTrajectory(trajectory4D, projected, kept);
+        if (stats) {
+            stats->reprojections += trajectory4D.size();
+            stats->simplifiedPoints += trajectory4D.size() - simplified.size();
+        }
+        spdlog::info("Simplified trajectory from {} to {} state vectors", trajectory4D.size(), simplified.size());
+        etaTimer.reset();
+        // Sample the grid the original trajectory would be sampled on, so its samples are a subset
+        const auto originalBounds = ab::util::CapsuleRegion(projected, spatialLateralBuffer).bounds();
+        const std::array<int, 2> gridOrigin{static_cast<int>(originalBounds[0]),
+                                            static_cast<int>(originalBounds[1])};
+        const auto temporalMargin = static_cast<int>(std::ceil(tolerance.temporal));
+        // Vertical samples are spaced by the grid and taken from altitudes rounded to it, so the vertical buffer
+        // grows in whole grid steps to keep the samples of the original trajectory
+        const auto verticalMargin = GRID_SCALE_FACTOR * std::ceil(tolerance.vertical / GRID_SCALE_FACTOR);
+        return trajectoryCellBookings(projection, simplified, indexer, nLevels,
+                                      temporalBackwardBuffer + temporalMargin,
+                                      temporalForwardBuffer + temporalMargin,
+                                      spatialLateralBuffer + tolerance.lateral,
+                                      spatialVerticalBuffer + verticalMargin, stats, budget, resource,
+                                      gridOrigin);
+    }
+
+    /**
+     * @brief Book a trajectory too long for a single local projection as tiles that each have their own, in parallel.
+     *
+     * Cells booked by more than one tile near a seam have their time slices merged.
+     */
+    LevelBookings
+    tiledCellBookings(const std::vector<ab::d4::StateVector4D> &trajectory4D, const LevelIndexer &indexer,
+                      size_t nLevels, int temporalBackwardBuffer, int temporalForwardBuffer,
+                      ab::FPScalar spatialLateralBuffer, ab::FPScalar spatialVerticalBuffer,
+                      const ab::BookingOptions &options, ab::BookingStats *stats, CallBudget &budget) {
+        using namespace ab;
+        std::optional<util::StageTimer> setupTimer(std::in_place, stats, &BookingStats::setupSeconds);
+        // Tiles reach as far from their origin as the buffered trajectories projected locally without tiling
+        const auto tiles = util::trajectoryTiles(trajectory4D,
+                                                 options.localProjectionMaxRadius - spatialLateralBuffer);
+        spdlog::info("Split trajectory into {} tiles with local projections", tiles.size());
+        setupTimer.reset();
+
+        const auto nTiles = static_cast<long>(tiles.size());
+        std::vector<LevelBookings> tileBookings(tiles.size());
+        std::vector<BookingStats> tileStats(tiles.size());
+        std::vector<std::exception_ptr> errors(tiles.size());
+        // A resource given in the options is not shared between threads, so its tiles are booked in turn
+#pragma omp parallel for schedule(dynamic, 1) if(!options.memoryResource)
+        for (long t = 0; t < nTiles; ++t) {
+            try {
+                budget.check();
+                ScratchResource scratch(options);
+                const util::LocalProjection projection(tiles[t].origin.x(), tiles[t].origin.y());
+                tileBookings[t] = projectedCellBookings(projection, tiles[t].trajectory, indexer, nLevels,
+                                                        temporalBackwardBuffer, temporalForwardBuffer,
+                                                        spatialLateralBuffer, spatialVerticalBuffer, options,
+                                                        stats ? &tileStats[t] : nullptr, budget, scratch.resource);
+            } catch (...) {
+                errors[t] = std::current_exception();
             }
-            const auto minNode = std::min_element(distances.cbegin(), distances.cend(),
-                                                  [](const auto &a, const auto &b) {
-                                                      return a.second < b.second;
-                                                  });
-            const auto trajPoint = trajPoints[minNode->first];
-            const auto desiredTimeSlice = trajPointMap.at(trajPoint);
-            const auto midZ = static_cast<FPScalar>(trajPoint.z());
-            const int minZ = static_cast<int>(std::max(midZ - spatialVerticalBuffer, static_cast<FPScalar>(0)));
-            const int maxZ = static_cast<int>(midZ + spatialVerticalBuffer);
-
-            for (int z = minZ; z < maxZ; z += GRID_SCALE_FACTOR) {
-                const Index xyzC{x, y, z};
-                const auto projCoord = util::reprojectCoordinate_r(revReproj, xyzC.x(), xyzC.y(), xyzC.z());
-                clearedTimeSlices.emplace_back(desiredTimeSlice,
-                                               indexer(projCoord.xyz.y, projCoord.xyz.x, projCoord.xyz.z));
+        }
+        for (const auto &error: errors) {
+            if (error) std::rethrow_exception(error);
+        }
+        if (stats) {
+            for (const auto &s: tileStats) {
+                *stats += s;
             }
         }
+        budget.check();
+
+        const util::StageTimer mergeTimer(stats, &BookingStats::mergeSeconds);
+        ScratchResource scratch(options);
+        LevelBookings finalBookings;
+        for (size_t l = 0; l < nLevels; ++l) {
+            RawBookings levelTimeSlices(scratch.resource);
+            for (const auto &bookings: tileBookings) {
+                for (const auto &booking: bookings[l]) {
+                    levelTimeSlices.push_back({booking.timeSlice, std::pmr::string(booking.cellId, scratch.resource)});
+                }
+            }
+            auto merged = mergeCellBookings(levelTimeSlices, scratch.resource);
+            std::sort(merged.begin(), merged.end(),
+                      [](const auto &a, const auto &b) {
+                          return a.timeSlice.start < b.timeSlice.start;
+                      });
+            finalBookings.emplace_back(std::move(merged));
+        }
+        return finalBookings;
     }
 
-    // Map each cell ID to a vector of time slices from clearedTimeSlices
-    std::unordered_map<std::string, std::vector<d4::TimeSlice>> cellTimeSlices;
-    for (const auto &booking: clearedTimeSlices) {
-        cellTimeSlices[booking.cellId].emplace_back(booking.timeSlice);
+    LevelBookings
+    levelCellBookings(const std::vector<ab::d4::StateVector4D> &trajectory4D, const LevelIndexer &indexer,
+                      size_t nLevels, int temporalBackwardBuffer, int temporalForwardBuffer,
+                      ab::FPScalar spatialLateralBuffer, ab::FPScalar spatialVerticalBuffer,
+                      const ab::BookingOptions &options, ab::BookingStats *stats) {
+        ab::GeoPolygon positions;
+        positions.reserve(trajectory4D.size());
+        for (const auto &sv: trajectory4D) {
+            positions.emplace_back(sv.position);
+        }
+        CallBudget budget(options);
+        budget.check();
+        if (options.projection == ab::ProjectionMode::Auto && options.tileLongTrajectories
+            && trajectory4D.size() >= 2 && spatialLateralBuffer < options.localProjectionMaxRadius
+            && ab::util::LocalProjection::centredOn(positions).radiusOf(positions) + spatialLateralBuffer
+               > options.localProjectionMaxRadius) {
+            return tiledCellBookings(trajectory4D, indexer, nLevels, temporalBackwardBuffer, temporalForwardBuffer,
+                                     spatialLateralBuffer, spatialVerticalBuffer, options, stats, budget);
+        }
+        ScratchResource scratch(options);
+        return withProjection(options, positions, spatialLateralBuffer, stats, [&](const auto &projection) {
+            return projectedCellBookings(projection, trajectory4D, indexer, nLevels, temporalBackwardBuffer,
+                                         temporalForwardBuffer, spatialLateralBuffer, spatialVerticalBuffer, options,
+                                         stats, budget, scratch.resource);
+        });
     }
-    // For each cell ID in the map, combine all overlapping time slices by checking their intersections
-    std::vector<CellBooking> finalBookings;
-    for (const auto &cellTimeSlice: cellTimeSlices) {
-        const auto &cellId = cellTimeSlice.first;
-        const auto &timeSlices = cellTimeSlice.second;
-        if (timeSlices.size() == 1) {
-            finalBookings.emplace_back(timeSlices[0], cellId);
-            continue;
+
+    LevelBookings
+    levelCellBookings(const ab::d4::Volume4D &volume4D, const LevelIndexer &indexer, size_t nLevels,
+                      const ab::BookingOptions &options, ab::BookingStats *stats) {
+        CallBudget budget(options);
+        budget.check();
+        ScratchResource scratch(options);
+        return withProjection(options, volume4D.footprint, 0, stats, [&](const auto &projection) {
+            return volumeCellBookings(projection, volume4D, indexer, nLevels, stats, budget, scratch.resource);
+        });
+    }
+
+    LevelIndexer singleLevel(const Indexer &indexer) {
+        return [&indexer](double lat, double lng, double alt, std::vector<std::string> &ids) {
+            ids[0] = indexer(lat, lng, alt);
+        };
+    }
+
+    std::vector<ab::CellBooking>
+    indexedCellBookings(const std::vector<ab::d4::StateVector4D> &trajectory4D, const Indexer &indexer,
+                        int temporalBackwardBuffer, int temporalForwardBuffer, ab::FPScalar spatialLateralBuffer,
+                        ab::FPScalar spatialVerticalBuffer, const ab::BookingOptions &options, ab::BookingStats *stats) {
+        return levelCellBookings(trajectory4D, singleLevel(indexer), 1, temporalBackwardBuffer,
+                                 temporalForwardBuffer, spatialLateralBuffer, spatialVerticalBuffer, options,
+                                 stats).front();
+    }
+
+    std::vector<ab::CellBooking>
+    indexedCellBookings(const ab::d4::Volume4D &volume4D, const Indexer &indexer, const ab::BookingOptions &options,
+                        ab::BookingStats *stats) {
+        return levelCellBookings(volume4D, singleLevel(indexer), 1, options, stats).front();
+    }
+
+    /**
+     * @brief Get the two hex character vertical layer code of an altitude
+     */
+    std::string layerCode(int layer) {
+        std::stringstream stream;
+        stream << std::hex << layer;
+        std::string hexString = stream.str();
+        if (hexString.length() == 1) hexString = "0" + hexString;
+        return hexString.substr(0, 2);
+    }
+
+    std::string layerCode(int verticalResolution, ab::FPScalar altitude) {
+        return layerCode(static_cast<int>(altitude / verticalResolution));
+    }
+
+    /**
+     * @brief Replace the last two characters of a lateral cell ID with a vertical layer code
+     */
+    std::string withLayerCode(const std::string &lateralId, const std::string &layer) {
+        return lateralId.substr(0, lateralId.length() - 2) + layer;
+    }
+
+    /**
+     * @brief Get the H3 cell of a coordinate, reusing recent lookups of the same coordinate, or of a coordinate in the
+     * same cell along the scan row, on this thread
+     */
+    H3Index lateralH3Cell(int h3Resolution, ab::FPScalar latitude, ab::FPScalar longitude) {
+        thread_local ab::util::CellLookupCache<H3Index> cache;
+        return cache.get(h3Resolution, latitude, longitude, [&] {
+            const LatLng latLng{RADIANS(latitude), RADIANS(longitude)};
+            H3Index out = 0;
+            latLngToCell(&latLng, h3Resolution, &out);
+            return out;
+        }, [](H3Index cell) {
+            // H3 cell edges, including those split at icosahedron face edges, are great circle arcs
+            LatLng centre;
+            cellToLatLng(cell, &centre);
+            CellBoundary boundary;
+            cellToBoundary(cell, &boundary);
+            std::array<ab::util::UnitVector, std::extent_v<decltype(CellBoundary::verts)>> vertices;
+            for (int i = 0; i < boundary.numVerts; ++i) {
+                vertices[i] = ab::util::unitVector(DEGREES(boundary.verts[i].lat), DEGREES(boundary.verts[i].lng));
+            }
+            return ab::util::InscribedCap::of(ab::util::unitVector(DEGREES(centre.lat), DEGREES(centre.lng)),
+                                              vertices.data(), boundary.numVerts);
+        });
+    }
+
+    /**
+     * @brief Get the S2 cell of a coordinate, reusing recent lookups of the same coordinate, or of a coordinate in the
+     * same cell along the scan row, on this thread
+     */
+    S2CellId lateralS2Cell(int s2Level, ab::FPScalar latitude, ab::FPScalar longitude) {
+        thread_local ab::util::CellLookupCache<std::uint64_t> cache;
+        return S2CellId(cache.get(s2Level, latitude, longitude, [&] {
+            return S2CellId(S2LatLng::FromDegrees(latitude, longitude)).parent(s2Level).id();
+        }, [](std::uint64_t id) {
+            // S2 cell edges are great circle arcs
+            const S2Cell cell{S2CellId(id)};
+            const auto unit = [](const S2Point &p) {
+                const double norm = std::sqrt(p.x() * p.x() + p.y() * p.y() + p.z() * p.z());
+                return ab::util::UnitVector{p.x() / norm, p.y() / norm, p.z() / norm};
+            };
+            std::array<ab::util::UnitVector, 4> vertices;
+            for (int k = 0; k < 4; ++k) {
+                vertices[k] = unit(cell.GetVertex(k));
+            }
+            return ab::util::InscribedCap::of(unit(cell.GetCenter()), vertices.data(), vertices.size());
+        }));
+    }
+
+    std::string h3String(H3Index cell) {
+        char h3Str[20];
+        h3ToString(cell, h3Str, 20);
+        return {h3Str};
+    }
+
+    /**
+     * @brief Make an indexer for several resolutions at once.
+     *
+     * Each (lat, lng) is indexed once at the finest H3 resolution and once at the finest S2 level requested, and
+     * coarser cells are derived as parents of those. For S2 this is identical to indexing directly. H3 hierarchy is
+     * not exactly nested, so near cell edges a coarse H3 cell can differ from directly indexing the point.
+     */
+    LevelIndexer levelIndexer(const std::vector<ab::ResolutionSpec> &resolutions) {
+        using ab::IndexSystem;
+        if (resolutions.empty()) {
+            throw std::invalid_argument("At least one resolution is required");
+        }
+        int finestH3 = -1, finestS2 = -1;
+        for (const auto &spec: resolutions) {
+            const bool isH3 = spec.indexSystem == IndexSystem::H3 || spec.indexSystem == IndexSystem::H3D;
+            if (spec.resolution < 0 || spec.resolution > (isH3 ? 15 : S2CellId::kMaxLevel)) {
+                throw std::invalid_argument("Resolution " + std::to_string(spec.resolution) + " is out of range");
+            }
+            if (spec.verticalResolution <= 0) {
+                throw std::invalid_argument("Vertical resolution must be positive");
+            }
+            auto &finest = isH3 ? finestH3 : finestS2;
+            finest = std::max(finest, spec.resolution);
         }
-        // Sort time slices by start time
-        std::vector<d4::TimeSlice> sortedTimeSlices = timeSlices;
-        std::sort(sortedTimeSlices.begin(), sortedTimeSlices.end(),
-                  [](const auto &a, const auto &b) {
-                      return a.start < b.start;
-                  });
-        // Merge time slices
-        std::vector<d4::TimeSlice> mergedTimeSlices;
-        mergedTimeSlices.emplace_back(sortedTimeSlices[0]);
-        for (int i = 1; i < sortedTimeSlices.size(); ++i) {
-            const auto &prev = mergedTimeSlices.back();
-            const auto &curr = sortedTimeSlices[i];
-            if (prev.end >= curr.start) {
-                mergedTimeSlices.back().end = curr.end;
+        return [resolutions, finestH3, finestS2](double lat, double lng, double alt, std::vector<std::string> &ids) {
+            const H3Index h3Cell = finestH3 >= 0 ? lateralH3Cell(finestH3, lat, lng) : 0;
+            const S2CellId s2Cell = finestS2 >= 0 ? lateralS2Cell(finestS2, lat, lng) : S2CellId();
+            for (size_t i = 0; i < resolutions.size(); ++i) {
+                const auto &spec = resolutions[i];
+                switch (spec.indexSystem) {
+                    case IndexSystem::H3:
+                    case IndexSystem::H3D: {
+                        H3Index parent = h3Cell;
+                        if (spec.resolution < finestH3) cellToParent(h3Cell, spec.resolution, &parent);
+                        ids[i] = spec.indexSystem == IndexSystem::H3
+                                 ? h3String(parent)
+                                 : withLayerCode(h3String(parent), layerCode(spec.verticalResolution, alt));
+                        break;
+                    }
+                    case IndexSystem::S2:
+                    case IndexSystem::S23D: {
+                        const auto token = s2Cell.parent(spec.resolution).ToToken();
+                        ids[i] = spec.indexSystem == IndexSystem::S2
+                                 ? token
+                                 : withLayerCode(token, layerCode(spec.verticalResolution, alt));
+                        break;
+                    }
+                }
+            }
+        };
+    }
+
+    /**
+     * @brief Run a booking call, compacting the output if requested and recording its stats if requested
+     * @param compactAs the index system of the cells of each level, or nullopt if they can not be compacted
+     * @param book books the cells of each level, recording into the given stats if they are not null
+     */
+    LevelBookings
+    recordedLevelBookings(const ab::BookingOptions &options,
+                          const std::vector<std::optional<ab::IndexSystem>> &compactAs,
+                          const std::function<LevelBookings(ab::BookingStats *)> &book,
+                          const std::optional<CacheLookup> &cacheLookup = std::nullopt) {
+        using namespace ab;
+        BookingStats callStats;
+        BookingStats *stats = options.stats ? &callStats : nullptr;
+        LevelBookings levels;
+        {
+            const util::StageTimer totalTimer(stats, &BookingStats::totalSeconds);
+            std::optional<LevelBookings> cached;
+            if (cacheLookup) {
+                cached = options.cache->find(cacheLookup->key, cacheLookup->departure);
+            }
+            if (cached) {
+                levels = std::move(*cached);
             } else {
-                mergedTimeSlices.emplace_back(curr);
+                levels = book(stats);
+                if (options.temporalMergeGap > 0) {
+                    const util::StageTimer mergeTimer(stats, &BookingStats::mergeSeconds);
+                    for (auto &bookings: levels) {
+                        bookings = coalesceCellBookings(bookings, std::chrono::seconds(options.temporalMergeGap),
+                                                        std::chrono::seconds(options.maxMergedSliceLength));
+                    }
+                }
+                if (options.compact) {
+                    const util::StageTimer compactTimer(stats, &BookingStats::compactSeconds);
+                    for (size_t l = 0; l < levels.size(); ++l) {
+                        if (compactAs[l]) levels[l] = compactCellBookings(levels[l], *compactAs[l]);
+                    }
+                }
+                if (cacheLookup) {
+                    options.cache->insert(cacheLookup->key, cacheLookup->departure, levels);
+                }
+            }
+            // The limit is not part of the cache key, so cached results are checked against it too
+            if (options.maxOutputCells > 0) {
+                std::uint64_t cells = 0;
+                for (const auto &bookings: levels) {
+                    cells += bookings.size();
+                }
+                if (cells > options.maxOutputCells) {
+                    throw BookingLimitError("Booking returned " + std::to_string(cells)
+                                            + " cell bookings, more than the limit of "
+                                            + std::to_string(options.maxOutputCells));
+                }
             }
         }
-        // Add merged time slices to final bookings
-        for (const auto &timeSlice: mergedTimeSlices) {
-            finalBookings.emplace_back(timeSlice, cellId);
+        if (stats) {
+            callStats.calls = 1;
+            for (const auto &bookings: levels) {
+                callStats.mergedBookings += bookings.size();
+            }
+            *options.stats += callStats;
+            recordProcessBookingStats(callStats);
         }
+        return levels;
     }
 
-    // Sort final bookings by start time
-    std::sort(finalBookings.begin(), finalBookings.end(),
-              [](const auto &a, const auto &b) {
-                  return a.timeSlice.start < b.timeSlice.start;
-              });
+    std::vector<ab::CellBooking>
+    recordedBookings(const ab::BookingOptions &options, std::optional<ab::IndexSystem> compactAs,
+                     const std::function<std::vector<ab::CellBooking>(ab::BookingStats *)> &book,
+                     const std::optional<CacheLookup> &cacheLookup) {
+        return recordedLevelBookings(options, {compactAs}, [&](ab::BookingStats *stats) {
+            return LevelBookings{book(stats)};
+        }, cacheLookup).front();
+    }
 
+    std::optional<CacheLookup>
+    trajectoryCacheLookup(const ab::BookingOptions &options, const std::vector<ab::d4::StateVector4D> &trajectory4D,
+                          int temporalBackwardBuffer, int temporalForwardBuffer, ab::FPScalar spatialLateralBuffer,
+                          ab::FPScalar spatialVerticalBuffer, const std::string &indexKey) {
+        if (!options.cache || trajectory4D.empty()) return std::nullopt;
+        return CacheLookup{ab::BookingCache::trajectoryKey(trajectory4D, temporalBackwardBuffer, temporalForwardBuffer,
+                                                           spatialLateralBuffer, spatialVerticalBuffer, indexKey,
+                                                           options),
+                           trajectory4D.front().time};
+    }
 
-    return finalBookings;
+    std::vector<std::optional<ab::IndexSystem>> levelIndexSystems(const std::vector<ab::ResolutionSpec> &resolutions) {
+        std::vector<std::optional<ab::IndexSystem>> indexSystems;
+        for (const auto &spec: resolutions) {
+            indexSystems.emplace_back(spec.indexSystem);
+        }
+        return indexSystems;
+    }
+}
+
+std::vector<ab::CellBooking> ab::getIndexedCellBookings(std::vector<d4::StateVector4D> trajectory4D,
+                                                        const std::function<std::string(double, double,
+                                                                                        double)> &indexer,
+                                                        int temporalBackwardBuffer, int temporalForwardBuffer,
+                                                        FPScalar spatialLateralBuffer, FPScalar spatialVerticalBuffer,
+                                                        const BookingOptions &options) {
+    // The cells of a custom indexer are unknown, so only the samples are estimated
+    admit(options, trajectory4D, {}, spatialLateralBuffer, spatialVerticalBuffer);
+    // Tiles of long trajectories are booked in parallel, and the indexer is not required to be thread safe
+    std::mutex indexerMutex;
+    const Indexer serialIndexer = [&](double lat, double lng, double alt) {
+        const std::lock_guard<std::mutex> lock(indexerMutex);
+        return indexer(lat, lng, alt);
+    };
+    return recordedBookings(options, std::nullopt, [&](BookingStats *stats) {
+        return indexedCellBookings(trajectory4D, serialIndexer, temporalBackwardBuffer, temporalForwardBuffer,
+                                   spatialLateralBuffer, spatialVerticalBuffer, options, stats);
+    });
 }
 
 
 std::vector<ab::CellBooking>
 ab::getIndexedCellBookings(ab::d4::Volume4D volume4D,
-                           const std::function<std::string(double, double, double)> &indexer) {
-    // The Eckert VI projection is good enough for the whole world
-    // The only distances being measured are between points on the same trajectory
-    // rather than the start to end of the trajectory
-    // UTM could be used for a more accurate projection, but the accuracy improvement is smaller
-    // than the applied buffer and is much less than the eventual loss of accuracy after discretisation
-    // to an indexing system
-    const auto pj = util::makeProjObject("EPSG:4326", "ESRI:54010");
-    PJ *reproj = std::get<0>(pj);
-    const auto revpj = util::makeProjObject("ESRI:54010", "EPSG:4326");
-    PJ *revReproj = std::get<0>(revpj);
-    spdlog::info("Made PROJ contexts");
-    GEOSContextHandle_t geosCtx = initGEOS_r(notice, log_and_exit);
-    spdlog::info("Made GEOS Context");
-
-    std::vector<ab::Position> reprojFootprintPoints;
-    std::transform(volume4D.footprint.begin(), volume4D.footprint.end(),
-                   std::back_inserter(reprojFootprintPoints),
-                   [reproj](const auto &p) {
-                       const auto rc = util::reprojectCoordinate_r(reproj, p.y(), p.x(), p.z());
-                       return ab::Position{rc.xyz.x, rc.xyz.y, rc.xyz.z};
-                   });
-    const auto reprojGeoPoly = ab::GeoPolygon(reprojFootprintPoints);
-
-
-    // We store the deconflicted bookings first before committing them to the grid
-    // This is in case the trajectory fails to deconflict at a later stage and we
-    // have already booked previous cells in the grid
-    std::vector<CellBooking> clearedTimeSlices;
-
-    spdlog::info("\tGetting bounds of buffer...");
-    const auto bounds = util::getPolyBounds<3>(reprojGeoPoly);
-    // Cast down to ints as they will be iterated over
-    // The scale is so small that no precision is lost
-    int xMin = static_cast<int>(bounds[0]), xMax = static_cast<int>(bounds[3] + 1);
-    int yMin = static_cast<int>(bounds[1]), yMax = static_cast<int>(bounds[4] + 1);
-
-    spdlog::info("Iterating bounds to book cells...");
-//#pragma omp parallel for collapse(2) schedule(dynamic)
-    for (int x = xMin; x < xMax; x += GRID_SCALE_FACTOR) {
-        for (int y = yMin; y < yMax; y += GRID_SCALE_FACTOR) {
-            const Eigen::Vector2i xyC{x, y};
-            if (!util::isInsidePolygon(reprojGeoPoly, xyC)) continue;
-            for (int z = volume4D.floor; z < volume4D.ceiling; z += GRID_SCALE_FACTOR) {
-                const Index xyzC{x, y, z};
-                const auto projCoord = util::reprojectCoordinate_r(revReproj, xyzC.x(), xyzC.y(), xyzC.z());
-                clearedTimeSlices.emplace_back(volume4D.timeSlice,
-                                               indexer(projCoord.xyz.x, projCoord.xyz.y, projCoord.xyz.z));
+                           const std::function<std::string(double, double, double)> &indexer,
+                           const BookingOptions &options) {
+    admit(options, volume4D, {});
+    return recordedBookings(options, std::nullopt, [&](BookingStats *stats) {
+        return indexedCellBookings(volume4D, indexer, options, stats);
+    });
+}
+
+std::vector<std::vector<ab::CellBooking>>
+ab::getMultiResolutionCellBookings(const std::vector<d4::StateVector4D> &trajectory4D,
+                                   const std::vector<ResolutionSpec> &resolutions, int temporalBackwardBuffer,
+                                   int temporalForwardBuffer, FPScalar spatialLateralBuffer,
+                                   FPScalar spatialVerticalBuffer, const BookingOptions &options) {
+    const auto indexer = levelIndexer(resolutions);
+    std::string indexKey;
+    for (const auto &spec: resolutions) {
+        indexKey += std::to_string(static_cast<int>(spec.indexSystem)) + ":" + std::to_string(spec.resolution) + ":"
+                    + std::to_string(spec.verticalResolution) + ";";
+    }
+    admit(options, trajectory4D, resolutions, spatialLateralBuffer, spatialVerticalBuffer);
+    return recordedLevelBookings(options, levelIndexSystems(resolutions), [&](BookingStats *stats) {
+        return levelCellBookings(trajectory4D, indexer, resolutions.size(), temporalBackwardBuffer,
+                                 temporalForwardBuffer, spatialLateralBuffer, spatialVerticalBuffer, options, stats);
+    }, trajectoryCacheLookup(options, trajectory4D, temporalBackwardBuffer, temporalForwardBuffer,
+                             spatialLateralBuffer, spatialVerticalBuffer, "multi:" + indexKey));
+}
+
+std::vector<std::vector<ab::CellBooking>>
+ab::getMultiResolutionVolumeBookings(const d4::Volume4D &volume4D, const std::vector<ResolutionSpec> &resolutions,
+                                     const BookingOptions &options) {
+    const auto indexer = levelIndexer(resolutions);
+    admit(options, volume4D, resolutions);
+    return recordedLevelBookings(options, levelIndexSystems(resolutions), [&](BookingStats *stats) {
+        return levelCellBookings(volume4D, indexer, resolutions.size(), options, stats);
+    });
+}
+
+std::vector<ab::CellBooking>
+ab::compactCellBookings(const std::vector<CellBooking> &bookings, IndexSystem indexSystem) {
+    if (indexSystem == IndexSystem::S23D) {
+        // The layer code overwrites the lowest levels of the S2 token, so the lateral cell cannot be recovered
+        return bookings;
+    }
+    // Bookings can only be compacted with others that share an identical time slice, and for H3D the same layer
+    std::map<std::tuple<d4::TimeInstant, d4::TimeInstant, std::string>, std::vector<std::string>> groups;
+    for (const auto &booking: bookings) {
+        const auto layerCode =
+                indexSystem == IndexSystem::H3D ? booking.cellId.substr(booking.cellId.length() - 2) : "";
+        groups[{booking.timeSlice.start, booking.timeSlice.end, layerCode}].emplace_back(booking.cellId);
+    }
+
+    std::vector<CellBooking> compactedBookings;
+    for (auto &group: groups) {
+        const d4::TimeSlice timeSlice(std::get<0>(group.first), std::get<1>(group.first));
+        const auto &layerCode = std::get<2>(group.first);
+        auto &cellIds = group.second;
+        std::sort(cellIds.begin(), cellIds.end());
+        cellIds.erase(std::unique(cellIds.begin(), cellIds.end()), cellIds.end());
+
+        if (indexSystem == IndexSystem::S2) {
+            std::vector<S2CellId> s2Cells;
+            s2Cells.reserve(cellIds.size());
+            for (const auto &cellId: cellIds) {
+                s2Cells.emplace_back(S2CellId::FromToken(cellId));
+            }
+            // Construction normalises the union, replacing every 4 siblings with their parent
+            const S2CellUnion cellUnion(std::move(s2Cells));
+            for (const auto &s2Cell: cellUnion.cell_ids()) {
+                compactedBookings.emplace_back(timeSlice, s2Cell.ToToken());
             }
+            continue;
+        }
+
+        // H3 and H3D
+        // H3D replaces the last 2 hex digits of the H3 index with the layer code. These are always set for
+        // resolutions up to 12 so the lateral index can be restored from the remainder
+        std::vector<H3Index> h3Cells;
+        h3Cells.reserve(cellIds.size());
+        for (const auto &cellId: cellIds) {
+            H3Index h3Cell;
+            const auto lateralCellId =
+                    indexSystem == IndexSystem::H3D ? cellId.substr(0, cellId.length() - 2) + "ff" : cellId;
+            stringToH3(lateralCellId.c_str(), &h3Cell);
+            h3Cells.emplace_back(h3Cell);
+        }
+        std::vector<H3Index> compactedCells(h3Cells.size(), 0);
+        if ((indexSystem == IndexSystem::H3D && getResolution(h3Cells.front()) > 12)
+            || compactCells(h3Cells.data(), compactedCells.data(), static_cast<int64_t>(h3Cells.size())) != 0) {
+            spdlog::warn("Could not compact {} cells, returning them uncompacted", cellIds.size());
+            for (const auto &cellId: cellIds) {
+                compactedBookings.emplace_back(timeSlice, cellId);
+            }
+            continue;
+        }
+        char h3Str[20];
+        for (const auto &h3Cell: compactedCells) {
+            // Unused output slots are left as H3_NULL
+            if (h3Cell == 0) continue;
+            h3ToString(h3Cell, h3Str, 20);
+            auto cellId = std::string(h3Str);
+            if (indexSystem == IndexSystem::H3D) {
+                cellId = cellId.substr(0, cellId.length() - 2) + layerCode;
+            }
+            compactedBookings.emplace_back(timeSlice, cellId);
         }
     }
 
-    // Map each cell ID to a vector of time slices from clearedTimeSlices
-    std::unordered_map<std::string, std::vector<d4::TimeSlice>> cellTimeSlices;
-    for (const auto &booking: clearedTimeSlices) {
+    // Groups are visited in time slice order, so this is already sorted by start time
+    return compactedBookings;
+}
+
+std::vector<ab::CellBooking>
+ab::coalesceCellBookings(const std::vector<CellBooking> &bookings, d4::TimeInstant::duration gap,
+                         d4::TimeInstant::duration maxSliceLength) {
+    if (gap < d4::TimeInstant::duration::zero() || maxSliceLength < d4::TimeInstant::duration::zero()) {
+        throw std::invalid_argument("The merge gap and maximum slice length must not be negative");
+    }
+    std::unordered_map<std::string_view, std::vector<d4::TimeSlice>> cellTimeSlices;
+    for (const auto &booking: bookings) {
         cellTimeSlices[booking.cellId].emplace_back(booking.timeSlice);
     }
-    // For each cell ID in the map, combine all overlapping time slices by checking their intersections
-    std::vector<CellBooking> finalBookings;
-    for (const auto &cellTimeSlice: cellTimeSlices) {
-        const auto &cellId = cellTimeSlice.first;
-        const auto &timeSlices = cellTimeSlice.second;
-        if (timeSlices.size() == 1) {
-            finalBookings.emplace_back(timeSlices[0], cellId);
-            continue;
-        }
-        // Sort time slices by start time
-        std::vector<d4::TimeSlice> sortedTimeSlices = timeSlices;
-        std::sort(sortedTimeSlices.begin(), sortedTimeSlices.end(),
-                  [](const auto &a, const auto &b) {
-                      return a.start < b.start;
-                  });
-        // Merge time slices
-        std::vector<d4::TimeSlice> mergedTimeSlices;
-        mergedTimeSlices.emplace_back(sortedTimeSlices[0]);
-        for (int i = 1; i < sortedTimeSlices.size(); ++i) {
-            const auto &prev = mergedTimeSlices.back();
-            const auto &curr = sortedTimeSlices[i];
-            if (prev.end >= curr.start) {
-                mergedTimeSlices.back().end = curr.end;
+    std::vector<CellBooking> coalesced;
+    coalesced.reserve(cellTimeSlices.size());
+    for (auto &[cellId, timeSlices]: cellTimeSlices) {
+        std::sort(timeSlices.begin(), timeSlices.end(), [](const auto &a, const auto &b) {
+            return a.start < b.start;
+        });
+        auto current = timeSlices.front();
+        for (std::size_t i = 1; i < timeSlices.size(); ++i) {
+            const auto &next = timeSlices[i];
+            const auto end = std::max(current.end, next.end);
+            if (next.start <= current.end
+                || (next.start - current.end <= gap
+                    && (maxSliceLength == d4::TimeInstant::duration::zero() || end - current.start <= maxSliceLength))) {
+                current.end = end;
             } else {
-                mergedTimeSlices.emplace_back(curr);
+                coalesced.emplace_back(current, std::string(cellId));
+                current = next;
             }
         }
-        // Add merged time slices to final bookings
-        for (const auto &timeSlice: mergedTimeSlices) {
-            finalBookings.emplace_back(timeSlice, cellId);
+        coalesced.emplace_back(current, std::string(cellId));
+    }
+    std::sort(coalesced.begin(), coalesced.end(), [](const auto &a, const auto &b) {
+        return std::tie(a.timeSlice.start, a.cellId) < std::tie(b.timeSlice.start, b.cellId);
+    });
+    return coalesced;
+}
+
+namespace {
+    /**
+     * @brief Split a 3D cell ID into its lateral prefix and vertical layer
+     */
+    std::pair<std::string_view, int> splitLayer(const std::string &cellId) {
+        const auto isHex = [](char c) {
+            return std::isxdigit(static_cast<unsigned char>(c)) != 0;
+        };
+        if (cellId.length() < 3 || !isHex(cellId[cellId.length() - 2]) || !isHex(cellId[cellId.length() - 1])) {
+            throw std::invalid_argument("Cell ID " + cellId + " has no vertical layer code");
         }
+        return {std::string_view(cellId).substr(0, cellId.length() - 2),
+                std::stoi(cellId.substr(cellId.length() - 2), nullptr, 16)};
+    }
+}
+
+std::vector<ab::LayerSpanBooking>
+ab::mergeVerticalLayers(const std::vector<CellBooking> &bookings) {
+    // Group the layers of each lateral cell by time slice
+    std::map<std::tuple<std::string_view, d4::TimeInstant, d4::TimeInstant>, std::vector<int>> columns;
+    for (const auto &booking: bookings) {
+        const auto [lateral, layer] = splitLayer(booking.cellId);
+        columns[{lateral, booking.timeSlice.start, booking.timeSlice.end}].push_back(layer);
     }
+    std::vector<LayerSpanBooking> spans;
+    for (auto &[column, layers]: columns) {
+        const auto &[lateral, start, end] = column;
+        std::sort(layers.begin(), layers.end());
+        layers.erase(std::unique(layers.begin(), layers.end()), layers.end());
+        for (std::size_t first = 0, i = 1; i <= layers.size(); ++i) {
+            if (i < layers.size() && layers[i] == layers[i - 1] + 1) continue;
+            spans.emplace_back(d4::TimeSlice(start, end), std::string(lateral) + layerCode(layers[first]),
+                               static_cast<int>(i - first));
+            first = i;
+        }
+    }
+    std::stable_sort(spans.begin(), spans.end(), [](const auto &a, const auto &b) {
+        return a.timeSlice.start < b.timeSlice.start;
+    });
+    return spans;
+}
 
-    return finalBookings;
+std::vector<ab::CellBooking>
+ab::expandVerticalLayers(const std::vector<LayerSpanBooking> &bookings) {
+    std::vector<CellBooking> expanded;
+    for (const auto &span: bookings) {
+        const auto [lateral, lowest] = splitLayer(span.cellId);
+        for (int layer = lowest; layer < lowest + span.layers; ++layer) {
+            expanded.emplace_back(span.timeSlice, std::string(lateral) + layerCode(layer));
+        }
+    }
+    return expanded;
+}
+
+std::string
+ab::parentCell(const std::string &cellId, IndexSystem indexSystem, int resolution) {
+    if (indexSystem == IndexSystem::S23D) {
+        throw std::invalid_argument("S23D cells have no parent cells");
+    }
+    if (indexSystem == IndexSystem::S2) {
+        const auto s2Cell = S2CellId::FromToken(cellId);
+        if (!s2Cell.is_valid()) {
+            throw std::invalid_argument("Cell ID " + cellId + " is not an S2 token");
+        }
+        if (resolution < 0 || resolution > s2Cell.level()) {
+            throw std::invalid_argument("Level " + std::to_string(resolution) + " is not a parent level of "
+                                        + cellId);
+        }
+        return s2Cell.parent(resolution).ToToken();
+    }
+
+    // See compactCellBookings for restoring the lateral index of H3D cells
+    const auto isH3D = indexSystem == IndexSystem::H3D;
+    if (isH3D && cellId.length() < 3) {
+        throw std::invalid_argument("Cell ID " + cellId + " has no vertical layer code");
+    }
+    const auto lateralCellId = isH3D ? cellId.substr(0, cellId.length() - 2) + "ff" : cellId;
+    H3Index h3Cell = 0;
+    if (stringToH3(lateralCellId.c_str(), &h3Cell) != 0 || !isValidCell(h3Cell)) {
+        throw std::invalid_argument("Cell ID " + cellId + " is not an " + (isH3D ? "H3D" : "H3") + " cell");
+    }
+    if (isH3D && getResolution(h3Cell) > 12) {
+        throw std::invalid_argument("H3D cells finer than resolution 12 have no parent cells");
+    }
+    H3Index parent = 0;
+    if (resolution < 0 || cellToParent(h3Cell, resolution, &parent) != 0) {
+        throw std::invalid_argument("Resolution " + std::to_string(resolution) + " is not a parent resolution of "
+                                    + cellId);
+    }
+    return isH3D ? withLayerCode(h3String(parent), cellId.substr(cellId.length() - 2)) : h3String(parent);
+}
+
+namespace {
+    /**
+     * @brief The average area in square meters and edge length in meters of the cells of a resolution
+     */
+    std::pair<double, double> averageCellSize(const ab::ResolutionSpec &spec) {
+        if (spec.indexSystem == ab::IndexSystem::H3 || spec.indexSystem == ab::IndexSystem::H3D) {
+            double area = 0, edge = 0;
+            if (getHexagonAreaAvgM2(spec.resolution, &area) != 0
+                || getHexagonEdgeLengthAvgM(spec.resolution, &edge) != 0) {
+                throw std::invalid_argument("Resolution " + std::to_string(spec.resolution) + " is out of range");
+            }
+            return {area, edge};
+        }
+        if (spec.resolution < 0 || spec.resolution > S2CellId::kMaxLevel) {
+            throw std::invalid_argument("Resolution " + std::to_string(spec.resolution) + " is out of range");
+        }
+        // The six faces of the cube are split in four at each level
+        const double area = 4 * M_PI * ab::util::EARTH_RADIUS * ab::util::EARTH_RADIUS
+                            / (6 * std::pow(4.0, spec.resolution));
+        return {area, std::sqrt(area)};
+    }
+
+    /**
+     * @brief Estimate the cost of sampling a region
+     * @param area the lateral area of the region in square meters
+     * @param perimeter the perimeter of the region in meters
+     * @param verticalSteps the average number of vertical steps sampled at each sample
+     */
+    ab::BookingCostEstimate
+    regionCost(double area, double perimeter, double verticalSteps,
+               const std::vector<ab::ResolutionSpec> &resolutions) {
+        ab::BookingCostEstimate cost;
+        cost.samples = static_cast<std::uint64_t>(std::ceil(area / (GRID_SCALE_FACTOR * GRID_SCALE_FACTOR)));
+        cost.indexerCalls = static_cast<std::uint64_t>(std::ceil(cost.samples * verticalSteps));
+        for (const auto &spec: resolutions) {
+            if (spec.verticalResolution <= 0) {
+                throw std::invalid_argument("Vertical resolution must be positive");
+            }
+            const auto [cellArea, cellEdge] = averageCellSize(spec);
+            // The cells within an edge length of the region, but no more than one for each sample
+            const auto lateralCells = std::min(
+                    static_cast<double>(cost.samples),
+                    std::ceil((area + perimeter * cellEdge + M_PI * cellEdge * cellEdge) / cellArea));
+            const bool is3D = spec.indexSystem == ab::IndexSystem::H3D || spec.indexSystem == ab::IndexSystem::S23D;
+            const auto layers = is3D ? std::min(std::ceil(verticalSteps),
+                                                std::ceil(verticalSteps * GRID_SCALE_FACTOR / spec.verticalResolution)
+                                                + 1)
+                                     : 1.0;
+            cost.cells += static_cast<std::uint64_t>(lateralCells * layers);
+        }
+        const auto nLevels = std::max<std::size_t>(resolutions.size(), 1);
+        cost.bytes = cost.indexerCalls * nLevels * sizeof(RawBooking) + cost.cells * sizeof(ab::CellBooking);
+        return cost;
+    }
+
+    void throwIfOverLimits(const ab::BookingOptions &options, const ab::BookingCostEstimate &cost) {
+        if (options.maxSamples > 0 && cost.samples > options.maxSamples) {
+            throw ab::BookingLimitError("Booking is estimated to take " + std::to_string(cost.samples)
+                                        + " samples, more than the limit of " + std::to_string(options.maxSamples));
+        }
+        if (options.maxOutputCells > 0 && cost.cells > options.maxOutputCells) {
+            throw ab::BookingLimitError("Booking is estimated to return " + std::to_string(cost.cells)
+                                        + " cell bookings, more than the limit of "
+                                        + std::to_string(options.maxOutputCells));
+        }
+    }
+
+    /**
+     * @brief Reject a trajectory booking estimated to be over the limits of the options with a BookingLimitError
+     */
+    void admit(const ab::BookingOptions &options, const std::vector<ab::d4::StateVector4D> &trajectory4D,
+               const std::vector<ab::ResolutionSpec> &resolutions, ab::FPScalar spatialLateralBuffer,
+               ab::FPScalar spatialVerticalBuffer) {
+        if (options.maxSamples == 0 && options.maxOutputCells == 0) return;
+        throwIfOverLimits(options, ab::estimateBookingCost(trajectory4D, resolutions, spatialLateralBuffer,
+                                                           spatialVerticalBuffer));
+    }
+
+    /**
+     * @brief Reject a volume booking estimated to be over the limits of the options with a BookingLimitError
+     */
+    void admit(const ab::BookingOptions &options, const ab::d4::Volume4D &volume4D,
+               const std::vector<ab::ResolutionSpec> &resolutions) {
+        if (options.maxSamples == 0 && options.maxOutputCells == 0) return;
+        throwIfOverLimits(options, ab::estimateBookingCost(volume4D, resolutions));
+    }
+}
+
+ab::BookingCostEstimate
+ab::estimateBookingCost(const std::vector<d4::StateVector4D> &trajectory4D,
+                        const std::vector<ResolutionSpec> &resolutions, FPScalar spatialLateralBuffer,
+                        FPScalar spatialVerticalBuffer) {
+    if (trajectory4D.empty()) return {};
+    // The buffered trajectory is a capsule around each segment, with overlaps at turns counted twice
+    const auto verticalSteps = [&](FPScalar altitude) {
+        // Sampled like the pipeline, about the altitude rounded down to the sampling grid
+        const auto midZ = static_cast<FPScalar>(static_cast<int>(altitude) / GRID_SCALE_FACTOR * GRID_SCALE_FACTOR);
+        const auto minZ = std::max(midZ - spatialVerticalBuffer, static_cast<FPScalar>(0));
+        return std::max(std::ceil((midZ + spatialVerticalBuffer - minZ) / GRID_SCALE_FACTOR), 0.0);
+    };
+    const double endArea = M_PI * spatialLateralBuffer * spatialLateralBuffer;
+    double area = endArea, perimeter = 2 * M_PI * spatialLateralBuffer;
+    double steps = endArea * verticalSteps(trajectory4D.front().position.z());
+    for (std::size_t i = 1; i < trajectory4D.size(); ++i) {
+        const auto &from = trajectory4D[i - 1].position, &to = trajectory4D[i].position;
+        const auto length = util::haversineDistance(from, to);
+        const auto segmentArea = 2 * spatialLateralBuffer * length;
+        area += segmentArea;
+        perimeter += 2 * length;
+        steps += segmentArea * verticalSteps((from.z() + to.z()) / 2);
+    }
+    return regionCost(area, perimeter, area > 0 ? steps / area : 0, resolutions);
+}
+
+ab::BookingCostEstimate
+ab::estimateBookingCost(const d4::Volume4D &volume4D, const std::vector<ResolutionSpec> &resolutions) {
+    const auto &footprint = volume4D.footprint;
+    if (footprint.size() < 3) return {};
+    const auto projection = util::LocalProjection::centredOn(footprint);
+    double twiceArea = 0, perimeter = 0;
+    for (std::size_t i = 0; i < footprint.size(); ++i) {
+        const auto &next = footprint[(i + 1) % footprint.size()];
+        const auto p0 = projection.forward(footprint[i]), p1 = projection.forward(next);
+        twiceArea += p0.x() * p1.y() - p1.x() * p0.y();
+        perimeter += util::haversineDistance(footprint[i], next);
+    }
+    const auto verticalSteps = std::max(
+            std::ceil(static_cast<double>(volume4D.ceiling - volume4D.floor) / GRID_SCALE_FACTOR), 0.0);
+    return regionCost(std::abs(twiceArea) / 2, perimeter, verticalSteps, resolutions);
+}
+
+std::vector<ab::d4::StateVector4D>
+ab::simplifyTrajectory(const std::vector<d4::StateVector4D> &trajectory4D, FPScalar lateralTolerance,
+                       FPScalar verticalTolerance, FPScalar temporalTolerance) {
+    GeoPolygon positions;
+    positions.reserve(trajectory4D.size());
+    for (const auto &sv: trajectory4D) {
+        positions.emplace_back(sv.position);
+    }
+    const auto projection = util::LocalProjection::centredOn(positions);
+    for (auto &position: positions) {
+        position = projection.forward(position);
+    }
+    const auto kept = util::simplifiedTrajectoryIndices(
+            trajectory4D, positions, {lateralTolerance, verticalTolerance, temporalTolerance});
+    return util::simplifiedTrajectory(trajectory4D, positions, kept);
 }
 
 std::string ab::geoToH3(int h3Resolution, FPScalar latitude, FPScalar longitude) {
-    const LatLng latLng{RADIANS(latitude), RADIANS(longitude)};
-    H3Index out;
-    latLngToCell(&latLng, h3Resolution, &out);
-    char h3Str[20];
-    h3ToString(out, h3Str, 20);
-    return {h3Str};
+    return h3String(lateralH3Cell(h3Resolution, latitude, longitude));
 }
 
 std::string
 ab::geoToH3D(int h3Resolution, int verticalResolution, FPScalar latitude, FPScalar longitude, FPScalar altitude) {
     // Lateral
-    const LatLng latLng{RADIANS(latitude), RADIANS(longitude)};
-    H3Index out = 0;
-    latLngToCell(&latLng, h3Resolution, &out);
-    char h3Str[20];
-    h3ToString(out, h3Str, 20);
-    auto h3String = std::string(h3Str);
+    const auto lateral = h3String(lateralH3Cell(h3Resolution, latitude, longitude));
 
     //Vertical
-    const auto layer = altitude / verticalResolution;
-    std::stringstream stream;
-    stream << std::hex << static_cast<int>(layer);
-    std::string hexString = stream.str();
-    if (hexString.length() == 1) hexString = "0" + hexString;
-
-    return h3String.substr(0, h3String.length() - 2) + hexString.substr(0, 2);
+    return withLayerCode(lateral, layerCode(verticalResolution, altitude));
 }
 
 std::string ab::geoToS2(int s2Resolution, FPScalar latitude, FPScalar longitude) {
-    const S2LatLng latLng = S2LatLng::FromDegrees(latitude, longitude);
-    const S2CellId cellId(latLng);
-    const S2CellId parentCellId = cellId.parent(s2Resolution);
-    return parentCellId.ToToken();
+    return lateralS2Cell(s2Resolution, latitude, longitude).ToToken();
 }
 
 std::string
 ab::geoToS23D(int s2Resolution, int verticalResolution, FPScalar latitude, FPScalar longitude, FPScalar altitude) {
     // Lateral
-    const S2LatLng latLng = S2LatLng::FromDegrees(latitude, longitude);
-    const S2CellId cellId(latLng);
-    const S2CellId parentCellId = cellId.parent(s2Resolution);
-    auto lateralS2Index = parentCellId.ToToken();
+    const auto lateral = lateralS2Cell(s2Resolution, latitude, longitude).ToToken();
 
     // Vertical
-    const auto layer = altitude / verticalResolution;
-    std::stringstream stream;
-    stream << std::hex << static_cast<int>(layer);
-    std::string hexString = stream.str();
-    if (hexString.length() == 1) hexString = "0" + hexString;
-
-    return lateralS2Index.substr(0, lateralS2Index.length() - 2) + hexString.substr(0, 2);
+    return withLayerCode(lateral, layerCode(verticalResolution, altitude));
 }
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include "airspacebookingutils/AsyncBooking.h"
+#include "TestFixtures.h"
+
+using namespace std::chrono;
+using namespace ab::test;
+
+TEST(AsyncBookingTests, TestMatchesBlocking) {
+    ab::BookingExecutor executor(2);
+    auto trajectoryFuture = ab::getH3CellBookingsAsync(trajectory(), 300, 600, 100, 30, 11, {}, executor);
+    auto volumeFuture = ab::getH3DVolumeBookingsAsync(volume(120), 11, 30, {}, executor);
+
+    const auto trajectoryBookings = trajectoryFuture.get();
+    const auto expected = ab::getH3CellBookings(trajectory(), 300, 600, 100, 30, 11);
+    ASSERT_EQ(expected.size(), trajectoryBookings.size());
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].cellId, trajectoryBookings[i].cellId);
+        EXPECT_EQ(expected[i].timeSlice.start, trajectoryBookings[i].timeSlice.start);
+        EXPECT_EQ(expected[i].timeSlice.end, trajectoryBookings[i].timeSlice.end);
+    }
+    EXPECT_EQ(ab::getH3DVolumeBookings(volume(120), 11, 30).size(), volumeFuture.get().size());
+}
+
+TEST(AsyncBookingTests, TestCallback) {
+    ab::BookingExecutor executor(1);
+    std::promise<std::size_t> done;
+    executor.submit([]() { return ab::getH3CellBookings(trajectory(), 300, 600, 100, 30, 11); },
+                    [&done](std::future<std::vector<ab::CellBooking>> result) {
+                        done.set_value(result.get().size());
+                    });
+    EXPECT_EQ(ab::getH3CellBookings(trajectory(), 300, 600, 100, 30, 11).size(), done.get_future().get());
+
+    // Exceptions reach the callback through the future
+    std::promise<bool> threw;
+    executor.submit([]() -> int { throw std::runtime_error("failed"); },
+                    [&threw](std::future<int> result) {
+                        try {
+                            result.get();
+                            threw.set_value(false);
+                        } catch (const std::runtime_error &) {
+                            threw.set_value(true);
+                        }
+                    });
+    EXPECT_TRUE(threw.get_future().get());
+}
+
+TEST(AsyncBookingTests, TestCancellation) {
+    ab::BookingExecutor executor(1);
+    ab::BookingOptions options;
+    options.cancellation.emplace();
+    options.cancellation->cancel();
+    EXPECT_THROW(ab::getH3CellBookingsAsync(trajectory(), 300, 600, 100, 30, 11, options, executor).get(),
+                 ab::BookingCancelledError);
+
+    // A large volume stops sampling soon after it is cancelled
+    options.cancellation.emplace();
+    options.stats = std::make_shared<ab::BookingStats>();
+    auto future = ab::getH3DVolumeBookingsAsync(volume(3000), 13, 30, options, executor);
+    std::this_thread::sleep_for(milliseconds(20));
+    const auto cancelledAt = steady_clock::now();
+    options.cancellation->cancel();
+    EXPECT_THROW(future.get(), ab::BookingCancelledError);
+    EXPECT_LT(steady_clock::now() - cancelledAt, milliseconds(500));
+    // Cancelled calls are not recorded
+    EXPECT_EQ(0, options.stats->calls);
+}
+
+TEST(AsyncBookingTests, TestDeadline) {
+    ab::BookingExecutor executor(1);
+    ab::BookingOptions options;
+    options.deadline = steady_clock::now();
+    EXPECT_THROW(ab::getH3VolumeBookingsAsync(volume(120), 11, options, executor).get(), ab::BookingLimitError);
+
+    // Time spent queued behind another call counts towards the deadline
+    std::promise<void> release;
+    auto blocker = executor.submit([opened = release.get_future().share()]() { opened.wait(); });
+    options.deadline = steady_clock::now() + milliseconds(50);
+    auto future = ab::getH3VolumeBookingsAsync(volume(120), 11, options, executor);
+    std::this_thread::sleep_for(milliseconds(100));
+    release.set_value();
+    blocker.get();
+    EXPECT_THROW(future.get(), ab::BookingLimitError);
+
+    options.deadline = steady_clock::now() + minutes(1);
+    EXPECT_FALSE(ab::getH3VolumeBookingsAsync(volume(120), 11, options, executor).get().empty());
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <sstream>
+#include "airspacebookingutils/BookingBuffer.h"
+#include "TestFixtures.h"
+
+using namespace std::chrono;
+using namespace ab::test;
+
+namespace {
+    const std::vector<ab::CellBooking> bookings{
+            {ab::d4::TimeSlice(t0, t0 + minutes(10)), "8919591565bffff"},
+            {ab::d4::TimeSlice(t0 + milliseconds(1500), t0 + minutes(15)), "8919591565fffff"},
+            {ab::d4::TimeSlice(t0 - hours(1), t0), "487c0b"},
+    };
+
+    void expectEqual(const std::vector<ab::CellBooking> &expected, const std::vector<ab::CellBooking> &actual) {
+        ASSERT_EQ(expected.size(), actual.size());
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            EXPECT_EQ(expected[i].cellId, actual[i].cellId);
+            EXPECT_EQ(expected[i].timeSlice.start, actual[i].timeSlice.start);
+            EXPECT_EQ(expected[i].timeSlice.end, actual[i].timeSlice.end);
+        }
+    }
+}
+
+TEST(BookingBufferTests, TestRoundTrip) {
+    const auto buffer = ab::encodeBookings(bookings);
+    EXPECT_EQ(ab::bookingBufferSize(bookings.size()), buffer.size());
+    EXPECT_EQ(0, reinterpret_cast<std::uintptr_t>(buffer.data()) % alignof(std::uint64_t));
+
+    const ab::BookingBufferView view(buffer.data(), buffer.size());
+    ASSERT_EQ(3, view.size());
+    // Columns are read in place
+    EXPECT_EQ(buffer.data() + 24, reinterpret_cast<const char *>(view.cellKeys()));
+    EXPECT_EQ(duration_cast<nanoseconds>(t0.time_since_epoch()).count(), view.starts()[0]);
+    EXPECT_EQ(duration_cast<nanoseconds>((t0 + minutes(15)).time_since_epoch()).count(), view.ends()[1]);
+    EXPECT_EQ("487c0b", view[2].cellId);
+    expectEqual(bookings, view.toCellBookings());
+
+    const auto empty = ab::encodeBookings({});
+    EXPECT_EQ(0, ab::BookingBufferView(empty.data(), empty.size()).size());
+}
+
+TEST(BookingBufferTests, TestWriteBookings) {
+    std::ostringstream out;
+    ab::writeBookings(bookings, out);
+    const auto buffer = ab::encodeBookings(bookings);
+    EXPECT_EQ(std::string(buffer.data(), buffer.size()), out.str());
+}
+
+TEST(BookingBufferTests, TestInvalidBuffers) {
+    EXPECT_THROW(ab::encodeBookings({{ab::d4::TimeSlice(t0, t0), "not hex"}}), std::invalid_argument);
+
+    auto buffer = ab::encodeBookings(bookings);
+    EXPECT_THROW(ab::BookingBufferView(buffer.data(), buffer.size() - 8), std::invalid_argument);
+    EXPECT_THROW(ab::BookingBufferView(buffer.data(), 10), std::invalid_argument);
+    buffer.data()[0] = 'X';
+    EXPECT_THROW(ab::BookingBufferView(buffer.data(), buffer.size()), std::invalid_argument);
+}
+
+TEST(BookingBufferTests, TestWriter) {
+    ab::BookingBufferWriter writer;
+    writer.add(bookings[0]);
+    writer.add({bookings[1], bookings[2]});
+    EXPECT_THROW(writer.add({ab::d4::TimeSlice(t0, t0), "not hex"}), std::invalid_argument);
+    ASSERT_EQ(3, writer.size());
+
+    const auto buffer = writer.finish();
+    const auto encoded = ab::encodeBookings(bookings);
+    ASSERT_EQ(encoded.size(), buffer.size());
+    EXPECT_EQ(0, std::memcmp(encoded.data(), buffer.data(), buffer.size()));
+    expectEqual(bookings, buffer.view().toCellBookings());
+
+    writer.clear();
+    EXPECT_EQ(0, writer.finish().view().size());
+}
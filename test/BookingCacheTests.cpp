@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "airspacebookingutils/BookingCache.h"
+#include "TestFixtures.h"
+
+using namespace ab::test;
+
+namespace {
+    std::vector<ab::d4::StateVector4D> route(ab::d4::TimeInstant start) {
+        return {
+                {{-1.39200210, 50.90768760, 200}, start,                              10},
+                {{-1.45465850, 50.93035940, 10},  start + std::chrono::minutes(3), 15},
+        };
+    }
+
+    std::vector<std::vector<ab::CellBooking>> bookings(ab::d4::TimeInstant start, int n) {
+        std::vector<ab::CellBooking> level;
+        for (int i = 0; i < n; ++i) {
+            level.emplace_back(ab::d4::TimeSlice(start + std::chrono::seconds(i), start + std::chrono::seconds(i + 60)),
+                               "8919591565bffff");
+        }
+        return {level};
+    }
+}
+
+TEST(BookingCacheTests, TestTimeShiftedHit) {
+    ab::BookingCache cache;
+    const auto key = ab::BookingCache::trajectoryKey(route(t0), 300, 600, 100, 30, "H3:9", {});
+    EXPECT_FALSE(cache.find(key, t0));
+    cache.insert(key, t0, bookings(t0, 3));
+
+    // The same route departing an hour later has the same key
+    const auto later = t0 + std::chrono::hours(1);
+    const auto laterKey = ab::BookingCache::trajectoryKey(route(later), 300, 600, 100, 30, "H3:9", {});
+    ASSERT_EQ(key, laterKey);
+    const auto hit = cache.find(laterKey, later);
+    ASSERT_TRUE(hit);
+    ASSERT_EQ(1, hit->size());
+    ASSERT_EQ(3, hit->front().size());
+    EXPECT_EQ(later + std::chrono::seconds(2), hit->front()[2].timeSlice.start);
+    EXPECT_EQ(later + std::chrono::seconds(62), hit->front()[2].timeSlice.end);
+    EXPECT_EQ(1, cache.hits());
+    EXPECT_EQ(1, cache.misses());
+
+    // Anything changing the output changes the key
+    EXPECT_NE(key, ab::BookingCache::trajectoryKey(route(t0), 300, 600, 100, 30, "H3:8", {}));
+    EXPECT_NE(key, ab::BookingCache::trajectoryKey(route(t0), 300, 600, 150, 30, "H3:9", {}));
+    ab::BookingOptions compact;
+    compact.compact = true;
+    EXPECT_NE(key, ab::BookingCache::trajectoryKey(route(t0), 300, 600, 100, 30, "H3:9", compact));
+    auto slower = route(t0);
+    slower[1].time += std::chrono::seconds(1);
+    EXPECT_NE(key, ab::BookingCache::trajectoryKey(slower, 300, 600, 100, 30, "H3:9", {}));
+}
+
+TEST(BookingCacheTests, TestMemoryCapEvictsLeastRecentlyUsed) {
+    ab::BookingCache cache;
+    cache.insert("a", t0, bookings(t0, 10));
+    const auto entryBytes = cache.bytes();
+    cache.setMaxBytes(entryBytes * 2 + entryBytes / 2);
+    cache.insert("b", t0, bookings(t0, 10));
+    // Use a so b is the least recently used
+    EXPECT_TRUE(cache.find("a", t0));
+    cache.insert("c", t0, bookings(t0, 10));
+
+    EXPECT_EQ(2, cache.size());
+    EXPECT_EQ(1, cache.evictions());
+    EXPECT_LE(cache.bytes(), cache.maxBytes());
+    EXPECT_TRUE(cache.find("a", t0));
+    EXPECT_FALSE(cache.find("b", t0));
+    EXPECT_TRUE(cache.find("c", t0));
+
+    // Entries larger than the cap are not cached
+    cache.insert("d", t0, bookings(t0, 1000));
+    EXPECT_FALSE(cache.find("d", t0));
+
+    cache.setMaxBytes(0);
+    EXPECT_EQ(0, cache.size());
+    EXPECT_EQ(0, cache.bytes());
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include "airspacebookingutils/BookingCache.h"
+#include "airspacebookingutils/library.h"
+#include "TestFixtures.h"
+
+using namespace std::chrono;
+using namespace ab::test;
+
+TEST(BookingCostTests, TestTrajectoryEstimate) {
+    ab::BookingOptions options;
+    options.stats = std::make_shared<ab::BookingStats>();
+    const auto bookings = ab::getH3DCellBookings(trajectory(), 300, 600, 100, 30, 12, 30, options);
+    const auto cost = ab::estimateBookingCost(trajectory(), {{ab::IndexSystem::H3D, 12, 30}}, 100, 30);
+
+    EXPECT_NEAR(options.stats->samplesInside, cost.samples, 0.2 * options.stats->samplesInside);
+    EXPECT_NEAR(options.stats->indexerCalls, cost.indexerCalls, 0.2 * options.stats->indexerCalls);
+    EXPECT_NEAR(bookings.size(), cost.cells, 0.5 * bookings.size());
+    EXPECT_GT(cost.bytes, cost.indexerCalls * sizeof(ab::d4::TimeSlice));
+
+    // Coarser cells are fewer, and every resolution adds its cells
+    const auto coarse = ab::estimateBookingCost(trajectory(), {{ab::IndexSystem::H3, 8}}, 100, 30);
+    EXPECT_LT(coarse.cells, cost.cells);
+    EXPECT_EQ(cost.samples, coarse.samples);
+    const auto both = ab::estimateBookingCost(trajectory(), {{ab::IndexSystem::H3D, 12, 30},
+                                                             {ab::IndexSystem::H3, 8}}, 100, 30);
+    EXPECT_EQ(cost.cells + coarse.cells, both.cells);
+    EXPECT_THROW(ab::estimateBookingCost(trajectory(), {{ab::IndexSystem::H3, 16}}), std::invalid_argument);
+}
+
+TEST(BookingCostTests, TestVolumeEstimate) {
+    ab::BookingOptions options;
+    options.stats = std::make_shared<ab::BookingStats>();
+    const auto bookings = ab::getH3VolumeBookings(volume(120), 11, options);
+    const auto cost = ab::estimateBookingCost(volume(120), {{ab::IndexSystem::H3, 11}});
+
+    EXPECT_NEAR(options.stats->samplesInside, cost.samples, 0.1 * options.stats->samplesInside);
+    EXPECT_EQ(3 * cost.samples, cost.indexerCalls);
+    EXPECT_NEAR(bookings.size(), cost.cells, 0.5 * bookings.size());
+}
+
+TEST(BookingCostTests, TestLimits) {
+    ab::BookingOptions options;
+    options.stats = std::make_shared<ab::BookingStats>();
+    options.maxSamples = 1000;
+    EXPECT_THROW(ab::getH3VolumeBookings(volume(120), 11, options), ab::BookingLimitError);
+    // Rejected before booking anything
+    EXPECT_EQ(0, options.stats->calls);
+
+    options.maxSamples = 0;
+    options.maxOutputCells = 100;
+    EXPECT_THROW(ab::getH3CellBookings(trajectory(), 300, 600, 100, 30, 12, options), ab::BookingLimitError);
+    options.maxOutputCells = 100000;
+    EXPECT_NO_THROW(ab::getH3CellBookings(trajectory(), 300, 600, 100, 30, 12, options));
+
+    // Cached results are held to the limit too, as it is not part of the cache key. The cached result is larger than
+    // the estimate, so the booking is admitted and only the cell count can reject it
+    options.cache = std::make_shared<ab::BookingCache>();
+    const auto key = ab::BookingCache::trajectoryKey(trajectory(), 300, 600, 100, 30, "H3:8", options);
+    options.cache->insert(key, t0, {std::vector<ab::CellBooking>(200, booking("8819591565fffff", 0, 10))});
+    options.maxOutputCells = 100;
+    EXPECT_THROW(ab::getH3CellBookings(trajectory(), 300, 600, 100, 30, 8, options), ab::BookingLimitError);
+    EXPECT_EQ(1, options.cache->hits());
+    options.cache = nullptr;
+
+    // A large volume aborts while sampling once past its time limit
+    options.maxOutputCells = 0;
+    options.timeLimit = milliseconds(1);
+    EXPECT_THROW(ab::getH3DVolumeBookings(volume(3000), 13, 30, options), ab::BookingLimitError);
+}
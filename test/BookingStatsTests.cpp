@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include "airspacebookingutils/BookingStats.h"
+
+TEST(BookingStatsTests, TestAccumulate) {
+    ab::BookingStats a;
+    a.calls = 1;
+    a.indexerSeconds = 0.5;
+    a.indexerCalls = 10;
+    ab::BookingStats b;
+    b.calls = 2;
+    b.indexerSeconds = 0.25;
+    b.rawBookings = 7;
+    a += b;
+    EXPECT_EQ(3, a.calls);
+    EXPECT_DOUBLE_EQ(0.75, a.indexerSeconds);
+    EXPECT_EQ(10, a.indexerCalls);
+    EXPECT_EQ(7, a.rawBookings);
+}
+
+TEST(BookingStatsTests, TestStageTimer) {
+    ab::BookingStats stats;
+    {
+        const ab::util::StageTimer timer(&stats, &ab::BookingStats::mergeSeconds);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_GE(stats.mergeSeconds, 0.005);
+    // A null stats pointer is a no-op
+    const ab::util::StageTimer timer(nullptr, &ab::BookingStats::mergeSeconds);
+}
+
+TEST(BookingStatsTests, TestProcessAggregate) {
+    ab::resetProcessBookingStats();
+    ab::BookingStats stats;
+    stats.calls = 1;
+    stats.samplesInside = 4;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&stats] { ab::recordProcessBookingStats(stats); });
+    }
+    for (auto &t: threads) t.join();
+
+    const auto aggregate = ab::processBookingStats();
+    EXPECT_EQ(4, aggregate.calls);
+    EXPECT_EQ(16, aggregate.samplesInside);
+
+    const auto text = aggregate.toPrometheus("abu");
+    EXPECT_NE(std::string::npos, text.find("# TYPE abu_calls_total counter\nabu_calls_total 4\n"));
+    EXPECT_NE(std::string::npos, text.find("abu_samples_inside_total 16\n"));
+    EXPECT_NE(std::string::npos, text.find("abu_stage_seconds_total{stage=\"indexer\"} 0\n"));
+
+    ab::resetProcessBookingStats();
+    EXPECT_EQ(0, ab::processBookingStats().calls);
+}
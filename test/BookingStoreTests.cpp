@@ -0,0 +1,326 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <random>
+#include "airspacebookingutils/BookingStore.h"
+#include "TestFixtures.h"
+
+using namespace std::chrono;
+using namespace ab::test;
+
+namespace {
+    std::vector<ab::CellBooking> shifted(std::vector<ab::CellBooking> bookings, ab::BookingStore::Duration offset) {
+        for (auto &b: bookings) {
+            b.timeSlice.start += offset;
+            b.timeSlice.end += offset;
+        }
+        return bookings;
+    }
+}
+
+TEST(BookingStoreTests, TestIsFree) {
+    ab::BookingStore store;
+    store.add(1, {booking("8919591565bffff", 0, 10), booking("8919591565fffff", 5, 15)});
+    EXPECT_EQ(2, store.size());
+    EXPECT_EQ(2, store.cellCount());
+
+    EXPECT_FALSE(store.isFree({booking("8919591565bffff", 9, 20)}));
+    EXPECT_FALSE(store.isFree({booking("8919591565fffff", 6, 7)}));
+    // Touching at an endpoint is free
+    EXPECT_TRUE(store.isFree({booking("8919591565bffff", 10, 20), booking("8919591565fffff", 0, 5)}));
+    EXPECT_TRUE(store.isFree({booking("891959156a3ffff", 0, 60)}));
+    // Bookings overlapping each other exceed the capacity of a free cell together
+    EXPECT_FALSE(store.isFree({booking("891959156a3ffff", 0, 60), booking("891959156a3ffff", 30, 40)}));
+    EXPECT_TRUE(store.isFree({booking("891959156a3ffff", 0, 30), booking("891959156a3ffff", 30, 40)}));
+
+    store.clear();
+    EXPECT_EQ(0, store.size());
+    EXPECT_TRUE(store.isFree({booking("8919591565bffff", 9, 20)}));
+}
+
+TEST(BookingStoreTests, TestEarliestFreeOffset) {
+    ab::BookingStore store;
+    store.add(1, {booking("a", 0, 10), booking("b", 12, 20)});
+    store.add(2, {booking("a", 30, 40)});
+    const std::vector<ab::CellBooking> pattern{booking("a", 0, 5), booking("b", 5, 10)};
+
+    // Cell a is free from +10 min, but b is then booked from 15 to 20 which overlaps its reservation until 20
+    EXPECT_EQ(minutes(15), store.earliestFreeOffset(pattern, minutes(0), hours(2)));
+    EXPECT_EQ(minutes(15), store.earliestFreeOffset(pattern, minutes(15), hours(2)));
+    // Cell a from 30 overlaps its second reservation, so only +15 min to +25 min fit before +40 min
+    EXPECT_EQ(minutes(20), store.earliestFreeOffset(pattern, minutes(20), hours(2)));
+    EXPECT_EQ(minutes(40), store.earliestFreeOffset(pattern, minutes(26), hours(2)));
+    EXPECT_FALSE(store.earliestFreeOffset(pattern, minutes(26), minutes(39)).has_value());
+    // Free straight away before the reservations
+    EXPECT_EQ(minutes(-30), store.earliestFreeOffset(pattern, minutes(-30), hours(2)));
+}
+
+TEST(BookingStoreTests, TestEarliestFreeOffsetMatchesRebooking) {
+    std::mt19937 rng(3);
+    ab::BookingStore store;
+    for (int op = 0; op < 200; ++op) {
+        std::vector<ab::CellBooking> bookings;
+        for (int b = 0; b < 10; ++b) {
+            const int start = static_cast<int>(rng() % 600);
+            bookings.push_back(booking(std::to_string(rng() % 50), start, start + 1 + static_cast<int>(rng() % 10)));
+        }
+        store.add(op, bookings);
+    }
+    std::vector<ab::CellBooking> pattern;
+    for (int b = 0; b < 8; ++b) {
+        pattern.push_back(booking(std::to_string(rng() % 50), b * 2, b * 2 + 3));
+    }
+
+    // Shifting the departure a minute at a time finds the same earliest offset
+    std::optional<ab::BookingStore::Duration> expected;
+    for (int offset = 0; offset <= 720; ++offset) {
+        if (store.isFree(shifted(pattern, minutes(offset)))) {
+            expected = minutes(offset);
+            break;
+        }
+    }
+    ASSERT_TRUE(expected.has_value());
+    const auto offset = store.earliestFreeOffset(pattern, minutes(0), minutes(720));
+    ASSERT_TRUE(offset.has_value());
+    EXPECT_LE(*offset, *expected);
+    EXPECT_TRUE(store.isFree(shifted(pattern, *offset)));
+}
+
+TEST(BookingStoreTests, TestCapacity) {
+    ab::BookingStore store;
+    store.setCapacity("a", 2);
+    store.setCapacity("closed", 0);
+    store.add(1, {booking("a", 0, 10), booking("b", 0, 10)});
+    store.add(2, {booking("a", 5, 15)});
+    EXPECT_EQ(2, store.maxOccupancy("a", t0, t0 + minutes(20)));
+    EXPECT_EQ(1, store.maxOccupancy("a", t0 + minutes(10), t0 + minutes(20)));
+
+    // Only where both reservations overlap is cell a at its capacity
+    EXPECT_FALSE(store.isFree({booking("a", 8, 9)}));
+    EXPECT_TRUE(store.isFree({booking("a", 10, 20)}));
+    EXPECT_TRUE(store.isFree({booking("a", 0, 5)}));
+    EXPECT_FALSE(store.isFree({booking("b", 8, 9)}));
+    EXPECT_FALSE(store.isFree({booking("closed", 0, 1)}));
+    // Two overlapping candidate bookings fit once the reservations end, but not alongside one of them
+    EXPECT_TRUE(store.isFree({booking("a", 15, 20), booking("a", 16, 18)}));
+    EXPECT_FALSE(store.isFree({booking("a", 14, 20), booking("a", 14, 16)}));
+    EXPECT_FALSE(store.isFree({booking("a", 18, 19), booking("b", 20, 30), booking("a", 16, 20),
+                               booking("a", 17, 19)}));
+    const auto saturated = store.saturatedSlices("a", t0, t0 + hours(1));
+    ASSERT_EQ(1, saturated.size());
+    EXPECT_EQ(t0 + minutes(5), saturated[0].start);
+    EXPECT_EQ(t0 + minutes(10), saturated[0].end);
+    EXPECT_EQ(minutes(10), store.earliestFreeOffset({booking("a", 0, 5)}, minutes(1), hours(1)));
+    EXPECT_FALSE(store.earliestFreeOffset({booking("closed", 0, 5)}, minutes(0), hours(1)).has_value());
+
+    // Saturated time slices that touch are joined
+    store.add(3, {booking("a", 10, 20), booking("a", 12, 30)});
+    const auto joined = store.saturatedSlices("a", t0, t0 + hours(1));
+    ASSERT_EQ(1, joined.size());
+    EXPECT_EQ(t0 + minutes(20), joined[0].end);
+
+    store.setDefaultCapacity(3);
+    EXPECT_TRUE(store.isFree({booking("b", 8, 9)}));
+    EXPECT_EQ(2, store.capacity("a"));
+}
+
+TEST(BookingStoreTests, TestLoadCapacities) {
+    const auto path = testing::TempDir() + "capacities.txt";
+    {
+        std::ofstream out(path);
+        out << "# cell, capacity\n* 2\n8919591565bffff 4\n\n8919591565fffff,0\n";
+    }
+    ab::BookingStore store;
+    store.loadCapacities(path);
+    EXPECT_EQ(2, store.defaultCapacity());
+    EXPECT_EQ(4, store.capacity("8919591565bffff"));
+    EXPECT_EQ(0, store.capacity("8919591565fffff"));
+    EXPECT_EQ(2, store.capacity("891959156a3ffff"));
+
+    {
+        std::ofstream out(path);
+        out << "8919591565bffff 1\n8919591565fffff -1\n";
+    }
+    EXPECT_THROW(store.loadCapacities(path), std::runtime_error);
+    // Nothing is loaded from a malformed file
+    EXPECT_EQ(4, store.capacity("8919591565bffff"));
+    EXPECT_THROW(store.loadCapacities(path + ".missing"), std::runtime_error);
+}
+
+TEST(BookingStoreTests, TestCapacityMatchesRebooking) {
+    std::mt19937 rng(5);
+    ab::BookingStore store(3);
+    for (int op = 0; op < 600; ++op) {
+        std::vector<ab::CellBooking> bookings;
+        for (int b = 0; b < 10; ++b) {
+            const int start = static_cast<int>(rng() % 600);
+            bookings.push_back(booking(std::to_string(rng() % 30), start, start + 1 + static_cast<int>(rng() % 20)));
+        }
+        store.add(op, bookings);
+    }
+    std::vector<ab::CellBooking> pattern;
+    for (int b = 0; b < 8; ++b) {
+        pattern.push_back(booking(std::to_string(rng() % 30), b * 2, b * 2 + 3));
+    }
+
+    // isFree agrees with counting the overlaps at every minute
+    std::optional<ab::BookingStore::Duration> expected;
+    for (int offset = 0; offset <= 720; ++offset) {
+        bool free = true;
+        for (const auto &b: shifted(pattern, minutes(offset))) {
+            for (auto t = b.timeSlice.start; t < b.timeSlice.end; t += minutes(1)) {
+                free &= store.reservedSlices(b.cellId, t, t + minutes(1)).size() < 3;
+            }
+        }
+        EXPECT_EQ(free, store.isFree(shifted(pattern, minutes(offset)))) << offset;
+        if (free && !expected) expected = minutes(offset);
+    }
+    // Reservations start and end on whole minutes, so the earliest free offset does too
+    ASSERT_TRUE(expected.has_value());
+    EXPECT_GT(*expected, minutes(0));
+    EXPECT_EQ(expected, store.earliestFreeOffset(pattern, minutes(0), minutes(720)));
+}
+
+TEST(BookingStoreTests, TestOccupiedCells) {
+    ab::BookingStore store(1, minutes(15));
+    EXPECT_EQ(minutes(15), store.occupancyBucketWidth());
+    EXPECT_THROW(ab::BookingStore(1, minutes(0)), std::invalid_argument);
+    store.add(1, {booking("a", 0, 10), booking("b", 20, 40), booking("c", 3, 4)});
+
+    // Order is kept and unknown cells are unoccupied
+    const std::vector<std::string> cells{"d", "c", "b", "a"};
+    EXPECT_EQ(std::vector<std::string>({"c", "a"}), store.occupiedCells(cells, t0, t0 + minutes(15)));
+    EXPECT_EQ(std::vector<std::string>({"d", "b"}), store.unoccupiedCells(cells, t0, t0 + minutes(15)));
+    // Within the edge buckets only overlapping reservations count, and touching is not overlapping
+    EXPECT_EQ(std::vector<std::string>({"b"}), store.occupiedCells(cells, t0 + minutes(10), t0 + minutes(21)));
+    EXPECT_TRUE(store.occupiedCells(cells, t0 + minutes(4), t0 + minutes(3)).empty());
+
+    store.clear();
+    EXPECT_TRUE(store.occupiedCells(cells, t0, t0 + minutes(60)).empty());
+}
+
+TEST(BookingStoreTests, TestOccupiedCellsMatchesReservations) {
+    std::mt19937 rng(9);
+    ab::BookingStore store(1, minutes(7));
+    for (int op = 0; op < 300; ++op) {
+        const int start = static_cast<int>(rng() % 2000) - 1000;
+        store.add(op, {booking(std::to_string(rng() % 500), start, start + 1 + static_cast<int>(rng() % 40))});
+    }
+    std::vector<std::string> cells;
+    for (int c = 0; c < 600; ++c) {
+        cells.push_back(std::to_string(c));
+    }
+    for (int query = 0; query < 50; ++query) {
+        const auto start = t0 + seconds(static_cast<int>(rng() % 120000) - 60000);
+        // Long intervals span more buckets than are occupied
+        const auto end = start + seconds(1 + rng() % (query % 2 ? 6000 : 200000));
+        std::vector<std::string> expected;
+        for (const auto &cell: cells) {
+            if (!store.reservedSlices(cell, start, end).empty()) expected.push_back(cell);
+        }
+        EXPECT_EQ(expected, store.occupiedCells(cells, start, end));
+        EXPECT_EQ(cells.size() - expected.size(), store.unoccupiedCells(cells, start, end).size());
+    }
+}
+
+TEST(BookingStoreTests, TestRemove) {
+    ab::BookingStore store;
+    store.add(1, {booking("a", 0, 10), booking("b", 0, 10), booking("a", 20, 30)});
+    store.add(2, {booking("a", 10, 20), booking("c", 5, 6)});
+    EXPECT_EQ(2, store.operationCount());
+    EXPECT_EQ(std::vector<std::string>({"a", "b"}), store.cellsOf(1));
+    typedef std::vector<ab::BookingStore::OperationId> Operations;
+    EXPECT_EQ(Operations({1, 2}), store.operationsIn("a", t0 + minutes(5), t0 + minutes(25)));
+    EXPECT_EQ(Operations({2}), store.operationsIn("a", t0 + minutes(10), t0 + minutes(20)));
+
+    EXPECT_EQ(3, store.remove(1));
+    EXPECT_EQ(0, store.remove(1));
+    EXPECT_EQ(2, store.size());
+    EXPECT_EQ(2, store.cellCount());
+    EXPECT_EQ(1, store.operationCount());
+    EXPECT_TRUE(store.cellsOf(1).empty());
+    EXPECT_TRUE(store.isFree({booking("a", 0, 10), booking("b", 0, 10)}));
+    EXPECT_FALSE(store.isFree({booking("a", 15, 16)}));
+    // Cell a is still occupied in the buckets its remaining reservation overlaps
+    const std::vector<std::string> cells{"a", "b", "c"};
+    EXPECT_EQ(std::vector<std::string>({"a", "c"}), store.occupiedCells(cells, t0, t0 + minutes(15)));
+    EXPECT_TRUE(store.occupiedCells(cells, t0 + minutes(20), t0 + minutes(60)).empty());
+}
+
+TEST(BookingStoreTests, TestBatchedRemoveMatchesRebuild) {
+    std::mt19937 rng(13);
+    std::vector<std::vector<ab::CellBooking>> operations;
+    for (int op = 0; op < 400; ++op) {
+        std::vector<ab::CellBooking> bookings;
+        for (int b = 0; b < 5; ++b) {
+            const int start = static_cast<int>(rng() % 1000);
+            bookings.push_back(booking(std::to_string(rng() % 100), start, start + 1 + static_cast<int>(rng() % 60)));
+        }
+        operations.push_back(bookings);
+    }
+    ab::BookingStore store(1, minutes(10)), expected(1, minutes(10));
+    std::vector<ab::BookingStore::OperationId> cancelled;
+    for (std::size_t op = 0; op < operations.size(); ++op) {
+        store.add(op, operations[op]);
+        if (rng() % 3 == 0) {
+            cancelled.push_back(op);
+        } else {
+            expected.add(op, operations[op]);
+        }
+    }
+    const auto stored = store.size();
+    EXPECT_EQ(stored - expected.size(), store.remove(cancelled));
+    EXPECT_EQ(expected.size(), store.size());
+    EXPECT_EQ(expected.cellCount(), store.cellCount());
+    EXPECT_EQ(expected.operationCount(), store.operationCount());
+
+    std::vector<std::string> cells;
+    for (int c = 0; c < 100; ++c) {
+        cells.push_back(std::to_string(c));
+    }
+    for (int query = 0; query < 50; ++query) {
+        const auto start = t0 + minutes(static_cast<int>(rng() % 1100));
+        const auto end = start + minutes(1 + rng() % 60);
+        EXPECT_EQ(expected.occupiedCells(cells, start, end), store.occupiedCells(cells, start, end));
+        const auto &cell = cells[rng() % cells.size()];
+        EXPECT_EQ(expected.operationsIn(cell, start, end), store.operationsIn(cell, start, end));
+        EXPECT_EQ(expected.reservedSlices(cell, start, end).size(), store.reservedSlices(cell, start, end).size());
+    }
+
+    // Cells emptied by the removal are numbered again when booked
+    for (std::size_t op = 0; op < operations.size(); ++op) {
+        if (std::find(cancelled.begin(), cancelled.end(), op) != cancelled.end()) store.add(op, operations[op]);
+    }
+    for (int query = 0; query < 20; ++query) {
+        const auto start = t0 + minutes(static_cast<int>(rng() % 1100));
+        const auto end = start + minutes(1 + rng() % 60);
+        std::vector<std::string> occupied;
+        for (const auto &cell: cells) {
+            if (!store.reservedSlices(cell, start, end).empty()) occupied.push_back(cell);
+        }
+        EXPECT_EQ(occupied, store.occupiedCells(cells, start, end));
+    }
+}
+
+TEST(BookingStoreTests, TestLongReservationCandidates) {
+    ab::BookingStore store(2, minutes(15));
+    // An all day hold alongside many short reservations
+    store.add(0, {booking("a", 0, 24 * 60)});
+    for (int op = 1; op <= 1000; ++op) {
+        store.add(op, {booking("a", op, op + 5)});
+    }
+    // Only the short reservations starting near the window and the long hold are visited
+    EXPECT_LE(store.candidateCount("a", t0 + minutes(500), t0 + minutes(510)), 20u);
+    EXPECT_EQ(std::vector<ab::BookingStore::OperationId>({0, 495, 496, 497, 498, 499, 500}),
+              store.operationsIn("a", t0 + minutes(499), t0 + minutes(501)));
+    EXPECT_FALSE(store.isFree({booking("a", 500, 501)}));
+    EXPECT_TRUE(store.isFree({booking("a", 2000, 2001)}));
+    const auto slices = store.reservedSlices("a", t0 + minutes(3), t0 + minutes(4));
+    ASSERT_EQ(4, slices.size());
+    EXPECT_EQ(t0, slices.front().start);
+
+    // Removing the hold keeps the bitmaps of the buckets the short reservations still occupy
+    EXPECT_EQ(1, store.remove(0));
+    EXPECT_LE(store.candidateCount("a", t0 + minutes(500), t0 + minutes(510)), 20u);
+    EXPECT_EQ(std::vector<std::string>({"a"}), store.occupiedCells({"a"}, t0 + minutes(900), t0 + minutes(1000)));
+    EXPECT_TRUE(store.occupiedCells({"a"}, t0 + minutes(1100), t0 + minutes(1400)).empty());
+}
@@ -0,0 +1,21 @@
+#include <gtest/gtest.h>
+#include "airspacebookingutils/util/CellKey.h"
+
+TEST(CellKeyTests, TestRoundTrip) {
+    for (const std::string id: {"8919591565bffff", "4876b", "89c25bc", "00a", "0", ""}) {
+        const auto key = ab::util::encodeCellKey(id);
+        ASSERT_TRUE(key.has_value()) << id;
+        EXPECT_EQ(id, ab::util::decodeCellKey(*key));
+    }
+}
+
+TEST(CellKeyTests, TestLeadingZerosAreDistinct) {
+    EXPECT_NE(*ab::util::encodeCellKey("a"), *ab::util::encodeCellKey("0a"));
+    EXPECT_NE(*ab::util::encodeCellKey("0"), *ab::util::encodeCellKey(""));
+}
+
+TEST(CellKeyTests, TestUnpackableIds) {
+    EXPECT_FALSE(ab::util::encodeCellKey("89c25bc8a5a7b1e3").has_value());
+    EXPECT_FALSE(ab::util::encodeCellKey("8919591565BFFFF").has_value());
+    EXPECT_FALSE(ab::util::encodeCellKey("89_1").has_value());
+}
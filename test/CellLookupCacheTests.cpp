@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include "airspacebookingutils/util/CellLookupCache.h"
+
+TEST(CellLookupCacheTests, TestReusesExactCoordinates) {
+    ab::util::CellLookupCache<std::uint64_t> cache;
+    int lookups = 0;
+    const auto lookup = [&lookups](double lat, double lng, int res) {
+        ++lookups;
+        return static_cast<std::uint64_t>(lat * 1000) * 31 + static_cast<std::uint64_t>(lng * 1000) + res;
+    };
+
+    // Repeated vertical layers of the same column
+    const auto expected = lookup(50.9, 1.39, 9);
+    lookups = 0;
+    for (int z = 0; z < 5; ++z) {
+        EXPECT_EQ(expected, cache.get(9, 50.9, 1.39, [&] { return lookup(50.9, 1.39, 9); }));
+    }
+    EXPECT_EQ(1, lookups);
+    EXPECT_EQ(4, cache.hits());
+    EXPECT_EQ(1, cache.misses());
+
+    // A different resolution or coordinate is a miss
+    cache.get(8, 50.9, 1.39, [&] { return lookup(50.9, 1.39, 8); });
+    cache.get(9, 50.9000001, 1.39, [&] { return lookup(50.9000001, 1.39, 9); });
+    EXPECT_EQ(3, cache.misses());
+}
+
+TEST(CellLookupCacheTests, TestCollisionsReturnCorrectCells) {
+    ab::util::CellLookupCache<std::uint64_t, 4> cache;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < 100; ++i) {
+            const double lat = 50 + i * 1e-4;
+            EXPECT_EQ(static_cast<std::uint64_t>(i), cache.get(9, lat, -1.4, [i] { return static_cast<std::uint64_t>(i); }));
+        }
+    }
+}
+
+TEST(CellLookupCacheTests, TestReusesCellInsideInscribedCap) {
+    // Cells 0.01 degrees wide along the equator, bounded by meridians and, to within the cap margin, the
+    // parallels 0.005 degrees either side of it
+    const auto cellOf = [](double lng) { return static_cast<std::uint64_t>(std::floor(lng * 100)); };
+    const auto cap = [](std::uint64_t cell) {
+        const double west = cell / 100.0, east = west + 0.01;
+        const std::array<ab::util::UnitVector, 4> vertices{
+                ab::util::unitVector(-0.005, west), ab::util::unitVector(-0.005, east),
+                ab::util::unitVector(0.005, east), ab::util::unitVector(0.005, west)};
+        return ab::util::InscribedCap::of(ab::util::unitVector(0, west + 0.005), vertices.data(), vertices.size());
+    };
+
+    ab::util::CellLookupCache<std::uint64_t> cache;
+    int lookups = 0;
+    for (int i = 0; i < 1000; ++i) {
+        const double lng = 10 + i * 0.0003;
+        ASSERT_EQ(cellOf(lng), cache.get(9, 0, lng, [&] {
+            ++lookups;
+            return cellOf(lng);
+        }, cap));
+    }
+    EXPECT_EQ(1000 - lookups, cache.capHits());
+    EXPECT_LT(lookups, 300);
+
+    // The cap stays inside the cell, away from its edges
+    const auto inscribed = cap(1000);
+    EXPECT_TRUE(inscribed.contains(ab::util::unitVector(0.004, 10.005)));
+    EXPECT_FALSE(inscribed.contains(ab::util::unitVector(0, 10.0001)));
+    EXPECT_FALSE(inscribed.contains(ab::util::unitVector(0.00499, 10.005)));
+}
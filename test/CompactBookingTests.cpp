@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+#include "airspacebookingutils/CompactBooking.h"
+#include "TestFixtures.h"
+
+using namespace std::chrono;
+using namespace ab::test;
+
+TEST(CompactBookingTests, TestRoundTrip) {
+    const std::vector<ab::CellBooking> bookings{booking("8919591565bffff", t0 + minutes(5), t0 + minutes(15)),
+                                                booking("487c0b", t0, t0 + hours(24 * 365))};
+    const auto batch = ab::CompactBookingBatch::fromCellBookings(bookings);
+    EXPECT_EQ(t0, batch.epoch());
+    ASSERT_EQ(2, batch.size());
+    EXPECT_EQ(300, batch.bookings()[0].start);
+    EXPECT_EQ(900, batch.bookings()[0].end);
+
+    const auto expanded = batch.toCellBookings();
+    ASSERT_EQ(2, expanded.size());
+    for (std::size_t i = 0; i < bookings.size(); ++i) {
+        EXPECT_EQ(bookings[i].cellId, expanded[i].cellId);
+        EXPECT_EQ(bookings[i].timeSlice.start, expanded[i].timeSlice.start);
+        EXPECT_EQ(bookings[i].timeSlice.end, expanded[i].timeSlice.end);
+    }
+}
+
+TEST(CompactBookingTests, TestRoundingCoversTimeSlice) {
+    const ab::CompactBookingBatch batch(t0 + milliseconds(250));
+    EXPECT_EQ(t0, batch.epoch());
+
+    const auto compact = batch.compact(booking("8919591565bffff", t0 - milliseconds(1500), t0 + milliseconds(1)));
+    EXPECT_EQ(-2, compact.start);
+    EXPECT_EQ(1, compact.end);
+    const auto timeSlice = batch.timeSlice(compact);
+    EXPECT_EQ(t0 - seconds(2), timeSlice.start);
+    EXPECT_EQ(t0 + seconds(1), timeSlice.end);
+}
+
+TEST(CompactBookingTests, TestInvalidBookings) {
+    ab::CompactBookingBatch batch(t0);
+    EXPECT_THROW(batch.add(booking("not hex", t0, t0 + minutes(1))), std::invalid_argument);
+    EXPECT_THROW(batch.add(booking("8919591565bffff", t0, t0 + hours(24 * 365 * 70))), std::invalid_argument);
+    EXPECT_EQ(0, batch.size());
+    EXPECT_EQ(0, ab::CompactBookingBatch::fromCellBookings({}).size());
+}
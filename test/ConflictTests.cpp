@@ -1,9 +1,14 @@
 #include <gtest/gtest.h>
 #include <iostream>
 #include <chrono>
+#include <random>
 #include "airspacebookingutils/library.h"
+#include "airspacebookingutils/ConflictDetection.h"
+#include "airspacebookingutils/util/LocalProjection.h"
+#include "TestFixtures.h"
 
 using namespace std::chrono;
+using namespace ab::test;
 
 class ConflictTests : public ::testing::Test {
 protected:
@@ -25,3 +30,140 @@ TEST_F(ConflictTests, BasicXTest) {
     const auto cells2 = ab::getH3CellBookings(traj2);
 }
 
+TEST(DetectConflictsTests, TestOverlappingOperations) {
+    const auto at = [](int minutes) { return t0 + minutes * 60s; };
+    const std::vector<std::vector<ab::CellBooking>> operations{
+            {{{at(0), at(10)}, "8919591565bffff"}, {{at(5), at(15)}, "8919591565fffff"}},
+            // Overlaps op 0 in both cells
+            {{{at(8), at(12)}, "8919591565bffff"}, {{at(0), at(6)}, "8919591565fffff"}},
+            // Only touches op 0 at an endpoint, and overlaps op 1
+            {{{at(10), at(20)}, "8919591565bffff"}},
+            // Disjoint cell
+            {{{at(0), at(60)}, "891959156a3ffff"}},
+    };
+
+    const auto conflicts = ab::detectConflicts(operations);
+    ASSERT_EQ(3, conflicts.size());
+    EXPECT_EQ(0, conflicts[0].firstOperation);
+    EXPECT_EQ(1, conflicts[0].secondOperation);
+    EXPECT_EQ("8919591565fffff", conflicts[0].cellId);
+    EXPECT_EQ(at(5), conflicts[0].overlap.start);
+    EXPECT_EQ(at(6), conflicts[0].overlap.end);
+    EXPECT_EQ("8919591565bffff", conflicts[1].cellId);
+    EXPECT_EQ(at(8), conflicts[1].overlap.start);
+    EXPECT_EQ(at(10), conflicts[1].overlap.end);
+    EXPECT_EQ(1, conflicts[2].firstOperation);
+    EXPECT_EQ(2, conflicts[2].secondOperation);
+    EXPECT_EQ(at(10), conflicts[2].overlap.start);
+    EXPECT_EQ(at(12), conflicts[2].overlap.end);
+}
+
+TEST(DetectConflictsTests, TestMatchesBruteForce) {
+    std::vector<std::vector<ab::CellBooking>> operations(200);
+    std::mt19937 rng(42);
+    for (auto &bookings: operations) {
+        for (int b = 0; b < 20; ++b) {
+            const auto start = t0 + std::chrono::minutes(rng() % 600);
+            const auto cell = "89195915" + std::to_string(rng() % 30) + "ffff";
+            bookings.emplace_back(ab::d4::TimeSlice(start, start + std::chrono::minutes(1 + rng() % 20)), cell);
+        }
+    }
+    const auto countBruteForce = [](const std::vector<std::vector<ab::CellBooking>> &ops) {
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < ops.size(); ++i) {
+            for (std::size_t j = i + 1; j < ops.size(); ++j) {
+                for (const auto &a: ops[i]) {
+                    for (const auto &b: ops[j]) {
+                        if (a.cellId == b.cellId && a.timeSlice.start < b.timeSlice.end
+                            && b.timeSlice.start < a.timeSlice.end) {
+                            ++n;
+                        }
+                    }
+                }
+            }
+        }
+        return n;
+    };
+    EXPECT_EQ(countBruteForce(operations), ab::detectConflicts(operations).size());
+
+    // A 16 character ID can not be packed, so all IDs are interned
+    operations.back().emplace_back(ab::d4::TimeSlice(t0, t0 + 1min), "89c25bc8a5a7b1e3");
+    EXPECT_EQ(countBruteForce(operations), ab::detectConflicts(operations).size());
+}
+
+class ClosestApproachTests : public ::testing::Test {
+protected:
+    const ab::util::LocalProjection projection{-1.4, 50.9};
+
+    // A straight track between two local (x, y, z) points flown at a speed from a departure time
+    std::vector<ab::d4::StateVector4D> track(const ab::Position &from, const ab::Position &to, double speed,
+                                             ab::d4::TimeInstant departure) const {
+        return {ab::d4::StateVector4D(projection.inverse(from), departure, speed),
+                ab::d4::StateVector4D(projection.inverse(to), ab::d4::TimeInstant{}, speed)};
+    }
+};
+
+TEST_F(ClosestApproachTests, TestCrossingTracks) {
+    // A flies east through the origin from t0, B flies north through the origin from t0 + 20 s, 100 m higher.
+    // Their separation is (10t - 1000, 1200 - 10t, -100) which is closest at t = 110 s
+    const auto a = track({-1000, 0, 100}, {1000, 0, 100}, 10, t0);
+    const auto b = track({0, -1000, 200}, {0, 1000, 200}, 10, t0 + 20s);
+
+    const auto closest = ab::closestPointOfApproach(a, b);
+    ASSERT_TRUE(closest.has_value());
+    EXPECT_NEAR(100 * std::sqrt(2.0), closest->lateralDistance, 0.5);
+    EXPECT_NEAR(100, closest->verticalDistance, 1e-6);
+    EXPECT_NEAR(std::sqrt(3.0) * 100, closest->distance, 0.5);
+    EXPECT_NEAR(110, duration<double>(closest->time - t0).count(), 0.1);
+}
+
+TEST_F(ClosestApproachTests, TestNoCommonTime) {
+    const auto a = track({-1000, 0, 100}, {1000, 0, 100}, 10, t0);
+    const auto b = track({-1000, 0, 100}, {1000, 0, 100}, 10, t0 + 1h);
+    EXPECT_FALSE(ab::closestPointOfApproach(a, b).has_value());
+    EXPECT_FALSE(ab::closestPointOfApproach(a, {}).has_value());
+}
+
+TEST_F(ClosestApproachTests, TestCandidatePairs) {
+    const std::vector<std::vector<ab::d4::StateVector4D>> trajectories{
+            track({-1000, 0, 100}, {1000, 0, 100}, 10, t0),
+            track({0, -1000, 100}, {0, 1000, 100}, 10, t0 + 20s),
+            // Parallel to the first, 10 km north
+            track({-1000, 10000, 100}, {1000, 10000, 100}, 10, t0),
+            // The reverse of the first route, departing 30 s after it lands
+            track({1000, 0, 100}, {-1000, 0, 100}, 10, t0 + 230s),
+    };
+    using Pairs = std::vector<std::pair<std::size_t, std::size_t>>;
+    // The first pair is closest at 141 m
+    EXPECT_EQ(Pairs({{0, 1}}), ab::conflictCandidatePairs(trajectories, 150, 0));
+    EXPECT_EQ(Pairs(), ab::conflictCandidatePairs(trajectories, 140, 0));
+    // The temporal buffers cover the gap between the first landing and the last departing
+    EXPECT_EQ(Pairs({{0, 1}, {0, 3}}), ab::conflictCandidatePairs(trajectories, 150, 0, 40));
+}
+
+TEST_F(ClosestApproachTests, TestCandidatePairsMatchBruteForce) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> coordinate(-5000, 5000);
+    std::uniform_real_distribution<double> altitude(50, 150);
+    std::vector<std::vector<ab::d4::StateVector4D>> trajectories;
+    for (int i = 0; i < 150; ++i) {
+        std::vector<ab::d4::StateVector4D> trajectory;
+        auto departure = t0 + std::chrono::seconds(rng() % 3600);
+        for (int k = 0; k < 4; ++k) {
+            trajectory.emplace_back(projection.inverse(coordinate(rng), coordinate(rng), altitude(rng)), departure,
+                                    15);
+            departure += std::chrono::seconds(400 + rng() % 300);
+        }
+        trajectories.push_back(trajectory);
+    }
+
+    std::vector<std::pair<std::size_t, std::size_t>> expected;
+    for (std::size_t i = 0; i < trajectories.size(); ++i) {
+        for (std::size_t j = i + 1; j < trajectories.size(); ++j) {
+            const auto closest = ab::closestPointOfApproach(trajectories[i], trajectories[j]);
+            if (closest && closest->distance < std::hypot(200.0, 30.0)) expected.emplace_back(i, j);
+        }
+    }
+    ASSERT_FALSE(expected.empty());
+    EXPECT_EQ(expected, ab::conflictCandidatePairs(trajectories, 200, 30));
+}
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include <limits>
+#include <set>
+#include "airspacebookingutils/util/GridCoverage.h"
+#include "airspacebookingutils/library.h"
+
+namespace {
+    std::set<std::pair<int, int>> bruteForce(const ab::GeoPolygon &polygon, int xMin, int yMin, int nx, int ny,
+                                             int step) {
+        std::set<std::pair<int, int>> samples;
+        for (int i = 0; i < nx; ++i) {
+            for (int j = 0; j < ny; ++j) {
+                const Eigen::Vector2i xy{xMin + i * step, yMin + j * step};
+                if (ab::util::isInsidePolygon(polygon, xy)) samples.emplace(xy.x(), xy.y());
+            }
+        }
+        return samples;
+    }
+}
+
+TEST(GridCoverageTests, TestMatchesBruteForce) {
+    // A concave, L shaped polygon with a diagonal edge
+    const ab::GeoPolygon polygon{
+            {-1000, -1000, 0},
+            {3000,  -1000, 0},
+            {3000,  500,   0},
+            {500,   800,   0},
+            {400,   4000,  0},
+            {-1000, 4000,  0},
+            {-1000, -1000, 0},
+    };
+    const int step = 40;
+    const int xMin = -1100, yMin = -1100;
+    const int nx = ab::util::gridSize(xMin, 3100, step);
+    const int ny = ab::util::gridSize(yMin, 4100, step);
+
+    std::set<std::pair<int, int>> covered;
+    const ab::util::PolygonRegion region(polygon);
+    const auto nTests = ab::util::coverGrid(region, xMin, yMin, nx, ny, step, [&](int x, int y) {
+        EXPECT_TRUE(covered.emplace(x, y).second) << "Sample visited twice: " << x << ", " << y;
+    });
+
+    const auto expected = bruteForce(polygon, xMin, yMin, nx, ny, step);
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(covered, expected);
+    // Only the boundary should need per-sample tests
+    EXPECT_LT(nTests, static_cast<std::uint64_t>(nx * ny) / 2);
+}
+
+TEST(GridCoverageTests, TestEmptyAndDisjoint) {
+    const ab::GeoPolygon polygon{
+            {0,   0,   0},
+            {100, 0,   0},
+            {100, 100, 0},
+            {0,   100, 0},
+            {0,   0,   0},
+    };
+    const ab::util::PolygonRegion region(polygon);
+    int visited = 0;
+    ab::util::coverGrid(region, 0, 0, 0, 10, 40, [&](int, int) { ++visited; });
+    EXPECT_EQ(visited, 0);
+    ab::util::coverGrid(region, 10000, 10000, 50, 50, 40, [&](int, int) { ++visited; });
+    EXPECT_EQ(visited, 0);
+    EXPECT_EQ(ab::util::gridSize(0, 100, 40), 3);
+    EXPECT_EQ(ab::util::gridSize(100, 0, 40), 0);
+}
+
+TEST(GridCoverageTests, TestLargeGrid) {
+    // Over 2^31 samples, so the block sizes and corners only fit in 64 bits
+    const int nx = 50000, ny = 50000;
+    ASSERT_GT(static_cast<std::int64_t>(nx) * ny, std::numeric_limits<std::int32_t>::max());
+    const std::vector<ab::Position> centreline{
+            {0,   0, 100},
+            {200, 0, 100},
+    };
+    const ab::util::CapsuleRegion capsule(centreline, 50);
+    std::uint64_t visited = 0;
+    const auto nTests = ab::util::coverGrid(capsule, 0, 0, nx, ny, 1, [&](int x, int y) {
+        ++visited;
+        EXPECT_TRUE(capsule.contains(x, y));
+    });
+    // The quadtree splits down to the capsule rather than testing the grid sample by sample
+    EXPECT_GT(visited, 0u);
+    EXPECT_LT(nTests, 100000u);
+    EXPECT_EQ(ab::util::gridSize(-1500000000, 1500000000, 40), 75000000);
+}
+
+TEST(GridCoverageTests, TestCapsuleRegion) {
+    const std::vector<ab::Position> centreline{
+            {0,    0,    100},
+            {2000, 0,    100},
+            {2000, 1500, 200},
+    };
+    const ab::util::CapsuleRegion capsule(centreline, 300);
+    EXPECT_TRUE(capsule.contains(1000.0, 299.0));
+    EXPECT_FALSE(capsule.contains(1000.0, 301.0));
+    // Rounded caps at the ends and the outside of the corner
+    EXPECT_TRUE(capsule.contains(-200.0, 200.0));
+    EXPECT_FALSE(capsule.contains(-250.0, 250.0));
+    EXPECT_TRUE(capsule.contains(2200.0, -200.0));
+    EXPECT_NEAR(std::sqrt(capsule.distanceSquared(1000, 1000)), 1000, 1e-9);
+
+    const auto bounds = capsule.bounds();
+    EXPECT_DOUBLE_EQ(bounds[0], -300);
+    EXPECT_DOUBLE_EQ(bounds[1], -300);
+    EXPECT_DOUBLE_EQ(bounds[2], 2300);
+    EXPECT_DOUBLE_EQ(bounds[3], 1800);
+
+    const int step = 40;
+    const int xMin = static_cast<int>(bounds[0]), yMin = static_cast<int>(bounds[1]);
+    const int nx = ab::util::gridSize(xMin, static_cast<int>(bounds[2] + 1), step);
+    const int ny = ab::util::gridSize(yMin, static_cast<int>(bounds[3] + 1), step);
+    std::set<std::pair<int, int>> covered;
+    ab::util::coverGrid(capsule, xMin, yMin, nx, ny, step, [&](int x, int y) {
+        covered.emplace(x, y);
+    });
+    std::set<std::pair<int, int>> expected;
+    for (int i = 0; i < nx; ++i) {
+        for (int j = 0; j < ny; ++j) {
+            if (capsule.contains(xMin + i * step, yMin + j * step)) expected.emplace(xMin + i * step, yMin + j * step);
+        }
+    }
+    EXPECT_EQ(covered, expected);
+}
@@ -1,11 +1,34 @@
 #include <gtest/gtest.h>
 #include "airspacebookingutils/library.h"
 #include <h3/h3api.h>
+#include "TestFixtures.h"
+
+using namespace ab::test;
 
 TEST(H3IndexTests, GeoToH3Tests) {
     ASSERT_EQ("8919591565bffff", ab::geoToH3(9, 50.90768760, -1.39200210));
 }
 
+TEST(H3IndexTests, GeoToH3ScanRowTests) {
+    // Rows of closely spaced coordinates reuse cells, and must still match a full lookup everywhere,
+    // including around a pentagon, where the row crosses several icosahedron faces
+    const std::vector<std::pair<double, double>> rowStarts{{50.9, -1.45}, {50.9003, -1.45}, {64.7, 10.5},
+                                                           {58.0, -35.0}};
+    for (int res = 8; res <= 12; ++res) {
+        for (const auto &[lat, lng]: rowStarts) {
+            for (int i = 0; i < 3000; ++i) {
+                const double sampleLng = lng + i * 3e-5;
+                const LatLng latLng{lat * M_PI / 180, sampleLng * M_PI / 180};
+                H3Index cell;
+                latLngToCell(&latLng, res, &cell);
+                char expected[17];
+                h3ToString(cell, expected, sizeof(expected));
+                ASSERT_EQ(expected, ab::geoToH3(res, lat, sampleLng)) << res << " " << lat << " " << sampleLng;
+            }
+        }
+    }
+}
+
 TEST(H3IndexTests, H3ToGeoTests) {
     LatLng latLng;
     H3Index out;
@@ -13,4 +36,102 @@ TEST(H3IndexTests, H3ToGeoTests) {
     cellToLatLng(out, &latLng);
     ASSERT_NEAR(50.90768760, latLng.lat * 180 / M_PI, 1e-2);
     ASSERT_NEAR(-1.39200210, latLng.lng * 180 / M_PI, 1e-2);
-}
\ No newline at end of file
+}
+
+TEST(H3IndexTests, CompactCellBookingsTests) {
+    H3Index parent;
+    stringToH3("8819591565fffff", &parent);
+    int64_t nChildren;
+    cellToChildrenSize(parent, 9, &nChildren);
+    std::vector<H3Index> children(nChildren);
+    cellToChildren(parent, 9, children.data());
+
+    const ab::d4::TimeSlice slice1(ab::d4::TimeInstant{}, ab::d4::TimeInstant{} + std::chrono::minutes(5));
+    const ab::d4::TimeSlice slice2(ab::d4::TimeInstant{}, ab::d4::TimeInstant{} + std::chrono::minutes(10));
+    std::vector<ab::CellBooking> bookings;
+    char h3Str[20];
+    for (const auto &child: children) {
+        h3ToString(child, h3Str, 20);
+        bookings.emplace_back(slice1, h3Str);
+    }
+    // A sibling set spread over different time slices cannot be compacted
+    bookings.back().timeSlice = slice2;
+
+    const auto compacted = ab::compactCellBookings(bookings, ab::IndexSystem::H3);
+    ASSERT_EQ(bookings.size(), compacted.size());
+
+    bookings.back().timeSlice = slice1;
+    bookings.emplace_back(slice2, "8919591565bffff");
+    const auto compactedParent = ab::compactCellBookings(bookings, ab::IndexSystem::H3);
+    ASSERT_EQ(2, compactedParent.size());
+    EXPECT_EQ("8819591565fffff", compactedParent[0].cellId);
+    EXPECT_EQ(slice1.end, compactedParent[0].timeSlice.end);
+    EXPECT_EQ("8919591565bffff", compactedParent[1].cellId);
+
+    // H3D cells compact within each layer
+    std::vector<ab::CellBooking> h3dBookings;
+    for (const auto &booking: bookings) {
+        if (booking.timeSlice.end != slice1.end) continue;
+        for (const auto &layer: {"01", "02"}) {
+            h3dBookings.emplace_back(booking.timeSlice, booking.cellId.substr(0, booking.cellId.length() - 2) + layer);
+        }
+    }
+    const auto compactedH3D = ab::compactCellBookings(h3dBookings, ab::IndexSystem::H3D);
+    ASSERT_EQ(2, compactedH3D.size());
+    EXPECT_EQ("8819591565fff01", compactedH3D[0].cellId);
+    EXPECT_EQ("8819591565fff02", compactedH3D[1].cellId);
+}
+
+TEST(H3IndexTests, CoalesceCellBookingsTests) {
+    using namespace std::chrono;
+    const std::vector<ab::CellBooking> bookings{
+            {ab::d4::TimeSlice(t0, t0 + seconds(60)),                "8919591565bffff"},
+            // Revisited 10 s after leaving
+            {ab::d4::TimeSlice(t0 + seconds(70), t0 + seconds(130)),  "8919591565bffff"},
+            // Contained in the previous time slice
+            {ab::d4::TimeSlice(t0 + seconds(80), t0 + seconds(90)),   "8919591565bffff"},
+            {ab::d4::TimeSlice(t0 + seconds(200), t0 + seconds(260)), "8919591565bffff"},
+            {ab::d4::TimeSlice(t0 + seconds(61), t0 + seconds(62)),   "8919591564bffff"}};
+
+    const auto overlapping = ab::coalesceCellBookings(bookings, seconds(0));
+    EXPECT_EQ(4, overlapping.size());
+
+    const auto coalesced = ab::coalesceCellBookings(bookings, seconds(10));
+    ASSERT_EQ(3, coalesced.size());
+    EXPECT_EQ(t0, coalesced[0].timeSlice.start);
+    EXPECT_EQ(t0 + seconds(130), coalesced[0].timeSlice.end);
+    EXPECT_EQ("8919591564bffff", coalesced[1].cellId);
+
+    EXPECT_EQ(2, ab::coalesceCellBookings(bookings, seconds(70)).size());
+    // Joins stop at the longest slice length
+    const auto capped = ab::coalesceCellBookings(bookings, seconds(70), seconds(200));
+    ASSERT_EQ(3, capped.size());
+    EXPECT_EQ(t0 + seconds(130), capped[0].timeSlice.end);
+
+    EXPECT_THROW(ab::coalesceCellBookings(bookings, seconds(-1)), std::invalid_argument);
+}
+
+TEST(H3IndexTests, MergeVerticalLayersTests) {
+    using namespace std::chrono;
+    const ab::d4::TimeSlice slice1(t0, t0 + seconds(60)), slice2(t0 + seconds(60), t0 + seconds(120));
+    std::vector<ab::CellBooking> bookings;
+    for (const auto &layer: {"09", "0a", "0b", "0d"}) {
+        bookings.emplace_back(slice1, std::string("8919591565bff") + layer);
+    }
+    bookings.emplace_back(slice2, "8919591565bff0c");
+
+    const auto spans = ab::mergeVerticalLayers(bookings);
+    ASSERT_EQ(3, spans.size());
+    EXPECT_EQ("8919591565bff09", spans[0].cellId);
+    EXPECT_EQ(3, spans[0].layers);
+    EXPECT_EQ("8919591565bff0d", spans[1].cellId);
+    EXPECT_EQ(1, spans[1].layers);
+    EXPECT_EQ(slice2.start, spans[2].timeSlice.start);
+
+    const auto expanded = ab::expandVerticalLayers(spans);
+    ASSERT_EQ(bookings.size(), expanded.size());
+    for (std::size_t i = 0; i < bookings.size(); ++i) {
+        EXPECT_EQ(bookings[i].cellId, expanded[i].cellId);
+    }
+    EXPECT_THROW(ab::mergeVerticalLayers({{slice1, "8919591565bffzz"}}), std::invalid_argument);
+}
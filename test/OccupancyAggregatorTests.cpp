@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <set>
+#include "airspacebookingutils/OccupancyAggregator.h"
+#include "TestFixtures.h"
+
+using namespace std::chrono;
+using namespace ab::test;
+
+TEST(OccupancyAggregatorTests, TestHistogramAndPeak) {
+    const auto cell = ab::geoToH3(10, 50.90, -1.40);
+    ab::OccupancyAggregator aggregator(minutes(15), t0);
+    aggregator.add(1, {booking(cell, 0, 20)});
+    aggregator.add(2, {booking(cell, 10, 40)});
+    // Touches the first without overlapping it
+    aggregator.add(3, {booking(cell, 20, 25)});
+    // Streamed in a later batch
+    aggregator.add(4, {booking(cell, 12, 18), booking(ab::geoToH3(10, 51.0, -1.0), 0, 5)});
+    EXPECT_EQ(5, aggregator.size());
+    EXPECT_EQ(2, aggregator.cellCount());
+
+    const auto occupancy = aggregator.occupancy();
+    ASSERT_EQ(2, occupancy.size());
+    EXPECT_TRUE(occupancy[0].cellId < occupancy[1].cellId);
+    const auto &result = occupancy[0].cellId == cell ? occupancy[0] : occupancy[1];
+    EXPECT_EQ(4, result.operations);
+    EXPECT_EQ(t0, result.firstBucket);
+    EXPECT_EQ(std::vector<std::uint32_t>({3, 4, 1}), result.histogram);
+    EXPECT_EQ(3, result.peakConcurrency);
+    EXPECT_EQ(t0 + minutes(12), result.peak.start);
+    EXPECT_EQ(t0 + minutes(18), result.peak.end);
+
+    aggregator.clear();
+    EXPECT_TRUE(aggregator.occupancy().empty());
+    EXPECT_THROW(ab::OccupancyAggregator(minutes(0)), std::invalid_argument);
+}
+
+TEST(OccupancyAggregatorTests, TestJoinsOperationSlices) {
+    const auto cell = ab::geoToH3(10, 50.90, -1.40);
+    ab::OccupancyAggregator aggregator(minutes(10), t0 + minutes(5));
+    aggregator.add(1, {booking(cell, 0, 10), booking(cell, 10, 20)});
+    aggregator.add(1, {booking(cell, 15, 30), booking(cell, 40, 40)});
+    aggregator.add(2, {booking(cell, -8, 2)});
+
+    const auto occupancy = aggregator.occupancy();
+    ASSERT_EQ(1, occupancy.size());
+    EXPECT_EQ(2, occupancy[0].operations);
+    // Buckets are aligned to the origin, before it too
+    EXPECT_EQ(t0 - minutes(15), occupancy[0].firstBucket);
+    EXPECT_EQ(std::vector<std::uint32_t>({1, 2, 1, 1, 1}), occupancy[0].histogram);
+    EXPECT_EQ(2, occupancy[0].peakConcurrency);
+    EXPECT_EQ(t0, occupancy[0].peak.start);
+    EXPECT_EQ(t0 + minutes(2), occupancy[0].peak.end);
+}
+
+TEST(OccupancyAggregatorTests, TestOperationReturning) {
+    const auto cell = ab::geoToH3(10, 50.90, -1.40);
+    ab::OccupancyAggregator aggregator(minutes(15), t0);
+    // Leaves and comes back within a bucket, then again across buckets
+    aggregator.add(1, {booking(cell, 0, 3), booking(cell, 5, 8), booking(cell, 10, 20), booking(cell, 25, 40)});
+    aggregator.add(2, {booking(cell, 20, 22)});
+
+    const auto occupancy = aggregator.occupancy();
+    ASSERT_EQ(1, occupancy.size());
+    EXPECT_EQ(2, occupancy[0].operations);
+    EXPECT_EQ(std::vector<std::uint32_t>({1, 2, 1}), occupancy[0].histogram);
+    // Operation 2 only occupies the cell while operation 1 is away
+    EXPECT_EQ(1, occupancy[0].peakConcurrency);
+
+    // Children visited with a gap between them occupy their parent once
+    const auto parent = ab::geoToH3(7, 50.90, -1.40);
+    aggregator.clear();
+    aggregator.add(1, {booking(ab::geoToH3(9, 50.90, -1.400), 0, 3), booking(ab::geoToH3(9, 50.90, -1.406), 5, 8)});
+    const auto rolledUp = aggregator.rollup(ab::IndexSystem::H3, 7);
+    ASSERT_EQ(1, rolledUp.size());
+    EXPECT_EQ(parent, rolledUp[0].cellId);
+    EXPECT_EQ(1, rolledUp[0].operations);
+    EXPECT_EQ(std::vector<std::uint32_t>({1}), rolledUp[0].histogram);
+}
+
+TEST(OccupancyAggregatorTests, TestRollup) {
+    const auto parent = ab::geoToH3(7, 50.90, -1.40);
+    std::vector<std::string> children;
+    for (const auto lng: {-1.400, -1.403, -1.406, -1.409}) {
+        const auto child = ab::geoToH3(9, 50.90, lng);
+        ASSERT_EQ(parent, ab::parentCell(child, ab::IndexSystem::H3, 7));
+        children.push_back(child);
+    }
+    ASSERT_EQ(4, std::set<std::string>(children.begin(), children.end()).size());
+
+    ab::OccupancyAggregator aggregator(minutes(15), t0);
+    // Crossing the children one after the other occupies the parent once
+    aggregator.add(1, {booking(children[0], 0, 6), booking(children[1], 5, 11), booking(children[2], 10, 16)});
+    aggregator.add(2, {booking(children[3], 0, 30)});
+    aggregator.add(3, {booking(ab::geoToH3(9, 52.0, 0.5), 0, 30)});
+
+    const auto rolledUp = aggregator.rollup(ab::IndexSystem::H3, 7);
+    ASSERT_EQ(2, rolledUp.size());
+    const auto &result = rolledUp[0].cellId == parent ? rolledUp[0] : rolledUp[1];
+    EXPECT_EQ(parent, result.cellId);
+    EXPECT_EQ(2, result.operations);
+    EXPECT_EQ(2, result.peakConcurrency);
+    EXPECT_EQ(std::vector<std::uint32_t>({2, 2}), result.histogram);
+    // The cells themselves are unchanged
+    EXPECT_EQ(5, aggregator.occupancy().size());
+
+    EXPECT_THROW(aggregator.rollup(ab::IndexSystem::H3, 10), std::invalid_argument);
+    EXPECT_THROW(aggregator.rollup(ab::IndexSystem::S23D, 7), std::invalid_argument);
+    EXPECT_THROW(ab::parentCell("zz", ab::IndexSystem::H3, 5), std::invalid_argument);
+    EXPECT_EQ(parent, ab::parentCell(parent, ab::IndexSystem::H3, 7));
+    const auto h3dCell = ab::geoToH3D(10, 30, 50.90, -1.40, 95);
+    EXPECT_EQ(parent.substr(0, parent.length() - 2) + "03", ab::parentCell(h3dCell, ab::IndexSystem::H3D, 7));
+}
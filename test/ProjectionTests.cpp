@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <proj.h>
 #include "airspacebookingutils/util/GeometryProjectionUtils.h"
+#include "airspacebookingutils/util/LocalProjection.h"
 #include "airspacebookingutils/library.h"
 
 const std::vector<ab::Position> test_positions{
@@ -34,3 +35,35 @@ TEST(ProjectionTests, TestEckertVIProjection) {
         EXPECT_NEAR(pos.z(), unprojected.xyz.z, 0.1);
     }
 }
+
+TEST(ProjectionTests, TestLocalProjectionRoundTrip) {
+    const auto projection = ab::util::LocalProjection::centredOn(test_positions);
+    for (const auto &pos: test_positions) {
+        const auto projected = projection.forward(pos);
+        const auto unprojected = projection.inverse(projected);
+        EXPECT_NEAR(pos.x(), unprojected.x(), 1e-9);
+        EXPECT_NEAR(pos.y(), unprojected.y(), 1e-9);
+        EXPECT_EQ(pos.z(), unprojected.z());
+    }
+}
+
+TEST(ProjectionTests, TestLocalProjectionDistances) {
+    // A drone scale extent around Southampton
+    const ab::Position origin{-1.391015, 50.905473, 0};
+    const ab::util::LocalProjection projection(origin.x(), origin.y());
+    EXPECT_NEAR(0, projection.forward(origin).norm(), 1e-6);
+    for (const auto &offset: std::vector<ab::Position>{{0.1,  0,     0},
+                                                       {0,    0.1,   0},
+                                                       {-0.2, 0.15,  0},
+                                                       {0.05, -0.25, 0}}) {
+        const ab::Position pos = origin + offset;
+        const auto projected = projection.forward(pos);
+        // Distances from the origin are preserved exactly on the sphere
+        EXPECT_NEAR(ab::util::haversineDistance(origin, pos), projected.head<2>().norm(), 1e-3);
+    }
+    // Distances between points away from the origin are preserved well within a meter
+    const ab::Position p0 = origin + ab::Position{0.1, 0.1, 0};
+    const ab::Position p1 = origin + ab::Position{0.12, 0.11, 0};
+    const auto projectedDistance = (projection.forward(p1) - projection.forward(p0)).head<2>().norm();
+    EXPECT_NEAR(ab::util::haversineDistance(p0, p1), projectedDistance, 0.5);
+}
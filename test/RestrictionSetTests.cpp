@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include "airspacebookingutils/RestrictionSet.h"
+#include "TestFixtures.h"
+
+using namespace std::chrono;
+using namespace ab::test;
+
+class RestrictionSetTests : public ::testing::Test {
+protected:
+    // Around Southampton Central station
+    const ab::GeoPolygon station{{-1.4160, 50.9060, 0}, {-1.4100, 50.9060, 0}, {-1.4100, 50.9090, 0},
+                                 {-1.4160, 50.9090, 0}, {-1.4160, 50.9060, 0}};
+    // Around Southampton Airport, about 6 km away
+    const ab::GeoPolygon airport{{-1.3620, 50.9480, 0}, {-1.3520, 50.9480, 0}, {-1.3520, 50.9560, 0},
+                                 {-1.3620, 50.9560, 0}, {-1.3620, 50.9480, 0}};
+    const ab::ResolutionSpec h3{ab::IndexSystem::H3, 10};
+    const std::string path = ::testing::TempDir() + "restrictions.abrs";
+
+    void TearDown() override {
+        std::remove(path.c_str());
+    }
+
+    std::vector<ab::CellBooking> stationBookings(ab::d4::TimeInstant start) const {
+        return ab::getH3VolumeBookings(ab::d4::Volume4D(station, 0, 120, {start, start + minutes(10)}), 10);
+    }
+};
+
+TEST_F(RestrictionSetTests, TestPermanentRestrictions) {
+    const auto restrictions = ab::RestrictionSet::compile({airport, station}, 0, 120, {h3});
+    EXPECT_GT(restrictions.cellCount(h3), 0);
+
+    const auto bookings = stationBookings(t0);
+    EXPECT_TRUE(restrictions.touches(bookings, h3));
+    EXPECT_EQ(std::vector<std::size_t>{1}, restrictions.touchedRestrictions(bookings, h3));
+    // Cells outside of every restriction
+    EXPECT_FALSE(restrictions.touches({ab::CellBooking({t0, t0 + minutes(10)}, ab::geoToH3(10, 50.93, -1.45))},
+                                      h3));
+    EXPECT_THROW(restrictions.touches(bookings, ab::ResolutionSpec(ab::IndexSystem::H3, 9)), std::invalid_argument);
+}
+
+TEST_F(RestrictionSetTests, TestTimeValidity) {
+    const auto restrictions = ab::RestrictionSet::compile(
+            {ab::d4::Volume4D(station, 0, 120, {t0, t0 + hours(1)})}, {h3});
+    EXPECT_TRUE(restrictions.touches(stationBookings(t0 + minutes(30)), h3));
+    // Ending as the restriction starts, or starting as it ends, does not touch it
+    EXPECT_FALSE(restrictions.touches(stationBookings(t0 - minutes(10)), h3));
+    EXPECT_FALSE(restrictions.touches(stationBookings(t0 + hours(1)), h3));
+}
+
+TEST_F(RestrictionSetTests, TestSaveAndOpen) {
+    const std::vector<ab::ResolutionSpec> resolutions{h3, {ab::IndexSystem::H3D, 10, 40}};
+    const auto compiled = ab::RestrictionSet::compile({airport, station}, 0, 120, resolutions);
+    compiled.save(path);
+
+    const auto opened = ab::RestrictionSet::open(path);
+    ASSERT_EQ(2, opened.resolutions().size());
+    EXPECT_EQ(ab::IndexSystem::H3D, opened.resolutions()[1].indexSystem);
+    EXPECT_EQ(40, opened.resolutions()[1].verticalResolution);
+    for (const auto &resolution: resolutions) {
+        EXPECT_EQ(compiled.cellCount(resolution), opened.cellCount(resolution));
+    }
+    const auto bookings = stationBookings(t0);
+    EXPECT_EQ(compiled.touchedRestrictions(bookings, h3), opened.touchedRestrictions(bookings, h3));
+}
+
+TEST_F(RestrictionSetTests, TestOpenInvalidFile) {
+    EXPECT_THROW(ab::RestrictionSet::open(path), std::runtime_error);
+    std::ofstream(path) << "not a restriction set";
+    EXPECT_THROW(ab::RestrictionSet::open(path), std::runtime_error);
+}
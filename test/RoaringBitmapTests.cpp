@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include "airspacebookingutils/util/RoaringBitmap.h"
+
+namespace {
+    /**
+     * @brief A bitmap of values and the same values in a set, spanning sparse and dense containers
+     */
+    std::pair<ab::util::RoaringBitmap, std::set<std::uint32_t>> randomSet(std::mt19937 &rng, std::size_t dense) {
+        ab::util::RoaringBitmap bitmap;
+        std::set<std::uint32_t> values;
+        const auto insert = [&](std::uint32_t value) {
+            EXPECT_EQ(values.insert(value).second, bitmap.add(value));
+        };
+        // Dense in the first container, sparse in the others
+        for (std::size_t i = 0; i < dense; ++i) {
+            insert(rng() % 65536);
+        }
+        for (int i = 0; i < 500; ++i) {
+            insert(65536 + rng() % (1u << 20));
+        }
+        return {bitmap, values};
+    }
+
+    std::vector<std::uint32_t> combined(const std::set<std::uint32_t> &a, const std::set<std::uint32_t> &b, char op) {
+        std::vector<std::uint32_t> result;
+        if (op == '|') std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+        if (op == '&') std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+        if (op == '-') std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+        return result;
+    }
+}
+
+TEST(RoaringBitmapTests, TestAddRemove) {
+    ab::util::RoaringBitmap bitmap;
+    EXPECT_TRUE(bitmap.empty());
+    EXPECT_TRUE(bitmap.add(7));
+    EXPECT_FALSE(bitmap.add(7));
+    EXPECT_TRUE(bitmap.add(0xFFFFFFFF));
+    EXPECT_TRUE(bitmap.contains(7));
+    EXPECT_FALSE(bitmap.contains(8));
+    EXPECT_EQ(std::vector<std::uint32_t>({7, 0xFFFFFFFF}), bitmap.values());
+
+    // Switches to a bitmap container past the array limit and back below it
+    for (std::uint32_t v = 0; v < 10000; v += 2) {
+        bitmap.add(v);
+    }
+    EXPECT_EQ(5002, bitmap.cardinality());
+    // A bitmap container takes 8 KiB
+    EXPECT_LT(bitmap.bytes(), 9 * 1024);
+    for (std::uint32_t v = 0; v < 10000; v += 4) {
+        EXPECT_TRUE(bitmap.remove(v));
+    }
+    EXPECT_FALSE(bitmap.remove(0));
+    EXPECT_EQ(2502, bitmap.cardinality());
+    EXPECT_TRUE(bitmap.contains(6));
+    EXPECT_FALSE(bitmap.contains(8));
+    EXPECT_TRUE(bitmap.remove(0xFFFFFFFF));
+    EXPECT_EQ(2501, bitmap.cardinality());
+}
+
+TEST(RoaringBitmapTests, TestSetOperations) {
+    std::mt19937 rng(11);
+    for (const auto &[denseA, denseB]: {std::pair<int, int>{100, 200}, {20000, 300}, {300, 20000}, {30000, 40000}}) {
+        const auto [a, aValues] = randomSet(rng, denseA);
+        const auto [b, bValues] = randomSet(rng, denseB);
+        EXPECT_EQ(combined(aValues, bValues, '|'), (a | b).values());
+        EXPECT_EQ(combined(aValues, bValues, '&'), (a & b).values());
+        EXPECT_EQ(combined(aValues, bValues, '-'), (a - b).values());
+        EXPECT_EQ((a & b).values().size(), (a & b).cardinality());
+
+        auto c = a;
+        c |= b;
+        c -= b;
+        EXPECT_EQ(a - b, c);
+        c &= a;
+        EXPECT_EQ(a - b, c);
+    }
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <set>
+#include "airspacebookingutils/RouteSearch.h"
+#include "airspacebookingutils/util/LocalProjection.h"
+#include "TestFixtures.h"
+
+using namespace std::chrono;
+using namespace ab::test;
+
+class RouteSearchTests : public ::testing::Test {
+protected:
+    // About 2.3 km apart in Southampton
+    const ab::Position origin{-1.4040, 50.9090, 60};
+    const ab::Position destination{-1.3720, 50.9090, 60};
+    ab::BookingStore store;
+    ab::RouteSearchOptions options;
+
+    void SetUp() override {
+        options.temporalBackwardBuffer = 0;
+        options.temporalForwardBuffer = 0;
+    }
+
+    // The cells of the search at an altitude within a radius of a (lon, lat, alt) position
+    std::set<std::string> cellsWithin(const ab::Position &centre, ab::FPScalar radius) const {
+        const ab::util::LocalProjection projection(centre.x(), centre.y());
+        std::set<std::string> cells;
+        for (ab::FPScalar x = -radius; x <= radius; x += 5) {
+            for (ab::FPScalar y = -radius; y <= radius; y += 5) {
+                if (x * x + y * y > radius * radius) continue;
+                const auto p = projection.inverse(x, y, centre.z());
+                cells.insert(*routeCells({ab::d4::StateVector4D(p, t0, 0)}).begin());
+            }
+        }
+        return cells;
+    }
+
+    std::set<std::string> routeCells(const std::vector<ab::d4::StateVector4D> &route) const {
+        std::set<std::string> cells;
+        for (const auto &sv: route) {
+            cells.insert(options.indexSystem == ab::IndexSystem::H3D
+                         ? ab::geoToH3D(options.h3Resolution, options.verticalResolution, sv.position.y(),
+                                        sv.position.x(), sv.position.z())
+                         : ab::geoToH3(options.h3Resolution, sv.position.y(), sv.position.x()));
+        }
+        return cells;
+    }
+};
+
+TEST_F(RouteSearchTests, TestFreeAirspace) {
+    const auto route = ab::findFreeRoute(store, origin, destination, t0, options);
+    ASSERT_TRUE(route.has_value());
+    ASSERT_GE(route->size(), 2);
+    EXPECT_EQ(ab::geoToH3(options.h3Resolution, origin.y(), origin.x()),
+              ab::geoToH3(options.h3Resolution, route->front().position.y(), route->front().position.x()));
+    EXPECT_EQ(ab::geoToH3(options.h3Resolution, destination.y(), destination.x()),
+              ab::geoToH3(options.h3Resolution, route->back().position.y(), route->back().position.x()));
+    EXPECT_EQ(t0, route->front().time);
+    for (std::size_t i = 1; i < route->size(); ++i) {
+        EXPECT_LT((*route)[i - 1].time, (*route)[i].time);
+        EXPECT_EQ(60, (*route)[i].position.z());
+    }
+    // Close to flying straight at 15 m/s
+    const auto flightTime = duration<double>(route->back().time - route->front().time).count();
+    EXPECT_GT(flightTime, 2200 / 15.0);
+    EXPECT_LT(flightTime, 1.2 * 2300 / 15.0);
+}
+
+TEST_F(RouteSearchTests, TestAvoidsBookedCells) {
+    const auto direct = ab::findFreeRoute(store, origin, destination, t0, options);
+    ASSERT_TRUE(direct.has_value());
+    for (const auto &cell: cellsWithin({-1.3880, 50.9090, 60}, 300)) {
+        store.add(1, {ab::CellBooking(ab::d4::TimeSlice(t0 - hours(1), t0 + hours(24)), cell)});
+    }
+
+    const auto route = ab::findFreeRoute(store, origin, destination, t0, options);
+    ASSERT_TRUE(route.has_value());
+    for (const auto &cell: routeCells(*route)) {
+        EXPECT_TRUE(store.reservedSlices(cell, t0, t0 + hours(1)).empty()) << cell;
+    }
+    EXPECT_GT(route->back().time, direct->back().time);
+}
+
+TEST_F(RouteSearchTests, TestWaitsForBookingToClear) {
+    options.maxHover = 600;
+    const auto destinationCell = ab::geoToH3(options.h3Resolution, destination.y(), destination.x());
+    store.add(1, {ab::CellBooking(ab::d4::TimeSlice(t0, t0 + minutes(10)), destinationCell)});
+
+    const auto route = ab::findFreeRoute(store, origin, destination, t0, options);
+    ASSERT_TRUE(route.has_value());
+    EXPECT_GT(route->back().time, t0 + minutes(10));
+
+    // Without hovering the route can not wait for the destination to clear, as revisiting a cell later in the same
+    // safe interval is never better
+    options.maxHover = 0;
+    options.maxExpansions = 10000;
+    EXPECT_FALSE(ab::findFreeRoute(store, origin, destination, t0, options).has_value());
+}
+
+TEST_F(RouteSearchTests, TestClimbsOverBookedLayer) {
+    options.indexSystem = ab::IndexSystem::H3D;
+    options.minAltitude = 40;
+    options.maxAltitude = 160;
+    // Book the 40 m to 80 m layer for 1 km around the midpoint, which is far shorter to climb over than fly around
+    for (const auto &cell: cellsWithin({-1.3880, 50.9090, 60}, 1000)) {
+        store.add(1, {ab::CellBooking(ab::d4::TimeSlice(t0 - hours(1), t0 + hours(24)), cell)});
+    }
+
+    const auto route = ab::findFreeRoute(store, origin, destination, t0, options);
+    ASSERT_TRUE(route.has_value());
+    EXPECT_EQ(60, route->front().position.z());
+    EXPECT_EQ(60, route->back().position.z());
+    ab::FPScalar maxAltitude = 0;
+    for (const auto &sv: *route) {
+        maxAltitude = std::max(maxAltitude, sv.position.z());
+    }
+    EXPECT_EQ(100, maxAltitude);
+    for (const auto &cell: routeCells(*route)) {
+        EXPECT_TRUE(store.reservedSlices(cell, t0, t0 + hours(1)).empty()) << cell;
+    }
+}
+
+TEST_F(RouteSearchTests, TestOriginBooked) {
+    const auto originCell = ab::geoToH3(options.h3Resolution, origin.y(), origin.x());
+    store.add(1, {ab::CellBooking(ab::d4::TimeSlice(t0 - minutes(1), t0 + minutes(10)), originCell)});
+    EXPECT_FALSE(ab::findFreeRoute(store, origin, destination, t0, options).has_value());
+}
+
+TEST_F(RouteSearchTests, TestUnsupportedIndexSystem) {
+    options.indexSystem = ab::IndexSystem::S2;
+    EXPECT_THROW(ab::findFreeRoute(store, origin, destination, t0, options), std::invalid_argument);
+}
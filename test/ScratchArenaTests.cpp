@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include "airspacebookingutils/util/ScratchArena.h"
+
+namespace {
+    void fill(std::pmr::memory_resource *resource, std::size_t n) {
+        std::pmr::vector<int> values(resource);
+        for (std::size_t i = 0; i < n; ++i) {
+            values.push_back(static_cast<int>(i));
+        }
+    }
+}
+
+TEST(ScratchArenaTests, TestReusesBufferAcrossScopes) {
+    // Run on a fresh thread so earlier arenas on this thread do not count
+    std::thread([] {
+        EXPECT_EQ(0, ab::util::ScratchArena::retainedBytes());
+        {
+            ab::util::ScratchArena arena;
+            fill(arena.resource(), 10000);
+        }
+        const auto retained = ab::util::ScratchArena::retainedBytes();
+        EXPECT_GE(retained, 10000 * sizeof(int));
+
+        // A call of the same size fits in the retained buffer
+        {
+            ab::util::ScratchArena arena;
+            fill(arena.resource(), 10000);
+        }
+        EXPECT_EQ(retained, ab::util::ScratchArena::retainedBytes());
+    }).join();
+}
+
+TEST(ScratchArenaTests, TestNestedArenasAreSeparate) {
+    std::thread([] {
+        ab::util::ScratchArena outer;
+        std::pmr::vector<int> outerValues({1, 2, 3}, outer.resource());
+        {
+            ab::util::ScratchArena inner;
+            EXPECT_NE(outer.resource(), inner.resource());
+            fill(inner.resource(), 10000);
+        }
+        // Only the outermost arena grows the thread's buffer
+        EXPECT_EQ(0, ab::util::ScratchArena::retainedBytes());
+        EXPECT_EQ(std::vector<int>({1, 2, 3}), std::vector<int>(outerValues.begin(), outerValues.end()));
+    }).join();
+}
+
+TEST(ScratchArenaTests, TestRetainedBytesCap) {
+    std::thread([] {
+        // Calls larger than the cap do not grow the buffer
+        {
+            ab::util::ScratchArena arena(1000);
+            fill(arena.resource(), 10000);
+        }
+        EXPECT_EQ(0, ab::util::ScratchArena::retainedBytes());
+
+        {
+            ab::util::ScratchArena arena;
+            fill(arena.resource(), 10000);
+        }
+        EXPECT_GT(ab::util::ScratchArena::retainedBytes(), 0);
+        // A lower cap trims a larger buffer kept by an earlier call
+        {
+            ab::util::ScratchArena arena(1000);
+            fill(arena.resource(), 10);
+        }
+        EXPECT_EQ(0, ab::util::ScratchArena::retainedBytes());
+
+        {
+            ab::util::ScratchArena arena;
+            fill(arena.resource(), 10000);
+        }
+        {
+            ab::util::ScratchArena arena;
+            // Not freed while in use
+            ab::util::ScratchArena::release();
+            EXPECT_GT(ab::util::ScratchArena::retainedBytes(), 0);
+        }
+        ab::util::ScratchArena::release();
+        EXPECT_EQ(0, ab::util::ScratchArena::retainedBytes());
+    }).join();
+}
@@ -0,0 +1,50 @@
+/*
+ * TestFixtures.h
+ *
+ * The epoch, bookings, trajectory and volume shared by the tests.
+ */
+
+#ifndef AB_TESTFIXTURES_H
+#define AB_TESTFIXTURES_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include "airspacebookingutils/library.h"
+
+namespace ab::test {
+
+    // Noon on 1 January 2020 UTC, the time the fixtures are relative to
+    inline const d4::TimeInstant t0 = std::chrono::system_clock::from_time_t(1577880000);
+
+    /**
+     * @brief A booking of a cell over whole minutes from t0
+     */
+    inline CellBooking booking(const std::string &cellId, int startMinute, int endMinute) {
+        return {d4::TimeSlice(t0 + std::chrono::minutes(startMinute), t0 + std::chrono::minutes(endMinute)), cellId};
+    }
+
+    inline CellBooking booking(const std::string &cellId, d4::TimeInstant start, d4::TimeInstant end) {
+        return {d4::TimeSlice(start, end), cellId};
+    }
+
+    /**
+     * @brief A short flight over Southampton from t0
+     */
+    inline std::vector<d4::StateVector4D> trajectory() {
+        using std::chrono::seconds;
+        return {{Position(-1.392002, 50.907688, 100), t0,                 20},
+                {Position(-1.454659, 50.930359, 60),  t0 + seconds(250), 20},
+                {Position(-1.475000, 50.960000, 90),  t0 + seconds(430), 20}};
+    }
+
+    /**
+     * @brief A square of about 2 km sides over Southampton for the 30 minutes from t0
+     */
+    inline d4::Volume4D volume(float ceiling) {
+        return {{Position(-1.40, 50.90, 0), Position(-1.372, 50.90, 0), Position(-1.372, 50.918, 0),
+                 Position(-1.40, 50.918, 0)}, 0, ceiling, d4::TimeSlice(t0, t0 + std::chrono::minutes(30))};
+    }
+}
+
+#endif //AB_TESTFIXTURES_H
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include "airspacebookingutils/library.h"
+#include "airspacebookingutils/util/TrajectorySimplification.h"
+#include "TestFixtures.h"
+
+using namespace std::chrono;
+using namespace ab::test;
+
+namespace {
+    /**
+     * @brief A straight track east at 10 m/s, sampled every second, as (state vectors, projected positions)
+     */
+    std::pair<std::vector<ab::d4::StateVector4D>, std::vector<ab::Position>> straightTrack(int seconds) {
+        std::vector<ab::d4::StateVector4D> trajectory;
+        std::vector<ab::Position> positions;
+        for (int i = 0; i <= seconds; ++i) {
+            positions.emplace_back(10.0 * i, 0, 60);
+            trajectory.emplace_back(positions.back(), t0 + std::chrono::seconds(i), 10);
+        }
+        return {trajectory, positions};
+    }
+}
+
+TEST(TrajectorySimplificationTests, TestStraightTrackKeepsEndpoints) {
+    const auto [trajectory, positions] = straightTrack(60);
+    const auto kept = ab::util::simplifiedTrajectoryIndices(trajectory, positions, {1, 1, 1});
+    EXPECT_EQ(std::vector<std::size_t>({0, 60}), kept);
+
+    const auto simplified = ab::util::simplifiedTrajectory(trajectory, positions, kept);
+    ASSERT_EQ(2, simplified.size());
+    EXPECT_DOUBLE_EQ(10, simplified[0].speed);
+    EXPECT_EQ(t0 + seconds(60), simplified[1].time);
+}
+
+TEST(TrajectorySimplificationTests, TestKeepsDeviations) {
+    auto [trajectory, positions] = straightTrack(60);
+    // A lateral step, a climb and a hover
+    positions[20].y() = 5;
+    trajectory[20].position.y() = 5;
+    positions[40].z() = 70;
+    trajectory[40].position.z() = 70;
+    for (int i = 50; i <= 60; ++i) {
+        trajectory[i].time += seconds(30);
+    }
+
+    // The hover at 50 is covered by flying slowly from 49 to 51
+    EXPECT_EQ(std::vector<std::size_t>({0, 19, 20, 21, 39, 40, 41, 49, 51, 60}),
+              ab::util::simplifiedTrajectoryIndices(trajectory, positions, {2, 2, 5}));
+
+    // Looser tolerances drop them
+    EXPECT_EQ(std::vector<std::size_t>({0, 60}),
+              ab::util::simplifiedTrajectoryIndices(trajectory, positions, {10, 20, 60}));
+}
+
+TEST(TrajectorySimplificationTests, TestBookingsCoverOriginal) {
+    std::mt19937 rng(7);
+    std::normal_distribution<double> noise(0, 1);
+    std::vector<ab::d4::StateVector4D> trajectory;
+    double lon = -1.40, lat = 50.90, alt = 60, heading = 0.5;
+    for (int i = 0; i < 300; ++i) {
+        heading += 0.01 * noise(rng) + (i > 150 ? 0.02 : 0);
+        lon += (15 * std::sin(heading) + 0.3 * noise(rng)) / 70000;
+        lat += (15 * std::cos(heading) + 0.3 * noise(rng)) / 111000;
+        alt += 0.5 * noise(rng);
+        trajectory.emplace_back(ab::Position(lon, lat, alt), t0 + seconds(i), 15 + 0.2 * noise(rng));
+    }
+    ab::BookingOptions options;
+    options.simplifyTolerance = 0.2;
+    options.stats = std::make_shared<ab::BookingStats>();
+
+    for (const bool is3D: {false, true}) {
+        const auto original = is3D ? ab::getH3DCellBookings(trajectory, 300, 600, 100, 30, 11, 40)
+                                   : ab::getH3CellBookings(trajectory, 300, 600, 100, 30, 11);
+        const auto simplified = is3D ? ab::getH3DCellBookings(trajectory, 300, 600, 100, 30, 11, 40, options)
+                                     : ab::getH3CellBookings(trajectory, 300, 600, 100, 30, 11, options);
+        std::map<std::string, std::vector<ab::d4::TimeSlice>> simplifiedSlices;
+        for (const auto &booking: simplified) {
+            simplifiedSlices[booking.cellId].push_back(booking.timeSlice);
+        }
+        for (const auto &booking: original) {
+            const auto &slices = simplifiedSlices[booking.cellId];
+            EXPECT_TRUE(std::any_of(slices.begin(), slices.end(), [&](const ab::d4::TimeSlice &slice) {
+                return slice.start <= booking.timeSlice.start && slice.end >= booking.timeSlice.end;
+            })) << booking.cellId;
+        }
+    }
+    EXPECT_GT(options.stats->simplifiedPoints, 2 * 250);
+}
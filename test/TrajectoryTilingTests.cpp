@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <map>
+#include "airspacebookingutils/library.h"
+#include "airspacebookingutils/util/TrajectoryTiling.h"
+#include "TestFixtures.h"
+
+using namespace std::chrono;
+using namespace ab::test;
+
+namespace {
+    /**
+     * @brief A route from Heathrow to Frankfurt at 200 m/s, with only its endpoints and one waypoint
+     */
+    std::vector<ab::d4::StateVector4D> longHaul() {
+        const ab::Position london(-0.45, 51.47, 3000), brussels(4.48, 50.90, 3000), frankfurt(8.57, 50.04, 3000);
+        const auto firstLeg = ab::util::haversineDistance(london, brussels);
+        const auto secondLeg = ab::util::haversineDistance(brussels, frankfurt);
+        const auto arrival = t0 + seconds(static_cast<int>(firstLeg / 200));
+        return {{london,    t0,                                                     200},
+                {brussels,  arrival,                                                200},
+                {frankfurt, arrival + seconds(static_cast<int>(secondLeg / 200)), 200}};
+    }
+}
+
+TEST(TrajectoryTilingTests, TestTilesWithinReach) {
+    const auto trajectory = longHaul();
+    const auto tiles = ab::util::trajectoryTiles(trajectory, 50e3);
+    ASSERT_GT(tiles.size(), 10);
+
+    EXPECT_EQ(trajectory.front().time, tiles.front().trajectory.front().time);
+    EXPECT_EQ(trajectory.back().time, tiles.back().trajectory.back().time);
+    for (std::size_t t = 0; t < tiles.size(); ++t) {
+        const auto &tile = tiles[t];
+        ASSERT_GE(tile.trajectory.size(), 2);
+        for (const auto &sv: tile.trajectory) {
+            EXPECT_LE(ab::util::haversineDistance(tile.origin, sv.position), 50e3);
+        }
+        // Tiles share the state vector at their seam
+        if (t > 0) {
+            EXPECT_EQ(tiles[t - 1].trajectory.back().time, tile.trajectory.front().time);
+            EXPECT_EQ(tiles[t - 1].trajectory.back().position, tile.trajectory.front().position);
+        }
+    }
+
+    // Added state vectors are on the great circle and reached at the speed of their segment
+    const auto &added = tiles.front().trajectory[1];
+    const auto fromStart = ab::util::haversineDistance(trajectory[0].position, added.position);
+    const auto toEnd = ab::util::haversineDistance(added.position, trajectory[1].position);
+    EXPECT_NEAR(ab::util::haversineDistance(trajectory[0].position, trajectory[1].position), fromStart + toEnd, 1);
+    EXPECT_NEAR(fromStart / 200, duration<double>(added.time - t0).count(), 1e-3);
+    EXPECT_DOUBLE_EQ(3000, added.position.z());
+}
+
+TEST(TrajectoryTilingTests, TestInvalidReach) {
+    EXPECT_THROW(ab::util::trajectoryTiles(longHaul(), 0), std::invalid_argument);
+    EXPECT_TRUE(ab::util::trajectoryTiles({}, 1e3).empty());
+    EXPECT_EQ(1, ab::util::trajectoryTiles({longHaul().front()}, 1e3).size());
+}
+
+TEST(TrajectoryTilingTests, TestTiledBookingsMergeAtSeams) {
+    const auto trajectory = longHaul();
+    ab::BookingOptions options;
+    options.localProjectionMaxRadius = 50e3;
+    options.stats = std::make_shared<ab::BookingStats>();
+    const auto bookings = ab::getH3CellBookings(trajectory, 60, 120, 500, 30, 8, options);
+    ASSERT_FALSE(bookings.empty());
+    EXPECT_TRUE(std::is_sorted(bookings.begin(), bookings.end(), [](const auto &a, const auto &b) {
+        return a.timeSlice.start < b.timeSlice.start;
+    }));
+
+    // Cells booked by the tiles either side of a seam have a single merged time slice
+    std::map<std::string, std::vector<ab::d4::TimeSlice>> cellSlices;
+    for (const auto &booking: bookings) {
+        cellSlices[booking.cellId].push_back(booking.timeSlice);
+    }
+    for (const auto &[cellId, slices]: cellSlices) {
+        EXPECT_EQ(1, slices.size()) << cellId;
+    }
+
+    // Every tile seam is booked around the time it is reached
+    for (const auto &tile: ab::util::trajectoryTiles(trajectory, 50e3 - 500)) {
+        const auto &seam = tile.trajectory.front();
+        const auto cellId = ab::geoToH3(8, seam.position.y(), seam.position.x());
+        ASSERT_EQ(1, cellSlices.count(cellId)) << cellId;
+        const auto &slice = cellSlices[cellId].front();
+        EXPECT_LE(slice.start, seam.time - seconds(60));
+        EXPECT_GE(slice.end, seam.time + seconds(120));
+    }
+    EXPECT_GT(options.stats->rawBookings, options.stats->mergedBookings);
+}
@@ -93,9 +93,9 @@ def test_h3_cell_booking():
                                         temporal_forward_buffer=temporal_forward_buffer)
 
     # Test correct number of cells
-    assert len(cells_r7) == 5
-    assert len(cells_r8) == 11
-    assert len(cells_r9) == 30
+    assert len(cells_r7) == 4
+    assert len(cells_r8) == 10
+    assert len(cells_r9) == 28
 
     # Test correct timeslice backward buffering
     assert cells_r7[0].time_slice.start == soton1[0].time - datetime.timedelta(seconds=temporal_backward_buffer)
@@ -151,7 +151,7 @@ def test_h3_volume_booking():
     # Test correct number of cells
     assert len(cells_r7) == 7
     assert len(cells_r8) == 24
-    assert len(cells_r9) == 103
+    assert len(cells_r9) == 101
 
     # Test correct timeslice
     for cell in cells_r7:
@@ -185,9 +185,9 @@ def test_h3d_cell_booking():
                                          temporal_forward_buffer=temporal_forward_buffer)
 
     # Test correct number of cells
-    assert len(cells_r7) == 14
-    assert len(cells_r8) == 26
-    assert len(cells_r9) == 62
+    assert len(cells_r7) == 12
+    assert len(cells_r8) == 24
+    assert len(cells_r9) == 59
 
     # Test correct timeslice backward buffering
     assert cells_r7[0].time_slice.start == soton1[0].time - datetime.timedelta(seconds=temporal_backward_buffer)
@@ -236,7 +236,368 @@ def test_h3d_cell_booking():
         assert re.match('.*ff.{2}$', cell.cell_id)
 
 
+def test_booking_stats():
+    pab.reset_process_booking_stats()
+    options = pab.BookingOptions()
+    options.stats = pab.BookingStats()
+
+    cells = pab.get_H3_cell_bookings(soton1, h3_resolution=9, options=options)
+    stats = options.stats
+
+    assert stats.calls == 1
+    assert stats.merged_bookings == len(cells)
+    assert stats.raw_bookings >= stats.merged_bookings
+    assert stats.indexer_calls == stats.raw_bookings
+    assert stats.samples_inside > 0
+    assert stats.total_seconds >= stats.coverage_seconds >= stats.indexer_seconds > 0
+
+    # Uninstrumented calls are not recorded
+    pab.get_H3_cell_bookings(soton1, h3_resolution=9)
+    process_stats = pab.process_booking_stats()
+    assert process_stats.calls == 1
+    assert process_stats.indexer_calls == stats.indexer_calls
+    assert 'ab_booking_calls_total 1' in process_stats.to_prometheus()
+
+
+def test_multi_resolution_booking():
+    resolutions = [pab.ResolutionSpec(pab.IndexSystem.H3, 7), pab.ResolutionSpec(pab.IndexSystem.H3, 9),
+                   pab.ResolutionSpec(pab.IndexSystem.H3D, 9, 40)]
+    cells_r7, cells_r9, cells_h3d_r9 = pab.get_multi_resolution_cell_bookings(soton1, resolutions)
+
+    # The finest resolution is indexed directly
+    single_r9 = pab.get_H3_cell_bookings(soton1, h3_resolution=9)
+    assert {c.cell_id for c in cells_r9} == {c.cell_id for c in single_r9}
+    single_h3d_r9 = pab.get_H3D_cell_bookings(soton1, h3_resolution=9, vertical_resolution=40)
+    assert {c.cell_id for c in cells_h3d_r9} == {c.cell_id for c in single_h3d_r9}
+
+    # Coarser resolutions are the parents of the finest cells
+    assert len(cells_r7) == 5
+    for cell in cells_r7:
+        assert cell.cell_id.endswith('ffffff')
+
+    volume_resolutions = [pab.ResolutionSpec(pab.IndexSystem.S2, 13), pab.ResolutionSpec(pab.IndexSystem.H3, 9)]
+    s2_cells, h3_cells = pab.get_multi_resolution_volume_bookings(soton_vol1, volume_resolutions)
+    assert {c.cell_id for c in s2_cells} == {c.cell_id for c in pab.get_S2_volume_bookings(soton_vol1, 13)}
+    assert len(h3_cells) == 101
+
+
+def test_booking_cache():
+    options = pab.BookingOptions()
+    options.cache = pab.BookingCache()
+    cells = pab.get_H3_cell_bookings(soton1, h3_resolution=9, options=options)
+
+    offset = datetime.timedelta(hours=2)
+    later = [pab.StateVector4D(sv.position, sv.time + offset, sv.speed) for sv in soton1]
+    cached_cells = pab.get_H3_cell_bookings(later, h3_resolution=9, options=options)
+
+    assert options.cache.misses == 1
+    assert options.cache.hits == 1
+    assert len(options.cache) == 1
+    assert [c.cell_id for c in cached_cells] == [c.cell_id for c in cells]
+    for cell, cached_cell in zip(cells, cached_cells):
+        assert cached_cell.time_slice.start == cell.time_slice.start + offset
+        assert cached_cell.time_slice.end == cell.time_slice.end + offset
+
+    # A different resolution is a different entry
+    pab.get_H3_cell_bookings(later, h3_resolution=8, options=options)
+    assert options.cache.misses == 2
+
+
+def test_detect_conflicts():
+    cells = pab.get_H3_cell_bookings(soton1, h3_resolution=9)
+    offset = datetime.timedelta(hours=2)
+    later = [pab.StateVector4D(sv.position, sv.time + offset, sv.speed) for sv in soton1]
+    later_cells = pab.get_H3_cell_bookings(later, h3_resolution=9)
+
+    conflicts = pab.detect_conflicts([cells, cells, later_cells])
+    # The identical operations conflict in every cell, the later one conflicts with neither
+    assert len(conflicts) == len(cells)
+    for conflict in conflicts:
+        assert conflict.first_operation == 0
+        assert conflict.second_operation == 1
+
+
+def test_conflict_candidate_pairs():
+    offset = datetime.timedelta(hours=2)
+    later = [pab.StateVector4D(sv.position, sv.time + offset, sv.speed) for sv in soton1]
+
+    closest = pab.closest_point_of_approach(soton1, soton1)
+    assert closest.distance < 1e-6
+    assert pab.closest_point_of_approach(soton1, later) is None
+    assert pab.conflict_candidate_pairs([soton1, soton1, later], 100, 20) == [(0, 1)]
+
+
+def test_earliest_free_offset():
+    cells = pab.get_H3_cell_bookings(soton1, h3_resolution=9)
+    store = pab.BookingStore()
+    store.add(1, cells)
+    assert len(store) == len(cells)
+    assert not store.is_free(cells)
+
+    # The same flight is free once the first one has cleared every cell
+    last_end = max(c.time_slice.end for c in cells)
+    first_start = min(c.time_slice.start for c in cells)
+    offset = store.earliest_free_offset(cells, datetime.timedelta(0), datetime.timedelta(hours=2))
+    assert datetime.timedelta(0) < offset <= last_end - first_start
+    shifted = [pab.CellBooking(pab.TimeSlice(c.time_slice.start + offset, c.time_slice.end + offset), c.cell_id)
+               for c in cells]
+    assert store.is_free(shifted)
+    assert store.earliest_free_offset(cells, datetime.timedelta(0), datetime.timedelta(seconds=1)) is None
+
+
+def test_find_free_route():
+    store = pab.BookingStore()
+    options = pab.RouteSearchOptions()
+    origin = np.array([-1.4040, 50.9090, 60])
+    destination = np.array([-1.3720, 50.9090, 60])
+    departure = datetime.datetime(2020, 1, 1, 12, 0, 0)
+
+    route = pab.find_free_route(store, origin, destination, departure, options)
+    assert route[0].time == departure
+    assert route[-1].time > route[0].time
+
+    # Booking the middle of the direct route makes the next route take longer
+    store.add(1, pab.get_H3_cell_bookings(route[10:-10], 0, 600, 50, 30, 11))
+    detour = pab.find_free_route(store, origin, destination, departure, options)
+    assert detour[-1].time > route[-1].time
+
+
+def test_restriction_set(tmp_path):
+    footprint = [np.array(p) for p in [[-1.4160, 50.9060, 0], [-1.4100, 50.9060, 0], [-1.4100, 50.9090, 0],
+                                       [-1.4160, 50.9090, 0], [-1.4160, 50.9060, 0]]]
+    resolution = pab.ResolutionSpec(pab.IndexSystem.H3, 10)
+    restrictions = pab.RestrictionSet.compile_permanent([footprint], 0, 120, [resolution])
+    path = str(tmp_path / "restrictions.abrs")
+    restrictions.save(path)
+    opened = pab.RestrictionSet.open(path)
+    assert opened.cell_count(resolution) == restrictions.cell_count(resolution)
+
+    start = datetime.datetime(2020, 1, 1, 12, 0, 0)
+    volume = pab.Volume4D(footprint, 0, 120, pab.TimeSlice(start, start + datetime.timedelta(minutes=10)))
+    bookings = pab.get_H3_volume_bookings(volume, 10)
+    assert opened.touches(bookings, resolution)
+    assert opened.touched_restrictions(bookings, resolution) == [0]
+    assert not opened.touches([], resolution)
+
+
+def test_booking_buffer():
+    bookings = pab.get_H3_cell_bookings(soton1, h3_resolution=10)
+    buffer = pab.encode_bookings(bookings)
+    view = pab.BookingBufferView(buffer)
+    assert len(view) == len(bookings)
+
+    assert view.starts[0] == int(bookings[0].time_slice.start.timestamp()) * 10 ** 9
+    assert np.all(view.ends > view.starts)
+    assert not view.cell_keys.flags.writeable
+    assert view[0].cell_id == bookings[0].cell_id
+    assert [b.cell_id for b in view.to_cell_bookings()] == [b.cell_id for b in bookings]
+
+    # The columns can also be read without the bindings
+    count = int(np.frombuffer(buffer, dtype=np.uint64, count=1, offset=16)[0])
+    assert np.array_equal(np.frombuffer(buffer, dtype=np.uint64, count=count, offset=24), view.cell_keys)
+
+
+def test_booking_buffer_export(tmp_path):
+    import mmap
+    path = tmp_path / "bookings.bin"
+    path.write_bytes(pab.encode_bookings(pab.get_H3_cell_bookings(soton1, h3_resolution=10)))
+    with open(path, "rb") as f:
+        mapped = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    view = pab.BookingBufferView(mapped)
+    starts = view.starts
+    # The view exports the mapping, and its arrays keep the view alive
+    del view
+    try:
+        mapped.close()
+        assert False, "the mapping was closed under a live view"
+    except BufferError:
+        pass
+    assert np.all(starts > 0)
+    del starts
+    mapped.close()
+
+
+def test_compact_bookings():
+    bookings = pab.get_H3_cell_bookings(soton1, h3_resolution=10)
+    batch = pab.CompactBookingBatch.from_cell_bookings(bookings)
+    assert len(batch) == len(bookings)
+    assert batch.epoch == min(b.time_slice.start for b in bookings)
+    assert batch.bookings[0].end > batch.bookings[0].start
+
+    expanded = batch.to_cell_bookings()
+    assert [b.cell_id for b in expanded] == [b.cell_id for b in bookings]
+    assert [b.time_slice.start for b in expanded] == [b.time_slice.start for b in bookings]
+
+
+def test_simplify_trajectory():
+    simplified = pab.simplify_trajectory(soton1, 20, 10, 30)
+    assert 2 <= len(simplified) <= len(soton1)
+    assert simplified[0].time == soton1[0].time
+    assert simplified[-1].time == soton1[-1].time
+
+    options = pab.BookingOptions()
+    options.simplify_tolerance = 0.2
+    options.stats = pab.BookingStats()
+    cells = {b.cell_id for b in pab.get_H3_cell_bookings(soton1, h3_resolution=10, options=options)}
+    assert {b.cell_id for b in pab.get_H3_cell_bookings(soton1, h3_resolution=10)} <= cells
+    assert options.stats.simplified_points >= 0
+
+
+def test_long_haul_tiling():
+    start = datetime.datetime(2020, 1, 1, 12, 0, 0)
+    trajectory = [pab.StateVector4D([-0.45, 51.47, 3000], start, 200),
+                  pab.StateVector4D([2.55, 49.01, 3000], start + datetime.timedelta(seconds=1740), 200)]
+    options = pab.BookingOptions()
+    assert options.tile_long_trajectories
+    options.local_projection_max_radius = 50e3
+    bookings = pab.get_H3_cell_bookings(trajectory, h3_resolution=8, options=options)
+    cells = [b.cell_id for b in bookings]
+    assert len(cells) == len(set(cells))
+
+
+def test_coalesce_and_merge_layers():
+    options = pab.BookingOptions()
+    options.temporal_merge_gap = 60
+    options.max_merged_slice_length = 3600
+    merged = pab.get_H3D_cell_bookings(soton1, h3_resolution=10, options=options)
+    bookings = pab.get_H3D_cell_bookings(soton1, h3_resolution=10)
+    assert len(merged) <= len(bookings)
+    assert len(pab.coalesce_cell_bookings(bookings, datetime.timedelta(seconds=60),
+                                          datetime.timedelta(seconds=3600))) == len(merged)
+
+    spans = pab.merge_vertical_layers(bookings)
+    assert len(spans) <= len(bookings)
+    assert sum(span.layers for span in spans) == len(bookings)
+    assert sorted(b.cell_id for b in pab.expand_vertical_layers(spans)) == sorted(b.cell_id for b in bookings)
+
+
+def test_booking_limits():
+    resolutions = [pab.ResolutionSpec(pab.IndexSystem.H3, 11)]
+    cost = pab.estimate_booking_cost(soton1, resolutions)
+    assert cost.samples > 0
+    assert cost.indexer_calls >= cost.samples
+    assert cost.cells > 0
+
+    options = pab.BookingOptions()
+    options.max_samples = cost.samples // 10
+    try:
+        pab.get_H3_cell_bookings(soton1, h3_resolution=11, options=options)
+        assert False
+    except pab.BookingLimitError:
+        pass
+    options.max_samples = 0
+    options.time_limit = datetime.timedelta(minutes=1)
+    assert pab.get_H3_cell_bookings(soton1, h3_resolution=11, options=options)
+
+
+def test_cancellation():
+    import threading, time
+    options = pab.BookingOptions()
+    options.cancellation = pab.CancellationToken()
+    # Bookings release the GIL, so another thread can cancel one while it runs
+    canceller = threading.Timer(0.2, options.cancellation.cancel)
+    canceller.start()
+    started = time.monotonic()
+    try:
+        pab.get_H3_cell_bookings(soton1, spatial_lateral_buffer=3000, h3_resolution=15, options=options)
+        assert False, "the booking finished before it was cancelled"
+    except pab.BookingCancelledError:
+        pass
+    canceller.join()
+    assert options.cancellation.cancelled
+    assert time.monotonic() - started < 10
+
+
+def test_occupancy_aggregation():
+    aggregator = pab.OccupancyAggregator(datetime.timedelta(minutes=15), datetime.datetime(2020, 1, 1, 12, 0, 0))
+    aggregator.add_all((op, pab.get_H3_cell_bookings(soton1, h3_resolution=9)) for op in range(3))
+    assert len(aggregator) > 0
+    occupancy = aggregator.occupancy()
+    assert len(occupancy) == aggregator.cell_count
+    assert all(cell.peak_concurrency == 3 and cell.operations == 3 for cell in occupancy)
+    assert all(max(cell.histogram) == 3 for cell in occupancy)
+
+    parents = aggregator.rollup(pab.IndexSystem.H3, 7)
+    assert [parent.cell_id for parent in parents] == sorted(
+        {pab.parent_cell(cell.cell_id, pab.IndexSystem.H3, 7) for cell in occupancy})
+    assert all(parent.operations == 3 for parent in parents)
+
+
+def test_cell_capacity():
+    import tempfile, pathlib
+    cells = pab.get_H3_cell_bookings(soton1, h3_resolution=9)
+    store = pab.BookingStore(default_capacity=2)
+    store.add(1, cells)
+    assert store.is_free(cells)
+    assert store.max_occupancy(cells[0].cell_id, cells[0].time_slice.start, cells[0].time_slice.end) == 1
+    store.add(2, cells)
+    assert not store.is_free(cells)
+    saturated = store.saturated_slices(cells[0].cell_id, cells[0].time_slice.start, cells[0].time_slice.end)
+    assert len(saturated) == 1
+
+    with tempfile.TemporaryDirectory() as tmp:
+        path = pathlib.Path(tmp) / "capacities.txt"
+        path.write_text("* 3\n")
+        store.load_capacities(str(path))
+    assert store.default_capacity == 3
+    assert store.is_free(cells)
+    store.set_capacity(cells[0].cell_id, 2)
+    assert store.capacity(cells[0].cell_id) == 2
+    assert not store.is_free(cells)
+
+
+def test_occupied_cells():
+    import datetime
+    cells = pab.get_H3_cell_bookings(soton1, h3_resolution=9)
+    store = pab.BookingStore(occupancy_bucket_width=datetime.timedelta(minutes=5))
+    assert store.occupancy_bucket_width == datetime.timedelta(minutes=5)
+    store.add(1, cells[:len(cells) // 2])
+    cell_ids = [c.cell_id for c in cells]
+    start = min(c.time_slice.start for c in cells)
+    end = max(c.time_slice.end for c in cells)
+    occupied = store.occupied_cells(cell_ids, start, end)
+    assert set(occupied) == {c.cell_id for c in cells[:len(cells) // 2]}
+    assert set(store.unoccupied_cells(cell_ids, start, end)) == set(cell_ids) - set(occupied)
+
+
+def test_remove_bookings():
+    cells = pab.get_H3_cell_bookings(soton1, h3_resolution=9)
+    store = pab.BookingStore()
+    store.add(1, cells)
+    store.add(2, cells[:1])
+    assert store.operation_count == 2
+    assert store.cells_of(2) == [cells[0].cell_id]
+    assert store.operations_in(cells[0].cell_id, cells[0].time_slice.start, cells[0].time_slice.end) == [1, 2]
+    assert store.remove(2) == 1
+    assert store.remove([1, 3]) == len(cells)
+    assert len(store) == 0 and store.cell_count == 0
+    assert store.is_free(cells)
+
+
 if __name__ == '__main__':
     test_h3_cell_booking()
     test_h3d_cell_booking()
     test_h3_volume_booking()
+    test_booking_stats()
+    test_multi_resolution_booking()
+    test_booking_cache()
+    test_detect_conflicts()
+    test_conflict_candidate_pairs()
+    test_earliest_free_offset()
+    test_find_free_route()
+    import tempfile, pathlib
+    with tempfile.TemporaryDirectory() as tmp:
+        test_restriction_set(pathlib.Path(tmp))
+    test_booking_buffer()
+    with tempfile.TemporaryDirectory() as tmp:
+        test_booking_buffer_export(pathlib.Path(tmp))
+    test_compact_bookings()
+    test_simplify_trajectory()
+    test_long_haul_tiling()
+    test_coalesce_and_merge_layers()
+    test_booking_limits()
+    test_cancellation()
+    test_occupancy_aggregation()
+    test_cell_capacity()
+    test_occupied_cells()
+    test_remove_bookings()